@@ -372,6 +372,7 @@ static struct apartment *apartment_construct(DWORD model)
     list_init(&apt->stubmgrs);
     list_init(&apt->loaded_dlls);
     list_init(&apt->usage_cookies);
+    list_init(&apt->pending_calls);
     apt->ipidc = 0;
     apt->refs = 1;
     apt->remunk_exported = FALSE;
@@ -1105,14 +1106,20 @@ static HRESULT apartment_hostobject(struct apartment *apt, const struct host_obj
     return hr;
 }
 
-struct dispatch_params;
-
 static LRESULT CALLBACK apartment_wndproc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
+    struct apartment *apt;
+
     switch (msg)
     {
     case DM_EXECUTERPC:
-        rpc_execute_call((struct dispatch_params *)lParam);
+        /* callers keep a reference to the apartment, so the thread might
+         * have already left it */
+        if ((apt = (struct apartment *)GetWindowLongPtrW(hWnd, GWLP_USERDATA))) rpc_execute_pending_calls(apt);
+        return 0;
+    case WM_DESTROY:
+        /* nothing will run the calls that are still queued */
+        if ((apt = (struct apartment *)GetWindowLongPtrW(hWnd, GWLP_USERDATA))) rpc_cancel_pending_calls(apt);
         return 0;
     case DM_HOSTOBJECT:
         return apartment_hostobject(com_get_current_apt(), (const struct host_object_params *)lParam);
@@ -1269,6 +1276,8 @@ HRESULT apartment_createwindowifneeded(struct apartment *apt)
         if (InterlockedCompareExchangePointer((void **)&apt->win, hwnd, NULL))
             /* someone beat us to it */
             DestroyWindow(hwnd);
+        else
+            SetWindowLongPtrW(hwnd, GWLP_USERDATA, (LONG_PTR)apt);
     }
 
     return S_OK;
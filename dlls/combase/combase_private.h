@@ -46,6 +46,8 @@ struct apartment
 
     /* STA-only fields */
     HWND win;                /* message window (LOCK) */
+    struct list pending_calls; /* in-process calls to be run by the apartment thread (CS cs) */
+    BOOL calls_posted;       /* has a DM_EXECUTERPC message been posted for pending_calls? (CS cs) */
     IMessageFilter *filter;  /* message filter (CS cs) */
     BOOL main;               /* is this a main-threaded-apartment? (RO) */
 
@@ -57,7 +59,7 @@ HRESULT open_key_for_clsid(REFCLSID clsid, const WCHAR *keyname, REGSAM access,
 HRESULT open_appidkey_from_clsid(REFCLSID clsid, REGSAM access, HKEY *subkey);
 
 /* DCOM messages used by the apartment window (not compatible with native) */
-#define DM_EXECUTERPC   (WM_USER + 0) /* WPARAM = 0, LPARAM = (struct dispatch_params *) */
+#define DM_EXECUTERPC   (WM_USER + 0) /* WPARAM = 0, LPARAM = 0, calls are queued in apt->pending_calls */
 #define DM_HOSTOBJECT   (WM_USER + 1) /* WPARAM = 0, LPARAM = (struct host_object_params *) */
 
 #define CHARS_IN_GUID 39
@@ -134,6 +136,8 @@ void rpc_unregister_channel_hooks(void);
 
 struct dispatch_params;
 void rpc_execute_call(struct dispatch_params *params);
+void rpc_execute_pending_calls(struct apartment *apt);
+void rpc_cancel_pending_calls(struct apartment *apt);
 
 enum class_reg_data_origin
 {
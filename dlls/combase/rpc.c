@@ -36,6 +36,8 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(ole);
 
+static HRESULT rpc_post_call(struct apartment *apt, struct dispatch_params *params);
+static void rpc_cancel_call(struct apartment *apt, struct dispatch_params *params);
 static void __RPC_STUB dispatch_rpc(RPC_MESSAGE *msg);
 
 /* we only use one function to dispatch calls for all methods - we use the
@@ -97,10 +99,12 @@ typedef struct
     DWORD                  server_pid; /* id of server process */
     HANDLE                 event; /* cached event handle */
     IID                    iid; /* IID of the proxy this belongs to */
+    RPC_CLIENT_INTERFACE   cif; /* RPC interface information passed with each message */
 } ClientRpcChannelBuffer;
 
 struct dispatch_params
 {
+    struct list        entry; /* entry in the apartment's pending_calls list */
     RPCOLEMESSAGE     *msg; /* message */
     IRpcStubBuffer    *stub; /* stub buffer, if applicable */
     IRpcChannelBuffer *chan; /* server channel buffer, if applicable */
@@ -122,6 +126,7 @@ struct message_state
     /* client only */
     HWND target_hwnd;
     DWORD target_tid;
+    struct apartment *target_apt;
     struct dispatch_params params;
 };
 
@@ -1161,7 +1166,6 @@ static HRESULT WINAPI ClientRpcChannelBuffer_GetBuffer(LPRPCCHANNELBUFFER iface,
 {
     ClientRpcChannelBuffer *This = (ClientRpcChannelBuffer *)iface;
     RPC_MESSAGE *msg = (RPC_MESSAGE *)olemsg;
-    RPC_CLIENT_INTERFACE *cif;
     RPC_STATUS status;
     ORPCTHIS *orpcthis;
     struct message_state *message_state;
@@ -1175,25 +1179,12 @@ static HRESULT WINAPI ClientRpcChannelBuffer_GetBuffer(LPRPCCHANNELBUFFER iface,
 
     TRACE("(%p)->(%p,%s)\n", This, olemsg, debugstr_guid(riid));
 
-    cif = calloc(1, sizeof(RPC_CLIENT_INTERFACE));
-    if (!cif)
-        return E_OUTOFMEMORY;
-
     message_state = malloc(sizeof(*message_state));
     if (!message_state)
-    {
-        free(cif);
         return E_OUTOFMEMORY;
-    }
 
-    cif->Length = sizeof(RPC_CLIENT_INTERFACE);
-    /* RPC interface ID = COM interface ID */
-    cif->InterfaceId.SyntaxGUID = This->iid;
-    /* COM objects always have a version of 0.0 */
-    cif->InterfaceId.SyntaxVersion.MajorVersion = 0;
-    cif->InterfaceId.SyntaxVersion.MinorVersion = 0;
     msg->Handle = This->bind;
-    msg->RpcInterfaceInformation = cif;
+    msg->RpcInterfaceInformation = &This->cif;
 
     message_state->prefix_data_len = 0;
     message_state->binding_handle = This->bind;
@@ -1206,7 +1197,9 @@ static HRESULT WINAPI ClientRpcChannelBuffer_GetBuffer(LPRPCCHANNELBUFFER iface,
     message_state->channel_hook_info.pObject = NULL; /* only present on server-side */
     message_state->target_hwnd = NULL;
     message_state->target_tid = 0;
+    message_state->target_apt = NULL;
     memset(&message_state->params, 0, sizeof(message_state->params));
+    list_init(&message_state->params.entry);
 
     extensions_size = ChannelHooks_ClientGetSize(&message_state->channel_hook_info,
         &channel_hook_data, &channel_hook_count, &extension_count);
@@ -1245,6 +1238,9 @@ static HRESULT WINAPI ClientRpcChannelBuffer_GetBuffer(LPRPCCHANNELBUFFER iface,
              * means call directly instead of going through RPC runtime */
             if (!message_state->target_hwnd)
                 ERR("window for apartment %s is NULL\n", wine_dbgstr_longlong(apt->oxid));
+            /* keep the reference, the call is queued in the apartment */
+            message_state->target_apt = apt;
+            apt = NULL;
         }
     }
     if (apt) apartment_release(apt);
@@ -1416,16 +1412,9 @@ static HRESULT WINAPI ClientRpcChannelBuffer_SendReceive(LPRPCCHANNELBUFFER ifac
 
         msg->ProcNum &= ~RPC_FLAGS_VALID_BIT;
 
-        if (!PostMessageW(message_state->target_hwnd, DM_EXECUTERPC, 0,
-                          (LPARAM)&message_state->params))
-        {
-            ERR("PostMessage failed with error %lu\n", GetLastError());
-
-            /* Note: message_state->params.iface doesn't have a reference and
-             * so doesn't need to be released */
-
-            hr = HRESULT_FROM_WIN32(GetLastError());
-        }
+        /* Note: message_state->params.iface doesn't have a reference and
+         * so doesn't need to be released on failure */
+        hr = rpc_post_call(message_state->target_apt, &message_state->params);
     }
     else
     {
@@ -1451,6 +1440,9 @@ static HRESULT WINAPI ClientRpcChannelBuffer_SendReceive(LPRPCCHANNELBUFFER ifac
             tlsdata->pending_call_count_client++;
             hr = CoWaitForMultipleHandles(0, INFINITE, 1, &message_state->params.handle, &index);
             tlsdata->pending_call_count_client--;
+            /* the call might still be queued, don't let the apartment see it after FreeBuffer() */
+            if (hr != S_OK && message_state->params.bypass_rpcrt)
+                rpc_cancel_call(message_state->target_apt, &message_state->params);
         }
     }
     ClientRpcChannelBuffer_ReleaseEventHandle(This, message_state->params.handle);
@@ -1566,13 +1558,14 @@ static HRESULT WINAPI ClientRpcChannelBuffer_FreeBuffer(LPRPCCHANNELBUFFER iface
     else
         status = I_RpcFreeBuffer(msg);
 
-    free(msg->RpcInterfaceInformation);
     msg->RpcInterfaceInformation = NULL;
 
     if (message_state->params.stub)
         IRpcStubBuffer_Release(message_state->params.stub);
     if (message_state->params.chan)
         IRpcChannelBuffer_Release(message_state->params.chan);
+    if (message_state->target_apt)
+        apartment_release(message_state->target_apt);
     free(message_state);
 
     TRACE("-- %ld\n", status);
@@ -1696,6 +1689,13 @@ HRESULT rpc_create_clientchannel(const OXID *oxid, const IPID *ipid,
     This->server_pid = oxid_info->dwPid;
     This->event = NULL;
     This->iid = *iid;
+    memset(&This->cif, 0, sizeof(This->cif));
+    This->cif.Length = sizeof(RPC_CLIENT_INTERFACE);
+    /* RPC interface ID = COM interface ID */
+    This->cif.InterfaceId.SyntaxGUID = *iid;
+    /* COM objects always have a version of 0.0 */
+    This->cif.InterfaceId.SyntaxVersion.MajorVersion = 0;
+    This->cif.InterfaceId.SyntaxVersion.MinorVersion = 0;
 
     *chan = &This->super.IRpcChannelBuffer_iface;
 
@@ -1869,7 +1869,7 @@ static HRESULT unmarshal_ORPCTHAT(RPC_MESSAGE *msg, ORPCTHAT *orpcthat,
 
 void rpc_execute_call(struct dispatch_params *params)
 {
-    struct message_state *message_state = NULL;
+    struct message_state state, *message_state;
     RPC_MESSAGE *msg = (RPC_MESSAGE *)params->msg;
     char *original_buffer = msg->Buffer;
     ORPCTHIS orpcthis;
@@ -1893,14 +1893,8 @@ void rpc_execute_call(struct dispatch_params *params)
         goto exit;
     }
 
-    message_state = malloc(sizeof(*message_state));
-    if (!message_state)
-    {
-        params->hr = E_OUTOFMEMORY;
-        msg->Buffer = original_buffer;
-        goto exit;
-    }
-
+    /* the state is only used by the server channel while the stub is invoked */
+    message_state = &state;
     message_state->prefix_data_len = (char *)msg->Buffer - original_buffer;
     message_state->binding_handle = msg->Handle;
     message_state->bypass_rpcrt = params->bypass_rpcrt;
@@ -1986,10 +1980,96 @@ exit_reset_state:
     msg->BufferLength += message_state->prefix_data_len;
 
 exit:
-    free(message_state);
     if (params->handle) SetEvent(params->handle);
 }
 
+/* Queues an in-process call for execution by the thread of a single-threaded
+ * apartment. A message is only posted to the apartment window if none is
+ * pending, so that calls made while the apartment is busy are run in a batch. */
+static HRESULT rpc_post_call(struct apartment *apt, struct dispatch_params *params)
+{
+    HRESULT hr = S_OK;
+
+    EnterCriticalSection(&apt->cs);
+    list_add_tail(&apt->pending_calls, &params->entry);
+    if (!apt->calls_posted)
+    {
+        if (PostMessageW(apartment_getwindow(apt), DM_EXECUTERPC, 0, 0))
+            apt->calls_posted = TRUE;
+        else
+        {
+            hr = HRESULT_FROM_WIN32(GetLastError());
+            ERR("PostMessage failed, hr %#lx\n", hr);
+            list_remove(&params->entry);
+            list_init(&params->entry);
+        }
+    }
+    LeaveCriticalSection(&apt->cs);
+
+    return hr;
+}
+
+/* Removes a call from the queue of the apartment, if it's still there. */
+static void rpc_cancel_call(struct apartment *apt, struct dispatch_params *params)
+{
+    EnterCriticalSection(&apt->cs);
+    list_remove(&params->entry);
+    list_init(&params->entry);
+    LeaveCriticalSection(&apt->cs);
+}
+
+/* Runs the calls queued when DM_EXECUTERPC was received. Calls queued later
+ * post a new message, so that they still get executed if a call enters a
+ * modal loop, and so that other window messages aren't starved. */
+void rpc_execute_pending_calls(struct apartment *apt)
+{
+    struct list *entry;
+    unsigned int count;
+
+    EnterCriticalSection(&apt->cs);
+    apt->calls_posted = FALSE;
+    count = list_count(&apt->pending_calls);
+    LeaveCriticalSection(&apt->cs);
+
+    while (count--)
+    {
+        EnterCriticalSection(&apt->cs);
+        if ((entry = list_head(&apt->pending_calls)))
+        {
+            list_remove(entry);
+            list_init(entry);
+        }
+        LeaveCriticalSection(&apt->cs);
+        if (!entry) break;
+
+        rpc_execute_call(LIST_ENTRY(entry, struct dispatch_params, entry));
+    }
+}
+
+/* Fails the queued calls when the apartment window goes away. */
+void rpc_cancel_pending_calls(struct apartment *apt)
+{
+    struct dispatch_params *params;
+    struct list *entry;
+
+    for (;;)
+    {
+        EnterCriticalSection(&apt->cs);
+        apt->calls_posted = FALSE;
+        if ((entry = list_head(&apt->pending_calls)))
+        {
+            list_remove(entry);
+            list_init(entry);
+        }
+        LeaveCriticalSection(&apt->cs);
+        if (!entry) break;
+
+        params = LIST_ENTRY(entry, struct dispatch_params, entry);
+        params->hr = RPC_E_DISCONNECTED;
+        if (params->handle) SetEvent(params->handle);
+    }
+}
+
 static void __RPC_STUB dispatch_rpc(RPC_MESSAGE *msg)
 {
     struct dispatch_params *params;
@@ -2019,6 +2099,7 @@ static void __RPC_STUB dispatch_rpc(RPC_MESSAGE *msg)
         return;
     }
 
+    list_init(&params->entry);
     params->msg = (RPCOLEMESSAGE *)msg;
     params->status = RPC_S_OK;
     params->hr = S_OK;
@@ -2034,11 +2115,10 @@ static void __RPC_STUB dispatch_rpc(RPC_MESSAGE *msg)
 
         TRACE("Calling apartment thread %#lx...\n", apt->tid);
 
-        if (PostMessageW(apartment_getwindow(apt), DM_EXECUTERPC, 0, (LPARAM)params))
+        if (rpc_post_call(apt, params) == S_OK)
             WaitForSingleObject(params->handle, INFINITE);
         else
         {
-            ERR("PostMessage failed with error %lu\n", GetLastError());
             IRpcChannelBuffer_Release(params->chan);
             IRpcStubBuffer_Release(params->stub);
         }
@@ -159,6 +159,30 @@ enum d2d_device_context_target_type
     D2D_TARGET_COMMAND_LIST,
 };
 
+/* Consecutive draws with identical shader constants and brush are merged
+ * into a single draw call. */
+struct d2d_draw_batch
+{
+    enum d2d_shape_type shape_type;
+    struct d2d_brush *brush;
+    struct d2d_vs_cb vs_cb;
+    struct d2d_ps_cb ps_cb;
+
+    BYTE *vertices;
+    size_t vertices_size;
+    size_t vertex_count;
+    unsigned int vertex_stride;
+
+    UINT16 *indices;
+    size_t indices_size;
+    size_t index_count;
+
+    ID3D11Buffer *vb;
+    size_t vb_size;
+    ID3D11Buffer *ib;
+    size_t ib_size;
+};
+
 struct d2d_device_context
 {
     ID2D1DeviceContext1 ID2D1DeviceContext1_iface;
@@ -208,6 +232,14 @@ struct d2d_device_context
     D2D1_RENDER_TARGET_PROPERTIES desc;
     D2D1_SIZE_U pixel_size;
     struct d2d_clip_stack clip_stack;
+
+    struct d2d_draw_batch batch;
+    struct
+    {
+        unsigned int primitive_count;
+        unsigned int batched_count;
+        unsigned int draw_count;
+    } stats;
 };
 
 HRESULT d2d_d3d_create_render_target(struct d2d_device *device, IDXGISurface *surface, IUnknown *outer_unknown,
@@ -485,6 +517,27 @@ struct d2d_curve_outline_vertex
     D2D1_POINT_2F prev, next;
 };
 
+struct d2d_geometry_buffers
+{
+    ID3D11Device1 *device;
+
+    struct
+    {
+        BOOL valid;
+        ID3D11Buffer *ib, *vb;
+        ID3D11Buffer *bezier_vb;
+        ID3D11Buffer *arc_vb;
+    } fill;
+
+    struct
+    {
+        BOOL valid;
+        ID3D11Buffer *ib, *vb;
+        ID3D11Buffer *bezier_ib, *bezier_vb;
+        ID3D11Buffer *arc_ib, *arc_vb;
+    } outline;
+};
+
 struct d2d_geometry
 {
     ID2D1Geometry ID2D1Geometry_iface;
@@ -494,6 +547,10 @@ struct d2d_geometry
 
     D2D_MATRIX_3X2_F transform;
 
+    /* Device buffers for the fill and outline data below, created on first
+     * use. The data is in geometry space, so they are valid for any transform. */
+    struct d2d_geometry_buffers buffers;
+
     struct
     {
         D2D1_POINT_2F *vertices;
@@ -593,6 +650,8 @@ void d2d_transformed_geometry_init(struct d2d_geometry *geometry, ID2D1Factory *
 HRESULT d2d_geometry_group_init(struct d2d_geometry *geometry, ID2D1Factory *factory,
         D2D1_FILL_MODE fill_mode, ID2D1Geometry **src_geometries, unsigned int geometry_count);
 struct d2d_geometry *unsafe_impl_from_ID2D1Geometry(ID2D1Geometry *iface);
+struct d2d_geometry *d2d_geometry_get_tessellation_source(const struct d2d_geometry *geometry);
+void d2d_geometry_buffers_cleanup(struct d2d_geometry_buffers *buffers);
 
 struct d2d_shader
 {
@@ -22,6 +22,7 @@
 WINE_DEFAULT_DEBUG_CHANNEL(d2d);
 
 #define INITIAL_CLIP_STACK_SIZE 4
+#define D2D_MAX_BATCH_VERTEX_COUNT 256
 
 static const D2D1_MATRIX_3X2_F identity =
 {{{
@@ -188,6 +189,7 @@ static void d2d_device_context_draw(struct d2d_device_context *render_target, en
         ID3D11DeviceContext1_DrawIndexed(context, index_count, 0, 0);
     else
         ID3D11DeviceContext1_Draw(context, index_count, 0);
+    ++render_target->stats.draw_count;
 
     ID3D11DeviceContext1_SwapDeviceContextState(context, prev_state, NULL);
     ID3D11DeviceContext1_Release(context);
@@ -197,6 +199,256 @@ static void d2d_device_context_draw(struct d2d_device_context *render_target, en
         LeaveCriticalSection(render_target->cs);
 }
 
+static HRESULT d2d_device_context_write_cb(struct d2d_device_context *context,
+        ID3D11Buffer *buffer, const void *data, size_t size)
+{
+    D3D11_MAPPED_SUBRESOURCE map_desc;
+    ID3D11DeviceContext *d3d_context;
+    HRESULT hr;
+
+    ID3D11Device1_GetImmediateContext(context->d3d_device, &d3d_context);
+
+    if (FAILED(hr = ID3D11DeviceContext_Map(d3d_context, (ID3D11Resource *)buffer,
+            0, D3D11_MAP_WRITE_DISCARD, 0, &map_desc)))
+    {
+        WARN("Failed to map constant buffer, hr %#lx.\n", hr);
+        ID3D11DeviceContext_Release(d3d_context);
+        return hr;
+    }
+
+    memcpy(map_desc.pData, data, size);
+
+    ID3D11DeviceContext_Unmap(d3d_context, (ID3D11Resource *)buffer, 0);
+    ID3D11DeviceContext_Release(d3d_context);
+
+    return S_OK;
+}
+
+static void d2d_device_context_get_ps_cb(struct d2d_brush *brush, struct d2d_brush *opacity_brush,
+        BOOL outline, BOOL is_arc, struct d2d_ps_cb *cb_data)
+{
+    memset(cb_data, 0, sizeof(*cb_data));
+    cb_data->outline = outline;
+    cb_data->is_arc = is_arc;
+    if (!d2d_brush_fill_cb(brush, &cb_data->colour_brush))
+        WARN("Failed to initialize colour brush buffer.\n");
+    if (!d2d_brush_fill_cb(opacity_brush, &cb_data->opacity_brush))
+        WARN("Failed to initialize opacity brush buffer.\n");
+}
+
+static void d2d_device_context_get_vs_cb(struct d2d_device_context *context,
+        const D2D_MATRIX_3X2_F *geometry_transform, float stroke_width, struct d2d_vs_cb *cb_data)
+{
+    const D2D1_MATRIX_3X2_F *w;
+    float tmp_x, tmp_y;
+
+    cb_data->transform_geometry._11 = geometry_transform->_11;
+    cb_data->transform_geometry._21 = geometry_transform->_21;
+    cb_data->transform_geometry._31 = geometry_transform->_31;
+    cb_data->transform_geometry.pad0 = 0.0f;
+    cb_data->transform_geometry._12 = geometry_transform->_12;
+    cb_data->transform_geometry._22 = geometry_transform->_22;
+    cb_data->transform_geometry._32 = geometry_transform->_32;
+    cb_data->transform_geometry.stroke_width = stroke_width;
+
+    w = &context->drawing_state.transform;
+
+    tmp_x = context->desc.dpiX / 96.0f;
+    cb_data->transform_rtx.x = w->_11 * tmp_x;
+    cb_data->transform_rtx.y = w->_21 * tmp_x;
+    cb_data->transform_rtx.z = w->_31 * tmp_x;
+    cb_data->transform_rtx.w = 2.0f / context->pixel_size.width;
+
+    tmp_y = context->desc.dpiY / 96.0f;
+    cb_data->transform_rty.x = w->_12 * tmp_y;
+    cb_data->transform_rty.y = w->_22 * tmp_y;
+    cb_data->transform_rty.z = w->_32 * tmp_y;
+    cb_data->transform_rty.w = -2.0f / context->pixel_size.height;
+}
+
+static HRESULT d2d_device_context_update_dynamic_buffer(struct d2d_device_context *context,
+        ID3D11Buffer **buffer, size_t *buffer_size, UINT bind_flags, const void *data, size_t size)
+{
+    D3D11_MAPPED_SUBRESOURCE map_desc;
+    ID3D11DeviceContext *d3d_context;
+    D3D11_BUFFER_DESC buffer_desc;
+    HRESULT hr;
+
+    if (*buffer_size < size)
+    {
+        if (*buffer)
+            ID3D11Buffer_Release(*buffer);
+        *buffer = NULL;
+        *buffer_size = 0;
+
+        buffer_desc.ByteWidth = max(size, 0x10000);
+        buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+        buffer_desc.BindFlags = bind_flags;
+        buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        buffer_desc.MiscFlags = 0;
+
+        if (FAILED(hr = ID3D11Device1_CreateBuffer(context->d3d_device, &buffer_desc, NULL, buffer)))
+        {
+            WARN("Failed to create buffer, bind flags %#x, hr %#lx.\n", bind_flags, hr);
+            return hr;
+        }
+        *buffer_size = buffer_desc.ByteWidth;
+    }
+
+    ID3D11Device1_GetImmediateContext(context->d3d_device, &d3d_context);
+
+    if (SUCCEEDED(hr = ID3D11DeviceContext_Map(d3d_context, (ID3D11Resource *)*buffer,
+            0, D3D11_MAP_WRITE_DISCARD, 0, &map_desc)))
+    {
+        memcpy(map_desc.pData, data, size);
+        ID3D11DeviceContext_Unmap(d3d_context, (ID3D11Resource *)*buffer, 0);
+    }
+    else
+    {
+        WARN("Failed to map buffer, hr %#lx.\n", hr);
+    }
+
+    ID3D11DeviceContext_Release(d3d_context);
+
+    return hr;
+}
+
+static void d2d_device_context_flush_batch(struct d2d_device_context *context)
+{
+    struct d2d_draw_batch *batch = &context->batch;
+    size_t index_count, vertex_count;
+    struct d2d_brush *brush;
+    HRESULT hr;
+
+    if (!(index_count = batch->index_count))
+        return;
+
+    vertex_count = batch->vertex_count;
+    brush = batch->brush;
+    batch->index_count = 0;
+    batch->vertex_count = 0;
+    batch->brush = NULL;
+
+    if (FAILED(hr = d2d_device_context_update_dynamic_buffer(context, &batch->vb, &batch->vb_size,
+            D3D11_BIND_VERTEX_BUFFER, batch->vertices, vertex_count * batch->vertex_stride)))
+        goto done;
+    if (FAILED(hr = d2d_device_context_update_dynamic_buffer(context, &batch->ib, &batch->ib_size,
+            D3D11_BIND_INDEX_BUFFER, batch->indices, index_count * sizeof(*batch->indices))))
+        goto done;
+    if (FAILED(hr = d2d_device_context_write_cb(context, context->vs_cb, &batch->vs_cb, sizeof(batch->vs_cb))))
+        goto done;
+    if (FAILED(hr = d2d_device_context_write_cb(context, context->ps_cb, &batch->ps_cb, sizeof(batch->ps_cb))))
+        goto done;
+
+    d2d_device_context_draw(context, batch->shape_type, batch->ib, index_count,
+            batch->vb, batch->vertex_stride, brush, NULL);
+
+done:
+    if (FAILED(hr))
+        WARN("Failed to flush draw batch, hr %#lx.\n", hr);
+    ID2D1Brush_Release(&brush->ID2D1Brush_iface);
+}
+
+static void d2d_device_context_cleanup_batch(struct d2d_device_context *context)
+{
+    struct d2d_draw_batch *batch = &context->batch;
+
+    if (batch->brush)
+        ID2D1Brush_Release(&batch->brush->ID2D1Brush_iface);
+    if (batch->ib)
+        ID3D11Buffer_Release(batch->ib);
+    if (batch->vb)
+        ID3D11Buffer_Release(batch->vb);
+    free(batch->indices);
+    free(batch->vertices);
+}
+
+/* Brush resources are only bound when the batch is flushed, so only batch
+ * draws with brushes whose resources can't change in the meantime. */
+static BOOL d2d_device_context_can_batch(const struct d2d_brush *brush, const struct d2d_brush *opacity_brush)
+{
+    if (opacity_brush)
+        return FALSE;
+
+    return brush->type == D2D_BRUSH_TYPE_SOLID
+            || brush->type == D2D_BRUSH_TYPE_LINEAR
+            || brush->type == D2D_BRUSH_TYPE_RADIAL;
+}
+
+static BOOL d2d_device_context_batch_draw(struct d2d_device_context *context, enum d2d_shape_type shape_type,
+        const D2D_MATRIX_3X2_F *geometry_transform, float stroke_width, struct d2d_brush *brush, BOOL outline,
+        const void *vertices, size_t vertex_count, unsigned int vertex_stride,
+        const struct d2d_face *faces, size_t face_count)
+{
+    struct d2d_draw_batch *batch = &context->batch;
+    struct d2d_ps_cb ps_cb;
+    struct d2d_vs_cb vs_cb;
+    UINT16 *indices;
+    size_t i;
+
+    d2d_device_context_get_vs_cb(context, geometry_transform, stroke_width, &vs_cb);
+    d2d_device_context_get_ps_cb(brush, NULL, outline, FALSE, &ps_cb);
+
+    if (batch->index_count && (batch->shape_type != shape_type || batch->brush != brush
+            || batch->vertex_count + vertex_count > 0x10000
+            || memcmp(&batch->vs_cb, &vs_cb, sizeof(vs_cb))
+            || memcmp(&batch->ps_cb, &ps_cb, sizeof(ps_cb))))
+        d2d_device_context_flush_batch(context);
+
+    if (!d2d_array_reserve((void **)&batch->vertices, &batch->vertices_size,
+            (batch->vertex_count + vertex_count) * vertex_stride, 1))
+        return FALSE;
+    if (!d2d_array_reserve((void **)&batch->indices, &batch->indices_size,
+            batch->index_count + 3 * face_count, sizeof(*batch->indices)))
+        return FALSE;
+
+    if (!batch->index_count)
+    {
+        batch->shape_type = shape_type;
+        ID2D1Brush_AddRef(&brush->ID2D1Brush_iface);
+        batch->brush = brush;
+        batch->vs_cb = vs_cb;
+        batch->ps_cb = ps_cb;
+        batch->vertex_stride = vertex_stride;
+    }
+
+    memcpy(batch->vertices + batch->vertex_count * vertex_stride, vertices, vertex_count * vertex_stride);
+    indices = &batch->indices[batch->index_count];
+    for (i = 0; i < face_count; ++i)
+    {
+        *indices++ = batch->vertex_count + faces[i].v[0];
+        *indices++ = batch->vertex_count + faces[i].v[1];
+        *indices++ = batch->vertex_count + faces[i].v[2];
+    }
+    batch->vertex_count += vertex_count;
+    batch->index_count += 3 * face_count;
+    ++context->stats.batched_count;
+
+    return TRUE;
+}
+
+static HRESULT d2d_device_context_update_ps_cb(struct d2d_device_context *context,
+        struct d2d_brush *brush, struct d2d_brush *opacity_brush, BOOL outline, BOOL is_arc)
+{
+    struct d2d_ps_cb cb_data;
+
+    d2d_device_context_flush_batch(context);
+    d2d_device_context_get_ps_cb(brush, opacity_brush, outline, is_arc, &cb_data);
+
+    return d2d_device_context_write_cb(context, context->ps_cb, &cb_data, sizeof(cb_data));
+}
+
+static HRESULT d2d_device_context_update_vs_cb(struct d2d_device_context *context,
+        const D2D_MATRIX_3X2_F *geometry_transform, float stroke_width)
+{
+    struct d2d_vs_cb cb_data;
+
+    d2d_device_context_flush_batch(context);
+    d2d_device_context_get_vs_cb(context, geometry_transform, stroke_width, &cb_data);
+
+    return d2d_device_context_write_cb(context, context->vs_cb, &cb_data, sizeof(cb_data));
+}
+
 static void d2d_device_context_set_error(struct d2d_device_context *context, HRESULT code)
 {
     context->error.code = code;
@@ -264,6 +516,7 @@ static ULONG STDMETHODCALLTYPE d2d_device_context_inner_Release(IUnknown *iface)
     {
         unsigned int i, j, k;
 
+        d2d_device_context_cleanup_batch(context);
         d2d_clip_stack_cleanup(&context->clip_stack);
         IDWriteRenderingParams_Release(context->default_text_rendering_params);
         if (context->text_rendering_params)
@@ -738,98 +991,166 @@ static void STDMETHODCALLTYPE d2d_device_context_FillEllipse(ID2D1DeviceContext1
     ID2D1EllipseGeometry_Release(geometry);
 }
 
-static HRESULT d2d_device_context_update_ps_cb(struct d2d_device_context *context,
-        struct d2d_brush *brush, struct d2d_brush *opacity_brush, BOOL outline, BOOL is_arc)
+static HRESULT d2d_device_context_create_buffer(struct d2d_device_context *context,
+        UINT bind_flags, const void *data, size_t size, ID3D11Buffer **buffer)
 {
-    D3D11_MAPPED_SUBRESOURCE map_desc;
-    ID3D11DeviceContext *d3d_context;
-    struct d2d_ps_cb *cb_data;
+    D3D11_SUBRESOURCE_DATA buffer_data;
+    D3D11_BUFFER_DESC buffer_desc;
     HRESULT hr;
 
-    ID3D11Device1_GetImmediateContext(context->d3d_device, &d3d_context);
+    buffer_desc.ByteWidth = size;
+    buffer_desc.Usage = D3D11_USAGE_DEFAULT;
+    buffer_desc.BindFlags = bind_flags;
+    buffer_desc.CPUAccessFlags = 0;
+    buffer_desc.MiscFlags = 0;
 
-    if (FAILED(hr = ID3D11DeviceContext_Map(d3d_context, (ID3D11Resource *)context->ps_cb,
-            0, D3D11_MAP_WRITE_DISCARD, 0, &map_desc)))
+    buffer_data.pSysMem = data;
+    buffer_data.SysMemPitch = 0;
+    buffer_data.SysMemSlicePitch = 0;
+
+    if (FAILED(hr = ID3D11Device1_CreateBuffer(context->d3d_device, &buffer_desc, &buffer_data, buffer)))
+        WARN("Failed to create buffer, bind flags %#x, hr %#lx.\n", bind_flags, hr);
+
+    return hr;
+}
+
+/* Returns the buffers to draw "geometry" with, and the geometry holding
+ * the corresponding fill and outline data. Geometries that can't be cached
+ * use the temporary buffers in "tmp", which the caller needs to clean up. */
+static struct d2d_geometry_buffers *d2d_device_context_get_geometry_buffers(struct d2d_device_context *context,
+        const struct d2d_geometry *geometry, struct d2d_geometry_buffers *tmp, const struct d2d_geometry **data)
+{
+    struct d2d_geometry *source;
+
+    if (!(source = d2d_geometry_get_tessellation_source(geometry)))
     {
-        WARN("Failed to map constant buffer, hr %#lx.\n", hr);
-        ID3D11DeviceContext_Release(d3d_context);
-        return hr;
+        memset(tmp, 0, sizeof(*tmp));
+        *data = geometry;
+        return tmp;
     }
 
-    cb_data = map_desc.pData;
-    cb_data->outline = outline;
-    cb_data->is_arc = is_arc;
-    cb_data->pad[0] = 0;
-    cb_data->pad[1] = 0;
-    if (!d2d_brush_fill_cb(brush, &cb_data->colour_brush))
-        WARN("Failed to initialize colour brush buffer.\n");
-    if (!d2d_brush_fill_cb(opacity_brush, &cb_data->opacity_brush))
-        WARN("Failed to initialize opacity brush buffer.\n");
-
-    ID3D11DeviceContext_Unmap(d3d_context, (ID3D11Resource *)context->ps_cb, 0);
-    ID3D11DeviceContext_Release(d3d_context);
+    if (source->buffers.device != context->d3d_device)
+    {
+        d2d_geometry_buffers_cleanup(&source->buffers);
+        ID3D11Device1_AddRef(source->buffers.device = context->d3d_device);
+    }
 
-    return hr;
+    *data = source;
+    return &source->buffers;
 }
 
-static HRESULT d2d_device_context_update_vs_cb(struct d2d_device_context *context,
-        const D2D_MATRIX_3X2_F *geometry_transform, float stroke_width)
+static HRESULT d2d_device_context_update_outline_buffers(struct d2d_device_context *context,
+        const struct d2d_geometry *geometry, struct d2d_geometry_buffers *buffers)
 {
-    D3D11_MAPPED_SUBRESOURCE map_desc;
-    ID3D11DeviceContext *d3d_context;
-    const D2D1_MATRIX_3X2_F *w;
-    struct d2d_vs_cb *cb_data;
-    float tmp_x, tmp_y;
     HRESULT hr;
 
-    ID3D11Device1_GetImmediateContext(context->d3d_device, &d3d_context);
+    if (buffers->outline.valid)
+        return S_OK;
 
-    if (FAILED(hr = ID3D11DeviceContext_Map(d3d_context, (ID3D11Resource *)context->vs_cb,
-            0, D3D11_MAP_WRITE_DISCARD, 0, &map_desc)))
+    if (geometry->outline.face_count)
     {
-        WARN("Failed to map constant buffer, hr %#lx.\n", hr);
-        ID3D11DeviceContext_Release(d3d_context);
-        return hr;
+        if (FAILED(hr = d2d_device_context_create_buffer(context, D3D11_BIND_INDEX_BUFFER,
+                geometry->outline.faces, geometry->outline.face_count * sizeof(*geometry->outline.faces),
+                &buffers->outline.ib)))
+            goto fail;
+        if (FAILED(hr = d2d_device_context_create_buffer(context, D3D11_BIND_VERTEX_BUFFER,
+                geometry->outline.vertices, geometry->outline.vertex_count * sizeof(*geometry->outline.vertices),
+                &buffers->outline.vb)))
+            goto fail;
     }
 
-    cb_data = map_desc.pData;
-    cb_data->transform_geometry._11 = geometry_transform->_11;
-    cb_data->transform_geometry._21 = geometry_transform->_21;
-    cb_data->transform_geometry._31 = geometry_transform->_31;
-    cb_data->transform_geometry.pad0 = 0.0f;
-    cb_data->transform_geometry._12 = geometry_transform->_12;
-    cb_data->transform_geometry._22 = geometry_transform->_22;
-    cb_data->transform_geometry._32 = geometry_transform->_32;
-    cb_data->transform_geometry.stroke_width = stroke_width;
+    if (geometry->outline.bezier_face_count)
+    {
+        if (FAILED(hr = d2d_device_context_create_buffer(context, D3D11_BIND_INDEX_BUFFER,
+                geometry->outline.bezier_faces,
+                geometry->outline.bezier_face_count * sizeof(*geometry->outline.bezier_faces),
+                &buffers->outline.bezier_ib)))
+            goto fail;
+        if (FAILED(hr = d2d_device_context_create_buffer(context, D3D11_BIND_VERTEX_BUFFER,
+                geometry->outline.beziers, geometry->outline.bezier_count * sizeof(*geometry->outline.beziers),
+                &buffers->outline.bezier_vb)))
+            goto fail;
+    }
 
-    w = &context->drawing_state.transform;
+    if (geometry->outline.arc_face_count)
+    {
+        if (FAILED(hr = d2d_device_context_create_buffer(context, D3D11_BIND_INDEX_BUFFER,
+                geometry->outline.arc_faces, geometry->outline.arc_face_count * sizeof(*geometry->outline.arc_faces),
+                &buffers->outline.arc_ib)))
+            goto fail;
+        if (FAILED(hr = d2d_device_context_create_buffer(context, D3D11_BIND_VERTEX_BUFFER,
+                geometry->outline.arcs, geometry->outline.arc_count * sizeof(*geometry->outline.arcs),
+                &buffers->outline.arc_vb)))
+            goto fail;
+    }
 
-    tmp_x = context->desc.dpiX / 96.0f;
-    cb_data->transform_rtx.x = w->_11 * tmp_x;
-    cb_data->transform_rtx.y = w->_21 * tmp_x;
-    cb_data->transform_rtx.z = w->_31 * tmp_x;
-    cb_data->transform_rtx.w = 2.0f / context->pixel_size.width;
+    buffers->outline.valid = TRUE;
+    return S_OK;
 
-    tmp_y = context->desc.dpiY / 96.0f;
-    cb_data->transform_rty.x = w->_12 * tmp_y;
-    cb_data->transform_rty.y = w->_22 * tmp_y;
-    cb_data->transform_rty.z = w->_32 * tmp_y;
-    cb_data->transform_rty.w = -2.0f / context->pixel_size.height;
+fail:
+    d2d_geometry_buffers_cleanup(buffers);
+    return hr;
+}
 
-    ID3D11DeviceContext_Unmap(d3d_context, (ID3D11Resource *)context->vs_cb, 0);
-    ID3D11DeviceContext_Release(d3d_context);
+static HRESULT d2d_device_context_update_fill_buffers(struct d2d_device_context *context,
+        const struct d2d_geometry *geometry, struct d2d_geometry_buffers *buffers)
+{
+    HRESULT hr;
 
+    if (buffers->fill.valid)
+        return S_OK;
+
+    if (geometry->fill.face_count)
+    {
+        if (FAILED(hr = d2d_device_context_create_buffer(context, D3D11_BIND_INDEX_BUFFER,
+                geometry->fill.faces, geometry->fill.face_count * sizeof(*geometry->fill.faces),
+                &buffers->fill.ib)))
+            goto fail;
+        if (FAILED(hr = d2d_device_context_create_buffer(context, D3D11_BIND_VERTEX_BUFFER,
+                geometry->fill.vertices, geometry->fill.vertex_count * sizeof(*geometry->fill.vertices),
+                &buffers->fill.vb)))
+            goto fail;
+    }
+
+    if (geometry->fill.bezier_vertex_count && FAILED(hr = d2d_device_context_create_buffer(context,
+            D3D11_BIND_VERTEX_BUFFER, geometry->fill.bezier_vertices,
+            geometry->fill.bezier_vertex_count * sizeof(*geometry->fill.bezier_vertices),
+            &buffers->fill.bezier_vb)))
+        goto fail;
+
+    if (geometry->fill.arc_vertex_count && FAILED(hr = d2d_device_context_create_buffer(context,
+            D3D11_BIND_VERTEX_BUFFER, geometry->fill.arc_vertices,
+            geometry->fill.arc_vertex_count * sizeof(*geometry->fill.arc_vertices),
+            &buffers->fill.arc_vb)))
+        goto fail;
+
+    buffers->fill.valid = TRUE;
     return S_OK;
+
+fail:
+    d2d_geometry_buffers_cleanup(buffers);
+    return hr;
 }
 
 static void d2d_device_context_draw_geometry(struct d2d_device_context *render_target,
         const struct d2d_geometry *geometry, struct d2d_brush *brush, float stroke_width)
 {
-    D3D11_SUBRESOURCE_DATA buffer_data;
-    D3D11_BUFFER_DESC buffer_desc;
-    ID3D11Buffer *ib, *vb;
+    struct d2d_geometry_buffers *buffers, tmp;
+    const struct d2d_geometry *data;
     HRESULT hr;
 
+    ++render_target->stats.primitive_count;
+
+    if (!(data = d2d_geometry_get_tessellation_source(geometry)))
+        data = geometry;
+    if (d2d_device_context_can_batch(brush, NULL) && data->outline.face_count
+            && data->outline.vertex_count <= D2D_MAX_BATCH_VERTEX_COUNT
+            && !data->outline.bezier_face_count && !data->outline.arc_face_count
+            && d2d_device_context_batch_draw(render_target, D2D_SHAPE_TYPE_OUTLINE, &geometry->transform,
+            stroke_width, brush, TRUE, data->outline.vertices, data->outline.vertex_count,
+            sizeof(*data->outline.vertices), data->outline.faces, data->outline.face_count))
+        return;
+
     if (FAILED(hr = d2d_device_context_update_vs_cb(render_target, &geometry->transform, stroke_width)))
     {
         WARN("Failed to update vs constant buffer, hr %#lx.\n", hr);
@@ -842,105 +1163,38 @@ static void d2d_device_context_draw_geometry(struct d2d_device_context *render_t
         return;
     }
 
-    buffer_desc.Usage = D3D11_USAGE_DEFAULT;
-    buffer_desc.CPUAccessFlags = 0;
-    buffer_desc.MiscFlags = 0;
-
-    buffer_data.SysMemPitch = 0;
-    buffer_data.SysMemSlicePitch = 0;
-
-    if (geometry->outline.face_count)
-    {
-        buffer_desc.ByteWidth = geometry->outline.face_count * sizeof(*geometry->outline.faces);
-        buffer_desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-        buffer_data.pSysMem = geometry->outline.faces;
-
-        if (FAILED(hr = ID3D11Device1_CreateBuffer(render_target->d3d_device, &buffer_desc, &buffer_data, &ib)))
-        {
-            WARN("Failed to create index buffer, hr %#lx.\n", hr);
-            return;
-        }
-
-        buffer_desc.ByteWidth = geometry->outline.vertex_count * sizeof(*geometry->outline.vertices);
-        buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-        buffer_data.pSysMem = geometry->outline.vertices;
-
-        if (FAILED(hr = ID3D11Device1_CreateBuffer(render_target->d3d_device, &buffer_desc, &buffer_data, &vb)))
-        {
-            ERR("Failed to create vertex buffer, hr %#lx.\n", hr);
-            ID3D11Buffer_Release(ib);
-            return;
-        }
-
-        d2d_device_context_draw(render_target, D2D_SHAPE_TYPE_OUTLINE, ib, 3 * geometry->outline.face_count, vb,
-                sizeof(*geometry->outline.vertices), brush, NULL);
-
-        ID3D11Buffer_Release(vb);
-        ID3D11Buffer_Release(ib);
-    }
+    if (render_target->cs)
+        EnterCriticalSection(render_target->cs);
 
-    if (geometry->outline.bezier_face_count)
+    buffers = d2d_device_context_get_geometry_buffers(render_target, geometry, &tmp, &data);
+    if (FAILED(hr = d2d_device_context_update_outline_buffers(render_target, data, buffers)))
     {
-        buffer_desc.ByteWidth = geometry->outline.bezier_face_count * sizeof(*geometry->outline.bezier_faces);
-        buffer_desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-        buffer_data.pSysMem = geometry->outline.bezier_faces;
-
-        if (FAILED(hr = ID3D11Device1_CreateBuffer(render_target->d3d_device, &buffer_desc, &buffer_data, &ib)))
-        {
-            WARN("Failed to create curves index buffer, hr %#lx.\n", hr);
-            return;
-        }
-
-        buffer_desc.ByteWidth = geometry->outline.bezier_count * sizeof(*geometry->outline.beziers);
-        buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-        buffer_data.pSysMem = geometry->outline.beziers;
-
-        if (FAILED(hr = ID3D11Device1_CreateBuffer(render_target->d3d_device, &buffer_desc, &buffer_data, &vb)))
-        {
-            ERR("Failed to create curves vertex buffer, hr %#lx.\n", hr);
-            ID3D11Buffer_Release(ib);
-            return;
-        }
-
-        d2d_device_context_draw(render_target, D2D_SHAPE_TYPE_BEZIER_OUTLINE, ib,
-                3 * geometry->outline.bezier_face_count, vb,
-                sizeof(*geometry->outline.beziers), brush, NULL);
-
-        ID3D11Buffer_Release(vb);
-        ID3D11Buffer_Release(ib);
+        WARN("Failed to create outline buffers, hr %#lx.\n", hr);
+        goto done;
     }
 
-    if (geometry->outline.arc_face_count)
-    {
-        buffer_desc.ByteWidth = geometry->outline.arc_face_count * sizeof(*geometry->outline.arc_faces);
-        buffer_desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-        buffer_data.pSysMem = geometry->outline.arc_faces;
+    if (buffers->outline.ib)
+        d2d_device_context_draw(render_target, D2D_SHAPE_TYPE_OUTLINE, buffers->outline.ib,
+                3 * data->outline.face_count, buffers->outline.vb,
+                sizeof(*data->outline.vertices), brush, NULL);
 
-        if (FAILED(hr = ID3D11Device1_CreateBuffer(render_target->d3d_device, &buffer_desc, &buffer_data, &ib)))
-        {
-            WARN("Failed to create arcs index buffer, hr %#lx.\n", hr);
-            return;
-        }
+    if (buffers->outline.bezier_ib)
+        d2d_device_context_draw(render_target, D2D_SHAPE_TYPE_BEZIER_OUTLINE, buffers->outline.bezier_ib,
+                3 * data->outline.bezier_face_count, buffers->outline.bezier_vb,
+                sizeof(*data->outline.beziers), brush, NULL);
 
-        buffer_desc.ByteWidth = geometry->outline.arc_count * sizeof(*geometry->outline.arcs);
-        buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-        buffer_data.pSysMem = geometry->outline.arcs;
+    if (buffers->outline.arc_ib && SUCCEEDED(d2d_device_context_update_ps_cb(render_target,
+            brush, NULL, TRUE, TRUE)))
+        d2d_device_context_draw(render_target, D2D_SHAPE_TYPE_ARC_OUTLINE, buffers->outline.arc_ib,
+                3 * data->outline.arc_face_count, buffers->outline.arc_vb,
+                sizeof(*data->outline.arcs), brush, NULL);
 
-        if (FAILED(hr = ID3D11Device1_CreateBuffer(render_target->d3d_device, &buffer_desc, &buffer_data, &vb)))
-        {
-            ERR("Failed to create arcs vertex buffer, hr %#lx.\n", hr);
-            ID3D11Buffer_Release(ib);
-            return;
-        }
-
-        if (SUCCEEDED(d2d_device_context_update_ps_cb(render_target, brush, NULL, TRUE, TRUE)))
-            d2d_device_context_draw(render_target, D2D_SHAPE_TYPE_ARC_OUTLINE, ib,
-                    3 * geometry->outline.arc_face_count, vb,
-                    sizeof(*geometry->outline.arcs), brush, NULL);
+done:
+    if (buffers == &tmp)
+        d2d_geometry_buffers_cleanup(&tmp);
 
-        ID3D11Buffer_Release(vb);
-        ID3D11Buffer_Release(ib);
-    }
+    if (render_target->cs)
+        LeaveCriticalSection(render_target->cs);
 }
 
 static void STDMETHODCALLTYPE d2d_device_context_DrawGeometry(ID2D1DeviceContext1 *iface,
@@ -976,17 +1230,21 @@ static void STDMETHODCALLTYPE d2d_device_context_DrawGeometry(ID2D1DeviceContext
 static void d2d_device_context_fill_geometry(struct d2d_device_context *render_target,
         const struct d2d_geometry *geometry, struct d2d_brush *brush, struct d2d_brush *opacity_brush)
 {
-    D3D11_SUBRESOURCE_DATA buffer_data;
-    D3D11_BUFFER_DESC buffer_desc;
-    ID3D11Buffer *ib, *vb;
+    struct d2d_geometry_buffers *buffers, tmp;
+    const struct d2d_geometry *data;
     HRESULT hr;
 
-    buffer_desc.Usage = D3D11_USAGE_DEFAULT;
-    buffer_desc.CPUAccessFlags = 0;
-    buffer_desc.MiscFlags = 0;
+    ++render_target->stats.primitive_count;
 
-    buffer_data.SysMemPitch = 0;
-    buffer_data.SysMemSlicePitch = 0;
+    if (!(data = d2d_geometry_get_tessellation_source(geometry)))
+        data = geometry;
+    if (d2d_device_context_can_batch(brush, opacity_brush) && data->fill.face_count
+            && data->fill.vertex_count <= D2D_MAX_BATCH_VERTEX_COUNT
+            && !data->fill.bezier_vertex_count && !data->fill.arc_vertex_count
+            && d2d_device_context_batch_draw(render_target, D2D_SHAPE_TYPE_TRIANGLE, &geometry->transform,
+            0.0f, brush, FALSE, data->fill.vertices, data->fill.vertex_count,
+            sizeof(*data->fill.vertices), data->fill.faces, data->fill.face_count))
+        return;
 
     if (FAILED(hr = d2d_device_context_update_vs_cb(render_target, &geometry->transform, 0.0f)))
     {
@@ -1000,72 +1258,36 @@ static void d2d_device_context_fill_geometry(struct d2d_device_context *render_t
         return;
     }
 
-    if (geometry->fill.face_count)
-    {
-        buffer_desc.ByteWidth = geometry->fill.face_count * sizeof(*geometry->fill.faces);
-        buffer_desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-        buffer_data.pSysMem = geometry->fill.faces;
-
-        if (FAILED(hr = ID3D11Device1_CreateBuffer(render_target->d3d_device, &buffer_desc, &buffer_data, &ib)))
-        {
-            WARN("Failed to create index buffer, hr %#lx.\n", hr);
-            return;
-        }
-
-        buffer_desc.ByteWidth = geometry->fill.vertex_count * sizeof(*geometry->fill.vertices);
-        buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-        buffer_data.pSysMem = geometry->fill.vertices;
-
-        if (FAILED(hr = ID3D11Device1_CreateBuffer(render_target->d3d_device, &buffer_desc, &buffer_data, &vb)))
-        {
-            ERR("Failed to create vertex buffer, hr %#lx.\n", hr);
-            ID3D11Buffer_Release(ib);
-            return;
-        }
-
-        d2d_device_context_draw(render_target, D2D_SHAPE_TYPE_TRIANGLE, ib, 3 * geometry->fill.face_count, vb,
-                sizeof(*geometry->fill.vertices), brush, opacity_brush);
-
-        ID3D11Buffer_Release(vb);
-        ID3D11Buffer_Release(ib);
-    }
+    if (render_target->cs)
+        EnterCriticalSection(render_target->cs);
 
-    if (geometry->fill.bezier_vertex_count)
+    buffers = d2d_device_context_get_geometry_buffers(render_target, geometry, &tmp, &data);
+    if (FAILED(hr = d2d_device_context_update_fill_buffers(render_target, data, buffers)))
     {
-        buffer_desc.ByteWidth = geometry->fill.bezier_vertex_count * sizeof(*geometry->fill.bezier_vertices);
-        buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-        buffer_data.pSysMem = geometry->fill.bezier_vertices;
-
-        if (FAILED(hr = ID3D11Device1_CreateBuffer(render_target->d3d_device, &buffer_desc, &buffer_data, &vb)))
-        {
-            ERR("Failed to create curves vertex buffer, hr %#lx.\n", hr);
-            return;
-        }
-
-        d2d_device_context_draw(render_target, D2D_SHAPE_TYPE_CURVE, NULL, geometry->fill.bezier_vertex_count, vb,
-                sizeof(*geometry->fill.bezier_vertices), brush, opacity_brush);
-
-        ID3D11Buffer_Release(vb);
+        WARN("Failed to create fill buffers, hr %#lx.\n", hr);
+        goto done;
     }
 
-    if (geometry->fill.arc_vertex_count)
-    {
-        buffer_desc.ByteWidth = geometry->fill.arc_vertex_count * sizeof(*geometry->fill.arc_vertices);
-        buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-        buffer_data.pSysMem = geometry->fill.arc_vertices;
+    if (buffers->fill.ib)
+        d2d_device_context_draw(render_target, D2D_SHAPE_TYPE_TRIANGLE, buffers->fill.ib,
+                3 * data->fill.face_count, buffers->fill.vb,
+                sizeof(*data->fill.vertices), brush, opacity_brush);
 
-        if (FAILED(hr = ID3D11Device1_CreateBuffer(render_target->d3d_device, &buffer_desc, &buffer_data, &vb)))
-        {
-            ERR("Failed to create arc vertex buffer, hr %#lx.\n", hr);
-            return;
-        }
+    if (buffers->fill.bezier_vb)
+        d2d_device_context_draw(render_target, D2D_SHAPE_TYPE_CURVE, NULL, data->fill.bezier_vertex_count,
+                buffers->fill.bezier_vb, sizeof(*data->fill.bezier_vertices), brush, opacity_brush);
 
-        if (SUCCEEDED(d2d_device_context_update_ps_cb(render_target, brush, opacity_brush, FALSE, TRUE)))
-            d2d_device_context_draw(render_target, D2D_SHAPE_TYPE_CURVE, NULL, geometry->fill.arc_vertex_count, vb,
-                    sizeof(*geometry->fill.arc_vertices), brush, opacity_brush);
+    if (buffers->fill.arc_vb && SUCCEEDED(d2d_device_context_update_ps_cb(render_target,
+            brush, opacity_brush, FALSE, TRUE)))
+        d2d_device_context_draw(render_target, D2D_SHAPE_TYPE_CURVE, NULL, data->fill.arc_vertex_count,
+                buffers->fill.arc_vb, sizeof(*data->fill.arc_vertices), brush, opacity_brush);
 
-        ID3D11Buffer_Release(vb);
-    }
+done:
+    if (buffers == &tmp)
+        d2d_geometry_buffers_cleanup(&tmp);
+
+    if (render_target->cs)
+        LeaveCriticalSection(render_target->cs);
 }
 
 static void STDMETHODCALLTYPE d2d_device_context_FillGeometry(ID2D1DeviceContext1 *iface,
@@ -1738,6 +1960,8 @@ static HRESULT STDMETHODCALLTYPE d2d_device_context_Flush(ID2D1DeviceContext1 *i
 
     FIXME("iface %p, tag1 %p, tag2 %p stub!\n", iface, tag1, tag2);
 
+    d2d_device_context_flush_batch(context);
+
     if (context->ops && context->ops->device_context_present)
         context->ops->device_context_present(context->outer_unknown);
 
@@ -1823,6 +2047,7 @@ static void STDMETHODCALLTYPE d2d_device_context_PushAxisAlignedClip(ID2D1Device
             clip_rect->right * x_scale, clip_rect->bottom * y_scale);
     d2d_rect_expand(&transformed_rect, &point);
 
+    d2d_device_context_flush_batch(context);
     if (!d2d_clip_stack_push(&context->clip_stack, &transformed_rect))
         WARN("Failed to push clip rect.\n");
 }
@@ -1836,6 +2061,7 @@ static void STDMETHODCALLTYPE d2d_device_context_PopAxisAlignedClip(ID2D1DeviceC
     if (context->target.type == D2D_TARGET_COMMAND_LIST)
         d2d_command_list_pop_clip(context->target.command_list);
 
+    d2d_device_context_flush_batch(context);
     d2d_clip_stack_pop(&context->clip_stack);
 }
 
@@ -1857,6 +2083,8 @@ static void STDMETHODCALLTYPE d2d_device_context_Clear(ID2D1DeviceContext1 *ifac
         return;
     }
 
+    d2d_device_context_flush_batch(context);
+
     ID3D11Device1_GetImmediateContext(context->d3d_device, &d3d_context);
 
     if (FAILED(hr = ID3D11DeviceContext_Map(d3d_context, (ID3D11Resource *)context->vs_cb,
@@ -1926,6 +2154,7 @@ static void STDMETHODCALLTYPE d2d_device_context_BeginDraw(ID2D1DeviceContext1 *
         d2d_command_list_begin_draw(context->target.command_list, context);
 
     memset(&context->error, 0, sizeof(context->error));
+    memset(&context->stats, 0, sizeof(context->stats));
 }
 
 static HRESULT STDMETHODCALLTYPE d2d_device_context_EndDraw(ID2D1DeviceContext1 *iface,
@@ -1942,6 +2171,10 @@ static HRESULT STDMETHODCALLTYPE d2d_device_context_EndDraw(ID2D1DeviceContext1
         return E_NOTIMPL;
     }
 
+    d2d_device_context_flush_batch(context);
+    TRACE("Drew %u primitives using %u draw calls, %u primitives were batched.\n",
+            context->stats.primitive_count, context->stats.draw_count, context->stats.batched_count);
+
     if (tag1)
         *tag1 = context->error.tag1;
     if (tag2)
@@ -2383,6 +2616,8 @@ static void STDMETHODCALLTYPE d2d_device_context_SetTarget(ID2D1DeviceContext1 *
 
     TRACE("iface %p, target %p.\n", iface, target);
 
+    d2d_device_context_flush_batch(context);
+
     if (!target)
     {
         d2d_device_context_reset_target(context);
@@ -3152,6 +3387,7 @@ static HRESULT STDMETHODCALLTYPE d2d_gdi_interop_render_target_GetDC(ID2D1GdiInt
     if (FAILED(hr = d2d_gdi_interop_get_surface(render_target, &surface)))
         return hr;
 
+    d2d_device_context_flush_batch(render_target);
     hr = IDXGISurface1_GetDC(surface, mode != D2D1_DC_INITIALIZE_MODE_COPY, &render_target->target.hdc);
     IDXGISurface1_Release(surface);
 
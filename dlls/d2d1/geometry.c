@@ -1915,6 +1915,10 @@ static int __cdecl d2d_geometry_intersections_compare(const void *a, const void
         return i0->vertex_idx - i1->vertex_idx;
     if (i0->t != i1->t)
         return i0->t > i1->t ? 1 : -1;
+    if (i0->p.x != i1->p.x)
+        return i0->p.x > i1->p.x ? 1 : -1;
+    if (i0->p.y != i1->p.y)
+        return i0->p.y > i1->p.y ? 1 : -1;
     return 0;
 }
 
@@ -2191,82 +2195,146 @@ static BOOL d2d_geometry_apply_intersections(struct d2d_geometry *geometry,
     return TRUE;
 }
 
-/* Intersect the geometry's segments with themselves. This uses the
- * straightforward approach of testing everything against everything, but
- * there certainly exist more scalable algorithms for this. */
+struct d2d_geometry_segment
+{
+    struct d2d_segment_idx idx;
+    enum d2d_vertex_type type;
+    D2D1_RECT_F bounds;
+};
+
+static int __cdecl d2d_geometry_segment_compare(const void *a, const void *b)
+{
+    const struct d2d_geometry_segment *s0 = a;
+    const struct d2d_geometry_segment *s1 = b;
+
+    if (s0->bounds.left != s1->bounds.left)
+        return s0->bounds.left > s1->bounds.left ? 1 : -1;
+    if (s0->idx.figure_idx != s1->idx.figure_idx)
+        return s0->idx.figure_idx > s1->idx.figure_idx ? 1 : -1;
+    if (s0->idx.vertex_idx != s1->idx.vertex_idx)
+        return s0->idx.vertex_idx > s1->idx.vertex_idx ? 1 : -1;
+    return 0;
+}
+
+static BOOL d2d_geometry_get_segments(struct d2d_geometry *geometry,
+        struct d2d_geometry_segment **segments, size_t *segment_count)
+{
+    const struct d2d_figure *figure;
+    struct d2d_geometry_segment *s;
+    struct d2d_segment_idx idx;
+    size_t count = 0, next;
+
+    for (idx.figure_idx = 0; idx.figure_idx < geometry->u.path.figure_count; ++idx.figure_idx)
+        count += geometry->u.path.figures[idx.figure_idx].vertex_count;
+
+    *segment_count = 0;
+    if (!count)
+    {
+        *segments = NULL;
+        return TRUE;
+    }
+
+    if (!(*segments = calloc(count, sizeof(**segments))))
+    {
+        ERR("Failed to allocate segments array.\n");
+        return FALSE;
+    }
+
+    s = *segments;
+    for (idx.figure_idx = 0; idx.figure_idx < geometry->u.path.figure_count; ++idx.figure_idx)
+    {
+        figure = &geometry->u.path.figures[idx.figure_idx];
+        idx.control_idx = 0;
+        for (idx.vertex_idx = 0; idx.vertex_idx < figure->vertex_count; ++idx.vertex_idx)
+        {
+            if (figure->vertex_types[idx.vertex_idx] == D2D_VERTEX_TYPE_END)
+                continue;
+
+            s->idx = idx;
+            s->type = figure->vertex_types[idx.vertex_idx];
+            s->bounds.left = s->bounds.right = figure->vertices[idx.vertex_idx].x;
+            s->bounds.top = s->bounds.bottom = figure->vertices[idx.vertex_idx].y;
+            if ((next = idx.vertex_idx + 1) == figure->vertex_count)
+                next = 0;
+            d2d_rect_expand(&s->bounds, &figure->vertices[next]);
+            /* The control polygon always contains the curve. */
+            if (d2d_vertex_type_is_bezier(s->type))
+                d2d_rect_expand(&s->bounds, &figure->bezier_controls[idx.control_idx++]);
+            ++s;
+        }
+    }
+    *segment_count = s - *segments;
+
+    return TRUE;
+}
+
+static BOOL d2d_geometry_intersect_segments(struct d2d_geometry *geometry,
+        struct d2d_geometry_intersections *intersections, const struct d2d_geometry_segment *p,
+        const struct d2d_geometry_segment *q)
+{
+    const struct d2d_geometry_segment *tmp;
+
+    /* Pass the later segment as "p", like an exhaustive search would. The
+     * sweep finds candidate pairs in a different order, so intersections are
+     * recorded in a different order as well; d2d_geometry_intersect_self()
+     * sorts them before applying them. */
+    if (p->idx.figure_idx < q->idx.figure_idx
+            || (p->idx.figure_idx == q->idx.figure_idx && p->idx.vertex_idx < q->idx.vertex_idx))
+    {
+        tmp = p;
+        p = q;
+        q = tmp;
+    }
+
+    if (p->idx.figure_idx != q->idx.figure_idx
+            && !d2d_rect_check_overlap(&geometry->u.path.figures[p->idx.figure_idx].bounds,
+            &geometry->u.path.figures[q->idx.figure_idx].bounds))
+        return TRUE;
+
+    if (d2d_vertex_type_is_bezier(q->type))
+    {
+        if (d2d_vertex_type_is_bezier(p->type))
+            return d2d_geometry_intersect_bezier_bezier(geometry, intersections,
+                    &p->idx, 0.0f, 1.0f, &q->idx, 0.0f, 1.0f);
+        return d2d_geometry_intersect_bezier_line(geometry, intersections, &q->idx, &p->idx);
+    }
+
+    if (d2d_vertex_type_is_bezier(p->type))
+        return d2d_geometry_intersect_bezier_line(geometry, intersections, &p->idx, &q->idx);
+    return d2d_geometry_intersect_line_line(geometry, intersections, &p->idx, &q->idx);
+}
+
+/* Intersect the geometry's segments with themselves. Segments are sorted by
+ * the left edge of their bounding boxes, and swept from left to right; only
+ * segments with overlapping bounding boxes are tested against each other. */
 static BOOL d2d_geometry_intersect_self(struct d2d_geometry *geometry)
 {
     struct d2d_geometry_intersections intersections = {0};
-    const struct d2d_figure *figure_p, *figure_q;
-    struct d2d_segment_idx idx_p, idx_q;
-    enum d2d_vertex_type type_p, type_q;
+    const struct d2d_geometry_segment *p, *q;
+    struct d2d_geometry_segment *segments;
+    size_t segment_count, i, j;
     BOOL ret = FALSE;
-    size_t max_q;
 
     if (!geometry->u.path.figure_count)
         return TRUE;
 
-    for (idx_p.figure_idx = 0; idx_p.figure_idx < geometry->u.path.figure_count; ++idx_p.figure_idx)
+    if (!d2d_geometry_get_segments(geometry, &segments, &segment_count))
+        return FALSE;
+
+    qsort(segments, segment_count, sizeof(*segments), d2d_geometry_segment_compare);
+
+    for (i = 0; i < segment_count; ++i)
     {
-        figure_p = &geometry->u.path.figures[idx_p.figure_idx];
-        idx_p.control_idx = 0;
-        for (idx_p.vertex_idx = 0; idx_p.vertex_idx < figure_p->vertex_count; ++idx_p.vertex_idx)
+        p = &segments[i];
+        for (j = i + 1; j < segment_count; ++j)
         {
-            if ((type_p = figure_p->vertex_types[idx_p.vertex_idx]) == D2D_VERTEX_TYPE_END)
+            q = &segments[j];
+            if (q->bounds.left > p->bounds.right)
+                break;
+            if (q->bounds.top > p->bounds.bottom || q->bounds.bottom < p->bounds.top)
                 continue;
-
-            for (idx_q.figure_idx = 0; idx_q.figure_idx <= idx_p.figure_idx; ++idx_q.figure_idx)
-            {
-                figure_q = &geometry->u.path.figures[idx_q.figure_idx];
-                if (idx_q.figure_idx != idx_p.figure_idx)
-                {
-                    if (!d2d_rect_check_overlap(&figure_p->bounds, &figure_q->bounds))
-                        continue;
-                    if ((max_q = figure_q->vertex_count)
-                            && figure_q->vertex_types[max_q - 1] == D2D_VERTEX_TYPE_END)
-                        --max_q;
-                }
-                else
-                {
-                    max_q = idx_p.vertex_idx;
-                }
-
-                idx_q.control_idx = 0;
-                for (idx_q.vertex_idx = 0; idx_q.vertex_idx < max_q; ++idx_q.vertex_idx)
-                {
-                    type_q = figure_q->vertex_types[idx_q.vertex_idx];
-                    if (d2d_vertex_type_is_bezier(type_q))
-                    {
-                        if (d2d_vertex_type_is_bezier(type_p))
-                        {
-                            if (!d2d_geometry_intersect_bezier_bezier(geometry, &intersections,
-                                    &idx_p, 0.0f, 1.0f, &idx_q, 0.0f, 1.0f))
-                                goto done;
-                        }
-                        else
-                        {
-                            if (!d2d_geometry_intersect_bezier_line(geometry, &intersections, &idx_q, &idx_p))
-                                goto done;
-                        }
-                        ++idx_q.control_idx;
-                    }
-                    else
-                    {
-                        if (d2d_vertex_type_is_bezier(type_p))
-                        {
-                            if (!d2d_geometry_intersect_bezier_line(geometry, &intersections, &idx_p, &idx_q))
-                                goto done;
-                        }
-                        else
-                        {
-                            if (!d2d_geometry_intersect_line_line(geometry, &intersections, &idx_p, &idx_q))
-                                goto done;
-                        }
-                    }
-                }
-            }
-            if (d2d_vertex_type_is_bezier(type_p))
-                ++idx_p.control_idx;
+            if (!d2d_geometry_intersect_segments(geometry, &intersections, p, q))
+                goto done;
         }
     }
 
@@ -2276,6 +2344,7 @@ static BOOL d2d_geometry_intersect_self(struct d2d_geometry *geometry)
 
 done:
     free(intersections.intersections);
+    free(segments);
     return ret;
 }
 
@@ -2728,6 +2797,7 @@ static void d2d_geometry_cleanup(struct d2d_geometry *geometry)
     free(geometry->fill.bezier_vertices);
     free(geometry->fill.faces);
     free(geometry->fill.vertices);
+    d2d_geometry_buffers_cleanup(&geometry->buffers);
     ID2D1Factory_Release(geometry->factory);
 }
 
@@ -5529,3 +5599,44 @@ struct d2d_geometry *unsafe_impl_from_ID2D1Geometry(ID2D1Geometry *iface)
             || iface->lpVtbl == (const ID2D1GeometryVtbl *)&d2d_geometry_group_vtbl);
     return CONTAINING_RECORD(iface, struct d2d_geometry, ID2D1Geometry_iface);
 }
+
+/* Returns the geometry owning the fill and outline data used to draw
+ * "geometry", or NULL if that data may still change. */
+struct d2d_geometry *d2d_geometry_get_tessellation_source(const struct d2d_geometry *geometry)
+{
+    while (geometry->ID2D1Geometry_iface.lpVtbl == (const ID2D1GeometryVtbl *)&d2d_transformed_geometry_vtbl)
+        geometry = unsafe_impl_from_ID2D1Geometry(geometry->u.transformed.src_geometry);
+
+    if (geometry->ID2D1Geometry_iface.lpVtbl == (const ID2D1GeometryVtbl *)&d2d_path_geometry_vtbl
+            && geometry->u.path.state != D2D_GEOMETRY_STATE_CLOSED)
+        return NULL;
+
+    return (struct d2d_geometry *)geometry;
+}
+
+void d2d_geometry_buffers_cleanup(struct d2d_geometry_buffers *buffers)
+{
+    ID3D11Buffer **b[] =
+    {
+        &buffers->fill.ib,
+        &buffers->fill.vb,
+        &buffers->fill.bezier_vb,
+        &buffers->fill.arc_vb,
+        &buffers->outline.ib,
+        &buffers->outline.vb,
+        &buffers->outline.bezier_ib,
+        &buffers->outline.bezier_vb,
+        &buffers->outline.arc_ib,
+        &buffers->outline.arc_vb,
+    };
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(b); ++i)
+    {
+        if (*b[i])
+            ID3D11Buffer_Release(*b[i]);
+    }
+    if (buffers->device)
+        ID3D11Device1_Release(buffers->device);
+    memset(buffers, 0, sizeof(*buffers));
+}
@@ -9066,6 +9066,208 @@ static void test_bezier_intersect(BOOL d3d11)
     release_test_context(&ctx);
 }
 
+static void test_large_path_geometry(BOOL d3d11)
+{
+    static const struct
+    {
+        unsigned int x, y;
+        DWORD colour;
+    }
+    tests[] =
+    {
+        {160, 240, 0xffff0000},
+        {190, 240, 0xffff0000},
+        {160, 210, 0xffff0000},
+        {480, 240, 0xffff0000},
+        {510, 240, 0xffff0000},
+        {480, 270, 0xffff0000},
+        {  5,   5, 0xffffffff},
+        {320, 240, 0xffffffff},
+        {635, 475, 0xffffffff},
+    };
+    LARGE_INTEGER frequency, start, end;
+    ID2D1TransformedGeometry *transformed_geometry;
+    struct d2d1_test_context ctx;
+    struct resource_readback rb;
+    ID2D1SolidColorBrush *brush;
+    ID2D1PathGeometry *geometry;
+    D2D1_MATRIX_3X2_F matrix;
+    ID2D1GeometrySink *sink;
+    ID2D1RenderTarget *rt;
+    D2D1_POINT_2F point;
+    D2D1_COLOR_F colour;
+    unsigned int i;
+    float angle;
+    HRESULT hr;
+
+    if (!init_test_context(&ctx, d3d11))
+        return;
+
+    rt = ctx.rt;
+    ID2D1RenderTarget_SetAntialiasMode(rt, D2D1_ANTIALIAS_MODE_ALIASED);
+    set_color(&colour, 1.0f, 0.0f, 0.0f, 1.0f);
+    hr = ID2D1RenderTarget_CreateSolidColorBrush(rt, &colour, NULL, &brush);
+    ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+
+    /* A {65/32} star polygon; every edge intersects most of the others. */
+    hr = ID2D1Factory_CreatePathGeometry(ctx.factory, &geometry);
+    ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+    hr = ID2D1PathGeometry_Open(geometry, &sink);
+    ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+    ID2D1GeometrySink_SetFillMode(sink, D2D1_FILL_MODE_WINDING);
+    set_point(&point, 280.0f, 240.0f);
+    ID2D1GeometrySink_BeginFigure(sink, point, D2D1_FIGURE_BEGIN_FILLED);
+    for (i = 1; i < 65; ++i)
+    {
+        angle = 2.0f * M_PI * ((i * 32) % 65) / 65.0f;
+        line_to(sink, 160.0f + 120.0f * cosf(angle), 240.0f + 120.0f * sinf(angle));
+    }
+    ID2D1GeometrySink_EndFigure(sink, D2D1_FIGURE_END_CLOSED);
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+    hr = ID2D1GeometrySink_Close(sink);
+    QueryPerformanceCounter(&end);
+    ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+    ID2D1GeometrySink_Release(sink);
+    trace("Closing the geometry took %.3f ms.\n", (end.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart);
+
+    set_matrix_identity(&matrix);
+    translate_matrix(&matrix, 320.0f, 0.0f);
+    hr = ID2D1Factory_CreateTransformedGeometry(ctx.factory, (ID2D1Geometry *)geometry,
+            &matrix, &transformed_geometry);
+    ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+
+    /* Draw the geometries a few times, to make sure reusing the buffers
+     * created for the first draw gives the same results. */
+    for (i = 0; i < 3; ++i)
+    {
+        QueryPerformanceCounter(&start);
+        ID2D1RenderTarget_BeginDraw(rt);
+        set_color(&colour, 1.0f, 1.0f, 1.0f, 1.0f);
+        ID2D1RenderTarget_Clear(rt, &colour);
+        ID2D1RenderTarget_FillGeometry(rt, (ID2D1Geometry *)geometry, (ID2D1Brush *)brush, NULL);
+        ID2D1RenderTarget_FillGeometry(rt, (ID2D1Geometry *)transformed_geometry, (ID2D1Brush *)brush, NULL);
+        hr = ID2D1RenderTarget_EndDraw(rt, NULL, NULL);
+        QueryPerformanceCounter(&end);
+        ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+        trace("Drawing %u took %.3f ms.\n", i, (end.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart);
+    }
+
+    get_surface_readback(&ctx, &rb);
+    for (i = 0; i < ARRAY_SIZE(tests); ++i)
+    {
+        DWORD c = get_readback_colour(&rb, tests[i].x, tests[i].y);
+
+        ok(compare_colour(c, tests[i].colour, 0), "Got unexpected colour 0x%08lx at position {%u, %u}.\n",
+                c, tests[i].x, tests[i].y);
+    }
+    release_resource_readback(&rb);
+
+    ID2D1TransformedGeometry_Release(transformed_geometry);
+    ID2D1PathGeometry_Release(geometry);
+    ID2D1SolidColorBrush_Release(brush);
+    release_test_context(&ctx);
+}
+
+static void test_draw_batching(BOOL d3d11)
+{
+    static const struct
+    {
+        unsigned int x, y;
+        DWORD colour;
+    }
+    tests[] =
+    {
+        { 10,  10, 0xffff0000},
+        { 50,  10, 0xff0000ff},
+        { 90,  10, 0xffff0000},
+        {610,  10, 0xff0000ff},
+        { 30,  10, 0xffffffff},
+        { 10, 110, 0xff00ff00},
+        { 10,  50, 0xffffffff},
+        {  5, 210, 0xffff0000},
+        { 15, 210, 0xffffffff},
+        { 50, 300, 0xffff0000},
+        { 50, 310, 0xffffffff},
+        {150, 300, 0xffffffff},
+    };
+    struct d2d1_test_context ctx;
+    struct resource_readback rb;
+    ID2D1SolidColorBrush *brush;
+    D2D1_MATRIX_3X2_F matrix;
+    ID2D1RenderTarget *rt;
+    D2D1_POINT_2F p0, p1;
+    D2D1_COLOR_F colour;
+    unsigned int i;
+    D2D1_RECT_F r;
+    HRESULT hr;
+
+    if (!init_test_context(&ctx, d3d11))
+        return;
+
+    rt = ctx.rt;
+    ID2D1RenderTarget_SetAntialiasMode(rt, D2D1_ANTIALIAS_MODE_ALIASED);
+    set_color(&colour, 1.0f, 0.0f, 0.0f, 1.0f);
+    hr = ID2D1RenderTarget_CreateSolidColorBrush(rt, &colour, NULL, &brush);
+    ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+
+    ID2D1RenderTarget_BeginDraw(rt);
+    set_color(&colour, 1.0f, 1.0f, 1.0f, 1.0f);
+    ID2D1RenderTarget_Clear(rt, &colour);
+
+    /* Changing the brush colour between draws. */
+    for (i = 0; i < 16; ++i)
+    {
+        if (i & 1)
+            set_color(&colour, 0.0f, 0.0f, 1.0f, 1.0f);
+        else
+            set_color(&colour, 1.0f, 0.0f, 0.0f, 1.0f);
+        ID2D1SolidColorBrush_SetColor(brush, &colour);
+        set_rect(&r, i * 40.0f, 0.0f, i * 40.0f + 20.0f, 20.0f);
+        ID2D1RenderTarget_FillRectangle(rt, &r, (ID2D1Brush *)brush);
+    }
+
+    /* Changing the transform between draws. */
+    set_color(&colour, 0.0f, 1.0f, 0.0f, 1.0f);
+    ID2D1SolidColorBrush_SetColor(brush, &colour);
+    set_matrix_identity(&matrix);
+    translate_matrix(&matrix, 0.0f, 100.0f);
+    ID2D1RenderTarget_SetTransform(rt, &matrix);
+    set_rect(&r, 0.0f, 0.0f, 20.0f, 20.0f);
+    ID2D1RenderTarget_FillRectangle(rt, &r, (ID2D1Brush *)brush);
+    set_matrix_identity(&matrix);
+    ID2D1RenderTarget_SetTransform(rt, &matrix);
+
+    /* Popping the clip before the draw is submitted. */
+    set_color(&colour, 1.0f, 0.0f, 0.0f, 1.0f);
+    ID2D1SolidColorBrush_SetColor(brush, &colour);
+    set_rect(&r, 0.0f, 200.0f, 10.0f, 220.0f);
+    ID2D1RenderTarget_PushAxisAlignedClip(rt, &r, D2D1_ANTIALIAS_MODE_ALIASED);
+    set_rect(&r, 0.0f, 200.0f, 20.0f, 220.0f);
+    ID2D1RenderTarget_FillRectangle(rt, &r, (ID2D1Brush *)brush);
+    ID2D1RenderTarget_PopAxisAlignedClip(rt);
+
+    set_point(&p0, 0.0f, 300.0f);
+    set_point(&p1, 100.0f, 300.0f);
+    ID2D1RenderTarget_DrawLine(rt, p0, p1, (ID2D1Brush *)brush, 4.0f, NULL);
+
+    hr = ID2D1RenderTarget_EndDraw(rt, NULL, NULL);
+    ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+
+    get_surface_readback(&ctx, &rb);
+    for (i = 0; i < ARRAY_SIZE(tests); ++i)
+    {
+        DWORD c = get_readback_colour(&rb, tests[i].x, tests[i].y);
+
+        ok(compare_colour(c, tests[i].colour, 0), "Got unexpected colour 0x%08lx at position {%u, %u}.\n",
+                c, tests[i].x, tests[i].y);
+    }
+    release_resource_readback(&rb);
+
+    ID2D1SolidColorBrush_Release(brush);
+    release_test_context(&ctx);
+}
+
 static void test_create_device(BOOL d3d11)
 {
     D2D1_CREATION_PROPERTIES properties = {0};
@@ -14313,6 +14515,8 @@ START_TEST(d2d1)
     queue_test(test_wic_gdi_interop);
     queue_test(test_layer);
     queue_test(test_bezier_intersect);
+    queue_test(test_large_path_geometry);
+    queue_test(test_draw_batching);
     queue_test(test_create_device);
     queue_test(test_bitmap_surface);
     queue_test(test_device_context);
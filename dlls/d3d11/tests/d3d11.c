@@ -33563,6 +33563,137 @@ static void test_deferred_context_rendering(void)
     release_test_context(&test_context);
 }
 
+static void test_deferred_context_redundant_state(void)
+{
+    ID3D11BlendState *red_blend, *green_blend, *blue_blend, *ret_blend;
+    ID3D11DeviceContext *immediate, *deferred;
+    struct d3d11_test_context test_context;
+    ID3D11CommandList *list1, *list2;
+    D3D11_BLEND_DESC blend_desc;
+    ULONG refcount, expected;
+    float blend_factor[4];
+    ID3D11Device *device;
+    UINT sample_mask;
+    DWORD color;
+    HRESULT hr;
+
+    static const struct vec4 white = {1.0f, 1.0f, 1.0f, 1.0f};
+    static const float black[] = {0.0f, 0.0f, 0.0f, 1.0f};
+
+    if (!init_test_context(&test_context, NULL))
+        return;
+
+    device = test_context.device;
+    immediate = test_context.immediate_context;
+
+    memset(&blend_desc, 0, sizeof(blend_desc));
+    blend_desc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_RED;
+    hr = ID3D11Device_CreateBlendState(device, &blend_desc, &red_blend);
+    ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+    blend_desc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_GREEN;
+    hr = ID3D11Device_CreateBlendState(device, &blend_desc, &green_blend);
+    ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+    blend_desc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_BLUE;
+    hr = ID3D11Device_CreateBlendState(device, &blend_desc, &blue_blend);
+    ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+
+    hr = ID3D11Device_CreateDeferredContext(device, 0, &deferred);
+    ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+
+    /* Only the last of several consecutive state changes affects a draw. */
+
+    expected = get_refcount(red_blend);
+    ID3D11DeviceContext_OMSetRenderTargets(deferred, 1, &test_context.backbuffer_rtv, NULL);
+    set_viewport(deferred, 0.0f, 0.0f, 320.0f, 240.0f, 0.0f, 1.0f);
+    set_viewport(deferred, 0.0f, 0.0f, 640.0f, 480.0f, 0.0f, 1.0f);
+    ID3D11DeviceContext_OMSetBlendState(deferred, red_blend, NULL, D3D11_DEFAULT_SAMPLE_MASK);
+    ID3D11DeviceContext_OMSetBlendState(deferred, green_blend, NULL, D3D11_DEFAULT_SAMPLE_MASK);
+    ID3D11DeviceContext_OMSetBlendState(deferred, blue_blend, NULL, D3D11_DEFAULT_SAMPLE_MASK);
+    test_context.immediate_context = deferred;
+    draw_color_quad(&test_context, &white);
+    test_context.immediate_context = immediate;
+    hr = ID3D11DeviceContext_FinishCommandList(deferred, FALSE, &list1);
+    ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+
+    ID3D11DeviceContext_ClearRenderTargetView(immediate, test_context.backbuffer_rtv, black);
+    ID3D11DeviceContext_ExecuteCommandList(immediate, list1, FALSE);
+    color = get_texture_color(test_context.backbuffer, 320, 240);
+    ok(color == 0xffff0000, "Got unexpected colour %#08lx.\n", color);
+    color = get_texture_color(test_context.backbuffer, 480, 360);
+    ok(color == 0xffff0000, "Got unexpected colour %#08lx.\n", color);
+
+    ID3D11CommandList_Release(list1);
+    refcount = get_refcount(red_blend);
+    ok(refcount == expected, "Got unexpected refcount %lu, expected %lu.\n", refcount, expected);
+
+    /* State set before a draw is not overwritten by state set after it. */
+
+    ID3D11DeviceContext_OMSetRenderTargets(deferred, 1, &test_context.backbuffer_rtv, NULL);
+    set_viewport(deferred, 0.0f, 0.0f, 320.0f, 480.0f, 0.0f, 1.0f);
+    ID3D11DeviceContext_OMSetBlendState(deferred, red_blend, NULL, D3D11_DEFAULT_SAMPLE_MASK);
+    test_context.immediate_context = deferred;
+    draw_color_quad(&test_context, &white);
+    test_context.immediate_context = immediate;
+    set_viewport(deferred, 320.0f, 0.0f, 320.0f, 480.0f, 0.0f, 1.0f);
+    ID3D11DeviceContext_OMSetBlendState(deferred, blue_blend, NULL, D3D11_DEFAULT_SAMPLE_MASK);
+    ID3D11DeviceContext_OMSetBlendState(deferred, green_blend, NULL, D3D11_DEFAULT_SAMPLE_MASK);
+    test_context.immediate_context = deferred;
+    draw_color_quad(&test_context, &white);
+    test_context.immediate_context = immediate;
+    /* Trailing state is part of the command list as well. */
+    ID3D11DeviceContext_OMSetBlendState(deferred, red_blend, NULL, D3D11_DEFAULT_SAMPLE_MASK);
+    ID3D11DeviceContext_OMSetBlendState(deferred, blue_blend, NULL, D3D11_DEFAULT_SAMPLE_MASK);
+    hr = ID3D11DeviceContext_FinishCommandList(deferred, FALSE, &list1);
+    ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+
+    ID3D11DeviceContext_ClearRenderTargetView(immediate, test_context.backbuffer_rtv, black);
+    ID3D11DeviceContext_ExecuteCommandList(immediate, list1, TRUE);
+    color = get_texture_color(test_context.backbuffer, 160, 240);
+    ok(color == 0xff0000ff, "Got unexpected colour %#08lx.\n", color);
+    color = get_texture_color(test_context.backbuffer, 480, 240);
+    ok(color == 0xff00ff00, "Got unexpected colour %#08lx.\n", color);
+    ID3D11DeviceContext_OMGetBlendState(immediate, &ret_blend, blend_factor, &sample_mask);
+    ok(!ret_blend, "Got unexpected blend state %p.\n", ret_blend);
+
+    /* Executing a command list that sets the same state in between does not
+     * make the surrounding state changes redundant. */
+
+    ID3D11DeviceContext_OMSetBlendState(deferred, green_blend, NULL, D3D11_DEFAULT_SAMPLE_MASK);
+    hr = ID3D11DeviceContext_FinishCommandList(deferred, FALSE, &list2);
+    ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+
+    ID3D11DeviceContext_OMSetRenderTargets(deferred, 1, &test_context.backbuffer_rtv, NULL);
+    set_viewport(deferred, 0.0f, 0.0f, 320.0f, 480.0f, 0.0f, 1.0f);
+    ID3D11DeviceContext_OMSetBlendState(deferred, red_blend, NULL, D3D11_DEFAULT_SAMPLE_MASK);
+    ID3D11DeviceContext_ExecuteCommandList(deferred, list2, TRUE);
+    test_context.immediate_context = deferred;
+    draw_color_quad(&test_context, &white);
+    test_context.immediate_context = immediate;
+    ID3D11DeviceContext_ExecuteCommandList(deferred, list1, FALSE);
+    ID3D11DeviceContext_OMSetBlendState(deferred, blue_blend, NULL, D3D11_DEFAULT_SAMPLE_MASK);
+    hr = ID3D11DeviceContext_FinishCommandList(deferred, TRUE, &list2);
+    ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+
+    ID3D11DeviceContext_ClearRenderTargetView(immediate, test_context.backbuffer_rtv, black);
+    ID3D11DeviceContext_OMSetBlendState(immediate, green_blend, NULL, D3D11_DEFAULT_SAMPLE_MASK);
+    ID3D11DeviceContext_ExecuteCommandList(immediate, list2, TRUE);
+    color = get_texture_color(test_context.backbuffer, 160, 240);
+    ok(color == 0xff0000ff, "Got unexpected colour %#08lx.\n", color);
+    color = get_texture_color(test_context.backbuffer, 480, 240);
+    ok(color == 0xff00ff00, "Got unexpected colour %#08lx.\n", color);
+    ID3D11DeviceContext_OMGetBlendState(immediate, &ret_blend, blend_factor, &sample_mask);
+    ok(ret_blend == green_blend, "Got unexpected blend state %p.\n", ret_blend);
+    ID3D11BlendState_Release(ret_blend);
+
+    ID3D11CommandList_Release(list2);
+    ID3D11CommandList_Release(list1);
+    ID3D11DeviceContext_Release(deferred);
+    ID3D11BlendState_Release(blue_blend);
+    ID3D11BlendState_Release(green_blend);
+    ID3D11BlendState_Release(red_blend);
+    release_test_context(&test_context);
+}
+
 static void test_deferred_context_queries(void)
 {
     ID3D11DeviceContext *immediate, *deferred;
@@ -36164,6 +36295,154 @@ static void test_high_resource_count(void)
     release_test_context(&test_context);
 }
 
+static void test_shader_cache_child(void)
+{
+    static const struct vec4 green = {0.0f, 1.0f, 0.0f, 1.0f};
+    struct d3d11_test_context test_context;
+
+    if (!init_test_context(&test_context, NULL))
+        return;
+
+    draw_color_quad(&test_context, &green);
+    check_texture_color(test_context.backbuffer, 0xff00ff00, 0);
+
+    release_test_context(&test_context);
+}
+
+/* Entries start with a 24-byte header, followed by the key, which starts with
+ * an ASCII tag. Corrupting an entry sets the high bit of the first key byte. */
+#define SHADER_CACHE_KEY_OFFSET 24
+
+/* Corrupts all entries, or counts the ones that were replaced since. */
+static unsigned int shader_cache_update_entries(const char *path, BOOL corrupt)
+{
+    WIN32_FIND_DATAA find_data;
+    unsigned int count = 0;
+    char name[MAX_PATH];
+    HANDLE find, file;
+    DWORD size;
+    BYTE byte;
+
+    sprintf(name, "%s\\*.bin", path);
+    if ((find = FindFirstFileA(name, &find_data)) == INVALID_HANDLE_VALUE)
+        return 0;
+    do
+    {
+        sprintf(name, "%s\\%s", path, find_data.cFileName);
+        file = CreateFileA(name, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        ok(file != INVALID_HANDLE_VALUE, "Failed to open %s, error %lu.\n", debugstr_a(name), GetLastError());
+        SetFilePointer(file, SHADER_CACHE_KEY_OFFSET, NULL, FILE_BEGIN);
+        if (ReadFile(file, &byte, 1, &size, NULL) && size == 1)
+        {
+            if (corrupt)
+            {
+                byte ^= 0x80;
+                SetFilePointer(file, SHADER_CACHE_KEY_OFFSET, NULL, FILE_BEGIN);
+                WriteFile(file, &byte, 1, &size, NULL);
+                ++count;
+            }
+            else if (!(byte & 0x80))
+            {
+                ++count;
+            }
+        }
+        CloseHandle(file);
+    } while (FindNextFileA(find, &find_data));
+    FindClose(find);
+
+    return count;
+}
+
+static void run_shader_cache_child(const char *test_name)
+{
+    STARTUPINFOA si = {.cb = sizeof(si)};
+    PROCESS_INFORMATION pi;
+    char cmdline[MAX_PATH];
+    char **argv;
+    BOOL ret;
+
+    winetest_get_mainargs(&argv);
+    sprintf(cmdline, "\"%s\" %s shader_cache_child", argv[0], test_name);
+    ret = CreateProcessA(NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi);
+    ok(ret, "Failed to create process, error %lu.\n", GetLastError());
+    wait_child_process(pi.hProcess);
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+}
+
+static void test_shader_cache(const char *test_name)
+{
+    char path[MAX_PATH], name[MAX_PATH], config[MAX_PATH * 2], *old_config;
+    WIN32_FIND_DATAA find_data;
+    unsigned int count;
+    FILETIME time;
+    HANDLE find;
+    DWORD len;
+    HANDLE file;
+
+    if (strcmp(winetest_platform, "wine"))
+    {
+        skip("The shader cache is specific to wined3d.\n");
+        return;
+    }
+
+    GetTempPathA(ARRAY_SIZE(path), path);
+    GetTempFileNameA(path, "d3d", 0, name);
+    DeleteFileA(name);
+    strcpy(path, name);
+    ok(CreateDirectoryA(path, NULL), "Failed to create %s, error %lu.\n", debugstr_a(path), GetLastError());
+
+    /* A temporary file left behind by a process that didn't finish storing an entry. */
+    sprintf(name, "%s\\stale.tmp", path);
+    file = CreateFileA(name, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "Failed to create %s, error %lu.\n", debugstr_a(name), GetLastError());
+    time.dwLowDateTime = 0;
+    time.dwHighDateTime = 0x01d00000;
+    SetFileTime(file, NULL, NULL, &time);
+    CloseHandle(file);
+
+    old_config = NULL;
+    if ((len = GetEnvironmentVariableA("WINE_D3D_CONFIG", NULL, 0)) && (old_config = malloc(len)))
+        GetEnvironmentVariableA("WINE_D3D_CONFIG", old_config, len);
+    sprintf(config, "%s%sShaderCachePath=%s", old_config ? old_config : "", old_config ? "," : "", path);
+    SetEnvironmentVariableA("WINE_D3D_CONFIG", config);
+
+    /* Populate the cache. */
+    run_shader_cache_child(test_name);
+    count = shader_cache_update_entries(path, TRUE);
+    if (!count)
+    {
+        skip("The shader cache is not used by this renderer.\n");
+    }
+    else
+    {
+        ok(GetFileAttributesA(name) == INVALID_FILE_ATTRIBUTES, "Stale temporary file wasn't removed.\n");
+
+        /* Entries whose key doesn't match must be ignored and replaced. */
+        run_shader_cache_child(test_name);
+        count = shader_cache_update_entries(path, FALSE);
+        ok(count, "Mismatching entries weren't replaced.\n");
+
+        /* Load the replaced entries. */
+        run_shader_cache_child(test_name);
+    }
+
+    SetEnvironmentVariableA("WINE_D3D_CONFIG", old_config);
+    free(old_config);
+
+    sprintf(name, "%s\\*", path);
+    if ((find = FindFirstFileA(name, &find_data)) != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            sprintf(name, "%s\\%s", path, find_data.cFileName);
+            DeleteFileA(name);
+        } while (FindNextFileA(find, &find_data));
+        FindClose(find);
+    }
+    RemoveDirectoryA(path);
+}
+
 START_TEST(d3d11)
 {
     unsigned int argc, i;
@@ -36187,6 +36466,11 @@ START_TEST(d3d11)
         use_mt = FALSE;
 
     argc = winetest_get_mainargs(&argv);
+    if (argc >= 3 && !strcmp(argv[2], "shader_cache_child"))
+    {
+        test_shader_cache_child();
+        return;
+    }
     for (i = 2; i < argc; ++i)
     {
         if (!strcmp(argv[i], "--validate"))
@@ -36347,6 +36631,7 @@ START_TEST(d3d11)
     queue_test(test_deferred_context_state);
     queue_test(test_deferred_context_swap_state);
     queue_test(test_deferred_context_rendering);
+    queue_test(test_deferred_context_redundant_state);
     queue_test(test_deferred_context_map);
     queue_test(test_deferred_context_queries);
     queue_test(test_unbound_streams);
@@ -36366,6 +36651,8 @@ START_TEST(d3d11)
 
     run_queued_tests();
 
+    test_shader_cache(argv[1]);
+
     /* There should be no reason these tests can't be run in parallel with the
      * others, yet they randomly fail or crash when doing so.
      * (Radeon 560, Windows 10) */
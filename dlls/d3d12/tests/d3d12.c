@@ -215,14 +215,9 @@ static ID3D12RootSignature *create_default_root_signature(ID3D12Device *device)
     return root_signature;
 }
 
-#define create_pipeline_state(a, b, c, d) create_pipeline_state_(__LINE__, a, b, c, d)
-static ID3D12PipelineState *create_pipeline_state_(unsigned int line, ID3D12Device *device,
+static void init_pipeline_state_desc(D3D12_GRAPHICS_PIPELINE_STATE_DESC *desc,
         ID3D12RootSignature *root_signature, DXGI_FORMAT rt_format, const D3D12_SHADER_BYTECODE *ps)
 {
-    D3D12_GRAPHICS_PIPELINE_STATE_DESC pipeline_state_desc;
-    ID3D12PipelineState *pipeline_state;
-    HRESULT hr;
-
     static const DWORD vs_code[] =
     {
 #if 0
@@ -268,18 +263,29 @@ static ID3D12PipelineState *create_pipeline_state_(unsigned int line, ID3D12Devi
     if (!ps)
         ps = &default_ps;
 
-    memset(&pipeline_state_desc, 0, sizeof(pipeline_state_desc));
-    pipeline_state_desc.pRootSignature = root_signature;
-    pipeline_state_desc.VS = vs;
-    pipeline_state_desc.PS = *ps;
-    pipeline_state_desc.BlendState.RenderTarget[0].RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
-    pipeline_state_desc.RasterizerState.FillMode = D3D12_FILL_MODE_SOLID;
-    pipeline_state_desc.RasterizerState.CullMode = D3D12_CULL_MODE_BACK;
-    pipeline_state_desc.SampleMask = ~(UINT)0;
-    pipeline_state_desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-    pipeline_state_desc.NumRenderTargets = 1;
-    pipeline_state_desc.RTVFormats[0] = rt_format;
-    pipeline_state_desc.SampleDesc.Count = 1;
+    memset(desc, 0, sizeof(*desc));
+    desc->pRootSignature = root_signature;
+    desc->VS = vs;
+    desc->PS = *ps;
+    desc->BlendState.RenderTarget[0].RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
+    desc->RasterizerState.FillMode = D3D12_FILL_MODE_SOLID;
+    desc->RasterizerState.CullMode = D3D12_CULL_MODE_BACK;
+    desc->SampleMask = ~(UINT)0;
+    desc->PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+    desc->NumRenderTargets = 1;
+    desc->RTVFormats[0] = rt_format;
+    desc->SampleDesc.Count = 1;
+}
+
+#define create_pipeline_state(a, b, c, d) create_pipeline_state_(__LINE__, a, b, c, d)
+static ID3D12PipelineState *create_pipeline_state_(unsigned int line, ID3D12Device *device,
+        ID3D12RootSignature *root_signature, DXGI_FORMAT rt_format, const D3D12_SHADER_BYTECODE *ps)
+{
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC pipeline_state_desc;
+    ID3D12PipelineState *pipeline_state;
+    HRESULT hr;
+
+    init_pipeline_state_desc(&pipeline_state_desc, root_signature, rt_format, ps);
     hr = ID3D12Device_CreateGraphicsPipelineState(device, &pipeline_state_desc,
             &IID_ID3D12PipelineState, (void **)&pipeline_state);
     ok_(__FILE__, line)(hr == S_OK, "Failed to create graphics pipeline state, hr %#lx.\n", hr);
@@ -1497,6 +1503,98 @@ static void test_invalid_command_queue_types(void)
     ok(!refcount, "Device has %lu references left.\n", refcount);
 }
 
+static void test_pipeline_library(void)
+{
+    ID3D12PipelineLibrary *library, *library2;
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC desc;
+    ID3D12RootSignature *root_signature;
+    ID3D12PipelineState *state, *state2;
+    ID3D12Device1 *device1;
+    ID3D12Device *device;
+    ULONG refcount;
+    SIZE_T size;
+    void *data;
+    HRESULT hr;
+
+    if (!(device = create_device()))
+    {
+        skip("Failed to create device.\n");
+        return;
+    }
+
+    if (FAILED(hr = ID3D12Device_QueryInterface(device, &IID_ID3D12Device1, (void **)&device1)))
+    {
+        win_skip("ID3D12Device1 is not supported.\n");
+        ID3D12Device_Release(device);
+        return;
+    }
+
+    root_signature = create_default_root_signature(device);
+    init_pipeline_state_desc(&desc, root_signature, DXGI_FORMAT_R8G8B8A8_UNORM, NULL);
+    hr = ID3D12Device_CreateGraphicsPipelineState(device, &desc, &IID_ID3D12PipelineState, (void **)&state);
+    ok(hr == S_OK, "Failed to create pipeline state, hr %#lx.\n", hr);
+
+    hr = ID3D12Device1_CreatePipelineLibrary(device1, NULL, 0, &IID_ID3D12PipelineLibrary, (void **)&library);
+    if (hr == DXGI_ERROR_UNSUPPORTED)
+    {
+        skip("Pipeline libraries are not supported.\n");
+        goto done;
+    }
+    ok(hr == S_OK, "Failed to create pipeline library, hr %#lx.\n", hr);
+
+    hr = ID3D12PipelineLibrary_StorePipeline(library, L"pipeline", state);
+    ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+    hr = ID3D12PipelineLibrary_StorePipeline(library, L"pipeline", state);
+    ok(hr == E_INVALIDARG, "Got unexpected hr %#lx.\n", hr);
+
+    hr = ID3D12PipelineLibrary_LoadGraphicsPipeline(library, L"pipeline", &desc,
+            &IID_ID3D12PipelineState, (void **)&state2);
+    ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+    ID3D12PipelineState_Release(state2);
+    hr = ID3D12PipelineLibrary_LoadGraphicsPipeline(library, L"unknown", &desc,
+            &IID_ID3D12PipelineState, (void **)&state2);
+    ok(hr == E_INVALIDARG, "Got unexpected hr %#lx.\n", hr);
+
+    /* The description has to match the stored pipeline. */
+    desc.RTVFormats[0] = DXGI_FORMAT_B8G8R8A8_UNORM;
+    hr = ID3D12PipelineLibrary_LoadGraphicsPipeline(library, L"pipeline", &desc,
+            &IID_ID3D12PipelineState, (void **)&state2);
+    ok(hr == E_INVALIDARG, "Got unexpected hr %#lx.\n", hr);
+    desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+    size = ID3D12PipelineLibrary_GetSerializedSize(library);
+    ok(size, "Got zero serialized size.\n");
+    data = malloc(size);
+    hr = ID3D12PipelineLibrary_Serialize(library, data, size);
+    ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+
+    hr = ID3D12Device1_CreatePipelineLibrary(device1, data, size, &IID_ID3D12PipelineLibrary, (void **)&library2);
+    ok(hr == S_OK, "Failed to create pipeline library, hr %#lx.\n", hr);
+    if (SUCCEEDED(hr))
+    {
+        hr = ID3D12PipelineLibrary_LoadGraphicsPipeline(library2, L"pipeline", &desc,
+                &IID_ID3D12PipelineState, (void **)&state2);
+        ok(hr == S_OK, "Got unexpected hr %#lx.\n", hr);
+        ID3D12PipelineState_Release(state2);
+
+        desc.RTVFormats[0] = DXGI_FORMAT_B8G8R8A8_UNORM;
+        hr = ID3D12PipelineLibrary_LoadGraphicsPipeline(library2, L"pipeline", &desc,
+                &IID_ID3D12PipelineState, (void **)&state2);
+        ok(hr == E_INVALIDARG, "Got unexpected hr %#lx.\n", hr);
+
+        ID3D12PipelineLibrary_Release(library2);
+    }
+    free(data);
+
+    ID3D12PipelineLibrary_Release(library);
+done:
+    ID3D12PipelineState_Release(state);
+    ID3D12RootSignature_Release(root_signature);
+    ID3D12Device1_Release(device1);
+    refcount = ID3D12Device_Release(device);
+    ok(!refcount, "Device has %lu references left.\n", refcount);
+}
+
 START_TEST(d3d12)
 {
     BOOL enable_debug_layer = FALSE;
@@ -1533,4 +1631,5 @@ START_TEST(d3d12)
     test_swapchain_backbuffer_index();
     test_desktop_window();
     test_invalid_command_queue_types();
+    test_pipeline_library();
 }
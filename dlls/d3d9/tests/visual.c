@@ -28116,11 +28116,222 @@ static void test_mipmap_upload(void)
     release_test_context(&context);
 }
 
+static void test_ffp_shader_cache_child(BOOL draw)
+{
+    IDirect3DDevice9 *device;
+    unsigned int color, i;
+    IDirect3D9 *d3d;
+    ULONG refcount;
+    HWND window;
+    HRESULT hr;
+
+    static const struct
+    {
+        struct vec3 position;
+        DWORD diffuse;
+    }
+    quad[] =
+    {
+        {{-1.0f, -1.0f, 0.1f}, 0xffffff00},
+        {{-1.0f,  1.0f, 0.1f}, 0xffffff00},
+        {{ 1.0f, -1.0f, 0.1f}, 0xffffff00},
+        {{ 1.0f,  1.0f, 0.1f}, 0xffffff00},
+    };
+    static const struct
+    {
+        D3DTEXTUREOP op;
+        D3DCOLOR factor;
+        unsigned int expected;
+    }
+    tests[] =
+    {
+        {D3DTOP_SELECTARG2, 0xff00ff00, 0x00ffff00},
+        {D3DTOP_SELECTARG1, 0xff00ff00, 0x0000ff00},
+        {D3DTOP_MODULATE,   0xffff00ff, 0x00ff0000},
+    };
+
+    window = create_window();
+    d3d = Direct3DCreate9(D3D_SDK_VERSION);
+    ok(!!d3d, "Failed to create a D3D object.\n");
+    if (!(device = create_device(d3d, window, window, TRUE)))
+    {
+        skip("Failed to create a D3D device, skipping tests.\n");
+        goto done;
+    }
+
+    hr = IDirect3DDevice9_SetRenderState(device, D3DRS_LIGHTING, FALSE);
+    ok(hr == D3D_OK, "Got hr %#lx.\n", hr);
+    hr = IDirect3DDevice9_SetRenderState(device, D3DRS_ZENABLE, D3DZB_FALSE);
+    ok(hr == D3D_OK, "Got hr %#lx.\n", hr);
+    hr = IDirect3DDevice9_SetFVF(device, D3DFVF_XYZ | D3DFVF_DIFFUSE);
+    ok(hr == D3D_OK, "Got hr %#lx.\n", hr);
+    hr = IDirect3DDevice9_SetTextureStageState(device, 0, D3DTSS_COLORARG1, D3DTA_TFACTOR);
+    ok(hr == D3D_OK, "Got hr %#lx.\n", hr);
+    hr = IDirect3DDevice9_SetTextureStageState(device, 0, D3DTSS_COLORARG2, D3DTA_DIFFUSE);
+    ok(hr == D3D_OK, "Got hr %#lx.\n", hr);
+
+    for (i = 0; draw && i < ARRAY_SIZE(tests); ++i)
+    {
+        winetest_push_context("Test %u", i);
+
+        hr = IDirect3DDevice9_SetTextureStageState(device, 0, D3DTSS_COLOROP, tests[i].op);
+        ok(hr == D3D_OK, "Got hr %#lx.\n", hr);
+        hr = IDirect3DDevice9_SetRenderState(device, D3DRS_TEXTUREFACTOR, tests[i].factor);
+        ok(hr == D3D_OK, "Got hr %#lx.\n", hr);
+
+        hr = IDirect3DDevice9_Clear(device, 0, NULL, D3DCLEAR_TARGET, 0xff000000, 1.0f, 0);
+        ok(hr == D3D_OK, "Got hr %#lx.\n", hr);
+        hr = IDirect3DDevice9_BeginScene(device);
+        ok(hr == D3D_OK, "Got hr %#lx.\n", hr);
+        hr = IDirect3DDevice9_DrawPrimitiveUP(device, D3DPT_TRIANGLESTRIP, 2, quad, sizeof(*quad));
+        ok(hr == D3D_OK, "Got hr %#lx.\n", hr);
+        hr = IDirect3DDevice9_EndScene(device);
+        ok(hr == D3D_OK, "Got hr %#lx.\n", hr);
+
+        color = getPixelColor(device, 320, 240);
+        ok(color_match(color, tests[i].expected, 1), "Got unexpected color 0x%08x.\n", color);
+
+        winetest_pop_context();
+    }
+
+    refcount = IDirect3DDevice9_Release(device);
+    ok(!refcount, "Device has %lu references left.\n", refcount);
+done:
+    IDirect3D9_Release(d3d);
+    DestroyWindow(window);
+}
+
+/* Returns a hash of the names and contents of the shader cache entries. */
+static unsigned int hash_shader_cache(const char *path, unsigned int *count)
+{
+    WIN32_FIND_DATAA find_data;
+    unsigned int hash = 0, file_hash;
+    char name[MAX_PATH];
+    BYTE buffer[4096];
+    HANDLE find, file;
+    DWORD size, i;
+
+    *count = 0;
+    sprintf(name, "%s\\*.bin", path);
+    if ((find = FindFirstFileA(name, &find_data)) == INVALID_HANDLE_VALUE)
+        return 0;
+    do
+    {
+        file_hash = 0x811c9dc5;
+        for (i = 0; find_data.cFileName[i]; ++i)
+            file_hash = (file_hash ^ (BYTE)find_data.cFileName[i]) * 0x01000193;
+        sprintf(name, "%s\\%s", path, find_data.cFileName);
+        file = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+        ok(file != INVALID_HANDLE_VALUE, "Failed to open %s, error %lu.\n", debugstr_a(name), GetLastError());
+        while (ReadFile(file, buffer, sizeof(buffer), &size, NULL) && size)
+        {
+            for (i = 0; i < size; ++i)
+                file_hash = (file_hash ^ buffer[i]) * 0x01000193;
+        }
+        CloseHandle(file);
+        /* the order in which the files are listed doesn't matter */
+        hash += file_hash;
+        ++*count;
+    } while (FindNextFileA(find, &find_data));
+    FindClose(find);
+
+    return hash;
+}
+
+static void run_ffp_shader_cache_child(const char *test_name, BOOL draw)
+{
+    STARTUPINFOA si = {.cb = sizeof(si)};
+    PROCESS_INFORMATION pi;
+    char cmdline[MAX_PATH];
+    char **argv;
+    BOOL ret;
+
+    winetest_get_mainargs(&argv);
+    sprintf(cmdline, "\"%s\" %s ffp_shader_cache_child%s", argv[0], test_name, draw ? "" : " nodraw");
+    ret = CreateProcessA(NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi);
+    ok(ret, "Failed to create process, error %lu.\n", GetLastError());
+    wait_child_process(pi.hProcess);
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+}
+
+/* The fixed-function shaders used by a run are recorded in the shader cache,
+ * and created ahead of use by the following runs. Recorded shaders that a run
+ * doesn't use are aged, which changes the stored entries, so a run that doesn't
+ * draw shows whether the recorded settings were loaded. */
+static void test_ffp_shader_cache(const char *test_name)
+{
+    char path[MAX_PATH], name[MAX_PATH], config[MAX_PATH * 2], *old_config = NULL;
+    unsigned int hash, hash2, count;
+    WIN32_FIND_DATAA find_data;
+    HANDLE find;
+    DWORD len;
+
+    if (strcmp(winetest_platform, "wine"))
+    {
+        skip("The shader cache is specific to wined3d.\n");
+        return;
+    }
+
+    GetTempPathA(ARRAY_SIZE(path), path);
+    GetTempFileNameA(path, "d3d", 0, name);
+    DeleteFileA(name);
+    strcpy(path, name);
+    ok(CreateDirectoryA(path, NULL), "Failed to create %s, error %lu.\n", debugstr_a(path), GetLastError());
+
+    if ((len = GetEnvironmentVariableA("WINE_D3D_CONFIG", NULL, 0)) && (old_config = malloc(len)))
+        GetEnvironmentVariableA("WINE_D3D_CONFIG", old_config, len);
+    sprintf(config, "%s%sShaderCachePath=%s", old_config ? old_config : "", old_config ? "," : "", path);
+    SetEnvironmentVariableA("WINE_D3D_CONFIG", config);
+
+    run_ffp_shader_cache_child(test_name, TRUE);
+    hash = hash_shader_cache(path, &count);
+    if (!count)
+    {
+        skip("The shader cache is not used by this renderer.\n");
+        goto done;
+    }
+
+    /* The shaders recorded by the first run are preloaded, but not used. */
+    run_ffp_shader_cache_child(test_name, FALSE);
+    hash2 = hash_shader_cache(path, &count);
+    ok(hash2 != hash, "Recorded fixed-function shaders were not loaded.\n");
+
+    /* Using them again brings back the entries of the first run. */
+    run_ffp_shader_cache_child(test_name, TRUE);
+    hash2 = hash_shader_cache(path, &count);
+    ok(hash2 == hash, "Got unexpected shader cache contents.\n");
+
+done:
+    SetEnvironmentVariableA("WINE_D3D_CONFIG", old_config);
+    free(old_config);
+
+    sprintf(name, "%s\\*", path);
+    if ((find = FindFirstFileA(name, &find_data)) != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            sprintf(name, "%s\\%s", path, find_data.cFileName);
+            DeleteFileA(name);
+        } while (FindNextFileA(find, &find_data));
+        FindClose(find);
+    }
+    RemoveDirectoryA(path);
+}
+
 START_TEST(visual)
 {
     D3DADAPTER_IDENTIFIER9 identifier;
     IDirect3D9 *d3d;
+    char **argv;
     HRESULT hr;
+    int argc;
+
+    if ((argc = winetest_get_mainargs(&argv)) >= 3 && !strcmp(argv[2], "ffp_shader_cache_child"))
+    {
+        test_ffp_shader_cache_child(argc < 4 || strcmp(argv[3], "nodraw"));
+        return;
+    }
 
     if (!(d3d = Direct3DCreate9(D3D_SDK_VERSION)))
     {
@@ -28270,4 +28481,5 @@ START_TEST(visual)
     test_managed_reset();
     test_managed_generate_mipmap();
     test_mipmap_upload();
+    test_ffp_shader_cache(argv[1]);
 }
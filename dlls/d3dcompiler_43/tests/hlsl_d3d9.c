@@ -483,6 +483,155 @@ static void test_swizzle(void)
     release_test_context(&test_context);
 }
 
+static void test_component_stores(void)
+{
+    static const D3DXVECTOR4 color = {0.1f, 0.2f, 0.3f, 0.4f};
+    struct test_context test_context;
+    ID3DXConstantTable *constants;
+    ID3D10Blob *ps_code = NULL;
+    IDirect3DDevice9 *device;
+    unsigned int i;
+    struct vec4 v;
+    HRESULT hr;
+
+    static const struct
+    {
+        const char *source;
+        struct vec4 color;
+    }
+    tests[] =
+    {
+        /* Partial stores to one variable, out of order. */
+        {
+            "uniform float4 color;\n"
+            "float4 main() : COLOR\n"
+            "{\n"
+            "    float4 ret;\n"
+            "    ret.z = color.x;\n"
+            "    ret.x = color.w;\n"
+            "    ret.w = color.y;\n"
+            "    ret.y = color.z;\n"
+            "    return ret;\n"
+            "}",
+            {0.4f, 0.3f, 0.1f, 0.2f}
+        },
+        /* Partial stores to two variables, interleaved. */
+        {
+            "uniform float4 color;\n"
+            "float4 main() : COLOR\n"
+            "{\n"
+            "    float4 a, b;\n"
+            "    a.w = color.x;\n"
+            "    b.y = color.z;\n"
+            "    a.x = color.y;\n"
+            "    b.w = color.w;\n"
+            "    a.z = color.z;\n"
+            "    b.x = color.x;\n"
+            "    a.y = color.w;\n"
+            "    b.z = color.y;\n"
+            "    return a;\n"
+            "}",
+            {0.2f, 0.4f, 0.3f, 0.1f}
+        },
+        {
+            "uniform float4 color;\n"
+            "float4 main() : COLOR\n"
+            "{\n"
+            "    float4 a, b;\n"
+            "    a.w = color.x;\n"
+            "    b.y = color.z;\n"
+            "    a.x = color.y;\n"
+            "    b.w = color.w;\n"
+            "    a.z = color.z;\n"
+            "    b.x = color.x;\n"
+            "    a.y = color.w;\n"
+            "    b.z = color.y;\n"
+            "    return b;\n"
+            "}",
+            {0.1f, 0.3f, 0.2f, 0.4f}
+        },
+        /* Partial stores from different sources. */
+        {
+            "uniform float4 color;\n"
+            "float4 main() : COLOR\n"
+            "{\n"
+            "    float4 ret;\n"
+            "    float4 other = color * 2.0;\n"
+            "    ret.y = color.x;\n"
+            "    ret.x = other.x;\n"
+            "    ret.w = color.z;\n"
+            "    ret.z = other.y;\n"
+            "    return ret;\n"
+            "}",
+            {0.2f, 0.1f, 0.4f, 0.3f}
+        },
+        /* A load between two stores must see the first store. */
+        {
+            "uniform float4 color;\n"
+            "float4 main() : COLOR\n"
+            "{\n"
+            "    float4 ret = color;\n"
+            "    ret.y = color.x;\n"
+            "    float t = ret.y;\n"
+            "    ret.x = color.z;\n"
+            "    return float4(ret.x, ret.y, t, ret.w);\n"
+            "}",
+            {0.3f, 0.1f, 0.1f, 0.4f}
+        },
+        /* A store between two loads must not be moved past the second. */
+        {
+            "uniform float4 color;\n"
+            "float4 main() : COLOR\n"
+            "{\n"
+            "    float4 ret = color;\n"
+            "    float s = ret.x;\n"
+            "    ret.x = color.y;\n"
+            "    float t = ret.x;\n"
+            "    ret.y = color.w;\n"
+            "    return float4(s, t, ret.y, ret.x);\n"
+            "}",
+            {0.1f, 0.2f, 0.4f, 0.2f}
+        },
+        /* Unused values and stores to unused variables. */
+        {
+            "uniform float4 color;\n"
+            "float4 main() : COLOR\n"
+            "{\n"
+            "    float4 ret = color;\n"
+            "    float4 unused = color * 2.0;\n"
+            "    unused.x = ret.y;\n"
+            "    unused.yw = unused.zx + color.xy;\n"
+            "    ret.zw = color.xy;\n"
+            "    return ret;\n"
+            "}",
+            {0.1f, 0.2f, 0.1f, 0.2f}
+        },
+    };
+
+    if (!init_test_context(&test_context))
+        return;
+    device = test_context.device;
+
+    for (i = 0; i < ARRAY_SIZE(tests); ++i)
+    {
+        ps_code = compile_shader(tests[i].source, "ps_2_0", 0);
+        hr = pD3DXGetShaderConstantTable(ID3D10Blob_GetBufferPointer(ps_code), &constants);
+        ok(hr == D3D_OK, "Test %u: Got unexpected hr %#lx.\n", i, hr);
+        hr = ID3DXConstantTable_SetVector(constants, device, "color", &color);
+        ok(hr == D3D_OK, "Test %u: Got unexpected hr %#lx.\n", i, hr);
+        ID3DXConstantTable_Release(constants);
+        draw_quad(device, ps_code);
+
+        v = get_color_vec4(device, 0, 0);
+        ok(compare_vec4(&v, tests[i].color.x, tests[i].color.y, tests[i].color.z, tests[i].color.w, 0),
+                "Test %u: Got unexpected value {%.8e, %.8e, %.8e, %.8e}.\n", i, v.x, v.y, v.z, v.w);
+
+        ID3D10Blob_Release(ps_code);
+    }
+
+    release_test_context(&test_context);
+}
+
 static void test_math(void)
 {
     struct test_context test_context;
@@ -1852,6 +2001,7 @@ START_TEST(hlsl_d3d9)
     pD3DAssemble = (void *)GetProcAddress(mod, "D3DAssemble");
 
     test_swizzle();
+    test_component_stores();
     test_math();
     test_conditionals();
     test_float_vectors();
@@ -98,6 +98,7 @@ static inline char *strdup_ua( const char *src )
 }
 
 extern const char *debugstr_type( unsigned short );
+extern void cache_flush( const char *name );
 
 struct get_searchlist_params
 {
@@ -91,7 +91,8 @@ DNS_STATUS WINAPI DnsAcquireContextHandle_W( DWORD flags, void *cred, HANDLE *co
  */
 VOID WINAPI DnsFlushResolverCache(void)
 {
-    FIXME(": stub\n");
+    TRACE( "\n" );
+    cache_flush( NULL );
 }
 
 /******************************************************************************
@@ -100,8 +101,14 @@ VOID WINAPI DnsFlushResolverCache(void)
  */
 BOOL WINAPI DnsFlushResolverCacheEntry_A( PCSTR entry )
 {
-    FIXME( "%s: stub\n", debugstr_a(entry) );
+    char *name;
+
+    TRACE( "%s\n", debugstr_a(entry) );
+
     if (!entry) return FALSE;
+    if (!(name = strdup_au( entry ))) return FALSE;
+    cache_flush( name );
+    free( name );
     return TRUE;
 }
 
@@ -111,8 +118,10 @@ BOOL WINAPI DnsFlushResolverCacheEntry_A( PCSTR entry )
  */
 BOOL WINAPI DnsFlushResolverCacheEntry_UTF8( PCSTR entry )
 {
-    FIXME( "%s: stub\n", debugstr_a(entry) );
+    TRACE( "%s\n", debugstr_a(entry) );
+
     if (!entry) return FALSE;
+    cache_flush( entry );
     return TRUE;
 }
 
@@ -122,8 +131,14 @@ BOOL WINAPI DnsFlushResolverCacheEntry_UTF8( PCSTR entry )
  */
 BOOL WINAPI DnsFlushResolverCacheEntry_W( PCWSTR entry )
 {
-    FIXME( "%s: stub\n", debugstr_w(entry) );
+    char *name;
+
+    TRACE( "%s\n", debugstr_w(entry) );
+
     if (!entry) return FALSE;
+    if (!(name = strdup_wu( entry ))) return FALSE;
+    cache_flush( name );
+    free( name );
     return TRUE;
 }
 
@@ -32,6 +32,7 @@
 #include "ip2string.h"
 
 #include "wine/debug.h"
+#include "wine/list.h"
 #include "dnsapi.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(dnsapi);
@@ -163,6 +164,120 @@ DNS_STATUS WINAPI DnsQuery_A( const char *name, WORD type, DWORD options, void *
     return status;
 }
 
+/* Answers to queries sent to the default servers are cached until the
+ * smallest TTL of their records expires. Cached records are returned with
+ * their remaining TTL. */
+#define CACHE_MAX_ENTRIES  256
+#define CACHE_MAX_TTL      86400
+
+struct cache_entry
+{
+    struct list entry;
+    char *name;
+    WORD type;
+    DWORD options;
+    ULONGLONG expire;
+    DNS_RECORDA *records;
+};
+
+static struct list cache = LIST_INIT( cache );
+static unsigned int cache_count;
+static SRWLOCK cache_lock = SRWLOCK_INIT;
+
+static void free_cache_entry( struct cache_entry *entry )
+{
+    list_remove( &entry->entry );
+    cache_count--;
+    DnsRecordListFree( (DNS_RECORD *)entry->records, DnsFreeRecordList );
+    free( entry->name );
+    free( entry );
+}
+
+static BOOL cache_lookup( const char *name, WORD type, DWORD options, DNS_RECORDA **result )
+{
+    ULONGLONG now = GetTickCount64();
+    struct cache_entry *entry;
+    DNS_RECORDA *r;
+    BOOL found = FALSE;
+    DWORD ttl = 0;
+
+    options &= ~DNS_QUERY_BYPASS_CACHE;
+
+    AcquireSRWLockExclusive( &cache_lock );
+    LIST_FOR_EACH_ENTRY( entry, &cache, struct cache_entry, entry )
+    {
+        if (entry->type != type || entry->options != options || _stricmp( entry->name, name )) continue;
+
+        if (entry->expire <= now)
+        {
+            free_cache_entry( entry );
+            break;
+        }
+        if (!(*result = (DNS_RECORDA *)DnsRecordSetCopyEx( (DNS_RECORD *)entry->records,
+                                                           DnsCharSetUtf8, DnsCharSetUtf8 ))) break;
+
+        ttl = (entry->expire - now + 999) / 1000;
+        for (r = *result; r; r = r->pNext) r->dwTtl = ttl;
+        list_remove( &entry->entry );
+        list_add_head( &cache, &entry->entry );
+        found = TRUE;
+        break;
+    }
+    ReleaseSRWLockExclusive( &cache_lock );
+
+    if (found) TRACE( "returning cached records for %s, ttl %lu\n", debugstr_a(name), ttl );
+    return found;
+}
+
+static void cache_insert( const char *name, WORD type, DWORD options, DNS_RECORDA *records )
+{
+    struct cache_entry *entry, *old, *next;
+    DWORD ttl = CACHE_MAX_TTL;
+    DNS_RECORDA *r;
+
+    for (r = records; r; r = r->pNext) ttl = min( ttl, r->dwTtl );
+    if (!ttl) return;
+
+    if (!(entry = malloc( sizeof(*entry) ))) return;
+    entry->name = strdup( name );
+    entry->type = type;
+    entry->options = options & ~DNS_QUERY_BYPASS_CACHE;
+    entry->expire = GetTickCount64() + ttl * 1000;
+    entry->records = (DNS_RECORDA *)DnsRecordSetCopyEx( (DNS_RECORD *)records, DnsCharSetUtf8, DnsCharSetUtf8 );
+    if (!entry->name || !entry->records)
+    {
+        DnsRecordListFree( (DNS_RECORD *)entry->records, DnsFreeRecordList );
+        free( entry->name );
+        free( entry );
+        return;
+    }
+
+    AcquireSRWLockExclusive( &cache_lock );
+    LIST_FOR_EACH_ENTRY_SAFE( old, next, &cache, struct cache_entry, entry )
+    {
+        if (old->type == entry->type && old->options == entry->options && !_stricmp( old->name, name ))
+            free_cache_entry( old );
+    }
+    if (cache_count == CACHE_MAX_ENTRIES)
+        free_cache_entry( LIST_ENTRY( list_tail( &cache ), struct cache_entry, entry ) );
+    list_add_head( &cache, &entry->entry );
+    cache_count++;
+    ReleaseSRWLockExclusive( &cache_lock );
+}
+
+/* flush all entries, or the entries for the given name */
+void cache_flush( const char *name )
+{
+    struct cache_entry *entry, *next;
+
+    AcquireSRWLockExclusive( &cache_lock );
+    LIST_FOR_EACH_ENTRY_SAFE( entry, next, &cache, struct cache_entry, entry )
+    {
+        if (!name || !_stricmp( entry->name, name )) free_cache_entry( entry );
+    }
+    ReleaseSRWLockExclusive( &cache_lock );
+}
+
 /******************************************************************************
  * DnsQuery_UTF8              [DNSAPI.@]
  *
@@ -219,6 +334,10 @@ DNS_STATUS WINAPI DnsQuery_UTF8( const char *name, WORD type, DWORD options, voi
         }
     }
 
+    if (!servers && !(options & (DNS_QUERY_BYPASS_CACHE | DNS_QUERY_WIRE_ONLY)) &&
+        cache_lookup( name, type, options, result ))
+        return ERROR_SUCCESS;
+
     if ((ret = RESOLV_CALL( set_serverlist, servers ))) return ret;
 
     ret = RESOLV_CALL( query, &query_params );
@@ -243,6 +362,7 @@ DNS_STATUS WINAPI DnsQuery_UTF8( const char *name, WORD type, DWORD options, voi
         case DNS_RCODE_NOTZONE:  ret = DNS_ERROR_RCODE_NOTZONE; break;
         default:                 ret = DNS_ERROR_RCODE_NOT_IMPLEMENTED; break;
         }
+        if (!ret && !servers && !(options & DNS_QUERY_WIRE_ONLY)) cache_insert( name, type, options, *result );
     }
 
     if (ret == DNS_ERROR_RCODE_NAME_ERROR && type == DNS_TYPE_A &&
@@ -28,6 +28,11 @@
 
 #include "wine/test.h"
 
+static void (WINAPI *pDnsFlushResolverCache)(void);
+static BOOL (WINAPI *pDnsFlushResolverCacheEntry_A)(const char *);
+static BOOL (WINAPI *pDnsFlushResolverCacheEntry_UTF8)(const char *);
+static BOOL (WINAPI *pDnsFlushResolverCacheEntry_W)(const WCHAR *);
+
 static void test_DnsGetCacheDataTable( void )
 {
     BOOL ret;
@@ -43,7 +48,81 @@ static void test_DnsGetCacheDataTable( void )
     ok( entry != NULL, "DnsGetCacheDataTable returned NULL\n" );
 }
 
+static void test_DnsFlushResolverCache( void )
+{
+    DNS_RECORDA *rec, *rec2;
+    DNS_STATUS status;
+    BOOL ret;
+
+    if (!pDnsFlushResolverCacheEntry_A)
+    {
+        win_skip( "DnsFlushResolverCacheEntry_A not available\n" );
+        return;
+    }
+
+    ret = pDnsFlushResolverCacheEntry_A( NULL );
+    ok( !ret, "DnsFlushResolverCacheEntry_A succeeded\n" );
+    ret = pDnsFlushResolverCacheEntry_W( NULL );
+    ok( !ret, "DnsFlushResolverCacheEntry_W succeeded\n" );
+    ret = pDnsFlushResolverCacheEntry_UTF8( NULL );
+    ok( !ret, "DnsFlushResolverCacheEntry_UTF8 succeeded\n" );
+
+    ret = pDnsFlushResolverCacheEntry_A( "localhost" );
+    ok( ret, "DnsFlushResolverCacheEntry_A failed\n" );
+    ret = pDnsFlushResolverCacheEntry_W( L"localhost" );
+    ok( ret, "DnsFlushResolverCacheEntry_W failed\n" );
+    ret = pDnsFlushResolverCacheEntry_UTF8( "localhost" );
+    ok( ret, "DnsFlushResolverCacheEntry_UTF8 failed\n" );
+    pDnsFlushResolverCache();
+
+    rec = NULL;
+    status = DnsQuery_A( "localhost", DNS_TYPE_A, DNS_QUERY_STANDARD, NULL, &rec, NULL );
+    if (status)
+    {
+        skip( "localhost lookup failed, status %ld\n", status );
+        return;
+    }
+    ok( rec != NULL, "got NULL records\n" );
+    ok( rec->wType == DNS_TYPE_A, "got type %u\n", rec->wType );
+    ok( rec->Data.A.IpAddress == 0x0100007f, "got address %#lx\n", rec->Data.A.IpAddress );
+
+    /* a second lookup, possibly from the cache, gives the same answer */
+    rec2 = NULL;
+    status = DnsQuery_A( "localhost", DNS_TYPE_A, DNS_QUERY_STANDARD, NULL, &rec2, NULL );
+    ok( !status, "got status %ld\n", status );
+    ok( rec2 != NULL && rec2 != rec, "got records %p, %p\n", rec2, rec );
+    ok( rec2->wType == DNS_TYPE_A, "got type %u\n", rec2->wType );
+    ok( rec2->Data.A.IpAddress == rec->Data.A.IpAddress, "got address %#lx\n", rec2->Data.A.IpAddress );
+    ok( rec2->dwTtl <= rec->dwTtl, "got ttl %lu, previous %lu\n", rec2->dwTtl, rec->dwTtl );
+    DnsRecordListFree( (DNS_RECORD *)rec2, DnsFreeRecordList );
+
+    ret = pDnsFlushResolverCacheEntry_A( "LOCALHOST" );
+    ok( ret, "DnsFlushResolverCacheEntry_A failed\n" );
+    rec2 = NULL;
+    status = DnsQuery_A( "localhost", DNS_TYPE_A, DNS_QUERY_STANDARD, NULL, &rec2, NULL );
+    ok( !status, "got status %ld\n", status );
+    ok( rec2->Data.A.IpAddress == rec->Data.A.IpAddress, "got address %#lx\n", rec2->Data.A.IpAddress );
+    DnsRecordListFree( (DNS_RECORD *)rec2, DnsFreeRecordList );
+
+    pDnsFlushResolverCache();
+    rec2 = NULL;
+    status = DnsQuery_A( "localhost", DNS_TYPE_A, DNS_QUERY_BYPASS_CACHE, NULL, &rec2, NULL );
+    ok( !status, "got status %ld\n", status );
+    ok( rec2->Data.A.IpAddress == rec->Data.A.IpAddress, "got address %#lx\n", rec2->Data.A.IpAddress );
+    DnsRecordListFree( (DNS_RECORD *)rec2, DnsFreeRecordList );
+
+    DnsRecordListFree( (DNS_RECORD *)rec, DnsFreeRecordList );
+}
+
 START_TEST(cache)
 {
+    HMODULE module = GetModuleHandleA( "dnsapi.dll" );
+
+    pDnsFlushResolverCache = (void *)GetProcAddress( module, "DnsFlushResolverCache" );
+    pDnsFlushResolverCacheEntry_A = (void *)GetProcAddress( module, "DnsFlushResolverCacheEntry_A" );
+    pDnsFlushResolverCacheEntry_UTF8 = (void *)GetProcAddress( module, "DnsFlushResolverCacheEntry_UTF8" );
+    pDnsFlushResolverCacheEntry_W = (void *)GetProcAddress( module, "DnsFlushResolverCacheEntry_W" );
+
     test_DnsGetCacheDataTable();
+    test_DnsFlushResolverCache();
 }
@@ -1513,6 +1513,95 @@ static void analyzer_dump_user_features(DWRITE_TYPOGRAPHIC_FEATURES const **feat
     }
 }
 
+enum shaping_run_type
+{
+    SHAPING_RUN_GLYPHS,
+    SHAPING_RUN_PLACEMENTS,
+};
+
+static void analyzer_init_run_key(struct shaping_run_key *key, enum shaping_run_type type, const WCHAR *text,
+        UINT32 length, BOOL is_sideways, BOOL is_rtl, DWRITE_SCRIPT_ANALYSIS const *analysis, UINT32 language_tag,
+        DWRITE_TYPOGRAPHIC_FEATURES const **features, UINT32 const *feature_range_lengths, UINT32 feature_ranges)
+{
+    unsigned int i, flags = (is_sideways ? 0x1 : 0) | (is_rtl ? 0x2 : 0);
+
+    if (!features || !feature_range_lengths)
+        feature_ranges = 0;
+
+    shaping_run_key_init(key, type);
+    shaping_run_key_add(key, &length, sizeof(length));
+    shaping_run_key_add(key, text, length * sizeof(*text));
+    shaping_run_key_add(key, &flags, sizeof(flags));
+    shaping_run_key_add(key, &analysis->script, sizeof(analysis->script));
+    shaping_run_key_add(key, &analysis->shapes, sizeof(analysis->shapes));
+    shaping_run_key_add(key, &language_tag, sizeof(language_tag));
+    shaping_run_key_add(key, &feature_ranges, sizeof(feature_ranges));
+    for (i = 0; i < feature_ranges; ++i)
+    {
+        shaping_run_key_add(key, &feature_range_lengths[i], sizeof(*feature_range_lengths));
+        shaping_run_key_add(key, &features[i]->featureCount, sizeof(features[i]->featureCount));
+        shaping_run_key_add(key, features[i]->features, features[i]->featureCount * sizeof(*features[i]->features));
+    }
+}
+
+/* Cached glyphs are stored as glyph count, followed by cluster map, text properties,
+   glyphs and glyph properties arrays. */
+static BOOL analyzer_get_cached_glyphs(struct scriptshaping_cache *cache, const struct shaping_run_key *key,
+        UINT32 text_len, UINT32 max_glyph_count, UINT16 *clustermap, DWRITE_SHAPING_TEXT_PROPERTIES *text_props,
+        UINT16 *glyphs, DWRITE_SHAPING_GLYPH_PROPERTIES *glyph_props, UINT32 *glyph_count)
+{
+    size_t data_size = sizeof(*glyph_count) + text_len * (sizeof(*clustermap) + sizeof(*text_props))
+            + max_glyph_count * (sizeof(*glyphs) + sizeof(*glyph_props));
+    BYTE *data, *ptr;
+    BOOL ret;
+
+    if (!(data = malloc(data_size)))
+        return FALSE;
+
+    if ((ret = shaping_cache_get_run(cache, key, data, &data_size)))
+    {
+        ptr = data;
+        memcpy(glyph_count, ptr, sizeof(*glyph_count));
+        ptr += sizeof(*glyph_count);
+        memcpy(clustermap, ptr, text_len * sizeof(*clustermap));
+        ptr += text_len * sizeof(*clustermap);
+        memcpy(text_props, ptr, text_len * sizeof(*text_props));
+        ptr += text_len * sizeof(*text_props);
+        memcpy(glyphs, ptr, *glyph_count * sizeof(*glyphs));
+        ptr += *glyph_count * sizeof(*glyphs);
+        memcpy(glyph_props, ptr, *glyph_count * sizeof(*glyph_props));
+    }
+
+    free(data);
+    return ret;
+}
+
+static void analyzer_put_cached_glyphs(struct scriptshaping_cache *cache, const struct shaping_run_key *key,
+        UINT32 text_len, UINT16 const *clustermap, DWRITE_SHAPING_TEXT_PROPERTIES const *text_props,
+        UINT16 const *glyphs, DWRITE_SHAPING_GLYPH_PROPERTIES const *glyph_props, UINT32 glyph_count)
+{
+    size_t data_size = sizeof(glyph_count) + text_len * (sizeof(*clustermap) + sizeof(*text_props))
+            + glyph_count * (sizeof(*glyphs) + sizeof(*glyph_props));
+    BYTE *data, *ptr;
+
+    if (!(data = malloc(data_size)))
+        return;
+
+    ptr = data;
+    memcpy(ptr, &glyph_count, sizeof(glyph_count));
+    ptr += sizeof(glyph_count);
+    memcpy(ptr, clustermap, text_len * sizeof(*clustermap));
+    ptr += text_len * sizeof(*clustermap);
+    memcpy(ptr, text_props, text_len * sizeof(*text_props));
+    ptr += text_len * sizeof(*text_props);
+    memcpy(ptr, glyphs, glyph_count * sizeof(*glyphs));
+    ptr += glyph_count * sizeof(*glyphs);
+    memcpy(ptr, glyph_props, glyph_count * sizeof(*glyph_props));
+    shaping_cache_put_run(cache, key, data, data_size);
+
+    free(data);
+}
+
 static HRESULT WINAPI dwritetextanalyzer_GetGlyphs(IDWriteTextAnalyzer2 *iface,
     WCHAR const* text, UINT32 length, IDWriteFontFace* fontface, BOOL is_sideways,
     BOOL is_rtl, DWRITE_SCRIPT_ANALYSIS const* analysis, WCHAR const* locale,
@@ -1526,6 +1615,7 @@ static HRESULT WINAPI dwritetextanalyzer_GetGlyphs(IDWriteTextAnalyzer2 *iface,
     struct dwrite_fontface *font_obj;
     WCHAR digits[NATIVE_DIGITS_LEN];
     unsigned int glyph_count;
+    struct shaping_run_key key;
     HRESULT hr;
 
     TRACE("%s:%u, %p, %d, %d, %s, %s, %p, %p, %p, %u, %u, %p, %p, %p, %p, %p.\n", debugstr_wn(text, length),
@@ -1537,9 +1627,24 @@ static HRESULT WINAPI dwritetextanalyzer_GetGlyphs(IDWriteTextAnalyzer2 *iface,
 
     get_number_substitutes(substitution, is_rtl, digits);
     font_obj = unsafe_impl_from_IDWriteFontFace(fontface);
-    glyph_count = max(max_glyph_count, length);
 
     context.cache = fontface_get_shaping_cache(font_obj);
+    context.language_tag = get_opentype_language(locale);
+
+    *actual_glyph_count = 0;
+
+    analyzer_init_run_key(&key, SHAPING_RUN_GLYPHS, text, length, is_sideways, is_rtl, analysis,
+            context.language_tag, features, feature_range_lengths, feature_ranges);
+    shaping_run_key_add(&key, digits, wcslen(digits) * sizeof(*digits));
+    if (analyzer_get_cached_glyphs(context.cache, &key, length, max_glyph_count, clustermap, text_props,
+            glyphs, glyph_props, actual_glyph_count))
+    {
+        shaping_run_key_release(&key);
+        return S_OK;
+    }
+
+    glyph_count = max(max_glyph_count, length);
+
     context.script = analysis->script > Script_LastId ? Script_Unknown : analysis->script;
     context.text = text;
     context.length = length;
@@ -1552,15 +1657,12 @@ static HRESULT WINAPI dwritetextanalyzer_GetGlyphs(IDWriteTextAnalyzer2 *iface,
     context.u.subst.max_glyph_count = max_glyph_count;
     context.u.subst.capacity = glyph_count;
     context.u.subst.digits = digits;
-    context.language_tag = get_opentype_language(locale);
     context.user_features.features = features;
     context.user_features.range_lengths = feature_range_lengths;
     context.user_features.range_count = feature_ranges;
     context.glyph_infos = calloc(glyph_count, sizeof(*context.glyph_infos));
     context.table = &context.cache->gsub;
 
-    *actual_glyph_count = 0;
-
     if (!context.u.subst.glyphs || !context.u.subst.glyph_props || !context.glyph_infos)
     {
         hr = E_OUTOFMEMORY;
@@ -1574,9 +1676,12 @@ static HRESULT WINAPI dwritetextanalyzer_GetGlyphs(IDWriteTextAnalyzer2 *iface,
         *actual_glyph_count = context.glyph_count;
         memcpy(glyphs, context.u.subst.glyphs, context.glyph_count * sizeof(*glyphs));
         memcpy(glyph_props, context.u.subst.glyph_props, context.glyph_count * sizeof(*glyph_props));
+        analyzer_put_cached_glyphs(context.cache, &key, length, clustermap, text_props, glyphs, glyph_props,
+                *actual_glyph_count);
     }
 
 failed:
+    shaping_run_key_release(&key);
     free(context.u.subst.glyph_props);
     free(context.u.subst.glyphs);
     free(context.glyph_infos);
@@ -1584,6 +1689,67 @@ failed:
     return hr;
 }
 
+static void analyzer_add_placements_to_run_key(struct shaping_run_key *key, UINT16 const *clustermap,
+        DWRITE_SHAPING_TEXT_PROPERTIES const *text_props, UINT32 text_len, UINT16 const *glyphs,
+        DWRITE_SHAPING_GLYPH_PROPERTIES const *glyph_props, UINT32 glyph_count, float emsize,
+        DWRITE_MEASURING_MODE measuring_mode)
+{
+    shaping_run_key_add(key, clustermap, text_len * sizeof(*clustermap));
+    shaping_run_key_add(key, text_props, text_len * sizeof(*text_props));
+    shaping_run_key_add(key, &glyph_count, sizeof(glyph_count));
+    shaping_run_key_add(key, glyphs, glyph_count * sizeof(*glyphs));
+    shaping_run_key_add(key, glyph_props, glyph_count * sizeof(*glyph_props));
+    shaping_run_key_add(key, &emsize, sizeof(emsize));
+    shaping_run_key_add(key, &measuring_mode, sizeof(measuring_mode));
+}
+
+/* Cached placements are stored as text properties, followed by advances and offsets arrays. */
+static BOOL analyzer_get_cached_placements(struct scriptshaping_cache *cache, const struct shaping_run_key *key,
+        DWRITE_SHAPING_TEXT_PROPERTIES *text_props, UINT32 text_len, UINT32 glyph_count, float *advances,
+        DWRITE_GLYPH_OFFSET *offsets)
+{
+    size_t data_size = text_len * sizeof(*text_props) + glyph_count * (sizeof(*advances) + sizeof(*offsets));
+    BYTE *data, *ptr;
+    BOOL ret;
+
+    if (!(data = malloc(data_size)))
+        return FALSE;
+
+    if ((ret = shaping_cache_get_run(cache, key, data, &data_size)))
+    {
+        ptr = data;
+        memcpy(text_props, ptr, text_len * sizeof(*text_props));
+        ptr += text_len * sizeof(*text_props);
+        memcpy(advances, ptr, glyph_count * sizeof(*advances));
+        ptr += glyph_count * sizeof(*advances);
+        memcpy(offsets, ptr, glyph_count * sizeof(*offsets));
+    }
+
+    free(data);
+    return ret;
+}
+
+static void analyzer_put_cached_placements(struct scriptshaping_cache *cache, const struct shaping_run_key *key,
+        DWRITE_SHAPING_TEXT_PROPERTIES const *text_props, UINT32 text_len, UINT32 glyph_count, float const *advances,
+        DWRITE_GLYPH_OFFSET const *offsets)
+{
+    size_t data_size = text_len * sizeof(*text_props) + glyph_count * (sizeof(*advances) + sizeof(*offsets));
+    BYTE *data, *ptr;
+
+    if (!(data = malloc(data_size)))
+        return;
+
+    ptr = data;
+    memcpy(ptr, text_props, text_len * sizeof(*text_props));
+    ptr += text_len * sizeof(*text_props);
+    memcpy(ptr, advances, glyph_count * sizeof(*advances));
+    ptr += glyph_count * sizeof(*advances);
+    memcpy(ptr, offsets, glyph_count * sizeof(*offsets));
+    shaping_cache_put_run(cache, key, data, data_size);
+
+    free(data);
+}
+
 static HRESULT WINAPI dwritetextanalyzer_GetGlyphPlacements(IDWriteTextAnalyzer2 *iface,
     WCHAR const* text, UINT16 const* clustermap, DWRITE_SHAPING_TEXT_PROPERTIES *text_props,
     UINT32 text_len, UINT16 const* glyphs, DWRITE_SHAPING_GLYPH_PROPERTIES const* glyph_props,
@@ -1594,6 +1760,7 @@ static HRESULT WINAPI dwritetextanalyzer_GetGlyphPlacements(IDWriteTextAnalyzer2
     const struct dwritescript_properties *scriptprops;
     struct scriptshaping_context context = { 0 };
     struct dwrite_fontface *font_obj;
+    struct shaping_run_key key;
     unsigned int i;
     HRESULT hr;
 
@@ -1609,6 +1776,20 @@ static HRESULT WINAPI dwritetextanalyzer_GetGlyphPlacements(IDWriteTextAnalyzer2
 
     font_obj = unsafe_impl_from_IDWriteFontFace(fontface);
 
+    context.cache = fontface_get_shaping_cache(font_obj);
+    context.script = analysis->script > Script_LastId ? Script_Unknown : analysis->script;
+    context.language_tag = get_opentype_language(locale);
+
+    analyzer_init_run_key(&key, SHAPING_RUN_PLACEMENTS, text, text_len, is_sideways, is_rtl, analysis,
+            context.language_tag, features, feature_range_lengths, feature_ranges);
+    analyzer_add_placements_to_run_key(&key, clustermap, text_props, text_len, glyphs, glyph_props, glyph_count,
+            emSize, DWRITE_MEASURING_MODE_NATURAL);
+    if (analyzer_get_cached_placements(context.cache, &key, text_props, text_len, glyph_count, advances, offsets))
+    {
+        shaping_run_key_release(&key);
+        return S_OK;
+    }
+
     for (i = 0; i < glyph_count; ++i)
     {
         if (glyph_props[i].isZeroWidthSpace)
@@ -1620,8 +1801,6 @@ static HRESULT WINAPI dwritetextanalyzer_GetGlyphPlacements(IDWriteTextAnalyzer2
         offsets[i].ascenderOffset = 0.0f;
     }
 
-    context.cache = fontface_get_shaping_cache(font_obj);
-    context.script = analysis->script > Script_LastId ? Script_Unknown : analysis->script;
     context.text = text;
     context.length = text_len;
     context.is_rtl = is_rtl;
@@ -1635,7 +1814,6 @@ static HRESULT WINAPI dwritetextanalyzer_GetGlyphPlacements(IDWriteTextAnalyzer2
     context.measuring_mode = DWRITE_MEASURING_MODE_NATURAL;
     context.advances = advances;
     context.offsets = offsets;
-    context.language_tag = get_opentype_language(locale);
     context.user_features.features = features;
     context.user_features.range_lengths = feature_range_lengths;
     context.user_features.range_count = feature_ranges;
@@ -1650,8 +1828,11 @@ static HRESULT WINAPI dwritetextanalyzer_GetGlyphPlacements(IDWriteTextAnalyzer2
 
     scriptprops = &dwritescripts_properties[context.script];
     hr = shape_get_positions(&context, scriptprops->scripttags);
+    if (SUCCEEDED(hr))
+        analyzer_put_cached_placements(context.cache, &key, text_props, text_len, glyph_count, advances, offsets);
 
 failed:
+    shaping_run_key_release(&key);
     free(context.glyph_infos);
 
     return hr;
@@ -1669,6 +1850,7 @@ static HRESULT WINAPI dwritetextanalyzer_GetGdiCompatibleGlyphPlacements(IDWrite
     struct scriptshaping_context context = { 0 };
     DWRITE_MEASURING_MODE measuring_mode;
     struct dwrite_fontface *font_obj;
+    struct shaping_run_key key;
     unsigned int i;
     HRESULT hr;
 
@@ -1686,6 +1868,22 @@ static HRESULT WINAPI dwritetextanalyzer_GetGdiCompatibleGlyphPlacements(IDWrite
 
     measuring_mode = use_gdi_natural ? DWRITE_MEASURING_MODE_GDI_NATURAL : DWRITE_MEASURING_MODE_GDI_CLASSIC;
 
+    context.cache = fontface_get_shaping_cache(font_obj);
+    context.script = analysis->script > Script_LastId ? Script_Unknown : analysis->script;
+    context.language_tag = get_opentype_language(locale);
+
+    analyzer_init_run_key(&key, SHAPING_RUN_PLACEMENTS, text, text_len, is_sideways, is_rtl, analysis,
+            context.language_tag, features, feature_range_lengths, feature_ranges);
+    analyzer_add_placements_to_run_key(&key, clustermap, text_props, text_len, glyphs, glyph_props, glyph_count,
+            emSize, measuring_mode);
+    shaping_run_key_add(&key, &ppdip, sizeof(ppdip));
+    shaping_run_key_add(&key, transform ? transform : &identity, sizeof(*transform));
+    if (analyzer_get_cached_placements(context.cache, &key, text_props, text_len, glyph_count, advances, offsets))
+    {
+        shaping_run_key_release(&key);
+        return S_OK;
+    }
+
     for (i = 0; i < glyph_count; ++i)
     {
         if (glyph_props[i].isZeroWidthSpace)
@@ -1697,8 +1895,6 @@ static HRESULT WINAPI dwritetextanalyzer_GetGdiCompatibleGlyphPlacements(IDWrite
         offsets[i].ascenderOffset = 0.0f;
     }
 
-    context.cache = fontface_get_shaping_cache(font_obj);
-    context.script = analysis->script > Script_LastId ? Script_Unknown : analysis->script;
     context.text = text;
     context.length = text_len;
     context.is_rtl = is_rtl;
@@ -1712,7 +1908,6 @@ static HRESULT WINAPI dwritetextanalyzer_GetGdiCompatibleGlyphPlacements(IDWrite
     context.measuring_mode = measuring_mode;
     context.advances = advances;
     context.offsets = offsets;
-    context.language_tag = get_opentype_language(locale);
     context.user_features.features = features;
     context.user_features.range_lengths = feature_range_lengths;
     context.user_features.range_count = feature_ranges;
@@ -1727,8 +1922,11 @@ static HRESULT WINAPI dwritetextanalyzer_GetGdiCompatibleGlyphPlacements(IDWrite
 
     scriptprops = &dwritescripts_properties[context.script];
     hr = shape_get_positions(&context, scriptprops->scripttags);
+    if (SUCCEEDED(hr))
+        analyzer_put_cached_placements(context.cache, &key, text_props, text_len, glyph_count, advances, offsets);
 
 failed:
+    shaping_run_key_release(&key);
     free(context.glyph_infos);
 
     return hr;
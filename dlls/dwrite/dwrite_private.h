@@ -263,6 +263,9 @@ struct dwrite_fontface
         struct list mru;
         size_t max_size;
         size_t size;
+        unsigned int bitmap_hits;
+        unsigned int bitmap_misses;
+        unsigned int evictions;
     } cache;
     CRITICAL_SECTION cs;
 
@@ -631,6 +634,28 @@ struct scriptshaping_cache
         unsigned int markattachclassdef;
         unsigned int markglyphsetdef;
     } gdef;
+
+    /* Results of previous shaping calls, see shaping_cache_get_run(). */
+    struct
+    {
+        CRITICAL_SECTION cs;
+        struct wine_rb_tree tree;
+        struct list mru;
+        size_t size;
+        unsigned int hits;
+        unsigned int misses;
+        unsigned int evictions;
+    } runs;
+};
+
+/* Serialized shaping call arguments, used as a shaped runs cache key. */
+struct shaping_run_key
+{
+    BYTE *data;
+    size_t size;
+    size_t capacity;
+    unsigned int hash;
+    BOOL failed;
 };
 
 struct shaping_glyph_info
@@ -803,6 +828,14 @@ extern struct scriptshaping_cache *create_scriptshaping_cache(void *context,
 extern void release_scriptshaping_cache(struct scriptshaping_cache*);
 extern struct scriptshaping_cache *fontface_get_shaping_cache(struct dwrite_fontface *fontface);
 
+extern void shaping_run_key_init(struct shaping_run_key *key, unsigned int type);
+extern void shaping_run_key_add(struct shaping_run_key *key, const void *data, size_t size);
+extern void shaping_run_key_release(struct shaping_run_key *key);
+extern BOOL shaping_cache_get_run(struct scriptshaping_cache *cache, const struct shaping_run_key *key,
+        void *data, size_t *size);
+extern void shaping_cache_put_run(struct scriptshaping_cache *cache, const struct shaping_run_key *key,
+        const void *data, size_t size);
+
 extern void opentype_layout_scriptshaping_cache_init(struct scriptshaping_cache *cache);
 extern unsigned int opentype_layout_find_script(const struct scriptshaping_cache *cache, unsigned int kind,
         DWORD tag, unsigned int *script_index);
@@ -30,6 +30,7 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(dwrite);
 WINE_DECLARE_DEBUG_CHANNEL(dwrite_file);
+WINE_DECLARE_DEBUG_CHANNEL(dwrite_cache);
 
 #define MS_HEAD_TAG DWRITE_MAKE_OPENTYPE_TAG('h','e','a','d')
 #define MS_OS2_TAG  DWRITE_MAKE_OPENTYPE_TAG('O','S','/','2')
@@ -51,6 +52,7 @@ struct cache_key
     float size;
     unsigned short glyph;
     unsigned short mode;
+    MATRIX_2X2 m;
 };
 
 struct cache_entry
@@ -62,6 +64,7 @@ struct cache_entry
     RECT bbox;
     BYTE *bitmap;
     unsigned int bitmap_size;
+    unsigned int bitmap_mode : 4;
     unsigned int is_1bpp : 1;
     unsigned int has_contours : 1;
     unsigned int has_advance : 1;
@@ -69,6 +72,13 @@ struct cache_entry
     unsigned int has_bitmap : 1;
 };
 
+/* Glyph caches of all font faces share common size limit, on top of per-face one. */
+#define GLYPH_CACHE_MAX_SIZE 0x1000000
+#define GLYPH_CACHE_FACE_MAX_SIZE 0x100000
+
+/* Total size of the glyph caches of all font faces. */
+static LONG glyph_cache_size;
+
 /* Ignore dx and dy because FreeType doesn't actually use it */
 static inline void matrix_2x2_from_dwrite_matrix(MATRIX_2X2 *m1, const DWRITE_MATRIX *m2)
 {
@@ -84,10 +94,43 @@ static void fontface_release_cache_entry(struct cache_entry *entry)
     free(entry);
 }
 
-static struct cache_entry * fontface_get_cache_entry(struct dwrite_fontface *fontface, size_t size,
-        const struct cache_key *key)
+static void fontface_cache_update_size(struct dwrite_fontface *fontface, LONG delta)
+{
+    fontface->cache.size += delta;
+    InterlockedExchangeAdd(&glyph_cache_size, delta);
+}
+
+static void fontface_remove_cache_entry(struct dwrite_fontface *fontface, struct cache_entry *entry)
 {
-    struct cache_entry *entry, *old_entry;
+    fontface_cache_update_size(fontface, -(LONG)(entry->bitmap_size + sizeof(*entry)));
+    wine_rb_remove(&fontface->cache.tree, &entry->entry);
+    list_remove(&entry->mru);
+    fontface_release_cache_entry(entry);
+}
+
+/* Makes room for 'size' more bytes, least recently used entries are released first. */
+static void fontface_cache_evict(struct dwrite_fontface *fontface, size_t size, const struct cache_entry *keep)
+{
+    struct cache_entry *entry;
+
+    while (fontface->cache.size + size > fontface->cache.max_size
+            || glyph_cache_size + size > GLYPH_CACHE_MAX_SIZE)
+    {
+        if (list_empty(&fontface->cache.mru))
+            break;
+
+        entry = LIST_ENTRY(list_tail(&fontface->cache.mru), struct cache_entry, mru);
+        if (entry == keep)
+            break;
+
+        fontface_remove_cache_entry(fontface, entry);
+        fontface->cache.evictions++;
+    }
+}
+
+static struct cache_entry * fontface_get_cache_entry(struct dwrite_fontface *fontface, const struct cache_key *key)
+{
+    struct cache_entry *entry;
     struct wine_rb_entry *e;
 
     if (!(e = wine_rb_get(&fontface->cache.tree, key)))
@@ -96,16 +139,7 @@ static struct cache_entry * fontface_get_cache_entry(struct dwrite_fontface *fon
         entry->key = *key;
         list_init(&entry->mru);
 
-        size += sizeof(*entry);
-
-        if ((fontface->cache.size + size > fontface->cache.max_size) && !list_empty(&fontface->cache.mru))
-        {
-            old_entry = LIST_ENTRY(list_tail(&fontface->cache.mru), struct cache_entry, mru);
-            fontface->cache.size -= (old_entry->bitmap_size + sizeof(*old_entry));
-            wine_rb_remove(&fontface->cache.tree, &old_entry->entry);
-            list_remove(&old_entry->mru);
-            fontface_release_cache_entry(old_entry);
-        }
+        fontface_cache_evict(fontface, sizeof(*entry), NULL);
 
         if (wine_rb_put(&fontface->cache.tree, key, &entry->entry) == -1)
         {
@@ -114,7 +148,7 @@ static struct cache_entry * fontface_get_cache_entry(struct dwrite_fontface *fon
             return NULL;
         }
 
-        fontface->cache.size += size;
+        fontface_cache_update_size(fontface, sizeof(*entry));
     }
     else
         entry = WINE_RB_ENTRY_VALUE(e, struct cache_entry, entry);
@@ -125,15 +159,37 @@ static struct cache_entry * fontface_get_cache_entry(struct dwrite_fontface *fon
     return entry;
 }
 
+static void fontface_cache_set_bitmap(struct dwrite_fontface *fontface, struct cache_entry *entry,
+        DWRITE_RENDERING_MODE1 rendering_mode, const BYTE *bitmap, unsigned int bitmap_size, unsigned int is_1bpp)
+{
+    fontface_cache_update_size(fontface, -(LONG)entry->bitmap_size);
+    free(entry->bitmap);
+    entry->bitmap = NULL;
+    entry->bitmap_size = 0;
+    entry->has_bitmap = 0;
+
+    fontface_cache_evict(fontface, bitmap_size, entry);
+
+    if (!(entry->bitmap = malloc(bitmap_size)))
+        return;
+    memcpy(entry->bitmap, bitmap, bitmap_size);
+    entry->bitmap_size = bitmap_size;
+    entry->bitmap_mode = rendering_mode;
+    entry->is_1bpp = !!is_1bpp;
+    entry->has_bitmap = 1;
+
+    fontface_cache_update_size(fontface, bitmap_size);
+}
+
 static int fontface_get_glyph_advance(struct dwrite_fontface *fontface, float fontsize, unsigned short glyph,
         unsigned short mode, BOOL *has_contours)
 {
-    struct cache_key key = { .size = fontsize, .glyph = glyph, .mode = mode };
+    struct cache_key key = { .size = fontsize, .glyph = glyph, .mode = mode, .m = identity_2x2 };
     struct get_glyph_advance_params params;
     struct cache_entry *entry;
     unsigned int value;
 
-    if (!(entry = fontface_get_cache_entry(fontface, 0, &key)))
+    if (!(entry = fontface_get_cache_entry(fontface, &key)))
         return 0;
 
     if (!entry->has_advance)
@@ -167,15 +223,10 @@ void dwrite_fontface_get_glyph_bbox(IDWriteFontFace *iface, struct dwrite_glyphb
     params.glyph = bitmap->glyph;
     params.emsize = bitmap->emsize;
     matrix_2x2_from_dwrite_matrix(&params.m, bitmap->m ? bitmap->m : &identity);
+    key.m = params.m;
 
     EnterCriticalSection(&fontface->cs);
-    /* For now bypass cache for transformed cases. */
-    if (bitmap->m && memcmp(&params.m, &identity_2x2, sizeof(params.m)))
-    {
-        params.bbox = &bitmap->bbox;
-        UNIX_CALL(get_glyph_bbox, &params);
-    }
-    else if ((entry = fontface_get_cache_entry(fontface, 0, &key)))
+    if ((entry = fontface_get_cache_entry(fontface, &key)))
     {
         if (!entry->has_bbox)
         {
@@ -185,6 +236,11 @@ void dwrite_fontface_get_glyph_bbox(IDWriteFontFace *iface, struct dwrite_glyphb
         }
         bitmap->bbox = entry->bbox;
     }
+    else
+    {
+        params.bbox = &bitmap->bbox;
+        UNIX_CALL(get_glyph_bbox, &params);
+    }
     LeaveCriticalSection(&fontface->cs);
 }
 
@@ -199,9 +255,8 @@ static HRESULT dwrite_fontface_get_glyph_bitmap(struct dwrite_fontface *fontface
     struct cache_key key = { .size = bitmap->emsize, .glyph = bitmap->glyph, .mode = DWRITE_MEASURING_MODE_NATURAL };
     struct get_glyph_bitmap_params params;
     const RECT *bbox = &bitmap->bbox;
-    unsigned int bitmap_size, _1bpp;
+    unsigned int bitmap_size;
     struct cache_entry *entry;
-    HRESULT hr = S_OK;
 
     bitmap_size = get_glyph_bitmap_pitch(rendering_mode, bbox->right - bbox->left) *
             (bbox->bottom - bbox->top);
@@ -216,37 +271,26 @@ static HRESULT dwrite_fontface_get_glyph_bitmap(struct dwrite_fontface *fontface
     params.bitmap = bitmap->buf;
     params.is_1bpp = is_1bpp;
     matrix_2x2_from_dwrite_matrix(&params.m, bitmap->m ? bitmap->m : &identity);
+    key.m = params.m;
 
     EnterCriticalSection(&fontface->cs);
-    /* For now bypass cache for transformed cases. */
-    if (bitmap->m && memcmp(&params.m, &identity_2x2, sizeof(params.m)))
+    if ((entry = fontface_get_cache_entry(fontface, &key)) && entry->has_bitmap
+            && entry->bitmap_mode == rendering_mode && entry->bitmap_size == bitmap_size)
     {
-        UNIX_CALL(get_glyph_bitmap, &params);
-    }
-    else if ((entry = fontface_get_cache_entry(fontface, bitmap_size, &key)))
-    {
-        if (entry->has_bitmap)
-        {
-            memcpy(bitmap->buf, entry->bitmap, entry->bitmap_size);
-        }
-        else
-        {
-            params.is_1bpp = &_1bpp;
-            UNIX_CALL(get_glyph_bitmap, &params);
-
-            entry->bitmap_size = bitmap_size;
-            if ((entry->bitmap = malloc(entry->bitmap_size)))
-                memcpy(entry->bitmap, bitmap->buf, entry->bitmap_size);
-            entry->is_1bpp = !!_1bpp;
-            entry->has_bitmap = 1;
-        }
+        memcpy(bitmap->buf, entry->bitmap, entry->bitmap_size);
         *is_1bpp = entry->is_1bpp;
+        fontface->cache.bitmap_hits++;
     }
     else
-        hr = E_FAIL;
+    {
+        UNIX_CALL(get_glyph_bitmap, &params);
+        if (entry)
+            fontface_cache_set_bitmap(fontface, entry, rendering_mode, bitmap->buf, bitmap_size, *is_1bpp);
+        fontface->cache.bitmap_misses++;
+    }
     LeaveCriticalSection(&fontface->cs);
 
-    return hr;
+    return S_OK;
 }
 
 static int fontface_cache_compare(const void *k, const struct wine_rb_entry *e)
@@ -257,25 +301,30 @@ static int fontface_cache_compare(const void *k, const struct wine_rb_entry *e)
     if (key->size != key2->size) return key->size < key2->size ? -1 : 1;
     if (key->glyph != key2->glyph) return (int)key->glyph - (int)key2->glyph;
     if (key->mode != key2->mode) return (int)key->mode - (int)key2->mode;
-    return 0;
+    return memcmp(&key->m, &key2->m, sizeof(key->m));
 }
 
 static void fontface_cache_init(struct dwrite_fontface *fontface)
 {
     wine_rb_init(&fontface->cache.tree, fontface_cache_compare);
     list_init(&fontface->cache.mru);
-    fontface->cache.max_size = 0x8000;
+    fontface->cache.max_size = GLYPH_CACHE_FACE_MAX_SIZE;
 }
 
 static void fontface_cache_clear(struct dwrite_fontface *fontface)
 {
     struct cache_entry *entry, *entry2;
 
+    TRACE_(dwrite_cache)("Glyph cache of fontface %p: size %Iu, bitmap hits %u, misses %u, evictions %u.\n",
+            fontface, fontface->cache.size, fontface->cache.bitmap_hits, fontface->cache.bitmap_misses,
+            fontface->cache.evictions);
+
     LIST_FOR_EACH_ENTRY_SAFE(entry, entry2, &fontface->cache.mru, struct cache_entry, mru)
     {
         list_remove(&entry->mru);
         fontface_release_cache_entry(entry);
     }
+    InterlockedExchangeAdd(&glyph_cache_size, -(LONG)fontface->cache.size);
     memset(&fontface->cache, 0, sizeof(fontface->cache));
 }
 
@@ -247,6 +247,12 @@ struct dwrite_textlayout
     struct list underlines;
     struct list strikethrough;
     USHORT recompute;
+    /* Text positions runs have to be recomputed for, only meaningful when RECOMPUTE_CLUSTERS is set. */
+    struct
+    {
+        UINT32 start;
+        UINT32 end;
+    } dirty;
 
     DWRITE_LINE_BREAKPOINT *nominal_breakpoints;
     DWRITE_LINE_BREAKPOINT *actual_breakpoints;
@@ -330,23 +336,48 @@ static HRESULT alloc_layout_run(enum layout_run_kind kind, unsigned int start_po
     return S_OK;
 }
 
+static void free_layout_run(struct layout_run *run)
+{
+    list_remove(&run->entry);
+    if (run->kind == LAYOUT_RUN_REGULAR)
+    {
+        if (run->u.regular.run.fontFace)
+            IDWriteFontFace_Release(run->u.regular.run.fontFace);
+        free(run->u.regular.glyphs);
+        free(run->u.regular.clustermap);
+        free(run->u.regular.advances);
+        free(run->u.regular.offsets);
+    }
+    free(run);
+}
+
 static void free_layout_runs(struct dwrite_textlayout *layout)
 {
     struct layout_run *cur, *cur2;
     LIST_FOR_EACH_ENTRY_SAFE(cur, cur2, &layout->runs, struct layout_run, entry)
+        free_layout_run(cur);
+}
+
+/* Marks runs covering [start, end) text positions for recomputation, everything else is recomputed too,
+   but runs outside of accumulated range are reused as is. */
+static void layout_invalidate_runs(struct dwrite_textlayout *layout, UINT32 start, UINT32 end)
+{
+    if (layout->recompute & RECOMPUTE_CLUSTERS)
     {
-        list_remove(&cur->entry);
-        if (cur->kind == LAYOUT_RUN_REGULAR)
-        {
-            if (cur->u.regular.run.fontFace)
-                IDWriteFontFace_Release(cur->u.regular.run.fontFace);
-            free(cur->u.regular.glyphs);
-            free(cur->u.regular.clustermap);
-            free(cur->u.regular.advances);
-            free(cur->u.regular.offsets);
-        }
-        free(cur);
+        layout->dirty.start = min(layout->dirty.start, start);
+        layout->dirty.end = max(layout->dirty.end, end);
+    }
+    else
+    {
+        layout->dirty.start = start;
+        layout->dirty.end = end;
     }
+    layout->recompute = RECOMPUTE_EVERYTHING;
+}
+
+static void layout_invalidate(struct dwrite_textlayout *layout)
+{
+    layout_invalidate_runs(layout, 0, ~0u);
 }
 
 static void free_layout_eruns(struct dwrite_textlayout *layout)
@@ -609,7 +640,8 @@ static inline void layout_initialize_text_source(struct dwrite_textlayout *layou
     layout->text_source.length = length;
 }
 
-static HRESULT layout_itemize(struct dwrite_textlayout *layout)
+/* Creates runs for ranges starting within [start, end). */
+static HRESULT layout_itemize(struct dwrite_textlayout *layout, UINT32 start, UINT32 end)
 {
     IDWriteTextAnalyzer2 *analyzer;
     struct layout_range *range;
@@ -621,15 +653,14 @@ static HRESULT layout_itemize(struct dwrite_textlayout *layout)
     layout_initialize_text_source(layout, 0, layout->len);
     LIST_FOR_EACH_ENTRY(range, &layout->ranges, struct layout_range, h.entry) {
         /* We don't care about ranges that don't contain any text. */
-        if (range->h.range.startPosition >= layout->len)
+        if (range->h.range.startPosition >= min(end, layout->len))
             break;
 
+        if (range->h.range.startPosition < start)
+            continue;
+
         /* Inline objects override actual text in range. */
         if (range->object) {
-            hr = layout_update_breakpoints_range(layout, range);
-            if (FAILED(hr))
-                return hr;
-
             if (FAILED(hr = alloc_layout_run(LAYOUT_RUN_INLINE, range->h.range.startPosition, &r)))
                 return hr;
 
@@ -1147,14 +1178,81 @@ static HRESULT layout_shape_run(struct dwrite_textlayout *layout, struct regular
     return hr;
 }
 
+static UINT32 layout_run_get_length(const struct layout_run *run)
+{
+    return run->kind == LAYOUT_RUN_INLINE ? run->u.object.length : run->u.regular.descr.stringLength;
+}
+
+/* Returns text positions range covering all runs that need to be recomputed. Runs are itemized
+   per formatting range, so affected ranges are recomputed as a whole. Existing runs were itemized
+   using previous ranges, so dirty range has to cover every run it intersects too, otherwise kept
+   runs would overlap reitemized ones. */
+static void layout_get_dirty_runs_range(const struct dwrite_textlayout *layout, UINT32 *start, UINT32 *end)
+{
+    struct layout_range *range;
+    struct layout_run *run;
+    BOOL changed;
+
+    *start = layout->dirty.start;
+    *end = min(layout->dirty.end, layout->len);
+
+    if (list_empty(&layout->runs))
+    {
+        *start = 0;
+        *end = layout->len;
+        return;
+    }
+
+    if (*start >= *end)
+        return;
+
+    do
+    {
+        changed = FALSE;
+
+        if ((range = get_layout_range_by_pos(layout, *start)) && range->h.range.startPosition < *start)
+        {
+            *start = range->h.range.startPosition;
+            changed = TRUE;
+        }
+        if ((range = get_layout_range_by_pos(layout, *end - 1))
+                && min(range->h.range.startPosition + range->h.range.length, layout->len) > *end)
+        {
+            *end = min(range->h.range.startPosition + range->h.range.length, layout->len);
+            changed = TRUE;
+        }
+
+        LIST_FOR_EACH_ENTRY(run, &layout->runs, struct layout_run, entry)
+        {
+            UINT32 run_end = min(run->start_position + layout_run_get_length(run), layout->len);
+
+            if (run->start_position >= *end)
+                break;
+            if (run_end <= *start)
+                continue;
+
+            if (run->start_position < *start)
+            {
+                *start = run->start_position;
+                changed = TRUE;
+            }
+            if (run_end > *end)
+            {
+                *end = run_end;
+                changed = TRUE;
+            }
+        }
+    } while (changed);
+}
+
 static HRESULT layout_compute_runs(struct dwrite_textlayout *layout)
 {
-    struct layout_run *r;
-    UINT32 cluster = 0;
+    struct layout_run *r, *r2;
+    struct list runs, *next;
+    UINT32 cluster = 0, start, end;
     HRESULT hr;
 
     free_layout_eruns(layout);
-    free_layout_runs(layout);
 
     /* Cluster data arrays are allocated once, assuming one text position per cluster. */
     if (!layout->clustermetrics && layout->len)
@@ -1170,21 +1268,57 @@ static HRESULT layout_compute_runs(struct dwrite_textlayout *layout)
     }
     layout->cluster_count = 0;
 
-    if (FAILED(hr = layout_itemize(layout))) {
+    layout_get_dirty_runs_range(layout, &start, &end);
+    TRACE("Recomputing runs for [%u,%u).\n", start, end);
+
+    /* Keep runs outside of affected range, new runs are inserted before 'next' one. */
+    list_init(&runs);
+    list_move_tail(&runs, &layout->runs);
+    next = &runs;
+    LIST_FOR_EACH_ENTRY_SAFE(r, r2, &runs, struct layout_run, entry)
+    {
+        if (r->start_position >= end)
+        {
+            if (next == &runs) next = &r->entry;
+        }
+        else if (r->start_position >= start)
+            free_layout_run(r);
+    }
+
+    if (FAILED(hr = layout_itemize(layout, start, end))) {
         WARN("Itemization failed, hr %#lx.\n", hr);
-        return hr;
+        goto done;
     }
 
     if (FAILED(hr = layout_resolve_fonts(layout))) {
         WARN("Failed to resolve layout fonts, hr %#lx.\n", hr);
-        return hr;
+        goto done;
     }
 
-    /* fill run info */
     LIST_FOR_EACH_ENTRY(r, &layout->runs, struct layout_run, entry) {
         struct regular_layout_run *run = &r->u.regular;
         DWRITE_FONT_METRICS fontmetrics = { 0 };
 
+        if (r->kind == LAYOUT_RUN_INLINE)
+            continue;
+
+        if (FAILED(hr = layout_shape_run(layout, run)))
+            WARN("%s: shaping failed, hr %#lx.\n", debugstr_rundescr(&run->descr), hr);
+
+        /* baseline derived from font metrics */
+        layout_get_font_metrics(layout, run->run.fontFace, run->run.fontEmSize, &fontmetrics);
+        layout_get_font_height(run->run.fontEmSize, &fontmetrics, &r->baseline, &r->height);
+    }
+
+done:
+    list_move_before(next, &layout->runs);
+    list_move_tail(&layout->runs, &runs);
+
+    if (FAILED(hr))
+        return hr;
+
+    /* fill cluster info */
+    LIST_FOR_EACH_ENTRY(r, &layout->runs, struct layout_run, entry) {
         /* we need to do very little in case of inline objects */
         if (r->kind == LAYOUT_RUN_INLINE) {
             DWRITE_CLUSTER_METRICS *metrics = &layout->clustermetrics[cluster];
@@ -1218,27 +1352,19 @@ static HRESULT layout_compute_runs(struct dwrite_textlayout *layout)
             continue;
         }
 
-        if (FAILED(hr = layout_shape_run(layout, run)))
-            WARN("%s: shaping failed, hr %#lx.\n", debugstr_rundescr(&run->descr), hr);
-
-        /* baseline derived from font metrics */
-        layout_get_font_metrics(layout, run->run.fontFace, run->run.fontEmSize, &fontmetrics);
-        layout_get_font_height(run->run.fontEmSize, &fontmetrics, &r->baseline, &r->height);
-
         layout_set_cluster_metrics(layout, r, &cluster);
     }
 
-    if (hr == S_OK) {
-        layout->cluster_count = cluster;
-        if (cluster)
-            layout->clustermetrics[cluster-1].canWrapLineAfter = 1;
-    }
+    layout->cluster_count = cluster;
+    if (cluster)
+        layout->clustermetrics[cluster-1].canWrapLineAfter = 1;
 
-    return hr;
+    return S_OK;
 }
 
 static HRESULT layout_compute(struct dwrite_textlayout *layout)
 {
+    struct layout_range *range;
     HRESULT hr;
 
     if (!(layout->recompute & RECOMPUTE_CLUSTERS))
@@ -1264,8 +1390,22 @@ static HRESULT layout_compute(struct dwrite_textlayout *layout)
     free(layout->actual_breakpoints);
     layout->actual_breakpoints = NULL;
 
+    /* Inline objects override actual text in range. */
+    LIST_FOR_EACH_ENTRY(range, &layout->ranges, struct layout_range, h.entry)
+    {
+        if (range->h.range.startPosition >= layout->len)
+            break;
+
+        if (range->object && FAILED(hr = layout_update_breakpoints_range(layout, range)))
+            return hr;
+    }
+
     hr = layout_compute_runs(layout);
 
+    /* Partially computed runs can't be reused. */
+    if (FAILED(hr))
+        free_layout_runs(layout);
+
     if (TRACE_ON(dwrite)) {
         struct layout_run *cur;
 
@@ -2665,6 +2805,22 @@ static inline HRESULT return_range(const struct layout_range_header *h, DWRITE_T
     return S_OK;
 }
 
+static void layout_invalidate_range_attr(struct dwrite_textlayout *layout, enum layout_range_attr_kind attr,
+        const DWRITE_TEXT_RANGE *range)
+{
+    switch (attr)
+    {
+    /* Decorations and drawing effects are only used to split effective runs. */
+    case LAYOUT_RANGE_ATTR_UNDERLINE:
+    case LAYOUT_RANGE_ATTR_STRIKETHROUGH:
+    case LAYOUT_RANGE_ATTR_EFFECT:
+        layout->recompute |= RECOMPUTE_LINES_AND_OVERHANGS;
+        break;
+    default:
+        layout_invalidate_runs(layout, range->startPosition, range->startPosition + range->length);
+    }
+}
+
 /* Sets attribute value for given range, does all needed splitting/merging of existing ranges. */
 static HRESULT set_layout_range_attr(struct dwrite_textlayout *layout, enum layout_range_attr_kind attr, struct layout_range_attr_value *value)
 {
@@ -2772,7 +2928,7 @@ static HRESULT set_layout_range_attr(struct dwrite_textlayout *layout, enum layo
         list_add_after(&outer->entry, &cur->entry);
         list_add_after(&cur->entry, &right->entry);
 
-        layout->recompute = RECOMPUTE_EVERYTHING;
+        layout_invalidate_range_attr(layout, attr, &value->range);
         return S_OK;
     }
 
@@ -2812,7 +2968,7 @@ done:
     if (changed) {
         struct list *next, *i;
 
-        layout->recompute = RECOMPUTE_EVERYTHING;
+        layout_invalidate_range_attr(layout, attr, &value->range);
         i = list_head(ranges);
         while ((next = list_next(ranges, i))) {
             struct layout_range_header *next_range = LIST_ENTRY(next, struct layout_range_header, entry);
@@ -4073,7 +4229,7 @@ static HRESULT layout_set_vertical_orientation(struct dwrite_textlayout *layout,
         return hr;
 
     if (changed)
-        layout->recompute = RECOMPUTE_EVERYTHING;
+        layout_invalidate(layout);
 
     return S_OK;
 }
@@ -4158,7 +4314,7 @@ static HRESULT WINAPI dwritetextlayout3_InvalidateLayout(IDWriteTextLayout4 *ifa
 
     TRACE("%p.\n", iface);
 
-    layout->recompute = RECOMPUTE_EVERYTHING;
+    layout_invalidate(layout);
     return S_OK;
 }
 
@@ -4466,7 +4622,7 @@ static HRESULT WINAPI dwritetextformat_layout_SetReadingDirection(IDWriteTextFor
         return hr;
 
     if (changed)
-        layout->recompute = RECOMPUTE_EVERYTHING;
+        layout_invalidate(layout);
 
     return S_OK;
 }
@@ -4485,7 +4641,7 @@ static HRESULT WINAPI dwritetextformat_layout_SetFlowDirection(IDWriteTextFormat
         return hr;
 
     if (changed)
-        layout->recompute = RECOMPUTE_EVERYTHING;
+        layout_invalidate(layout);
 
     return S_OK;
 }
@@ -4988,6 +5144,7 @@ static HRESULT WINAPI dwritetextlayout_sink_SetBidiLevel(IDWriteTextAnalysisSink
             return hr;
 
         *run = *cur_run;
+        run->start_position = position + length;
         run->u.regular.descr.textPosition = position + length;
         run->u.regular.descr.stringLength = cur->descr.stringLength - length;
         run->u.regular.descr.string = &layout->str[position + length];
@@ -5275,6 +5432,7 @@ static HRESULT init_textlayout(const struct textlayout_desc *desc, struct dwrite
     layout->refcount = 1;
     layout->len = desc->length;
     layout->recompute = RECOMPUTE_EVERYTHING;
+    layout->dirty.end = ~0u;
     list_init(&layout->eruns);
     list_init(&layout->inlineobjects);
     list_init(&layout->underlines);
@@ -33,6 +33,7 @@
 #include "wine/debug.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(dwrite);
+WINE_DECLARE_DEBUG_CHANNEL(dwrite_cache);
 
 #ifdef WORDS_BIGENDIAN
 #define GET_BE_DWORD(x) (x)
@@ -40,6 +41,151 @@ WINE_DEFAULT_DEBUG_CHANNEL(dwrite);
 #define GET_BE_DWORD(x) RtlUlongByteSwap(x)
 #endif
 
+/* Shaped runs are cached per font face, with the total size limited per face. Entries that
+   are too large compared to that limit, e.g. whole document paragraphs, are not cached. */
+#define SHAPING_RUNS_CACHE_MAX_SIZE 0x40000
+#define SHAPING_RUNS_CACHE_MAX_ENTRY_SIZE (SHAPING_RUNS_CACHE_MAX_SIZE / 16)
+
+struct shaping_run_entry
+{
+    struct wine_rb_entry entry;
+    struct list mru;
+    unsigned int hash;
+    size_t key_size;
+    size_t data_size;
+    BYTE data[1]; /* Key data, followed by cached results. */
+};
+
+static int shaping_runs_compare(const void *k, const struct wine_rb_entry *e)
+{
+    const struct shaping_run_entry *entry = WINE_RB_ENTRY_VALUE(e, const struct shaping_run_entry, entry);
+    const struct shaping_run_key *key = k;
+
+    if (key->hash != entry->hash) return key->hash < entry->hash ? -1 : 1;
+    if (key->size != entry->key_size) return key->size < entry->key_size ? -1 : 1;
+    return memcmp(key->data, entry->data, key->size);
+}
+
+static void shaping_runs_remove_entry(struct scriptshaping_cache *cache, struct shaping_run_entry *entry)
+{
+    cache->runs.size -= offsetof(struct shaping_run_entry, data[entry->key_size + entry->data_size]);
+    wine_rb_remove(&cache->runs.tree, &entry->entry);
+    list_remove(&entry->mru);
+    free(entry);
+}
+
+void shaping_run_key_init(struct shaping_run_key *key, unsigned int type)
+{
+    memset(key, 0, sizeof(*key));
+    /* FNV-1a offset basis. */
+    key->hash = 0x811c9dc5;
+    shaping_run_key_add(key, &type, sizeof(type));
+}
+
+void shaping_run_key_add(struct shaping_run_key *key, const void *data, size_t size)
+{
+    const BYTE *ptr = data;
+    size_t i;
+
+    if (key->failed || !size)
+        return;
+
+    if (key->size + size > SHAPING_RUNS_CACHE_MAX_ENTRY_SIZE
+            || !dwrite_array_reserve((void **)&key->data, &key->capacity, key->size + size, sizeof(*key->data)))
+    {
+        key->failed = TRUE;
+        return;
+    }
+
+    for (i = 0; i < size; ++i)
+    {
+        key->hash ^= ptr[i];
+        key->hash *= 0x01000193;
+    }
+
+    memcpy(key->data + key->size, data, size);
+    key->size += size;
+}
+
+void shaping_run_key_release(struct shaping_run_key *key)
+{
+    free(key->data);
+}
+
+BOOL shaping_cache_get_run(struct scriptshaping_cache *cache, const struct shaping_run_key *key,
+        void *data, size_t *size)
+{
+    struct shaping_run_entry *entry;
+    struct wine_rb_entry *e;
+    BOOL ret = FALSE;
+
+    if (!cache || key->failed)
+        return FALSE;
+
+    EnterCriticalSection(&cache->runs.cs);
+    if ((e = wine_rb_get(&cache->runs.tree, key)))
+    {
+        entry = WINE_RB_ENTRY_VALUE(e, struct shaping_run_entry, entry);
+        if (entry->data_size <= *size)
+        {
+            memcpy(data, entry->data + entry->key_size, entry->data_size);
+            *size = entry->data_size;
+            list_remove(&entry->mru);
+            list_add_head(&cache->runs.mru, &entry->mru);
+            ret = TRUE;
+        }
+    }
+    if (ret) cache->runs.hits++;
+    else cache->runs.misses++;
+    LeaveCriticalSection(&cache->runs.cs);
+
+    return ret;
+}
+
+void shaping_cache_put_run(struct scriptshaping_cache *cache, const struct shaping_run_key *key,
+        const void *data, size_t size)
+{
+    struct shaping_run_entry *entry, *old_entry;
+    size_t entry_size;
+
+    if (!cache || key->failed)
+        return;
+
+    entry_size = offsetof(struct shaping_run_entry, data[key->size + size]);
+    if (entry_size > SHAPING_RUNS_CACHE_MAX_ENTRY_SIZE)
+        return;
+
+    if (!(entry = malloc(entry_size)))
+        return;
+    entry->hash = key->hash;
+    entry->key_size = key->size;
+    entry->data_size = size;
+    memcpy(entry->data, key->data, key->size);
+    memcpy(entry->data + key->size, data, size);
+
+    EnterCriticalSection(&cache->runs.cs);
+
+    while (cache->runs.size + entry_size > SHAPING_RUNS_CACHE_MAX_SIZE && !list_empty(&cache->runs.mru))
+    {
+        old_entry = LIST_ENTRY(list_tail(&cache->runs.mru), struct shaping_run_entry, mru);
+        shaping_runs_remove_entry(cache, old_entry);
+        cache->runs.evictions++;
+    }
+
+    if (wine_rb_put(&cache->runs.tree, key, &entry->entry) == -1)
+    {
+        /* Another thread has already added the same run. */
+        free(entry);
+    }
+    else
+    {
+        list_add_head(&cache->runs.mru, &entry->mru);
+        cache->runs.size += entry_size;
+    }
+
+    LeaveCriticalSection(&cache->runs.cs);
+}
+
 struct scriptshaping_cache *create_scriptshaping_cache(void *context, const struct shaping_font_ops *font_ops)
 {
     struct scriptshaping_cache *cache;
@@ -53,14 +199,27 @@ struct scriptshaping_cache *create_scriptshaping_cache(void *context, const stru
     opentype_layout_scriptshaping_cache_init(cache);
     cache->upem = cache->font->get_font_upem(cache->context);
 
+    InitializeCriticalSection(&cache->runs.cs);
+    wine_rb_init(&cache->runs.tree, shaping_runs_compare);
+    list_init(&cache->runs.mru);
+
     return cache;
 }
 
 void release_scriptshaping_cache(struct scriptshaping_cache *cache)
 {
+    struct shaping_run_entry *entry, *entry2;
+
     if (!cache)
         return;
 
+    TRACE_(dwrite_cache)("Shaped runs cache %p: size %Iu, hits %u, misses %u, evictions %u.\n", cache,
+            cache->runs.size, cache->runs.hits, cache->runs.misses, cache->runs.evictions);
+
+    LIST_FOR_EACH_ENTRY_SAFE(entry, entry2, &cache->runs.mru, struct shaping_run_entry, mru)
+        free(entry);
+    DeleteCriticalSection(&cache->runs.cs);
+
     cache->font->release_font_table(cache->context, cache->gdef.table.context);
     cache->font->release_font_table(cache->context, cache->gsub.table.context);
     cache->font->release_font_table(cache->context, cache->gpos.table.context);
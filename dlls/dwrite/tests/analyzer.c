@@ -1738,6 +1738,15 @@ if (0) {
     ok(actual_count == 4, "got %d\n", actual_count);
     ok(glyphs1[0] != glyphs2[0], "got %d\n", glyphs1[0]);
 
+    /* same run shaped again */
+    actual_count = 0;
+    memset(glyphs1, 0, sizeof(glyphs1));
+    hr = IDWriteTextAnalyzer_GetGlyphs(analyzer, test1W, lstrlenW(test1W), fontface, FALSE, TRUE, &sa, NULL,
+        NULL, NULL, NULL, 0, maxglyphcount, clustermap, props, glyphs1, shapingprops, &actual_count);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    ok(actual_count == 4, "got %d\n", actual_count);
+    ok(!memcmp(glyphs1, glyphs2, actual_count * sizeof(*glyphs1)), "Unexpected glyphs.\n");
+
     /* embedded control codes, with unknown script id 0 */
     get_fontface_glyphs(fontface, test3W, glyphs2);
     get_fontface_advances(fontface, 10.0, glyphs2, advances2, 2);
@@ -1852,6 +1861,172 @@ if (0) {
     IDWriteTextAnalyzer_Release(analyzer);
 }
 
+static void test_GetGlyphs_cache(void)
+{
+    DWRITE_FONT_FEATURE liga_on = { DWRITE_FONT_FEATURE_TAG_STANDARD_LIGATURES, 1 };
+    DWRITE_FONT_FEATURE liga_off = { DWRITE_FONT_FEATURE_TAG_STANDARD_LIGATURES, 0 };
+    DWRITE_FONT_FEATURE kern_on = { DWRITE_FONT_FEATURE_TAG_KERNING, 1 };
+    DWRITE_FONT_FEATURE kern_off = { DWRITE_FONT_FEATURE_TAG_KERNING, 0 };
+    DWRITE_TYPOGRAPHIC_FEATURES features = { 0 };
+    const DWRITE_TYPOGRAPHIC_FEATURES *pfeatures = &features;
+    IDWriteNumberSubstitution *subst_ar, *subst_en;
+    DWRITE_SHAPING_GLYPH_PROPERTIES glyphprops[10];
+    DWRITE_SHAPING_TEXT_PROPERTIES textprops[10];
+    UINT16 clustermap[10], glyphs[10], glyphs2[10], expected[10];
+    DWRITE_GLYPH_OFFSET offsets[10];
+    DWRITE_GLYPH_METRICS metrics[10];
+    DWRITE_FONT_METRICS fontmetrics;
+    FLOAT advances[10], advances2[10], design_advance;
+    IDWriteFontFace *fontface, *fontface2;
+    IDWriteTextAnalyzer *analyzer;
+    DWRITE_SCRIPT_ANALYSIS sa;
+    UINT32 count, count2, len, i;
+    WCHAR *path;
+    HRESULT hr;
+
+    analyzer = create_text_analyzer(&IID_IDWriteTextAnalyzer);
+    ok(!!analyzer, "Failed to create analyzer instance.\n");
+
+    fontface = create_fontface();
+
+    /* Same text shaped with a different font face. */
+    path = create_testfontfile(L"wine_test_font.ttf");
+    fontface2 = create_testfontface(path);
+
+    get_script_analysis(L"AD", &sa);
+    len = 2;
+    count = 0;
+    hr = IDWriteTextAnalyzer_GetGlyphs(analyzer, L"AD", len, fontface, FALSE, FALSE, &sa, NULL,
+        NULL, NULL, NULL, 0, ARRAY_SIZE(glyphs), clustermap, textprops, glyphs, glyphprops, &count);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    ok(count == 2, "Unexpected glyph count %u.\n", count);
+    get_fontface_glyphs(fontface, L"AD", expected);
+    ok(!memcmp(glyphs, expected, count * sizeof(*glyphs)), "Unexpected glyphs.\n");
+
+    count = 0;
+    hr = IDWriteTextAnalyzer_GetGlyphs(analyzer, L"AD", len, fontface2, FALSE, FALSE, &sa, NULL,
+        NULL, NULL, NULL, 0, ARRAY_SIZE(glyphs), clustermap, textprops, glyphs, glyphprops, &count);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    ok(count == 2, "Unexpected glyph count %u.\n", count);
+    get_fontface_glyphs(fontface2, L"AD", expected);
+    ok(!memcmp(glyphs, expected, count * sizeof(*glyphs)), "Unexpected glyphs.\n");
+
+    IDWriteFontFace_Release(fontface2);
+    DELETE_FONTFILE(path);
+
+    /* Same text shaped for a different locale. */
+    hr = IDWriteFactory_CreateNumberSubstitution(factory, DWRITE_NUMBER_SUBSTITUTION_METHOD_TRADITIONAL, L"ar-EG",
+            FALSE, &subst_ar);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    hr = IDWriteFactory_CreateNumberSubstitution(factory, DWRITE_NUMBER_SUBSTITUTION_METHOD_TRADITIONAL, L"en-US",
+            FALSE, &subst_en);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+
+    get_script_analysis(L"123", &sa);
+    len = 3;
+    count = 0;
+    hr = IDWriteTextAnalyzer_GetGlyphs(analyzer, L"123", len, fontface, FALSE, FALSE, &sa, L"ar-EG",
+        subst_ar, NULL, NULL, 0, ARRAY_SIZE(glyphs), clustermap, textprops, glyphs, glyphprops, &count);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    ok(count == 3, "Unexpected glyph count %u.\n", count);
+
+    count2 = 0;
+    hr = IDWriteTextAnalyzer_GetGlyphs(analyzer, L"123", len, fontface, FALSE, FALSE, &sa, L"en-US",
+        subst_en, NULL, NULL, 0, ARRAY_SIZE(glyphs2), clustermap, textprops, glyphs2, glyphprops, &count2);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    ok(count2 == 3, "Unexpected glyph count %u.\n", count2);
+    get_fontface_glyphs(fontface, L"123", expected);
+    ok(!memcmp(glyphs2, expected, count2 * sizeof(*glyphs2)), "Unexpected glyphs.\n");
+
+    count2 = 0;
+    memset(glyphs2, 0, sizeof(glyphs2));
+    hr = IDWriteTextAnalyzer_GetGlyphs(analyzer, L"123", len, fontface, FALSE, FALSE, &sa, L"ar-EG",
+        subst_ar, NULL, NULL, 0, ARRAY_SIZE(glyphs2), clustermap, textprops, glyphs2, glyphprops, &count2);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    ok(count2 == count, "Unexpected glyph count %u.\n", count2);
+    ok(!memcmp(glyphs2, glyphs, count * sizeof(*glyphs)), "Unexpected glyphs.\n");
+
+    IDWriteNumberSubstitution_Release(subst_ar);
+    IDWriteNumberSubstitution_Release(subst_en);
+
+    /* Same text shaped with different user features. */
+    get_script_analysis(L"fi", &sa);
+    len = 2;
+    features.features = &liga_on;
+    features.featureCount = 1;
+    count = 0;
+    hr = IDWriteTextAnalyzer_GetGlyphs(analyzer, L"fi", len, fontface, FALSE, FALSE, &sa, NULL,
+        NULL, &pfeatures, &len, 1, ARRAY_SIZE(glyphs), clustermap, textprops, glyphs, glyphprops, &count);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    ok(count == 1 || count == 2, "Unexpected glyph count %u.\n", count);
+
+    features.features = &liga_off;
+    count2 = 0;
+    hr = IDWriteTextAnalyzer_GetGlyphs(analyzer, L"fi", len, fontface, FALSE, FALSE, &sa, NULL,
+        NULL, &pfeatures, &len, 1, ARRAY_SIZE(glyphs2), clustermap, textprops, glyphs2, glyphprops, &count2);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    ok(count2 == 2, "Unexpected glyph count %u.\n", count2);
+    get_fontface_glyphs(fontface, L"fi", expected);
+    ok(!memcmp(glyphs2, expected, count2 * sizeof(*glyphs2)), "Unexpected glyphs.\n");
+
+    features.features = &liga_on;
+    count2 = 0;
+    memset(glyphs2, 0, sizeof(glyphs2));
+    hr = IDWriteTextAnalyzer_GetGlyphs(analyzer, L"fi", len, fontface, FALSE, FALSE, &sa, NULL,
+        NULL, &pfeatures, &len, 1, ARRAY_SIZE(glyphs2), clustermap, textprops, glyphs2, glyphprops, &count2);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    ok(count2 == count, "Unexpected glyph count %u.\n", count2);
+    ok(!memcmp(glyphs2, glyphs, count * sizeof(*glyphs)), "Unexpected glyphs.\n");
+
+    /* Same glyphs placed at different sizes. */
+    get_script_analysis(L"AV", &sa);
+    len = 2;
+    count = 0;
+    hr = IDWriteTextAnalyzer_GetGlyphs(analyzer, L"AV", len, fontface, FALSE, FALSE, &sa, NULL,
+        NULL, NULL, NULL, 0, ARRAY_SIZE(glyphs), clustermap, textprops, glyphs, glyphprops, &count);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    ok(count == 2, "Unexpected glyph count %u.\n", count);
+
+    IDWriteFontFace_GetMetrics(fontface, &fontmetrics);
+    hr = IDWriteFontFace_GetDesignGlyphMetrics(fontface, glyphs, count, metrics, FALSE);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+
+    hr = IDWriteTextAnalyzer_GetGlyphPlacements(analyzer, L"AV", clustermap, textprops, len, glyphs, glyphprops,
+        count, fontface, 10.0f, FALSE, FALSE, &sa, NULL, NULL, NULL, 0, advances, offsets);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    hr = IDWriteTextAnalyzer_GetGlyphPlacements(analyzer, L"AV", clustermap, textprops, len, glyphs, glyphprops,
+        count, fontface, 20.0f, FALSE, FALSE, &sa, NULL, NULL, NULL, 0, advances2, offsets);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    for (i = 0; i < count; ++i)
+    {
+        ok(advances[i] > 0.0f, "%u: unexpected advance %.8e.\n", i, advances[i]);
+        ok(fabsf(advances2[i] - 2.0f * advances[i]) < 1e-3f, "%u: unexpected advances %.8e, %.8e.\n",
+                i, advances[i], advances2[i]);
+    }
+
+    /* Same glyphs placed with different user features. Without kerning, advances are
+       the design advances, whether or not kerning changed them. */
+    features.features = &kern_on;
+    features.featureCount = 1;
+    hr = IDWriteTextAnalyzer_GetGlyphPlacements(analyzer, L"AV", clustermap, textprops, len, glyphs, glyphprops,
+        count, fontface, 20.0f, FALSE, FALSE, &sa, NULL, &pfeatures, &len, 1, advances, offsets);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+
+    features.features = &kern_off;
+    hr = IDWriteTextAnalyzer_GetGlyphPlacements(analyzer, L"AV", clustermap, textprops, len, glyphs, glyphprops,
+        count, fontface, 20.0f, FALSE, FALSE, &sa, NULL, &pfeatures, &len, 1, advances2, offsets);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    for (i = 0; i < count; ++i)
+    {
+        design_advance = metrics[i].advanceWidth * 20.0f / fontmetrics.designUnitsPerEm;
+        ok(fabsf(advances2[i] - design_advance) < 1e-3f, "%u: unexpected advance %.8e, expected %.8e.\n",
+                i, advances2[i], design_advance);
+    }
+
+    IDWriteFontFace_Release(fontface);
+    IDWriteTextAnalyzer_Release(analyzer);
+}
+
 static void test_GetTypographicFeatures(void)
 {
     static const WCHAR arabicW[] = {0x064a,0x064f,0x0633,0};
@@ -2979,6 +3154,7 @@ START_TEST(analyzer)
     test_GetScriptProperties();
     test_GetTextComplexity();
     test_GetGlyphs();
+    test_GetGlyphs_cache();
     test_numbersubstitution();
     test_GetTypographicFeatures();
     test_GetGlyphPlacements();
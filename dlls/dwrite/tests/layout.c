@@ -3203,8 +3203,10 @@ static void test_DetermineMinWidth(void)
 
 static void test_SetFontSize(void)
 {
+    DWRITE_CLUSTER_METRICS clusters[10], clusters2[10];
+    IDWriteTextLayout *layout, *layout2;
+    UINT32 count, count2;
     IDWriteTextFormat *format;
-    IDWriteTextLayout *layout;
     IDWriteFactory *factory;
     DWRITE_TEXT_RANGE r;
     FLOAT size;
@@ -3287,6 +3289,94 @@ static void test_SetFontSize(void)
     ok(r.startPosition == 100 && r.length == 4, "got %u, %u\n", r.startPosition, r.length);
     ok(size == 25.0, "got %.2f\n", size);
 
+    IDWriteTextLayout_Release(layout);
+
+    /* Changing size for a range of already computed layout. */
+    hr = IDWriteFactory_CreateTextLayout(factory, L"abcd efgh", 9, format, 1000.0f, 1000.0f, &layout);
+    ok(hr == S_OK, "Failed to create text layout, hr %#lx.\n", hr);
+
+    count = 0;
+    hr = IDWriteTextLayout_GetClusterMetrics(layout, clusters, ARRAY_SIZE(clusters), &count);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    ok(count == 9, "Unexpected cluster count %u.\n", count);
+
+    r.startPosition = 5;
+    r.length = 4;
+    hr = IDWriteTextLayout_SetFontSize(layout, 20.0f, r);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+
+    count = 0;
+    hr = IDWriteTextLayout_GetClusterMetrics(layout, clusters, ARRAY_SIZE(clusters), &count);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    ok(count == 9, "Unexpected cluster count %u.\n", count);
+
+    hr = IDWriteFactory_CreateTextLayout(factory, L"abcd efgh", 9, format, 1000.0f, 1000.0f, &layout2);
+    ok(hr == S_OK, "Failed to create text layout, hr %#lx.\n", hr);
+
+    hr = IDWriteTextLayout_SetFontSize(layout2, 20.0f, r);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+
+    count2 = 0;
+    hr = IDWriteTextLayout_GetClusterMetrics(layout2, clusters2, ARRAY_SIZE(clusters2), &count2);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    ok(count == count2, "Unexpected cluster count %u, expected %u.\n", count, count2);
+    ok(!memcmp(clusters, clusters2, count * sizeof(*clusters)), "Unexpected cluster metrics.\n");
+
+    IDWriteTextLayout_Release(layout2);
+
+    /* Split existing run in the middle, and change it again. */
+    r.startPosition = 2;
+    r.length = 2;
+    hr = IDWriteTextLayout_SetFontSize(layout, 30.0f, r);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+
+    r.startPosition = 3;
+    r.length = 3;
+    hr = IDWriteTextLayout_SetFontSize(layout, 10.0f, r);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+
+    count = 0;
+    hr = IDWriteTextLayout_GetClusterMetrics(layout, clusters, ARRAY_SIZE(clusters), &count);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    ok(count == 9, "Unexpected cluster count %u.\n", count);
+
+    r.startPosition = 1;
+    r.length = 1;
+    hr = IDWriteTextLayout_SetFontSize(layout, 15.0f, r);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+
+    count = 0;
+    hr = IDWriteTextLayout_GetClusterMetrics(layout, clusters, ARRAY_SIZE(clusters), &count);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    ok(count == 9, "Unexpected cluster count %u.\n", count);
+
+    hr = IDWriteFactory_CreateTextLayout(factory, L"abcd efgh", 9, format, 1000.0f, 1000.0f, &layout2);
+    ok(hr == S_OK, "Failed to create text layout, hr %#lx.\n", hr);
+
+    r.startPosition = 5;
+    r.length = 4;
+    hr = IDWriteTextLayout_SetFontSize(layout2, 20.0f, r);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    r.startPosition = 2;
+    r.length = 2;
+    hr = IDWriteTextLayout_SetFontSize(layout2, 30.0f, r);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    r.startPosition = 3;
+    r.length = 3;
+    hr = IDWriteTextLayout_SetFontSize(layout2, 10.0f, r);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    r.startPosition = 1;
+    r.length = 1;
+    hr = IDWriteTextLayout_SetFontSize(layout2, 15.0f, r);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+
+    count2 = 0;
+    hr = IDWriteTextLayout_GetClusterMetrics(layout2, clusters2, ARRAY_SIZE(clusters2), &count2);
+    ok(hr == S_OK, "Unexpected hr %#lx.\n", hr);
+    ok(count == count2, "Unexpected cluster count %u, expected %u.\n", count, count2);
+    ok(!memcmp(clusters, clusters2, count * sizeof(*clusters)), "Unexpected cluster metrics.\n");
+
+    IDWriteTextLayout_Release(layout2);
     IDWriteTextLayout_Release(layout);
     IDWriteTextFormat_Release(format);
     IDWriteFactory_Release(factory);
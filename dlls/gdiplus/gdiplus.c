@@ -442,21 +442,33 @@ BOOL lengthen_path(GpPath *path, INT len)
     return TRUE;
 }
 
+/* Computes (c * alpha + 127) / 255 for the two 8-bit channels stored in the
+ * low bytes of each 16-bit lane of "lanes", without any division. */
+static inline DWORD premultiply_lanes(DWORD lanes, DWORD alpha)
+{
+    DWORD t = lanes * alpha + 0x007f007f;
+    return ((t + ((t >> 8) & 0x00ff00ff) + 0x00010001) >> 8) & 0x00ff00ff;
+}
+
 void convert_32bppARGB_to_32bppPARGB(UINT width, UINT height,
     BYTE *dst_bits, INT dst_stride, const BYTE *src_bits, INT src_stride)
 {
-    INT x, y;
+    UINT x, y;
     for (y=0; y<height; y++)
     {
-        const BYTE *src=src_bits+y*src_stride;
-        BYTE *dst=dst_bits+y*dst_stride;
+        const DWORD *src=(const DWORD *)(src_bits+y*src_stride);
+        DWORD *dst=(DWORD *)(dst_bits+y*dst_stride);
         for (x=0; x<width; x++)
         {
-            BYTE alpha=src[3];
-            *dst++ = (*src++ * alpha + 127) / 255;
-            *dst++ = (*src++ * alpha + 127) / 255;
-            *dst++ = (*src++ * alpha + 127) / 255;
-            *dst++ = *src++;
+            DWORD argb=src[x], alpha=argb>>24;
+
+            if (alpha == 0xff)
+                dst[x] = argb;
+            else if (alpha == 0)
+                dst[x] = 0;
+            else
+                dst[x] = (alpha << 24) | premultiply_lanes(argb & 0x00ff00ff, alpha) |
+                         (premultiply_lanes((argb >> 8) & 0xff, alpha) << 8);
         }
     }
 }
@@ -418,6 +418,40 @@ static GpStatus alpha_blend_bmp_pixels(GpGraphics *graphics, INT dst_x, INT dst_
     INT x, y;
     CompositingMode comp_mode = graphics->compmode;
 
+    if (dst_bitmap->format == PixelFormat32bppARGB)
+    {
+        /* Blend whole rows directly into the bitmap bits, skipping the
+         * pixels that GdipBitmapSetPixel() would reject. */
+        INT x_min = max(0, -dst_x), x_max = min(src_width, (INT)dst_bitmap->width - dst_x);
+        INT y_min = max(0, -dst_y), y_max = min(src_height, (INT)dst_bitmap->height - dst_y);
+
+        for (y=y_min; y<y_max; y++)
+        {
+            const ARGB *src_row = (const ARGB *)(src + src_stride * y);
+            ARGB *dst_row = (ARGB *)(dst_bitmap->bits + dst_bitmap->stride * (y + dst_y)) + dst_x;
+
+            if (comp_mode == CompositingModeSourceCopy)
+            {
+                for (x=x_min; x<x_max; x++)
+                    dst_row[x] = (src_row[x] & 0xff000000) ? src_row[x] : 0;
+            }
+            else if (fmt & PixelFormatPAlpha)
+            {
+                for (x=x_min; x<x_max; x++)
+                    if (src_row[x] & 0xff000000)
+                        dst_row[x] = color_over_fgpremult(dst_row[x], src_row[x]);
+            }
+            else
+            {
+                for (x=x_min; x<x_max; x++)
+                    if (src_row[x] & 0xff000000)
+                        dst_row[x] = color_over(dst_row[x], src_row[x]);
+            }
+        }
+
+        return Ok;
+    }
+
     for (y=0; y<src_height; y++)
     {
         for (x=0; x<src_width; x++)
@@ -1038,14 +1072,30 @@ static ARGB resample_bitmap_pixel(GDIPCONST GpRect *src_rect, LPBYTE bits, UINT
             return sample_bitmap_pixel(src_rect, bits, width, height,
                 leftx, topy, attributes);
 
-        topleft = sample_bitmap_pixel(src_rect, bits, width, height,
-            leftx, topy, attributes);
-        topright = sample_bitmap_pixel(src_rect, bits, width, height,
-            rightx, topy, attributes);
-        bottomleft = sample_bitmap_pixel(src_rect, bits, width, height,
-            leftx, bottomy, attributes);
-        bottomright = sample_bitmap_pixel(src_rect, bits, width, height,
-            rightx, bottomy, attributes);
+        if (leftx >= src_rect->X && rightx < src_rect->X + src_rect->Width &&
+            topy >= src_rect->Y && bottomy < src_rect->Y + src_rect->Height)
+        {
+            /* All four samples are inside the source rectangle, so no
+             * wrapping is needed and they can be read directly. */
+            const ARGB *top_row = (const ARGB *)bits + (topy - src_rect->Y) * src_rect->Width;
+            const ARGB *bottom_row = (const ARGB *)bits + (bottomy - src_rect->Y) * src_rect->Width;
+
+            topleft = top_row[leftx - src_rect->X];
+            topright = top_row[rightx - src_rect->X];
+            bottomleft = bottom_row[leftx - src_rect->X];
+            bottomright = bottom_row[rightx - src_rect->X];
+        }
+        else
+        {
+            topleft = sample_bitmap_pixel(src_rect, bits, width, height,
+                leftx, topy, attributes);
+            topright = sample_bitmap_pixel(src_rect, bits, width, height,
+                rightx, topy, attributes);
+            bottomleft = sample_bitmap_pixel(src_rect, bits, width, height,
+                leftx, bottomy, attributes);
+            bottomright = sample_bitmap_pixel(src_rect, bits, width, height,
+                rightx, bottomy, attributes);
+        }
 
         x_offset = point->X - leftxf;
         top = blend_colors(topleft, topright, x_offset);
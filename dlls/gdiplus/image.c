@@ -587,6 +587,71 @@ GpStatus WINGDIPAPI GdipBitmapSetPixel(GpBitmap* bitmap, INT x, INT y,
     return Ok;
 }
 
+/* Row based conversions for the most common 24/32 bpp cases. These must give
+ * exactly the same results as the generic getpixel/setpixel combinations. */
+static void convert_24bppRGB_to_32bpp(INT width, INT height, INT dst_stride, BYTE *dst_bits,
+    INT src_stride, const BYTE *src_bits, DWORD alpha)
+{
+    INT x, y;
+
+    for (y=0; y<height; y++)
+    {
+        const BYTE *src=src_bits+src_stride*y;
+        DWORD *dst=(DWORD *)(dst_bits+dst_stride*y);
+        for (x=0; x<width; x++, src+=3)
+            dst[x] = alpha|(src[2]<<16)|(src[1]<<8)|src[0];
+    }
+}
+
+static void convert_32bppRGB_to_32bppARGB(INT width, INT height, INT dst_stride, BYTE *dst_bits,
+    INT src_stride, const BYTE *src_bits)
+{
+    INT x, y;
+
+    for (y=0; y<height; y++)
+    {
+        const DWORD *src=(const DWORD *)(src_bits+src_stride*y);
+        DWORD *dst=(DWORD *)(dst_bits+dst_stride*y);
+        for (x=0; x<width; x++)
+            dst[x] = src[x]|0xff000000;
+    }
+}
+
+static inline DWORD unpremultiply_channel(DWORD c, DWORD alpha, DWORD scaled_q)
+{
+    return (c > alpha) ? 0xff : (c * scaled_q) >> 15;
+}
+
+static void convert_32bppPARGB_to_32bppARGB(INT width, INT height, INT dst_stride, BYTE *dst_bits,
+    INT src_stride, const BYTE *src_bits)
+{
+    INT x, y;
+
+    for (y=0; y<height; y++)
+    {
+        const DWORD *src=(const DWORD *)(src_bits+src_stride*y);
+        DWORD *dst=(DWORD *)(dst_bits+dst_stride*y);
+        for (x=0; x<width; x++)
+        {
+            DWORD pargb=src[x], alpha=pargb>>24, scaled_q;
+
+            /* Fully opaque pixels are unchanged, and fully transparent ones
+             * keep their colour channels as is (see getpixel_32bppPARGB). */
+            if (alpha == 0xff || alpha == 0)
+            {
+                dst[x] = pargb;
+                continue;
+            }
+
+            scaled_q = (255 << 15) / alpha;
+            dst[x] = (alpha << 24) |
+                     (unpremultiply_channel((pargb >> 16) & 0xff, alpha, scaled_q) << 16) |
+                     (unpremultiply_channel((pargb >> 8) & 0xff, alpha, scaled_q) << 8) |
+                     unpremultiply_channel(pargb & 0xff, alpha, scaled_q);
+        }
+    }
+}
+
 GpStatus convert_pixels(INT width, INT height,
     INT dst_stride, BYTE *dst_bits, PixelFormat dst_format,
     ColorPalette *dst_palette,
@@ -887,11 +952,12 @@ GpStatus convert_pixels(INT width, INT height,
         case PixelFormat16bppARGB1555:
             convert_rgb_to_rgb(getpixel_24bppRGB, setpixel_16bppARGB1555);
         case PixelFormat32bppRGB:
-            convert_rgb_to_rgb(getpixel_24bppRGB, setpixel_32bppRGB);
+            convert_24bppRGB_to_32bpp(width, height, dst_stride, dst_bits, src_stride, src_bits, 0);
+            return Ok;
         case PixelFormat32bppARGB:
-            convert_rgb_to_rgb(getpixel_24bppRGB, setpixel_32bppARGB);
         case PixelFormat32bppPARGB:
-            convert_rgb_to_rgb(getpixel_24bppRGB, setpixel_32bppPARGB);
+            convert_24bppRGB_to_32bpp(width, height, dst_stride, dst_bits, src_stride, src_bits, 0xff000000);
+            return Ok;
         case PixelFormat48bppRGB:
             convert_rgb_to_rgb(getpixel_24bppRGB, setpixel_48bppRGB);
         case PixelFormat64bppARGB:
@@ -920,9 +986,9 @@ GpStatus convert_pixels(INT width, INT height,
         case PixelFormat24bppRGB:
             convert_rgb_to_rgb(getpixel_32bppRGB, setpixel_24bppRGB);
         case PixelFormat32bppARGB:
-            convert_rgb_to_rgb(getpixel_32bppRGB, setpixel_32bppARGB);
         case PixelFormat32bppPARGB:
-            convert_rgb_to_rgb(getpixel_32bppRGB, setpixel_32bppPARGB);
+            convert_32bppRGB_to_32bppARGB(width, height, dst_stride, dst_bits, src_stride, src_bits);
+            return Ok;
         case PixelFormat48bppRGB:
             convert_rgb_to_rgb(getpixel_32bppRGB, setpixel_48bppRGB);
         case PixelFormat64bppARGB:
@@ -983,7 +1049,8 @@ GpStatus convert_pixels(INT width, INT height,
         case PixelFormat32bppRGB:
             convert_rgb_to_rgb(getpixel_32bppPARGB, setpixel_32bppRGB);
         case PixelFormat32bppARGB:
-            convert_rgb_to_rgb(getpixel_32bppPARGB, setpixel_32bppARGB);
+            convert_32bppPARGB_to_32bppARGB(width, height, dst_stride, dst_bits, src_stride, src_bits);
+            return Ok;
         case PixelFormat48bppRGB:
             convert_rgb_to_rgb(getpixel_32bppPARGB, setpixel_48bppRGB);
         case PixelFormat64bppARGB:
@@ -4672,6 +4672,68 @@ static void test_DrawImage_SourceCopy(void)
     expect(Ok, status);
 }
 
+static void test_DrawImage_blend(void)
+{
+    static const DWORD dst_init[6] = { 0xff204080, 0xff204080, 0xff204080,
+                                       0xff204080, 0xff204080, 0x80204080 };
+    static const DWORD argb_pixels[6] = { 0x00ffffff, 0xff102030, 0x01ffffff,
+                                          0x80ff0000, 0xfe00ff00, 0x7f808080 };
+    static const DWORD pargb_pixels[6] = { 0x00000000, 0xff102030, 0x01010101,
+                                           0x80800000, 0xfe00fe00, 0x7f404040 };
+    static const DWORD argb_expected[6] = { 0xff204080, 0xff102030, 0xff204080,
+                                            0xff8f1f3f, 0xff00fe00, 0xbf5f6a80 };
+    static const DWORD pargb_expected[6] = { 0xff204080, 0xff102030, 0xff204080,
+                                             0xff8f1f3f, 0xff00fe00, 0xbf606a80 };
+    static const struct
+    {
+        PixelFormat format;
+        const DWORD *src;
+        const DWORD *expected;
+    }
+    tests[] =
+    {
+        { PixelFormat32bppARGB, argb_pixels, argb_expected },
+        { PixelFormat32bppPARGB, pargb_pixels, pargb_expected },
+    };
+    DWORD dst_pixels[6], src_pixels[6];
+    GpBitmap *dst, *src;
+    GpGraphics *graphics;
+    GpStatus status;
+    unsigned int i, j;
+
+    for (i = 0; i < ARRAY_SIZE(tests); i++)
+    {
+        memcpy(dst_pixels, dst_init, sizeof(dst_pixels));
+        memcpy(src_pixels, tests[i].src, sizeof(src_pixels));
+
+        status = GdipCreateBitmapFromScan0(6, 1, 24, PixelFormat32bppARGB, (BYTE *)dst_pixels, &dst);
+        expect(Ok, status);
+        status = GdipCreateBitmapFromScan0(6, 1, 24, tests[i].format, (BYTE *)src_pixels, &src);
+        expect(Ok, status);
+        status = GdipGetImageGraphicsContext((GpImage *)dst, &graphics);
+        expect(Ok, status);
+        status = GdipSetInterpolationMode(graphics, InterpolationModeNearestNeighbor);
+        expect(Ok, status);
+
+        status = GdipDrawImageI(graphics, (GpImage *)src, 0, 0);
+        expect(Ok, status);
+
+        /* Transparent and opaque source pixels must be exact. Windows
+         * rounds some of the partial blends differently. */
+        for (j = 0; j < ARRAY_SIZE(dst_pixels); j++)
+            ok(dst_pixels[j] == tests[i].expected[j] ||
+               broken(j > 1 && color_match(dst_pixels[j], tests[i].expected[j], 1)),
+               "%u: pixel %u: expected %08lx, got %08lx\n", i, j, tests[i].expected[j], dst_pixels[j]);
+
+        status = GdipDeleteGraphics(graphics);
+        expect(Ok, status);
+        status = GdipDisposeImage((GpImage *)src);
+        expect(Ok, status);
+        status = GdipDisposeImage((GpImage *)dst);
+        expect(Ok, status);
+    }
+}
+
 static void test_GdipDrawImagePointRect(void)
 {
     BYTE black_1x1[4] = { 0,0,0,0 };
@@ -5261,6 +5323,131 @@ static void test_PARGB_conversion(void)
     GdipDisposeImage((GpImage *)bitmap);
 }
 
+static void test_PARGB_conversion_exact(void)
+{
+    GpBitmap *bitmap;
+    BitmapData data;
+    GpStatus status;
+    DWORD *argb;
+    UINT x, y, mismatches = 0;
+
+    argb = malloc(256 * 256 * sizeof(*argb));
+    for (y = 0; y < 256; y++)
+        for (x = 0; x < 256; x++)
+            argb[y * 256 + x] = (y << 24) | (x << 16) | ((255 - x) << 8) | ((x * 7) & 0xff);
+
+    status = GdipCreateBitmapFromScan0(256, 256, 256 * 4, PixelFormat32bppARGB, (BYTE *)argb, &bitmap);
+    expect(Ok, status);
+
+    status = GdipBitmapLockBits(bitmap, NULL, ImageLockModeRead, PixelFormat32bppPARGB, &data);
+    expect(Ok, status);
+    for (y = 0; y < 256; y++)
+    {
+        const DWORD *row = (const DWORD *)((BYTE *)data.Scan0 + data.Stride * y);
+        for (x = 0; x < 256; x++)
+        {
+            DWORD src = argb[y * 256 + x], expected;
+
+            expected = (y << 24) |
+                ((((src >> 16) & 0xff) * y + 127) / 255) << 16 |
+                ((((src >> 8) & 0xff) * y + 127) / 255) << 8 |
+                ((src & 0xff) * y + 127) / 255;
+            if (row[x] != expected && !mismatches++)
+                ok(0, "pixel %u,%u: expected %08lx, got %08lx\n", x, y, expected, row[x]);
+        }
+    }
+    ok(!mismatches, "got %u mismatching pixels\n", mismatches);
+    status = GdipBitmapUnlockBits(bitmap, &data);
+    expect(Ok, status);
+
+    GdipDisposeImage((GpImage *)bitmap);
+    free(argb);
+}
+
+
+static void test_RGB_conversion_exact(void)
+{
+    /* 3 pixels per row, followed by 3 bytes of padding. */
+    BYTE rgb24[2 * 12] = { 0x00,0x00,0x00, 0xff,0xff,0xff, 0x12,0x34,0x56, 0xee,0xee,0xee,
+                           0x01,0x80,0xfe, 0x7f,0x80,0x81, 0xfe,0x01,0x00, 0xee,0xee,0xee };
+    static const DWORD rgb24_expected[6] = { 0xff000000, 0xffffffff, 0xff563412,
+                                             0xfffe8001, 0xff81807f, 0xff0001fe };
+    /* The alpha byte of 32bpp RGB is ignored. */
+    DWORD rgb32[6] = { 0x00000000, 0x80ffffff, 0x01563412,
+                       0xfffe8001, 0x7f81807f, 0xfe0001fe };
+    DWORD pargb[8] = { 0x00123456, 0xff123456, 0x01010000, 0x01020100,
+                       0x80407f80, 0xfe7f7ffe, 0x7f3f4080, 0x00000000 };
+    static const DWORD pargb_expected[8] = { 0x00123456, 0xff123456, 0x01ff0000, 0x01ffff00,
+                                             0x807ffdff, 0xfe7f7ffe, 0x7f7e80ff, 0x00000000 };
+    static const PixelFormat rgb_dst_formats[] =
+    {
+        PixelFormat32bppRGB, PixelFormat32bppARGB, PixelFormat32bppPARGB,
+    };
+    const DWORD *row;
+    GpBitmap *bitmap;
+    BitmapData data;
+    GpStatus status;
+    UINT i, x, y;
+
+    status = GdipCreateBitmapFromScan0(3, 2, 12, PixelFormat24bppRGB, rgb24, &bitmap);
+    expect(Ok, status);
+    for (i = 0; i < ARRAY_SIZE(rgb_dst_formats); i++)
+    {
+        status = GdipBitmapLockBits(bitmap, NULL, ImageLockModeRead, rgb_dst_formats[i], &data);
+        expect(Ok, status);
+        for (y = 0; y < 2; y++)
+        {
+            row = (const DWORD *)((BYTE *)data.Scan0 + data.Stride * y);
+            for (x = 0; x < 3; x++)
+            {
+                /* 32bpp RGB alpha is undefined. */
+                if (rgb_dst_formats[i] == PixelFormat32bppRGB)
+                    ok((row[x] & 0xffffff) == (rgb24_expected[y * 3 + x] & 0xffffff),
+                       "%#x: pixel %u,%u: expected %08lx, got %08lx\n", rgb_dst_formats[i], x, y,
+                       rgb24_expected[y * 3 + x], row[x]);
+                else
+                    ok(row[x] == rgb24_expected[y * 3 + x],
+                       "%#x: pixel %u,%u: expected %08lx, got %08lx\n", rgb_dst_formats[i], x, y,
+                       rgb24_expected[y * 3 + x], row[x]);
+            }
+        }
+        status = GdipBitmapUnlockBits(bitmap, &data);
+        expect(Ok, status);
+    }
+    GdipDisposeImage((GpImage *)bitmap);
+
+    status = GdipCreateBitmapFromScan0(3, 2, 12, PixelFormat32bppRGB, (BYTE *)rgb32, &bitmap);
+    expect(Ok, status);
+    for (i = 1; i < ARRAY_SIZE(rgb_dst_formats); i++)
+    {
+        status = GdipBitmapLockBits(bitmap, NULL, ImageLockModeRead, rgb_dst_formats[i], &data);
+        expect(Ok, status);
+        for (y = 0; y < 2; y++)
+        {
+            row = (const DWORD *)((BYTE *)data.Scan0 + data.Stride * y);
+            for (x = 0; x < 3; x++)
+                ok(row[x] == rgb24_expected[y * 3 + x],
+                   "%#x: pixel %u,%u: expected %08lx, got %08lx\n", rgb_dst_formats[i], x, y,
+                   rgb24_expected[y * 3 + x], row[x]);
+        }
+        status = GdipBitmapUnlockBits(bitmap, &data);
+        expect(Ok, status);
+    }
+    GdipDisposeImage((GpImage *)bitmap);
+
+    /* Transparent pixels keep their colour, opaque ones are unchanged, and
+     * channels greater than alpha saturate. */
+    status = GdipCreateBitmapFromScan0(8, 1, 32, PixelFormat32bppPARGB, (BYTE *)pargb, &bitmap);
+    expect(Ok, status);
+    status = GdipBitmapLockBits(bitmap, NULL, ImageLockModeRead, PixelFormat32bppARGB, &data);
+    expect(Ok, status);
+    row = data.Scan0;
+    for (x = 0; x < 8; x++)
+        ok(row[x] == pargb_expected[x], "pixel %u: expected %08lx, got %08lx\n", x, pargb_expected[x], row[x]);
+    status = GdipBitmapUnlockBits(bitmap, &data);
+    expect(Ok, status);
+    GdipDisposeImage((GpImage *)bitmap);
+}
 
 static void test_CloneBitmapArea(void)
 {
@@ -6342,10 +6529,13 @@ START_TEST(image)
     test_CloneBitmapArea();
     test_ARGB_conversion();
     test_PARGB_conversion();
+    test_PARGB_conversion_exact();
+    test_RGB_conversion_exact();
     test_DrawImage_scale();
     test_image_format();
     test_DrawImage();
     test_DrawImage_SourceCopy();
+    test_DrawImage_blend();
     test_GdipDrawImagePointRect();
     test_bitmapbits();
     test_tiff_palette();
@@ -47,6 +47,9 @@ static BOOL thread_stop;
 
 static HTTP_REQUEST_ID req_id_counter;
 
+/* maximum number of bytes read from a connection per wakeup */
+#define RECV_AHEAD_LIMIT 65536
+
 struct connection
 {
     struct list entry; /* in "connections" below */
@@ -56,6 +59,9 @@ struct connection
     char *buffer;
     unsigned int len, size;
     bool shutdown;
+    /* receive_data() stopped reading before the socket was drained; FD_READ
+     * might not be signaled again until recv() is called. */
+    bool recv_blocked;
 
     /* If there is a request fully received and waiting to be read, the
      * "available" parameter will be TRUE. Either there is no queue matching
@@ -82,8 +88,6 @@ struct connection
     ULONG unk_verb_len, url_len, content_len;
 };
 
-static struct list connections = LIST_INIT(connections);
-
 struct listening_socket
 {
     struct list entry;
@@ -110,21 +114,28 @@ struct request_queue
 
 static struct list request_queues = LIST_INIT(request_queues);
 
-static void accept_connection(SOCKET socket)
+static struct list connections = LIST_INIT(connections);
+static unsigned int connection_count;
+
+/* Scratch array used by the request thread to poll all connections at once. */
+static WSAPOLLFD *poll_fds;
+static unsigned int poll_fds_size;
+
+static BOOL accept_connection(SOCKET socket)
 {
     struct connection *conn;
     ULONG one = 1;
     SOCKET peer;
 
     if ((peer = accept(socket, NULL, NULL)) == INVALID_SOCKET)
-        return;
+        return FALSE;
 
     if (!(conn = calloc(1, sizeof(*conn))))
     {
         ERR("Failed to allocate memory.\n");
         shutdown(peer, SD_BOTH);
         closesocket(peer);
-        return;
+        return FALSE;
     }
     if (!(conn->buffer = malloc(8192)))
     {
@@ -132,13 +143,15 @@ static void accept_connection(SOCKET socket)
         free(conn);
         shutdown(peer, SD_BOTH);
         closesocket(peer);
-        return;
+        return FALSE;
     }
     conn->size = 8192;
     WSAEventSelect(peer, request_event, FD_READ | FD_CLOSE);
     ioctlsocket(peer, FIONBIO, &one);
     conn->socket = peer;
     list_add_head(&connections, &conn->entry);
+    ++connection_count;
+    return TRUE;
 }
 
 static void shutdown_connection(struct connection *conn)
@@ -154,6 +167,7 @@ static void close_connection(struct connection *conn)
         shutdown_connection(conn);
     closesocket(conn->socket);
     list_remove(&conn->entry);
+    --connection_count;
     free(conn);
 }
 
@@ -605,8 +619,22 @@ static void send_400(struct connection *conn)
     shutdown_connection(conn);
 }
 
+/* Returns whether the data received since "start" completes a request header. */
+static bool has_request_header(const struct connection *conn, unsigned int start)
+{
+    unsigned int i;
+
+    for (i = start > 3 ? start - 3 : 0; i + 4 <= conn->len; ++i)
+    {
+        if (!memcmp(conn->buffer + i, "\r\n\r\n", 4))
+            return true;
+    }
+    return false;
+}
+
 static void receive_data(struct connection *conn)
 {
+    unsigned int received = 0;
     int len, ret;
 
     if (conn->shutdown)
@@ -621,54 +649,67 @@ static void receive_data(struct connection *conn)
     }
 
     /* We might be waiting for an IRP, but always call recv() anyway, since we
-     * might have been woken up by the socket closing. */
-    if ((len = recv(conn->socket, conn->buffer + conn->len, conn->size - conn->len, 0)) <= 0)
-    {
-        if (WSAGetLastError() == WSAEWOULDBLOCK)
-            return; /* nothing to receive */
-        else if (!len)
-            TRACE("Connection was shut down by peer.\n");
-        else
-            ERR("Got error %u; shutting down connection.\n", WSAGetLastError());
-        close_connection(conn);
-        return;
-    }
-    conn->len += len;
-
-    if (conn->available)
-        return; /* waiting for an HttpReceiveHttpRequest() call */
-    if (conn->req_id != HTTP_NULL_ID)
-        return; /* waiting for an HttpSendHttpResponse() call */
-
-    TRACE("Received %u bytes of data.\n", len);
-
-    if (!(ret = parse_request(conn)))
+     * might have been woken up by the socket closing. If we are about to parse
+     * a new request, keep reading until its header is complete, so that it
+     * can be handed out without waiting for another wakeup. Don't read more
+     * than RECV_AHEAD_LIMIT bytes at once, so that a client which keeps
+     * sending can't hold the request thread. */
+    conn->recv_blocked = false;
+    for (;;)
     {
-        ULONG available;
-        ioctlsocket(conn->socket, FIONREAD, &available);
-        if (available)
+        if (conn->len == conn->size)
         {
-            TRACE("%lu more bytes of data available, trying with larger buffer.\n", available);
-            if (!(conn->buffer = realloc(conn->buffer, conn->len + available)))
+            char *buffer;
+
+            if (conn->available || conn->req_id != HTTP_NULL_ID)
             {
-                ERR("Failed to allocate %lu bytes of memory.\n", conn->len + available);
-                close_connection(conn);
-                return;
+                /* Don't buffer more than one request ahead. */
+                conn->recv_blocked = true;
+                break;
             }
-            conn->size = conn->len + available;
 
-            if ((len = recv(conn->socket, conn->buffer + conn->len, conn->size - conn->len, 0)) < 0)
+            if (!(buffer = realloc(conn->buffer, conn->size * 2)))
             {
-                ERR("Got error %u; shutting down connection.\n", WSAGetLastError());
+                ERR("Failed to allocate %u bytes of memory.\n", conn->size * 2);
                 close_connection(conn);
                 return;
             }
-            TRACE("Received %u bytes of data.\n", len);
-            conn->len += len;
-            ret = parse_request(conn);
+            conn->buffer = buffer;
+            conn->size *= 2;
+        }
+
+        if ((len = recv(conn->socket, conn->buffer + conn->len, conn->size - conn->len, 0)) <= 0)
+        {
+            if (len < 0 && WSAGetLastError() == WSAEWOULDBLOCK)
+                break; /* nothing more to receive */
+            else if (!len)
+                TRACE("Connection was shut down by peer.\n");
+            else
+                ERR("Got error %u; shutting down connection.\n", WSAGetLastError());
+            close_connection(conn);
+            return;
+        }
+
+        TRACE("Received %u bytes of data.\n", len);
+        received += len;
+        conn->len += len;
+
+        if (conn->available || conn->req_id != HTTP_NULL_ID
+                || received >= RECV_AHEAD_LIMIT || has_request_header(conn, conn->len - len))
+        {
+            conn->recv_blocked = true;
+            break;
         }
     }
-    if (!ret)
+
+    if (!received)
+        return;
+    if (conn->available)
+        return; /* waiting for an HttpReceiveHttpRequest() call */
+    if (conn->req_id != HTTP_NULL_ID)
+        return; /* waiting for an HttpSendHttpResponse() call */
+
+    if (!(ret = parse_request(conn)))
         TRACE("Request is incomplete, waiting for more data.\n");
     else if (ret < 0)
     {
@@ -677,10 +718,52 @@ static void receive_data(struct connection *conn)
     }
 }
 
+/* Ask for the readiness of every connection with a single call, so that only
+ * the connections which actually have something to report are visited. */
+static unsigned int poll_connections(void)
+{
+    struct connection *conn;
+    unsigned int count = 0;
+
+    if (connection_count > poll_fds_size)
+    {
+        unsigned int new_size = max(connection_count, poll_fds_size * 2);
+        WSAPOLLFD *fds;
+
+        if (!(fds = realloc(poll_fds, new_size * sizeof(*fds))))
+        {
+            ERR("Failed to allocate memory.\n");
+            return 0;
+        }
+        poll_fds = fds;
+        poll_fds_size = new_size;
+    }
+
+    LIST_FOR_EACH_ENTRY(conn, &connections, struct connection, entry)
+    {
+        poll_fds[count].fd = conn->socket;
+        poll_fds[count].events = POLLRDNORM;
+        poll_fds[count].revents = 0;
+        ++count;
+    }
+
+    if (count && WSAPoll(poll_fds, count, 0) < 0)
+    {
+        ERR("Failed to poll connections, error %u.\n", WSAGetLastError());
+        /* Fall back to visiting every connection. */
+        while (count--)
+            poll_fds[count].revents = POLLRDNORM;
+        count = connection_count;
+    }
+
+    return count;
+}
+
 static DWORD WINAPI request_thread_proc(void *arg)
 {
     struct connection *conn, *cursor;
     struct request_queue *queue;
+    unsigned int i, count;
     struct url *url;
 
     TRACE("Starting request thread.\n");
@@ -689,18 +772,26 @@ static DWORD WINAPI request_thread_proc(void *arg)
     {
         EnterCriticalSection(&http_cs);
 
+        /* Accept every pending connection, not just one per wakeup. */
         LIST_FOR_EACH_ENTRY(queue, &request_queues, struct request_queue, entry)
         {
             LIST_FOR_EACH_ENTRY(url, &queue->urls, struct url, entry)
             {
                 if (url->listening_sock && url->listening_sock->socket != -1)
-                    accept_connection(url->listening_sock->socket);
+                    while (accept_connection(url->listening_sock->socket));
             }
         }
 
+        /* The connection list is in the same order as the poll array; connections
+         * may be closed while walking it, but never added. */
+        count = poll_connections();
+        i = 0;
         LIST_FOR_EACH_ENTRY_SAFE(conn, cursor, &connections, struct connection, entry)
         {
-            receive_data(conn);
+            if (i >= count)
+                break;
+            if (poll_fds[i++].revents)
+                receive_data(conn);
         }
 
         LeaveCriticalSection(&http_cs);
@@ -936,6 +1027,20 @@ static struct connection *get_connection(HTTP_REQUEST_ID req_id)
     return NULL;
 }
 
+/* Find a request which was fully received and routed to this queue while no
+ * IRP was waiting for it. */
+static struct connection *get_available_connection(const struct request_queue *queue)
+{
+    struct connection *conn;
+
+    LIST_FOR_EACH_ENTRY(conn, &connections, struct connection, entry)
+    {
+        if (conn->available && conn->queue == queue && conn->req_id == HTTP_NULL_ID)
+            return conn;
+    }
+    return NULL;
+}
+
 static void WINAPI http_receive_request_cancel(DEVICE_OBJECT *device, IRP *irp)
 {
     TRACE("device %p, irp %p.\n", device, irp);
@@ -961,7 +1066,12 @@ static NTSTATUS http_receive_request(struct request_queue *queue, IRP *irp)
 
     EnterCriticalSection(&http_cs);
 
-    if ((conn = get_connection(params->id)) && conn->available && conn->queue == queue)
+    if (params->id == HTTP_NULL_ID)
+        conn = get_available_connection(queue);
+    else if ((conn = get_connection(params->id)) && (!conn->available || conn->queue != queue))
+        conn = NULL;
+
+    if (conn)
     {
         ret = complete_irp(conn, irp);
         LeaveCriticalSection(&http_cs);
@@ -1023,6 +1133,12 @@ static NTSTATUS http_send_response(struct request_queue *queue, IRP *irp)
                 WARN("Failed to parse request; shutting down connection.\n");
                 send_400(conn);
             }
+            else if (conn->recv_blocked)
+            {
+                /* Read what was left in the socket, and parse it if we are
+                 * still waiting for a request. */
+                receive_data(conn);
+            }
         }
         else
         {
@@ -1207,6 +1323,8 @@ static void WINAPI unload(DRIVER_OBJECT *driver)
         close_queue(queue);
     }
 
+    free(poll_fds);
+
     WSACleanup();
 
     IoDeleteDevice(device_obj);
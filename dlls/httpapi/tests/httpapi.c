@@ -546,6 +546,95 @@ static void test_v1_multiple_requests(void)
     ok(ret, "Failed to close queue handle, error %lu.\n", GetLastError());
 }
 
+static void test_v1_pipelined_requests(void)
+{
+    static const unsigned int req_count = 250;
+    char DECLSPEC_ALIGN(8) req_buffer[2048];
+    HTTP_REQUEST_V1 *req = (HTTP_REQUEST_V1 *)req_buffer;
+    LARGE_INTEGER frequency, start, end;
+    HTTP_RESPONSE_V1 response = {};
+    unsigned int i, j, count, len;
+    char req_text[200], *buffer;
+    DWORD timeout = 1000;
+    unsigned short port;
+    OVERLAPPED ovl;
+    HANDLE queue;
+    SOCKET s[4];
+    const char *p;
+    int ret;
+
+    ovl.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+
+    ret = HttpCreateHttpHandle(&queue, 0);
+    ok(!ret, "Got error %u.\n", ret);
+    port = add_url_v1(queue);
+
+    sprintf(req_text, simple_req, port);
+    len = strlen(req_text);
+    buffer = malloc(len * req_count);
+    for (i = 0; i < req_count; ++i)
+        memcpy(buffer + i * len, req_text, len);
+
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+
+    /* Every client pipelines all of its requests at once; they should all be
+     * delivered, in order, as soon as the previous response is sent. They
+     * don't fit in the server's initial receive buffer. */
+    for (i = 0; i < ARRAY_SIZE(s); ++i)
+    {
+        s[i] = create_client_socket(port);
+        setsockopt(s[i], SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout));
+        ret = send(s[i], buffer, len * req_count, 0);
+        ok(ret == len * req_count, "send() returned %d.\n", ret);
+    }
+
+    response.StatusCode = 418;
+    response.pReason = "I'm a teapot";
+    response.ReasonLength = 12;
+    for (i = 0; i < ARRAY_SIZE(s) * req_count; ++i)
+    {
+        ret = HttpReceiveHttpRequest(queue, HTTP_NULL_ID, 0, (HTTP_REQUEST *)req, sizeof(req_buffer), NULL, &ovl);
+        ok(!ret || ret == ERROR_IO_PENDING, "Got error %u.\n", ret);
+        ret = WaitForSingleObject(ovl.hEvent, 1000);
+        ok(!ret, "Request %u: got %u.\n", i, ret);
+        if (ret) break;
+        ok(req->Verb == HttpVerbGET, "Got verb %u.\n", req->Verb);
+
+        ret = HttpSendHttpResponse(queue, req->RequestId, 0, (HTTP_RESPONSE *)&response, NULL, NULL, NULL, 0, NULL, NULL);
+        ok(!ret, "Got error %u.\n", ret);
+    }
+
+    QueryPerformanceCounter(&end);
+    trace("Handled %u pipelined requests in %.2f ms.\n", i,
+            (end.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart);
+
+    for (i = 0; i < ARRAY_SIZE(s); ++i)
+    {
+        len = count = 0;
+        while (count < req_count && (ret = recv(s[i], buffer + len, 1024, 0)) > 0)
+        {
+            len += ret;
+            buffer[len] = 0;
+            for (p = buffer; (p = strstr(p, "HTTP/1.1 418")); p += 12)
+                ++count;
+            /* Keep a tail which might hold the start of the next status line. */
+            j = min(len, 11);
+            memmove(buffer, buffer + len - j, j);
+            len = j;
+        }
+        ok(count == req_count, "Socket %u: got %u responses.\n", i, count);
+        closesocket(s[i]);
+    }
+
+    free(buffer);
+    ret = remove_url_v1(queue, port);
+    ok(!ret, "Got error %u.\n", ret);
+    CloseHandle(ovl.hEvent);
+    ret = CloseHandle(queue);
+    ok(ret, "Failed to close queue handle, error %lu.\n", GetLastError());
+}
+
 static void test_v1_short_buffer(void)
 {
     char DECLSPEC_ALIGN(8) req_buffer[2048];
@@ -1787,6 +1876,7 @@ START_TEST(httpapi)
     test_v1_server();
     test_v1_completion_port();
     test_v1_multiple_requests();
+    test_v1_pipelined_requests();
     test_v1_short_buffer();
     test_v1_entity_body();
     test_v1_bad_request();
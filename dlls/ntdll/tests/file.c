@@ -1078,6 +1078,111 @@ static void test_set_io_completion(void)
     pNtClose( h );
 }
 
+static void test_io_completion_batch(void)
+{
+    FILE_IO_COMPLETION_INFORMATION info[150];
+    LARGE_INTEGER timeout = {{0}};
+    NTSTATUS res;
+    ULONG count, i;
+    HANDLE h;
+
+    if (!pNtRemoveIoCompletionEx)
+    {
+        skip("NtRemoveIoCompletionEx() not present\n");
+        return;
+    }
+
+    res = pNtCreateIoCompletion( &h, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+    ok( res == STATUS_SUCCESS, "NtCreateIoCompletion failed: %#lx\n", res );
+
+    for (i = 0; i < 200; i++)
+    {
+        res = pNtSetIoCompletion( h, i, i * 2, STATUS_SUCCESS, i * 3 );
+        ok( res == STATUS_SUCCESS, "NtSetIoCompletion failed: %#lx\n", res );
+    }
+
+    count = 0xdeadbeef;
+    memset( info, 0xcc, sizeof(info) );
+    res = pNtRemoveIoCompletionEx( h, info, ARRAY_SIZE(info), &count, &timeout, FALSE );
+    ok( res == STATUS_SUCCESS, "NtRemoveIoCompletionEx failed: %#lx\n", res );
+    ok( count == ARRAY_SIZE(info), "wrong count %lu\n", count );
+    for (i = 0; i < count; i++)
+    {
+        ok( info[i].CompletionKey == i, "%lu: wrong key %#Ix\n", i, info[i].CompletionKey );
+        ok( info[i].CompletionValue == i * 2, "%lu: wrong value %#Ix\n", i, info[i].CompletionValue );
+        ok( info[i].IoStatusBlock.Information == i * 3, "%lu: wrong information %#Ix\n",
+            i, info[i].IoStatusBlock.Information );
+        ok( info[i].IoStatusBlock.Status == STATUS_SUCCESS, "%lu: wrong status %#lx\n",
+            i, info[i].IoStatusBlock.Status );
+    }
+
+    count = get_pending_msgs( h );
+    ok( count == 50, "Unexpected msg count: %ld\n", count );
+
+    count = 0xdeadbeef;
+    res = pNtRemoveIoCompletionEx( h, info, ARRAY_SIZE(info), &count, &timeout, FALSE );
+    ok( res == STATUS_SUCCESS, "NtRemoveIoCompletionEx failed: %#lx\n", res );
+    ok( count == 50, "wrong count %lu\n", count );
+    ok( info[0].CompletionKey == 150, "wrong key %#Ix\n", info[0].CompletionKey );
+    ok( info[49].CompletionKey == 199, "wrong key %#Ix\n", info[49].CompletionKey );
+
+    count = 0xdeadbeef;
+    res = pNtRemoveIoCompletionEx( h, info, ARRAY_SIZE(info), &count, &timeout, FALSE );
+    ok( res == STATUS_TIMEOUT, "NtRemoveIoCompletionEx failed: %#lx\n", res );
+
+    pNtClose( h );
+}
+
+static DWORD WINAPI completion_producer_thread( void *arg )
+{
+    HANDLE port = arg;
+    ULONG i;
+
+    for (i = 0; i < 100000; i++) pNtSetIoCompletion( port, i, 0, STATUS_SUCCESS, 0 );
+    return 0;
+}
+
+static void test_io_completion_throughput(void)
+{
+    FILE_IO_COMPLETION_INFORMATION info[64];
+    LARGE_INTEGER timeout, freq, start, end;
+    ULONG count, total = 0, expect = 0, i;
+    HANDLE h, thread;
+    NTSTATUS res;
+
+    if (!pNtRemoveIoCompletionEx)
+    {
+        skip("NtRemoveIoCompletionEx() not present\n");
+        return;
+    }
+
+    res = pNtCreateIoCompletion( &h, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+    ok( res == STATUS_SUCCESS, "NtCreateIoCompletion failed: %#lx\n", res );
+
+    timeout.QuadPart = -5000 * 10000;
+    QueryPerformanceFrequency( &freq );
+    QueryPerformanceCounter( &start );
+    thread = CreateThread( NULL, 0, completion_producer_thread, h, 0, NULL );
+    while (total < 100000)
+    {
+        res = pNtRemoveIoCompletionEx( h, info, ARRAY_SIZE(info), &count, &timeout, FALSE );
+        ok( res == STATUS_SUCCESS, "NtRemoveIoCompletionEx failed: %#lx\n", res );
+        if (res) break;
+        for (i = 0; i < count; i++, expect++)
+            if (info[i].CompletionKey != expect) break;
+        ok( i == count, "packet %#lx out of order\n", expect );
+        if (i != count) break;
+        total += count;
+    }
+    QueryPerformanceCounter( &end );
+    WaitForSingleObject( thread, INFINITE );
+    CloseHandle( thread );
+
+    trace( "dequeued %lu packets, %.0f packets/s\n", total,
+           total * (double)freq.QuadPart / max( end.QuadPart - start.QuadPart, 1 ) );
+    pNtClose( h );
+}
+
 static void test_file_io_completion(void)
 {
     static const char pipe_name[] = "\\\\.\\pipe\\iocompletiontestnamedpipe";
@@ -5933,6 +6038,8 @@ START_TEST(file)
     append_file_test();
     nt_mailslot_test();
     test_set_io_completion();
+    test_io_completion_batch();
+    test_io_completion_throughput();
     test_file_io_completion();
     test_file_basic_information();
     test_file_all_information();
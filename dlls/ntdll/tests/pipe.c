@@ -19,6 +19,7 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdlib.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -1386,6 +1387,152 @@ static void read_pipe_test(ULONG pipe_flags, ULONG pipe_type)
     CloseHandle(event);
 }
 
+#define TRANSFER_CHUNK_SIZE 65536
+#define TRANSFER_CHUNK_COUNT 256
+#define PING_PONG_COUNT 1000
+
+static DWORD WINAPI transfer_writer_thread(void *arg)
+{
+    HANDLE pipe = arg;
+    DWORD written, i, j;
+    BYTE *buffer;
+    BOOL ret;
+
+    buffer = malloc(TRANSFER_CHUNK_SIZE);
+    for (i = 0; i < TRANSFER_CHUNK_COUNT; i++)
+    {
+        for (j = 0; j < TRANSFER_CHUNK_SIZE; j++) buffer[j] = i + j;
+        ret = WriteFile(pipe, buffer, TRANSFER_CHUNK_SIZE, &written, NULL);
+        ok(ret, "WriteFile failed, error %lu\n", GetLastError());
+        ok(written == TRANSFER_CHUNK_SIZE, "got %lu bytes written\n", written);
+        if (!ret) break;
+    }
+    free(buffer);
+    return 0;
+}
+
+static DWORD WINAPI ping_pong_thread(void *arg)
+{
+    HANDLE pipe = arg;
+    DWORD size, i;
+    BYTE data;
+
+    for (i = 0; i < PING_PONG_COUNT; i++)
+    {
+        if (!ReadFile(pipe, &data, 1, &size, NULL) || size != 1) break;
+        if (!WriteFile(pipe, &data, 1, &size, NULL)) break;
+    }
+    return 0;
+}
+
+static void test_byte_mode_transfer(void)
+{
+    LARGE_INTEGER frequency, start, end;
+    DWORD size, total = 0, i, errors = 0;
+    HANDLE read, write, client, server, thread;
+    OVERLAPPED overlapped = {0};
+    BYTE *buffer, data;
+    char partial[100];
+    BOOL ret;
+
+    QueryPerformanceFrequency(&frequency);
+
+    /* large transfer in byte mode, the data may be split across reads */
+    if (!create_pipe_pair(&read, &write, PIPE_ACCESS_INBOUND, PIPE_TYPE_BYTE, TRANSFER_CHUNK_SIZE))
+        return;
+
+    buffer = malloc(TRANSFER_CHUNK_SIZE);
+    QueryPerformanceCounter(&start);
+    thread = CreateThread(NULL, 0, transfer_writer_thread, write, 0, NULL);
+    while (total < TRANSFER_CHUNK_SIZE * TRANSFER_CHUNK_COUNT)
+    {
+        ret = ReadFile(read, buffer, TRANSFER_CHUNK_SIZE, &size, NULL);
+        ok(ret, "ReadFile failed, error %lu\n", GetLastError());
+        if (!ret) break;
+        for (i = 0; i < size; i++, total++)
+            if (buffer[i] != (BYTE)(total / TRANSFER_CHUNK_SIZE + total % TRANSFER_CHUNK_SIZE)) errors++;
+    }
+    QueryPerformanceCounter(&end);
+    ok(total == TRANSFER_CHUNK_SIZE * TRANSFER_CHUNK_COUNT, "got %lu bytes\n", total);
+    ok(!errors, "got %lu corrupted bytes\n", errors);
+    if (end.QuadPart > start.QuadPart)
+        trace("byte mode throughput: %.1f MiB/s\n", (double)total / (1024 * 1024)
+              * frequency.QuadPart / (end.QuadPart - start.QuadPart));
+
+    ok(!WaitForSingleObject(thread, 10000), "wait failed\n");
+    CloseHandle(thread);
+    free(buffer);
+    CloseHandle(read);
+    CloseHandle(write);
+
+    /* one byte round trips */
+    server = CreateNamedPipeA(PIPENAME, PIPE_ACCESS_DUPLEX, PIPE_WAIT | PIPE_TYPE_BYTE,
+                              1, 1024, 1024, NMPWAIT_USE_DEFAULT_WAIT, NULL);
+    ok(server != INVALID_HANDLE_VALUE, "CreateNamedPipe failed, error %lu\n", GetLastError());
+    client = CreateFileA(PIPENAME, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, 0);
+    ok(client != INVALID_HANDLE_VALUE, "CreateFile failed, error %lu\n", GetLastError());
+
+    thread = CreateThread(NULL, 0, ping_pong_thread, client, 0, NULL);
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < PING_PONG_COUNT; i++)
+    {
+        data = i;
+        ret = WriteFile(server, &data, 1, &size, NULL);
+        ok(ret, "WriteFile failed, error %lu\n", GetLastError());
+        ret = ReadFile(server, &data, 1, &size, NULL);
+        ok(ret, "ReadFile failed, error %lu\n", GetLastError());
+        if (!ret) break;
+        ok(size == 1 && data == (BYTE)i, "got size %lu, data %#x\n", size, data);
+    }
+    QueryPerformanceCounter(&end);
+    if (i == PING_PONG_COUNT)
+        trace("byte mode round trip latency: %.1f us\n", (double)(end.QuadPart - start.QuadPart)
+              * 1000000 / frequency.QuadPart / PING_PONG_COUNT);
+
+    ok(!WaitForSingleObject(thread, 10000), "wait failed\n");
+    CloseHandle(thread);
+    CloseHandle(client);
+    CloseHandle(server);
+
+    /* byte mode reads return as soon as some data is available */
+    server = CreateNamedPipeA(PIPENAME, PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED, PIPE_WAIT | PIPE_TYPE_BYTE,
+                              1, 1024, 1024, NMPWAIT_USE_DEFAULT_WAIT, NULL);
+    ok(server != INVALID_HANDLE_VALUE, "CreateNamedPipe failed, error %lu\n", GetLastError());
+    client = CreateFileA(PIPENAME, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, 0);
+    ok(client != INVALID_HANDLE_VALUE, "CreateFile failed, error %lu\n", GetLastError());
+
+    ret = WriteFile(server, "data", 4, &size, &overlapped);
+    if (!ret && GetLastError() == ERROR_IO_PENDING) ret = GetOverlappedResult(server, &overlapped, &size, TRUE);
+    ok(ret, "WriteFile failed, error %lu\n", GetLastError());
+    ret = ReadFile(client, partial, sizeof(partial), &size, NULL);
+    ok(ret, "ReadFile failed, error %lu\n", GetLastError());
+    ok(size == 4 && !memcmp(partial, "data", 4), "got size %lu\n", size);
+
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    ret = ReadFile(server, partial, sizeof(partial), NULL, &overlapped);
+    ok(!ret && GetLastError() == ERROR_IO_PENDING, "got ret %d, error %lu\n", ret, GetLastError());
+    ret = WriteFile(client, "xy", 2, &size, NULL);
+    ok(ret, "WriteFile failed, error %lu\n", GetLastError());
+    ret = GetOverlappedResult(server, &overlapped, &size, TRUE);
+    ok(ret, "GetOverlappedResult failed, error %lu\n", GetLastError());
+    ok(size == 2 && !memcmp(partial, "xy", 2), "got size %lu\n", size);
+
+    /* the client sees a disconnected pipe, not a broken one, even with data left unread */
+    ret = WriteFile(server, "z", 1, &size, &overlapped);
+    if (!ret && GetLastError() == ERROR_IO_PENDING) ret = GetOverlappedResult(server, &overlapped, &size, TRUE);
+    ok(ret, "WriteFile failed, error %lu\n", GetLastError());
+    ret = DisconnectNamedPipe(server);
+    ok(ret, "DisconnectNamedPipe failed, error %lu\n", GetLastError());
+    SetLastError(0xdeadbeef);
+    ret = ReadFile(client, partial, sizeof(partial), &size, NULL);
+    ok(!ret && GetLastError() == ERROR_PIPE_NOT_CONNECTED, "got ret %d, error %lu\n", ret, GetLastError());
+
+    CloseHandle(overlapped.hEvent);
+    CloseHandle(client);
+    CloseHandle(server);
+}
+
 static void test_transceive(void)
 {
     IO_STATUS_BLOCK iosb;
@@ -3191,6 +3338,7 @@ START_TEST(pipe)
     trace("starting message read in message mode server -> client\n");
     read_pipe_test(PIPE_ACCESS_OUTBOUND, PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE);
 
+    test_byte_mode_transfer();
     test_transceive();
     test_volume_info();
     test_file_info();
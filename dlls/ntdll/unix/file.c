@@ -5008,17 +5008,30 @@ static BOOL irp_completion( void *user, ULONG_PTR *info, unsigned int *status )
     return TRUE;
 }
 
+/* status of a read hitting end of file on a pipe connected through a unix socket */
+static unsigned int get_pipe_eof_status( HANDLE handle )
+{
+    FILE_PIPE_LOCAL_INFORMATION info;
+    IO_STATUS_BLOCK io;
+
+    if (!NtQueryInformationFile( handle, &io, &info, sizeof(info), FilePipeLocalInformation ) &&
+        info.NamedPipeState == FILE_PIPE_DISCONNECTED_STATE)
+        return STATUS_PIPE_DISCONNECTED;
+    return STATUS_PIPE_BROKEN;
+}
+
 static BOOL async_read_proc( void *user, ULONG_PTR *info, unsigned int *status )
 {
     struct async_fileio_read *fileio = user;
     int fd, needs_close, result;
+    enum server_fd_type type;
 
     switch (*status)
     {
     case STATUS_ALERTED: /* got some new data */
         /* check to see if the data is ready (non-blocking) */
         if ((*status = server_get_unix_fd( fileio->io.handle, FILE_READ_DATA, &fd,
-                                          &needs_close, NULL, NULL )))
+                                          &needs_close, &type, NULL )))
             break;
 
         result = virtual_locked_read(fd, &fileio->buffer[fileio->already], fileio->count-fileio->already);
@@ -5034,7 +5047,8 @@ static BOOL async_read_proc( void *user, ULONG_PTR *info, unsigned int *status )
         }
         else if (result == 0)
         {
-            *status = fileio->already ? STATUS_SUCCESS : STATUS_PIPE_BROKEN;
+            if (fileio->already) *status = STATUS_SUCCESS;
+            else *status = type == FD_TYPE_PIPE ? get_pipe_eof_status( fileio->io.handle ) : STATUS_PIPE_BROKEN;
         }
         else
         {
@@ -5293,6 +5307,7 @@ static unsigned int get_io_timeouts( HANDLE handle, enum server_fd_type type, UL
         }
         break;
     case FD_TYPE_SOCKET:
+    case FD_TYPE_PIPE:
     case FD_TYPE_CHAR:
         if (is_read) timeouts->interval = 0;  /* return as soon as we got something */
         break;
@@ -5345,6 +5360,7 @@ static NTSTATUS get_io_avail_mode( HANDLE handle, enum server_fd_type type, BOOL
     }
     case FD_TYPE_MAILSLOT:
     case FD_TYPE_SOCKET:
+    case FD_TYPE_PIPE:
     case FD_TYPE_CHAR:
         *avail_mode = TRUE;
         break;
@@ -5528,6 +5544,9 @@ NTSTATUS WINAPI NtReadFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, vo
                         goto done;
                     }
                     break;
+                case FD_TYPE_PIPE:
+                    status = get_pipe_eof_status( handle );
+                    goto err;
                 default:
                     status = STATUS_PIPE_BROKEN;
                     goto err;
@@ -1076,6 +1076,172 @@ static int remove_fd_from_cache( HANDLE handle )
 }
 
 
+/***********************************************************************/
+/* completion port message ring cache */
+
+#define COMPLETION_RING_CACHE_BLOCK_SIZE  (65536 / sizeof(struct completion_ring *))
+#define COMPLETION_RING_CACHE_ENTRIES     128
+
+static struct completion_ring **completion_ring_cache[COMPLETION_RING_CACHE_ENTRIES];
+
+/* used for ports whose ring couldn't be mapped; it always looks empty */
+static struct completion_ring no_completion_ring;
+
+/* number of threads currently using a ring returned by server_get_completion_ring() */
+static LONG completion_ring_readers;
+
+/* rings whose handle was closed while other threads may still be reading from
+ * them; they are kept mapped to zeroes until no thread uses any ring */
+static void **retired_completion_rings;
+static unsigned int retired_completion_ring_count, retired_completion_ring_size;
+
+/* caller must hold fd_cache_mutex */
+static void unmap_retired_completion_rings(void)
+{
+    /* readers take a reference before looking up the cache, so the rings that
+     * were removed from it can't be in use anymore if there's no reader */
+    if (ReadAcquire( &completion_ring_readers )) return;
+    while (retired_completion_ring_count)
+        munmap( retired_completion_rings[--retired_completion_ring_count], sizeof(struct completion_ring) );
+}
+
+static inline unsigned int completion_ring_index( HANDLE handle, unsigned int *entry )
+{
+    unsigned int idx = (wine_server_obj_handle(handle) >> 2) - 1;
+    *entry = idx / COMPLETION_RING_CACHE_BLOCK_SIZE;
+    return idx % COMPLETION_RING_CACHE_BLOCK_SIZE;
+}
+
+
+/***********************************************************************
+ *           map_completion_ring
+ *
+ * Caller must hold fd_cache_mutex.
+ */
+static struct completion_ring *map_completion_ring( HANDLE handle, unsigned int entry, unsigned int idx )
+{
+    struct completion_ring *ring;
+    obj_handle_t fd_handle;
+    data_size_t size = 0;
+    unsigned int ret;
+    void *ptr;
+    int fd = -1;
+
+    if (!completion_ring_cache[entry])  /* do we need to allocate a new block of entries? */
+    {
+        ptr = anon_mmap_alloc( COMPLETION_RING_CACHE_BLOCK_SIZE * sizeof(struct completion_ring *),
+                               PROT_READ | PROT_WRITE );
+        if (ptr == MAP_FAILED) return NULL;
+        completion_ring_cache[entry] = ptr;
+    }
+    if ((ring = completion_ring_cache[entry][idx])) return ring;
+
+    SERVER_START_REQ( get_completion_ring )
+    {
+        req->handle = wine_server_obj_handle( handle );
+        if (!(ret = wine_server_call( req )))
+        {
+            size = reply->size;
+            if ((fd = receive_fd( &fd_handle )) != -1)
+                assert( wine_server_ptr_handle(fd_handle) == handle );
+        }
+    }
+    SERVER_END_REQ;
+
+    if (ret == STATUS_INVALID_HANDLE || ret == STATUS_OBJECT_TYPE_MISMATCH || ret == STATUS_ACCESS_DENIED)
+        return NULL;
+
+    /* remember failures too, so that we don't ask again on every call */
+    ring = &no_completion_ring;
+    if (fd != -1)
+    {
+        if (size != sizeof(*ring))
+            ERR( "unexpected ring size %u for port %p\n", size, handle );
+        else if ((ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) != MAP_FAILED)
+            ring = ptr;
+        close( fd );
+    }
+    if (ring == &no_completion_ring) WARN( "no message ring for port %p, status %#x\n", handle, ret );
+
+    InterlockedExchangePointer( (void **)&completion_ring_cache[entry][idx], ring );
+    return ring;
+}
+
+
+/***********************************************************************
+ *           remove_completion_ring_from_cache
+ *
+ * Caller must hold fd_cache_mutex.
+ */
+static void remove_completion_ring_from_cache( HANDLE handle )
+{
+    unsigned int entry, idx = completion_ring_index( handle, &entry );
+    struct completion_ring *ring;
+    void **ptr;
+
+    if (entry >= COMPLETION_RING_CACHE_ENTRIES || !completion_ring_cache[entry]) return;
+    ring = InterlockedExchangePointer( (void **)&completion_ring_cache[entry][idx], NULL );
+    if (!ring || ring == &no_completion_ring) return;
+
+    unmap_retired_completion_rings();
+    if (!ReadAcquire( &completion_ring_readers ))
+    {
+        munmap( ring, sizeof(*ring) );
+        return;
+    }
+
+    /* zeroes look like an empty ring to threads that are still using it; the
+     * address is never reused while it's retired, so they can't dequeue
+     * messages of another port */
+    if (anon_mmap_fixed( ring, sizeof(*ring), PROT_READ | PROT_WRITE, 0 ) == MAP_FAILED) return;
+
+    if (retired_completion_ring_count == retired_completion_ring_size)
+    {
+        unsigned int new_size = max( 16, retired_completion_ring_size * 2 );
+        if (!(ptr = realloc( retired_completion_rings, new_size * sizeof(*ptr) ))) return;
+        retired_completion_rings = ptr;
+        retired_completion_ring_size = new_size;
+    }
+    retired_completion_rings[retired_completion_ring_count++] = ring;
+}
+
+
+/***********************************************************************
+ *           server_get_completion_ring
+ *
+ * Get the shared message ring of a completion port. Ports without a ring
+ * return an empty one. The lookup doesn't take any lock once the ring has
+ * been mapped. A non-NULL ring must be released with
+ * server_release_completion_ring().
+ */
+struct completion_ring *server_get_completion_ring( HANDLE handle )
+{
+    unsigned int entry, idx = completion_ring_index( handle, &entry );
+    struct completion_ring *ring;
+    sigset_t sigset;
+
+    if (entry >= COMPLETION_RING_CACHE_ENTRIES) return NULL;
+
+    InterlockedIncrement( &completion_ring_readers );
+    if (completion_ring_cache[entry] && (ring = completion_ring_cache[entry][idx])) return ring;
+
+    server_enter_uninterrupted_section( &fd_cache_mutex, &sigset );
+    ring = map_completion_ring( handle, entry, idx );
+    server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
+    if (!ring) InterlockedDecrement( &completion_ring_readers );
+    return ring;
+}
+
+
+/***********************************************************************
+ *           server_release_completion_ring
+ */
+void server_release_completion_ring( struct completion_ring *ring )
+{
+    InterlockedDecrement( &completion_ring_readers );
+}
+
+
 /***********************************************************************
  *           server_get_unix_fd
  *
@@ -1766,7 +1932,10 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source, HANDLE
     /* always remove the cached fd; if the server request fails we'll just
      * retrieve it again */
     if (options & DUPLICATE_CLOSE_SOURCE)
+    {
         fd = remove_fd_from_cache( source );
+        remove_completion_ring_from_cache( source );
+    }
 
     SERVER_START_REQ( dup_handle )
     {
@@ -1837,6 +2006,7 @@ NTSTATUS WINAPI NtClose( HANDLE handle )
     /* always remove the cached fd; if the server request fails we'll just
      * retrieve it again */
     fd = remove_fd_from_cache( handle );
+    remove_completion_ring_from_cache( handle );
 
     SERVER_START_REQ( close_handle )
     {
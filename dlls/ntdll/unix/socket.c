@@ -92,6 +92,7 @@
 #endif
 
 WINE_DEFAULT_DEBUG_CHANNEL(winsock);
+WINE_DECLARE_DEBUG_CHANNEL(sockperf);
 
 #define u64_to_user_ptr(u) ((void *)(uintptr_t)(u))
 
@@ -118,9 +119,101 @@ struct async_recv_ioctl
     int unix_flags;
     unsigned int count;
     BOOL icmp_over_dgram;
+    BOOL batchable;              /* can be received with other datagrams in a batch */
+    BOOL batch_pending;          /* is in its recv_batch_queue */
+    BOOL batched;                /* datagram was received in a batch by another async */
+    unsigned int batch_status;
+    ULONG_PTR batch_size;
+    struct list batch_entry;     /* entry in the recv_batch_queue list */
     struct iovec iov[1];
 };
 
+/* Pending overlapped receives on datagram sockets which may be filled by a
+ * batched receive. When an async is woken up, the datagrams queued on the
+ * socket are received with a single recvmmsg() call into its buffers and
+ * those of the receives pending on the same socket; the server is then asked
+ * to wake up the latter, which complete without another system call. The
+ * pending receives are hashed by socket handle so that unrelated sockets
+ * don't contend for the same lock. */
+#define RECV_BATCH_SIZE 16
+#define RECV_BATCH_QUEUES 16
+
+static struct recv_batch_queue
+{
+    pthread_mutex_t mutex;
+    struct list recvs;
+} recv_batch_queues[RECV_BATCH_QUEUES] =
+{
+#define RECV_BATCH_QUEUE_INIT(i) { PTHREAD_MUTEX_INITIALIZER, LIST_INIT( recv_batch_queues[i].recvs ) }
+    RECV_BATCH_QUEUE_INIT(0),  RECV_BATCH_QUEUE_INIT(1),  RECV_BATCH_QUEUE_INIT(2),  RECV_BATCH_QUEUE_INIT(3),
+    RECV_BATCH_QUEUE_INIT(4),  RECV_BATCH_QUEUE_INIT(5),  RECV_BATCH_QUEUE_INIT(6),  RECV_BATCH_QUEUE_INIT(7),
+    RECV_BATCH_QUEUE_INIT(8),  RECV_BATCH_QUEUE_INIT(9),  RECV_BATCH_QUEUE_INIT(10), RECV_BATCH_QUEUE_INIT(11),
+    RECV_BATCH_QUEUE_INIT(12), RECV_BATCH_QUEUE_INIT(13), RECV_BATCH_QUEUE_INIT(14), RECV_BATCH_QUEUE_INIT(15),
+#undef RECV_BATCH_QUEUE_INIT
+};
+
+static struct recv_batch_queue *get_recv_batch_queue( HANDLE handle )
+{
+    return &recv_batch_queues[(HandleToULong( handle ) >> 2) % RECV_BATCH_QUEUES];
+}
+
+/* datagram counters, reported on the sockperf channel */
+static struct
+{
+    LONG64 recv_packets;
+    LONG64 recv_calls;
+    LONG64 send_packets;
+    LONG64 send_calls;
+    LONG64 last_report;
+    LONG64 reported[4];          /* counter values at the last report */
+} sock_stats;
+
+static void sock_stats_report(void)
+{
+    LONG64 last = sock_stats.last_report, elapsed, current[4];
+    LARGE_INTEGER counter, freq;
+    unsigned int i;
+
+    NtQueryPerformanceCounter( &counter, &freq );
+    if (!last)
+    {
+        InterlockedCompareExchange64( &sock_stats.last_report, counter.QuadPart, 0 );
+        return;
+    }
+    if ((elapsed = counter.QuadPart - last) < freq.QuadPart) return;
+    if (InterlockedCompareExchange64( &sock_stats.last_report, counter.QuadPart, last ) != last) return;
+
+    current[0] = sock_stats.recv_packets;
+    current[1] = sock_stats.recv_calls;
+    current[2] = sock_stats.send_packets;
+    current[3] = sock_stats.send_calls;
+    for (i = 0; i < ARRAY_SIZE(current); ++i)
+    {
+        LONG64 count = current[i] - sock_stats.reported[i];
+        sock_stats.reported[i] = current[i];
+        current[i] = count * freq.QuadPart / elapsed;
+    }
+    TRACE_(sockperf)( "received %s packets/s in %s calls/s, sent %s packets/s in %s calls/s\n",
+                      wine_dbgstr_longlong( current[0] ), wine_dbgstr_longlong( current[1] ),
+                      wine_dbgstr_longlong( current[2] ), wine_dbgstr_longlong( current[3] ));
+}
+
+static void sock_stats_add_recv( unsigned int packets )
+{
+    if (!TRACE_ON(sockperf)) return;
+    InterlockedExchangeAdd64( &sock_stats.recv_packets, packets );
+    InterlockedIncrement64( &sock_stats.recv_calls );
+    sock_stats_report();
+}
+
+static void sock_stats_add_send(void)
+{
+    if (!TRACE_ON(sockperf)) return;
+    InterlockedIncrement64( &sock_stats.send_packets );
+    InterlockedIncrement64( &sock_stats.send_calls );
+    sock_stats_report();
+}
+
 struct async_send_ioctl
 {
     struct async_fileio io;
@@ -742,6 +835,7 @@ static NTSTATUS try_recv( int fd, struct async_recv_ioctl *async, ULONG_PTR *siz
         return sock_errno_to_status( errno );
     }
 
+    sock_stats_add_recv( 1 );
     status = (hdr.msg_flags & MSG_TRUNC) ? STATUS_BUFFER_OVERFLOW : STATUS_SUCCESS;
     if (async->icmp_over_dgram)
         ret = fixup_icmp_over_dgram( &hdr, &unix_addr, async->io.handle, ret, &status );
@@ -798,24 +892,170 @@ static NTSTATUS try_recv( int fd, struct async_recv_ioctl *async, ULONG_PTR *siz
     return status;
 }
 
+/* must be called with signals blocked, so that the async can't complete meanwhile */
+static void add_pending_recv( struct async_recv_ioctl *async )
+{
+    struct recv_batch_queue *queue = get_recv_batch_queue( async->io.handle );
+
+    pthread_mutex_lock( &queue->mutex );
+    async->batch_pending = TRUE;
+    list_add_tail( &queue->recvs, &async->batch_entry );
+    pthread_mutex_unlock( &queue->mutex );
+}
+
+static void remove_pending_recv( struct async_recv_ioctl *async )
+{
+    struct recv_batch_queue *queue = get_recv_batch_queue( async->io.handle );
+    sigset_t sigset;
+
+    server_enter_uninterrupted_section( &queue->mutex, &sigset );
+    if (async->batch_pending)
+    {
+        list_remove( &async->batch_entry );
+        async->batch_pending = FALSE;
+    }
+    server_leave_uninterrupted_section( &queue->mutex, &sigset );
+}
+
+#ifdef HAVE_RECVMMSG
+
+static void store_batch_result( struct async_recv_ioctl *async, const struct mmsghdr *msg,
+                                const union unix_sockaddr *unix_addr, unsigned int *status, ULONG_PTR *size )
+{
+    *status = (msg->msg_hdr.msg_flags & MSG_TRUNC) ? STATUS_BUFFER_OVERFLOW : STATUS_SUCCESS;
+    *size = msg->msg_len;
+    if (async->addr && msg->msg_hdr.msg_namelen)
+        *async->addr_len = sockaddr_from_unix( unix_addr, async->addr, *async->addr_len );
+}
+
+/* receive the datagram of an async along with those of other pending receives on the same socket */
+static NTSTATUS try_recv_batch( int fd, struct async_recv_ioctl *async, ULONG_PTR *size )
+{
+    struct async_recv_ioctl *batch[RECV_BATCH_SIZE], *other;
+    union unix_sockaddr unix_addr[RECV_BATCH_SIZE];
+    struct mmsghdr msgs[RECV_BATCH_SIZE];
+    client_ptr_t wake[RECV_BATCH_SIZE];
+    struct recv_batch_queue *queue = get_recv_batch_queue( async->io.handle );
+    unsigned int count = 0, i, status;
+    sigset_t sigset;
+    int ret;
+
+    if (!async->batchable || list_empty( &queue->recvs ))
+        return try_recv( fd, async, size );
+
+    server_enter_uninterrupted_section( &queue->mutex, &sigset );
+
+    batch[count++] = async;
+    LIST_FOR_EACH_ENTRY( other, &queue->recvs, struct async_recv_ioctl, batch_entry )
+    {
+        if (other->io.handle != async->io.handle) continue;
+        batch[count++] = other;
+        if (count == RECV_BATCH_SIZE) break;
+    }
+    if (count == 1)
+    {
+        server_leave_uninterrupted_section( &queue->mutex, &sigset );
+        return try_recv( fd, async, size );
+    }
+
+    memset( msgs, 0, count * sizeof(*msgs) );
+    for (i = 0; i < count; ++i)
+    {
+        if (batch[i]->addr)
+        {
+            msgs[i].msg_hdr.msg_name = &unix_addr[i].addr;
+            msgs[i].msg_hdr.msg_namelen = sizeof(unix_addr[i]);
+        }
+        msgs[i].msg_hdr.msg_iov = batch[i]->iov;
+        msgs[i].msg_hdr.msg_iovlen = batch[i]->count;
+    }
+
+    while ((ret = recvmmsg( fd, msgs, count, 0, NULL )) < 0 && errno == EINTR);
+
+    if (ret <= 0)
+    {
+        server_leave_uninterrupted_section( &queue->mutex, &sigset );
+        /* let recvmsg() deal with write watches */
+        if (!ret || errno == EFAULT) return try_recv( fd, async, size );
+        if (errno != EWOULDBLOCK) WARN( "recvmmsg: %s\n", strerror( errno ) );
+        return sock_errno_to_status( errno );
+    }
+
+    for (i = 1; i < ret; ++i)
+    {
+        other = batch[i];
+        list_remove( &other->batch_entry );
+        other->batch_pending = FALSE;
+        other->batched = TRUE;
+        store_batch_result( other, &msgs[i], &unix_addr[i], &other->batch_status, &other->batch_size );
+        wake[i - 1] = wine_server_client_ptr( &other->io );
+    }
+    server_leave_uninterrupted_section( &queue->mutex, &sigset );
+
+    sock_stats_add_recv( ret );
+    store_batch_result( async, &msgs[0], &unix_addr[0], &status, size );
+
+    if (ret > 1)
+    {
+        SERVER_START_REQ( socket_wake_recv )
+        {
+            req->handle = wine_server_obj_handle( async->io.handle );
+            wine_server_add_data( req, wake, (ret - 1) * sizeof(*wake) );
+            if (wine_server_call( req ))
+                WARN( "failed to wake up batched receives\n" );
+        }
+        SERVER_END_REQ;
+    }
+    return status;
+}
+
+#else
+
+static NTSTATUS try_recv_batch( int fd, struct async_recv_ioctl *async, ULONG_PTR *size )
+{
+    return try_recv( fd, async, size );
+}
+
+#endif
+
 static BOOL async_recv_proc( void *user, ULONG_PTR *info, unsigned int *status )
 {
     struct async_recv_ioctl *async = user;
+    sigset_t sigset;
     int fd, needs_close;
 
     TRACE( "%#x\n", *status );
 
-    if (*status == STATUS_ALERTED)
+    if (async->batchable) remove_pending_recv( async );
+
+    if (async->batched)
+    {
+        /* the datagram was received by another async; it is lost if the async was cancelled */
+        if (*status == STATUS_ALERTED)
+        {
+            *status = async->batch_status;
+            *info = async->batch_size;
+        }
+    }
+    else if (*status == STATUS_ALERTED)
     {
         if ((*status = server_get_unix_fd( async->io.handle, 0, &fd, &needs_close, NULL, NULL )))
             return TRUE;
 
-        *status = try_recv( fd, async, info );
+        *status = try_recv_batch( fd, async, info );
         TRACE( "got status %#x, %#lx bytes read\n", *status, *info );
         if (needs_close) close( fd );
 
         if (*status == STATUS_DEVICE_NOT_READY)
+        {
+            if (async->batchable)
+            {
+                pthread_sigmask( SIG_BLOCK, &server_block_set, &sigset );
+                add_pending_recv( async );
+                pthread_sigmask( SIG_SETMASK, &sigset, NULL );
+            }
             return FALSE;
+        }
     }
     release_fileio( &async->io );
     return TRUE;
@@ -838,10 +1078,35 @@ static BOOL is_icmp_over_dgram( int fd )
 #endif
 }
 
+static BOOL is_dgram_socket( int fd )
+{
+    socklen_t len;
+    int type;
+
+    len = sizeof(type);
+    return !getsockopt( fd, SOL_SOCKET, SO_TYPE, (char *)&type, &len ) && type == SOCK_DGRAM;
+}
+
+/* Batching is decided once when the receive is queued. Only datagram
+ * receives are batched: a stream receive has no message boundaries to split
+ * the data between the pending receives. */
+static void init_recv_batch( struct async_recv_ioctl *async, int fd, BOOL batchable )
+{
+    async->icmp_over_dgram = is_icmp_over_dgram( fd );
+#ifdef HAVE_RECVMMSG
+    async->batchable = batchable && !async->icmp_over_dgram && is_dgram_socket( fd );
+#else
+    async->batchable = FALSE;
+#endif
+    async->batch_pending = FALSE;
+    async->batched = FALSE;
+}
+
 static NTSTATUS sock_recv( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc_user, IO_STATUS_BLOCK *io,
                            int fd, struct async_recv_ioctl *async, int force_async )
 {
     HANDLE wait_handle;
+    sigset_t sigset;
     BOOL nonblocking;
     unsigned int i, status;
     ULONG options;
@@ -855,6 +1120,9 @@ static NTSTATUS sock_recv( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, voi
         }
     }
 
+    /* block signals so that the async can't complete before it is added to the pending list */
+    if (async->batchable) pthread_sigmask( SIG_BLOCK, &server_block_set, &sigset );
+
     SERVER_START_REQ( recv_socket )
     {
         req->force_async = force_async;
@@ -867,6 +1135,12 @@ static NTSTATUS sock_recv( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, voi
     }
     SERVER_END_REQ;
 
+    if (async->batchable)
+    {
+        if (status == STATUS_PENDING) add_pending_recv( async );
+        pthread_sigmask( SIG_SETMASK, &sigset, NULL );
+    }
+
     /* the server currently will never succeed immediately */
     assert(status == STATUS_ALERTED || status == STATUS_PENDING || NT_ERROR(status));
 
@@ -940,7 +1214,7 @@ static NTSTATUS sock_ioctl_recv( HANDLE handle, HANDLE event, PIO_APC_ROUTINE ap
     async->addr = addr;
     async->addr_len = addr_len;
     async->ret_flags = ret_flags;
-    async->icmp_over_dgram = is_icmp_over_dgram( fd );
+    init_recv_batch( async, fd, !unix_flags && !control );
 
     return sock_recv( handle, event, apc, apc_user, io, fd, async, force_async );
 }
@@ -963,7 +1237,7 @@ NTSTATUS sock_read( HANDLE handle, int fd, HANDLE event, PIO_APC_ROUTINE apc,
     async->addr = NULL;
     async->addr_len = NULL;
     async->ret_flags = NULL;
-    async->icmp_over_dgram = is_icmp_over_dgram( fd );
+    init_recv_batch( async, fd, TRUE );
 
     return sock_recv( handle, event, apc, apc_user, io, fd, async, 1 );
 }
@@ -1038,6 +1312,7 @@ static NTSTATUS try_send( int fd, struct async_send_ioctl *async )
     }
 
     async->sent_len += ret;
+    sock_stats_add_send();
 
     while (async->iov_cursor < async->count && ret >= async->iov[async->iov_cursor].iov_len)
         ret -= async->iov[async->iov_cursor++].iov_len;
@@ -1879,18 +1879,58 @@ NTSTATUS WINAPI NtSetIoCompletion( HANDLE handle, ULONG_PTR key, ULONG_PTR value
 }
 
 
+/* dequeue up to count messages from the ring without a server call */
+static ULONG dequeue_completions( HANDLE handle, FILE_IO_COMPLETION_INFORMATION *info, ULONG count )
+{
+    struct completion_ring *ring;
+    struct completion_msg *msg;
+    unsigned int head, tail, prev, i, n;
+
+    if (!(ring = server_get_completion_ring( handle ))) return 0;
+
+    head = ReadAcquire( (LONG *)&ring->head );
+    for (;;)
+    {
+        tail = ReadAcquire( (LONG *)&ring->tail );
+        if (!(n = min( tail - head, count ))) break;
+        for (i = 0; i < n; i++)
+        {
+            msg = &ring->msgs[(head + i) % COMPLETION_RING_SIZE];
+            info[i].CompletionKey             = msg->ckey;
+            info[i].CompletionValue           = msg->cvalue;
+            info[i].IoStatusBlock.Information = msg->information;
+            info[i].IoStatusBlock.Status      = msg->status;
+        }
+        /* the server doesn't reuse the entries until head has moved past them,
+         * so they are valid if nobody else claimed them in the meantime */
+        if ((prev = InterlockedCompareExchange( (LONG *)&ring->head, head + n, head )) == head) break;
+        head = prev;
+    }
+    server_release_completion_ring( ring );
+    return n;
+}
+
+
 /***********************************************************************
  *             NtRemoveIoCompletion (NTDLL.@)
  */
 NTSTATUS WINAPI NtRemoveIoCompletion( HANDLE handle, ULONG_PTR *key, ULONG_PTR *value,
                                       IO_STATUS_BLOCK *io, LARGE_INTEGER *timeout )
 {
+    FILE_IO_COMPLETION_INFORMATION info;
     unsigned int status;
 
     TRACE( "(%p, %p, %p, %p, %p)\n", handle, key, value, io, timeout );
 
     for (;;)
     {
+        if (dequeue_completions( handle, &info, 1 ))
+        {
+            *key   = info.CompletionKey;
+            *value = info.CompletionValue;
+            *io    = info.IoStatusBlock;
+            return STATUS_SUCCESS;
+        }
         SERVER_START_REQ( remove_completion )
         {
             req->handle = wine_server_obj_handle( handle );
@@ -1923,6 +1963,11 @@ NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE handle, FILE_IO_COMPLETION_INFORM
 
     for (;;)
     {
+        if ((i = dequeue_completions( handle, info, count )))
+        {
+            status = STATUS_SUCCESS;
+            break;
+        }
         while (i < count)
         {
             SERVER_START_REQ( remove_completion )
@@ -2347,6 +2347,89 @@ static void test_tablestrong_marshal_and_unmarshal_twice(void)
     end_host_object(tid, thread);
 }
 
+struct call_rate_data
+{
+    IStream *stream;
+    unsigned int count;
+};
+
+static DWORD CALLBACK call_rate_client_proc(void *arg)
+{
+    struct call_rate_data *data = arg;
+    IClassFactory *proxy;
+    unsigned int i;
+    HRESULT hr;
+
+    CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+
+    hr = CoUnmarshalInterface(data->stream, &IID_IClassFactory, (void **)&proxy);
+    ok_ole_success(hr, CoUnmarshalInterface);
+    if (SUCCEEDED(hr))
+    {
+        for (i = 0; i < data->count; i++)
+            if ((hr = IClassFactory_LockServer(proxy, TRUE)) != S_OK) break;
+        ok(hr == S_OK, "LockServer returned %#lx after %u calls\n", hr, i);
+        IClassFactory_Release(proxy);
+    }
+
+    CoUninitialize();
+    return 0;
+}
+
+/* measures the rate of calls between single-threaded apartments of the same
+ * process, from one and from several calling threads */
+static void test_interthread_call_rate(void)
+{
+    static const unsigned int thread_counts[] = {1, 4};
+    struct call_rate_data data[4];
+    HANDLE threads[4], host_thread;
+    unsigned int i, j, count;
+    DWORD tid, start, elapsed;
+    IStream *stream;
+    HRESULT hr;
+
+    cLocks = 0;
+    external_connections = 0;
+
+    hr = CreateStreamOnHGlobal(NULL, TRUE, &stream);
+    ok_ole_success(hr, CreateStreamOnHGlobal);
+    tid = start_host_object(stream, &IID_IClassFactory, (IUnknown *)&Test_ClassFactory, MSHLFLAGS_TABLESTRONG, &host_thread);
+
+    for (i = 0; i < ARRAY_SIZE(thread_counts); i++)
+    {
+        count = thread_counts[i];
+        IStream_Seek(stream, ullZero, STREAM_SEEK_SET, NULL);
+        for (j = 0; j < count; j++)
+        {
+            hr = IStream_Clone(stream, &data[j].stream);
+            ok_ole_success(hr, IStream_Clone);
+            data[j].count = 4000 / count;
+        }
+
+        start = GetTickCount();
+        for (j = 0; j < count; j++)
+            threads[j] = CreateThread(NULL, 0, call_rate_client_proc, &data[j], 0, NULL);
+        ok(!WaitForMultipleObjects(count, threads, TRUE, 30000), "wait timed out\n");
+        if (!(elapsed = GetTickCount() - start)) elapsed = 1;
+        trace("%u calls from %u thread(s) in %lu ms, %lu calls/s\n",
+              data[0].count * count, count, elapsed, data[0].count * count * 1000 / elapsed);
+
+        for (j = 0; j < count; j++)
+        {
+            CloseHandle(threads[j]);
+            IStream_Release(data[j].stream);
+        }
+    }
+
+    IStream_Seek(stream, ullZero, STREAM_SEEK_SET, NULL);
+    release_host_object(tid, 0);
+    IStream_Release(stream);
+
+    ok_no_locks();
+
+    end_host_object(tid, host_thread);
+}
+
 /* tests CoLockObjectExternal */
 static void test_lock_object_external(void)
 {
@@ -4697,6 +4780,7 @@ START_TEST(marshal)
         with_external_conn = !with_external_conn;
     } while (with_external_conn);
 
+    test_interthread_call_rate();
     test_marshal_channel_buffer();
     test_StdMarshal_custom_marshaling();
     test_DfMarshal_custom_marshaling();
@@ -38,6 +38,7 @@
 #include "wine/exception.h"
 #include "wine/asm.h"
 #include "wine/debug.h"
+#include "wine/list.h"
 
 #include "cpsf.h"
 #include "ndr_misc.h"
@@ -477,6 +478,237 @@ static size_t basetype_arg_size( unsigned char fc )
     }
 }
 
+/* Procedures described by -Oicf format strings are translated, on first use,
+ * into a plan which splits the parameters into [in] and [out] operation lists
+ * and precomputes the buffer size taken by fixed-size base types. Plans are
+ * keyed on the parameter format string, whose contents are compared on lookup
+ * since dynamically built format strings (e.g. for typelib marshalling) can be
+ * freed and their address reused. */
+
+#define NDR_PLAN_BUCKETS   64
+#define NDR_PLAN_MAX_COUNT 4096
+
+struct ndr_plan_op
+{
+    const NDR_PARAM_OIF *param;
+    /* wire and memory size of base types which are copied as is, 0 otherwise */
+    unsigned char base_size;
+};
+
+struct ndr_plan
+{
+    struct list entry;
+    const MIDL_STUB_DESC *stub_desc;
+    const unsigned char *format_types;
+    PFORMAT_STRING format;
+    unsigned int count;
+    /* buffer size of all [in] (resp. [out]) params, indexed by the buffer
+     * length modulo 8 before sizing, or ~0u if some of them must be sized */
+    ULONG in_size[8];
+    ULONG out_size[8];
+    unsigned int in_count, out_count;
+    struct ndr_plan_op *in_ops, *out_ops;
+    NDR_PARAM_OIF *params; /* copy of the format, to validate lookups */
+    struct ndr_plan_op ops[1];
+};
+
+static struct list ndr_plans[NDR_PLAN_BUCKETS];
+static unsigned int ndr_plan_count;
+static SRWLOCK ndr_plans_lock = SRWLOCK_INIT;
+
+static unsigned char plan_base_size( const NDR_PARAM_OIF *param )
+{
+    if (!param->attr.IsBasetype) return 0;
+
+    switch (param->u.type_format_char)
+    {
+    case FC_BYTE:
+    case FC_CHAR:
+    case FC_SMALL:
+    case FC_USMALL:
+        return 1;
+    case FC_WCHAR:
+    case FC_SHORT:
+    case FC_USHORT:
+        return 2;
+    case FC_LONG:
+    case FC_ULONG:
+    case FC_ERROR_STATUS_T:
+    case FC_ENUM32:
+    case FC_FLOAT:
+        return 4;
+    case FC_HYPER:
+    case FC_DOUBLE:
+        return 8;
+    default:
+        /* FC_ENUM16 and FC_[U]INT3264 differ in memory and on the wire */
+        return 0;
+    }
+}
+
+static void plan_calc_sizes( ULONG sizes[8], const struct ndr_plan_op *ops, unsigned int count )
+{
+    unsigned int i, start;
+    ULONG len;
+
+    for (i = 0; i < count; i++)
+    {
+        if (!ops[i].base_size)
+        {
+            for (start = 0; start < 8; start++) sizes[start] = ~0u;
+            return;
+        }
+    }
+
+    for (start = 0; start < 8; start++)
+    {
+        len = start;
+        for (i = 0; i < count; i++)
+            len = ((len + ops[i].base_size - 1) & ~(ops[i].base_size - 1)) + ops[i].base_size;
+        sizes[start] = len - start;
+    }
+}
+
+static struct ndr_plan *create_plan( const MIDL_STUB_DESC *stub_desc, PFORMAT_STRING format, unsigned int count )
+{
+    const NDR_PARAM_OIF *params = (const NDR_PARAM_OIF *)format;
+    struct ndr_plan *plan;
+    unsigned int i;
+
+    if (!(plan = malloc( offsetof( struct ndr_plan, ops[2 * count] ) + count * sizeof(*params) )))
+        return NULL;
+
+    plan->stub_desc = stub_desc;
+    plan->format_types = stub_desc->pFormatTypes;
+    plan->format = format;
+    plan->count = count;
+    plan->params = (NDR_PARAM_OIF *)&plan->ops[2 * count];
+    memcpy( plan->params, params, count * sizeof(*params) );
+
+    plan->in_ops = plan->ops;
+    plan->out_ops = plan->ops + count;
+    plan->in_count = plan->out_count = 0;
+    for (i = 0; i < count; i++)
+    {
+        const NDR_PARAM_OIF *param = &plan->params[i];
+        struct ndr_plan_op op = { param, plan_base_size( param ) };
+
+        if (param->attr.IsIn) plan->in_ops[plan->in_count++] = op;
+        if (param->attr.IsOut || param->attr.IsReturn) plan->out_ops[plan->out_count++] = op;
+    }
+    plan_calc_sizes( plan->in_size, plan->in_ops, plan->in_count );
+    plan_calc_sizes( plan->out_size, plan->out_ops, plan->out_count );
+    return plan;
+}
+
+static const struct ndr_plan *get_plan( const MIDL_STUB_DESC *stub_desc, PFORMAT_STRING format, unsigned int count )
+{
+    struct list *bucket = &ndr_plans[((ULONG_PTR)format >> 4) % NDR_PLAN_BUCKETS];
+    struct ndr_plan *plan, *new_plan;
+
+    AcquireSRWLockShared( &ndr_plans_lock );
+    if (bucket->next)
+    {
+        LIST_FOR_EACH_ENTRY( plan, bucket, struct ndr_plan, entry )
+        {
+            if (plan->format == format && plan->stub_desc == stub_desc &&
+                plan->format_types == stub_desc->pFormatTypes && plan->count == count &&
+                !memcmp( plan->params, format, count * sizeof(NDR_PARAM_OIF) ))
+            {
+                ReleaseSRWLockShared( &ndr_plans_lock );
+                return plan;
+            }
+        }
+    }
+    ReleaseSRWLockShared( &ndr_plans_lock );
+
+    if (ndr_plan_count >= NDR_PLAN_MAX_COUNT) return NULL;
+    if (!(new_plan = create_plan( stub_desc, format, count ))) return NULL;
+
+    TRACE( "created plan %p for format %p, %u params\n", new_plan, format, count );
+
+    /* plans are never freed, so that they can be used without holding the lock */
+    AcquireSRWLockExclusive( &ndr_plans_lock );
+    if (!bucket->next) list_init( bucket );
+    list_add_head( bucket, &new_plan->entry );
+    ndr_plan_count++;
+    ReleaseSRWLockExclusive( &ndr_plans_lock );
+    return new_plan;
+}
+
+static inline void plan_marshal_base( PMIDL_STUB_MESSAGE msg, const unsigned char *memory, unsigned int size )
+{
+    unsigned char *buffer = (unsigned char *)(((ULONG_PTR)msg->Buffer + size - 1) & ~(ULONG_PTR)(size - 1));
+
+    memset( msg->Buffer, 0, buffer - msg->Buffer );
+    if (buffer + size > (unsigned char *)msg->RpcMsg->Buffer + msg->BufferLength)
+    {
+        ERR( "buffer overflow - Buffer = %p, BufferEnd = %p, size = %u\n",
+             buffer, (unsigned char *)msg->RpcMsg->Buffer + msg->BufferLength, size );
+        RpcRaiseException( RPC_X_BAD_STUB_DATA );
+    }
+    memcpy( buffer, memory, size );
+    msg->Buffer = buffer + size;
+}
+
+/* same as NdrBaseTypeUnmarshall() called without fMustAlloc */
+static inline void plan_unmarshal_base( PMIDL_STUB_MESSAGE msg, unsigned char **memory, unsigned int size )
+{
+    unsigned char *buffer = (unsigned char *)(((ULONG_PTR)msg->Buffer + size - 1) & ~(ULONG_PTR)(size - 1));
+
+    if (!msg->IsClient && !*memory)
+    {
+        if (buffer + size > (unsigned char *)msg->RpcMsg->Buffer + msg->BufferLength)
+            RpcRaiseException( RPC_X_BAD_STUB_DATA );
+        *memory = buffer;
+    }
+    else
+    {
+        if (buffer + size > msg->BufferEnd)
+        {
+            ERR( "buffer overflow - Buffer = %p, BufferEnd = %p, size = %u\n", buffer, msg->BufferEnd, size );
+            RpcRaiseException( RPC_X_BAD_STUB_DATA );
+        }
+        memcpy( *memory, buffer, size );
+    }
+    msg->Buffer = buffer + size;
+}
+
+static inline void plan_marshal( PMIDL_STUB_MESSAGE msg, unsigned char *arg, const struct ndr_plan_op *op )
+{
+    if (op->base_size)
+        plan_marshal_base( msg, op->param->attr.IsSimpleRef ? *(unsigned char **)arg : arg, op->base_size );
+    else
+        call_marshaller( msg, arg, op->param );
+}
+
+static inline void plan_unmarshal( PMIDL_STUB_MESSAGE msg, unsigned char *arg, const struct ndr_plan_op *op )
+{
+    if (op->base_size)
+        plan_unmarshal_base( msg, op->param->attr.IsSimpleRef ? (unsigned char **)arg : &arg, op->base_size );
+    else
+        call_unmarshaller( msg, &arg, op->param, 0 );
+}
+
+static void plan_calc_size( PMIDL_STUB_MESSAGE msg, const ULONG sizes[8],
+                            const struct ndr_plan_op *ops, unsigned int count )
+{
+    unsigned int i;
+
+    if (sizes[0] != ~0u)
+    {
+        ULONG size = sizes[msg->BufferLength & 7];
+
+        if (msg->BufferLength + size < msg->BufferLength)
+            RpcRaiseException( RPC_X_BAD_STUB_DATA );
+        msg->BufferLength += size;
+        return;
+    }
+
+    for (i = 0; i < count; i++)
+        call_buffer_sizer( msg, msg->StackTop + ops[i].param->stack_offset, ops[i].param );
+}
+
 void client_do_args( PMIDL_STUB_MESSAGE pStubMsg, PFORMAT_STRING pFormat, enum stubless_phase phase,
                      void **fpu_args, unsigned short number_of_params, unsigned char *pRetVal )
 {
@@ -541,6 +773,66 @@ void client_do_args( PMIDL_STUB_MESSAGE pStubMsg, PFORMAT_STRING pFormat, enum s
     }
 }
 
+static void client_do_plan_args( PMIDL_STUB_MESSAGE pStubMsg, const struct ndr_plan *plan, PFORMAT_STRING pFormat,
+                                 enum stubless_phase phase, void **fpu_args, unsigned short number_of_params,
+                                 unsigned char *pRetVal )
+{
+    const NDR_PARAM_OIF *params = (const NDR_PARAM_OIF *)pFormat;
+    const struct ndr_plan_op *op;
+    unsigned char *pArg;
+    unsigned int i;
+
+    if (!plan)
+    {
+        client_do_args( pStubMsg, pFormat, phase, fpu_args, number_of_params, pRetVal );
+        return;
+    }
+
+    switch (phase)
+    {
+    case STUBLESS_CALCSIZE:
+        for (i = 0; i < plan->count; i++)
+        {
+            if (params[i].attr.IsSimpleRef && !*(unsigned char **)(pStubMsg->StackTop + params[i].stack_offset))
+                RpcRaiseException(RPC_X_NULL_REF_POINTER);
+        }
+        plan_calc_size( pStubMsg, plan->in_size, plan->in_ops, plan->in_count );
+        break;
+    case STUBLESS_MARSHAL:
+        for (op = plan->in_ops; op < plan->in_ops + plan->in_count; op++)
+        {
+#ifdef __x86_64__  /* floats are passed as doubles through varargs functions */
+            float f;
+#endif
+            pArg = pStubMsg->StackTop + op->param->stack_offset;
+#ifdef __x86_64__
+            if (op->param->attr.IsBasetype &&
+                op->param->u.type_format_char == FC_FLOAT &&
+                !op->param->attr.IsSimpleRef &&
+                !fpu_args)
+            {
+                f = *(double *)pArg;
+                pArg = (unsigned char *)&f;
+            }
+#endif
+            plan_marshal( pStubMsg, pArg, op );
+        }
+        break;
+    case STUBLESS_UNMARSHAL:
+        for (op = plan->out_ops; op < plan->out_ops + plan->out_count; op++)
+        {
+            if (!op->param->attr.IsOut) continue;
+            if (op->param->attr.IsReturn && pRetVal) pArg = pRetVal;
+            else pArg = pStubMsg->StackTop + op->param->stack_offset;
+            plan_unmarshal( pStubMsg, pArg, op );
+        }
+        break;
+    default:
+        client_do_args( pStubMsg, pFormat, phase, fpu_args, number_of_params, pRetVal );
+        break;
+    }
+}
+
 static unsigned int type_stack_size(unsigned char fc)
 {
     switch (fc)
@@ -705,7 +997,8 @@ static void CALLBACK ndr_client_call_finally(BOOL normal, void *arg)
 static LONG_PTR do_ndr_client_call( const MIDL_STUB_DESC *stub_desc, const PFORMAT_STRING format,
         const PFORMAT_STRING handle_format, void **stack_top, void **fpu_stack, MIDL_STUB_MESSAGE *stub_msg,
         unsigned short procedure_number, unsigned short stack_size, unsigned int number_of_params,
-        INTERPRETER_OPT_FLAGS Oif_flags, INTERPRETER_OPT_FLAGS2 ext_flags, const NDR_PROC_HEADER *proc_header )
+        INTERPRETER_OPT_FLAGS Oif_flags, INTERPRETER_OPT_FLAGS2 ext_flags, const NDR_PROC_HEADER *proc_header,
+        const struct ndr_plan *plan )
 {
     struct ndr_client_call_ctx finally_ctx;
     RPC_MESSAGE rpc_msg;
@@ -795,8 +1088,8 @@ static LONG_PTR do_ndr_client_call( const MIDL_STUB_DESC *stub_desc, const PFORM
 
         /* 2. CALCSIZE */
         TRACE( "CALCSIZE\n" );
-        client_do_args(stub_msg, format, STUBLESS_CALCSIZE, fpu_stack,
-                       number_of_params, (unsigned char *)&retval);
+        client_do_plan_args(stub_msg, plan, format, STUBLESS_CALCSIZE, fpu_stack,
+                            number_of_params, (unsigned char *)&retval);
 
         /* 3. GETBUFFER */
         TRACE( "GETBUFFER\n" );
@@ -815,8 +1108,8 @@ static LONG_PTR do_ndr_client_call( const MIDL_STUB_DESC *stub_desc, const PFORM
 
         /* 4. MARSHAL */
         TRACE( "MARSHAL\n" );
-        client_do_args(stub_msg, format, STUBLESS_MARSHAL, fpu_stack,
-                       number_of_params, (unsigned char *)&retval);
+        client_do_plan_args(stub_msg, plan, format, STUBLESS_MARSHAL, fpu_stack,
+                            number_of_params, (unsigned char *)&retval);
 
         /* 5. SENDRECEIVE */
         TRACE( "SENDRECEIVE\n" );
@@ -841,8 +1134,8 @@ static LONG_PTR do_ndr_client_call( const MIDL_STUB_DESC *stub_desc, const PFORM
 
         /* 6. UNMARSHAL */
         TRACE( "UNMARSHAL\n" );
-        client_do_args(stub_msg, format, STUBLESS_UNMARSHAL, fpu_stack,
-                       number_of_params, (unsigned char *)&retval);
+        client_do_plan_args(stub_msg, plan, format, STUBLESS_UNMARSHAL, fpu_stack,
+                            number_of_params, (unsigned char *)&retval);
     }
     __FINALLY_CTX(ndr_client_call_finally, &finally_ctx)
 
@@ -870,6 +1163,7 @@ LONG_PTR CDECL ndr_client_call( PMIDL_STUB_DESC pStubDesc, PFORMAT_STRING pForma
     LONG_PTR RetVal = 0;
     PFORMAT_STRING pHandleFormat;
     NDR_PARAM_OIF old_args[256];
+    const struct ndr_plan *plan = NULL;
 
     TRACE("pStubDesc %p, pFormat %p, ...\n", pStubDesc, pFormat);
 
@@ -930,6 +1224,8 @@ LONG_PTR CDECL ndr_client_call( PMIDL_STUB_DESC pStubDesc, PFORMAT_STRING pForma
             }
 #endif
         }
+
+        plan = get_plan(pStubDesc, pFormat, number_of_params);
     }
     else
     {
@@ -944,7 +1240,7 @@ LONG_PTR CDECL ndr_client_call( PMIDL_STUB_DESC pStubDesc, PFORMAT_STRING pForma
         {
             RetVal = do_ndr_client_call(pStubDesc, pFormat, pHandleFormat,
                     stack_top, fpu_stack, &stubMsg, procedure_number, stack_size,
-                    number_of_params, Oif_flags, ext_flags, pProcHeader);
+                    number_of_params, Oif_flags, ext_flags, pProcHeader, plan);
         }
         __EXCEPT_ALL
         {
@@ -962,7 +1258,7 @@ LONG_PTR CDECL ndr_client_call( PMIDL_STUB_DESC pStubDesc, PFORMAT_STRING pForma
         {
             RetVal = do_ndr_client_call(pStubDesc, pFormat, pHandleFormat,
                     stack_top, fpu_stack, &stubMsg, procedure_number, stack_size,
-                    number_of_params, Oif_flags, ext_flags, pProcHeader);
+                    number_of_params, Oif_flags, ext_flags, pProcHeader, plan);
         }
         __EXCEPT_ALL
         {
@@ -995,7 +1291,7 @@ LONG_PTR CDECL ndr_client_call( PMIDL_STUB_DESC pStubDesc, PFORMAT_STRING pForma
     {
         RetVal = do_ndr_client_call(pStubDesc, pFormat, pHandleFormat,
                 stack_top, fpu_stack, &stubMsg, procedure_number, stack_size,
-                number_of_params, Oif_flags, ext_flags, pProcHeader);
+                number_of_params, Oif_flags, ext_flags, pProcHeader, plan);
     }
 
     TRACE("RetVal = 0x%Ix\n", RetVal);
@@ -1299,6 +1595,41 @@ static LONG_PTR *stub_do_args(MIDL_STUB_MESSAGE *pStubMsg,
     return retval_ptr;
 }
 
+static LONG_PTR *stub_do_plan_args(MIDL_STUB_MESSAGE *pStubMsg, const struct ndr_plan *plan,
+                                   PFORMAT_STRING pFormat, enum stubless_phase phase,
+                                   unsigned short number_of_params)
+{
+    const NDR_PARAM_OIF *params = (const NDR_PARAM_OIF *)pFormat;
+    const struct ndr_plan_op *op;
+    unsigned char *pArg;
+    unsigned int i;
+
+    if (!plan) return stub_do_args(pStubMsg, pFormat, phase, number_of_params);
+
+    switch (phase)
+    {
+    case STUBLESS_UNMARSHAL:
+        for (i = 0, op = plan->in_ops; i < plan->count; i++)
+        {
+            pArg = pStubMsg->StackTop + params[i].stack_offset;
+            if (params[i].attr.ServerAllocSize)
+                *(void **)pArg = calloc(params[i].attr.ServerAllocSize, 8);
+            if (params[i].attr.IsIn)
+                plan_unmarshal(pStubMsg, pArg, op++);
+        }
+        return NULL;
+    case STUBLESS_CALCSIZE:
+        plan_calc_size(pStubMsg, plan->out_size, plan->out_ops, plan->out_count);
+        return NULL;
+    case STUBLESS_MARSHAL:
+        for (op = plan->out_ops; op < plan->out_ops + plan->out_count; op++)
+            plan_marshal(pStubMsg, pStubMsg->StackTop + op->param->stack_offset, op);
+        return NULL;
+    default:
+        return stub_do_args(pStubMsg, pFormat, phase, number_of_params);
+    }
+}
+
 /***********************************************************************
  *            NdrStubCall2 [RPCRT4.@]
  *
@@ -1336,6 +1667,8 @@ LONG WINAPI NdrStubCall2(
     LONG_PTR *retval_ptr = NULL;
     /* correlation cache */
     ULONG_PTR NdrCorrCache[256];
+    /* precomputed parameter plan, if any */
+    const struct ndr_plan *plan = NULL;
 
     TRACE("pThis %p, pChannel %p, pRpcMsg %p, pdwStubPhase %p\n", pThis, pChannel, pRpcMsg, pdwStubPhase);
 
@@ -1466,6 +1799,8 @@ LONG WINAPI NdrStubCall2(
             if (ext_flags.Unused & 0x2) /* has range on conformance */
                 stubMsg.CorrDespIncrement = 12;
         }
+
+        plan = get_plan(pStubDesc, pFormat, number_of_params);
     }
     else
     {
@@ -1539,7 +1874,7 @@ LONG WINAPI NdrStubCall2(
         case STUBLESS_MARSHAL:
         case STUBLESS_MUSTFREE:
         case STUBLESS_FREE:
-            retval_ptr = stub_do_args(&stubMsg, pFormat, phase, number_of_params);
+            retval_ptr = stub_do_plan_args(&stubMsg, plan, pFormat, phase, number_of_params);
             break;
         default:
             ERR("shouldn't reach here. phase %d\n", phase);
@@ -68,8 +68,20 @@ typedef struct _RpcConnection_np
     IO_STATUS_BLOCK io_status;
     HANDLE event_cache;
     BOOL read_closed;
+
+    /* ncalrpc shared memory transport */
+    struct lrpc_shm *shm;
+    HANDLE shm_mapping;
+    HANDLE shm_event; /* signaled by the peer */
+    HANDLE peer_event;
+    HANDLE peer_process;
+    BOOL shm_probed;
+    BOOL shm_sending; /* the first write after a read starts a new call */
+    LONG shm_cancelled;
 } RpcConnection_np;
 
+static BOOL lrpc_shm_connect(RpcConnection_np *npc);
+
 static RpcConnection *rpcrt4_conn_np_alloc(void)
 {
   RpcConnection_np *npc = calloc(1, sizeof(RpcConnection_np));
@@ -197,6 +209,13 @@ static RPC_STATUS rpcrt4_ncalrpc_open(RpcConnection* Connection)
 
   pname = ncalrpc_pipe_name(Connection->Endpoint);
   r = rpcrt4_conn_open_pipe(Connection, pname, TRUE);
+  if (r == RPC_S_OK && !lrpc_shm_connect(npc))
+  {
+    /* the server dropped the connection; retry without shared memory */
+    CloseHandle(npc->pipe);
+    npc->pipe = 0;
+    r = rpcrt4_conn_open_pipe(Connection, pname, TRUE);
+  }
   I_RpcFree(pname);
 
   return r;
@@ -468,6 +487,368 @@ static int rpcrt4_conn_np_wait_for_incoming_data(RpcConnection *conn)
     return rpcrt4_conn_np_read(conn, NULL, 0);
 }
 
+/**** ncalrpc shared memory support ****/
+
+/* Once an ncalrpc client is connected, it offers the server a pair of ring
+ * buffers in a shared section. If the server accepts, packets are exchanged
+ * through the rings rather than through the pipe, which is kept open for
+ * impersonation and for identifying the client. The offer is a 16-byte pipe
+ * message whose first byte can't be mistaken for an RPC packet header.
+ *
+ * The section and events are unnamed. The offer and the section header hold
+ * their handle values in the client process, and the server duplicates them
+ * from the process at the other end of the pipe, so a client can only hand
+ * over its own objects. Setting WINE_NCALRPC_SHM=0 makes servers decline. */
+
+#define LRPC_SHM_MAGIC   0x4d48534c /* "LSHM" */
+#define LRPC_SHM_VERSION 2
+#define LRPC_RING_SIZE   0x10000
+#define LRPC_SPIN_COUNT  4000
+
+struct lrpc_shm_offer
+{
+    DWORD magic;
+    DWORD version;
+    DWORD pid;
+    DWORD handle; /* section handle in the offer, zero in the reply if the server accepted */
+};
+
+struct lrpc_ring
+{
+    LONG head; /* only written by the reader */
+    LONG tail; /* only written by the writer */
+    LONG reader_waiting;
+    LONG writer_waiting;
+    char data[LRPC_RING_SIZE];
+};
+
+struct lrpc_shm
+{
+    LONG closed;
+    DWORD client_event; /* event handles in the client process */
+    DWORD server_event;
+    struct lrpc_ring rings[2]; /* client to server, server to client */
+};
+
+static struct lrpc_ring *lrpc_send_ring(RpcConnection_np *npc)
+{
+    return &npc->shm->rings[npc->common.server ? 1 : 0];
+}
+
+static struct lrpc_ring *lrpc_recv_ring(RpcConnection_np *npc)
+{
+    return &npc->shm->rings[npc->common.server ? 0 : 1];
+}
+
+static void lrpc_shm_close(RpcConnection_np *npc)
+{
+    if (npc->shm)
+    {
+        InterlockedExchange(&npc->shm->closed, TRUE);
+        if (npc->peer_event) SetEvent(npc->peer_event);
+        UnmapViewOfFile(npc->shm);
+        npc->shm = NULL;
+    }
+    if (npc->shm_mapping) CloseHandle(npc->shm_mapping);
+    if (npc->shm_event) CloseHandle(npc->shm_event);
+    if (npc->peer_event) CloseHandle(npc->peer_event);
+    if (npc->peer_process) CloseHandle(npc->peer_process);
+    npc->shm_mapping = npc->shm_event = npc->peer_event = npc->peer_process = 0;
+}
+
+static BOOL lrpc_shm_map(RpcConnection_np *npc)
+{
+    return !!(npc->shm = MapViewOfFile(npc->shm_mapping, FILE_MAP_WRITE, 0, 0, sizeof(struct lrpc_shm)));
+}
+
+static BOOL lrpc_shm_create(RpcConnection_np *npc, ULONG server_pid)
+{
+    if (!(npc->peer_process = OpenProcess(SYNCHRONIZE, FALSE, server_pid)))
+        return FALSE;
+    if (!(npc->shm_mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
+                                                sizeof(struct lrpc_shm), NULL)))
+        return FALSE;
+    if (!lrpc_shm_map(npc))
+        return FALSE;
+    if (!(npc->shm_event = CreateEventW(NULL, FALSE, FALSE, NULL)) ||
+        !(npc->peer_event = CreateEventW(NULL, FALSE, FALSE, NULL)))
+        return FALSE;
+    npc->shm->client_event = HandleToULong(npc->shm_event);
+    npc->shm->server_event = HandleToULong(npc->peer_event);
+    return TRUE;
+}
+
+static BOOL lrpc_shm_open(RpcConnection_np *npc, const struct lrpc_shm_offer *offer)
+{
+    static const DWORD event_access = EVENT_MODIFY_STATE | SYNCHRONIZE;
+    DWORD client_event, server_event;
+    ULONG client_pid;
+
+    if (!GetNamedPipeClientProcessId(npc->pipe, &client_pid))
+        return FALSE;
+    if (offer->pid != client_pid)
+    {
+        WARN("offer from process %04lx on a pipe connected to %04lx\n", offer->pid, client_pid);
+        return FALSE;
+    }
+
+    if (!(npc->peer_process = OpenProcess(PROCESS_DUP_HANDLE | SYNCHRONIZE, FALSE, client_pid)))
+        return FALSE;
+    if (!DuplicateHandle(npc->peer_process, ULongToHandle(offer->handle), GetCurrentProcess(),
+                         &npc->shm_mapping, FILE_MAP_READ | FILE_MAP_WRITE, FALSE, 0))
+        return FALSE;
+    if (!lrpc_shm_map(npc))
+        return FALSE;
+
+    client_event = ReadNoFence((LONG *)&npc->shm->client_event);
+    server_event = ReadNoFence((LONG *)&npc->shm->server_event);
+    return DuplicateHandle(npc->peer_process, ULongToHandle(server_event), GetCurrentProcess(),
+                           &npc->shm_event, event_access, FALSE, 0) &&
+           DuplicateHandle(npc->peer_process, ULongToHandle(client_event), GetCurrentProcess(),
+                           &npc->peer_event, event_access, FALSE, 0);
+}
+
+/* Offer shared memory to the server. Returns FALSE if the pipe is no longer
+ * usable, which happens when the server doesn't understand the offer. */
+static BOOL lrpc_shm_connect(RpcConnection_np *npc)
+{
+    struct lrpc_shm_offer offer, reply;
+    ULONG server_pid;
+
+    if (!GetNamedPipeServerProcessId(npc->pipe, &server_pid))
+        return TRUE;
+
+    if (!lrpc_shm_create(npc, server_pid))
+    {
+        WARN("failed to create shared memory transport, error %lu\n", GetLastError());
+        lrpc_shm_close(npc);
+        return TRUE;
+    }
+
+    offer.magic = LRPC_SHM_MAGIC;
+    offer.version = LRPC_SHM_VERSION;
+    offer.pid = GetCurrentProcessId();
+    offer.handle = HandleToULong(npc->shm_mapping);
+    if (rpcrt4_conn_np_write(&npc->common, &offer, sizeof(offer)) != sizeof(offer) ||
+        rpcrt4_conn_np_read(&npc->common, &reply, sizeof(reply)) != sizeof(reply) ||
+        reply.magic != LRPC_SHM_MAGIC)
+    {
+        WARN("server doesn't support the shared memory transport\n");
+        lrpc_shm_close(npc);
+        return FALSE;
+    }
+
+    if (reply.handle)
+    {
+        TRACE("server declined the shared memory transport\n");
+        lrpc_shm_close(npc);
+        return TRUE;
+    }
+
+    TRACE("using shared memory transport\n");
+    return TRUE;
+}
+
+static BOOL lrpc_shm_enabled(void)
+{
+    WCHAR value[8];
+
+    return GetEnvironmentVariableW(L"WINE_NCALRPC_SHM", value, ARRAY_SIZE(value)) != 1 || value[0] != '0';
+}
+
+static void lrpc_shm_accept(RpcConnection_np *npc, const struct lrpc_shm_offer *offer)
+{
+    struct lrpc_shm_offer reply = *offer;
+
+    reply.version = LRPC_SHM_VERSION;
+    if (offer->version == LRPC_SHM_VERSION && lrpc_shm_enabled() && lrpc_shm_open(npc, offer))
+    {
+        TRACE("using shared memory transport\n");
+        reply.handle = 0;
+    }
+    else
+    {
+        WARN("not using shared memory transport, error %lu\n", GetLastError());
+        lrpc_shm_close(npc);
+        reply.handle = 1;
+    }
+
+    if (rpcrt4_conn_np_write(&npc->common, &reply, sizeof(reply)) != sizeof(reply))
+        lrpc_shm_close(npc);
+}
+
+static BOOL lrpc_ring_ready(const struct lrpc_ring *ring, BOOL for_data)
+{
+    if (for_data)
+        return ReadAcquire(&ring->tail) != ring->head;
+    return (ULONG)(ring->tail - ReadAcquire(&ring->head)) < LRPC_RING_SIZE;
+}
+
+/* Wait until there is data to read from, or space to write to, the ring.
+ * Spin for a while first, since the peer is usually about to answer. */
+static BOOL lrpc_wait(RpcConnection_np *npc, struct lrpc_ring *ring, BOOL for_data)
+{
+    LONG *waiting = for_data ? &ring->reader_waiting : &ring->writer_waiting;
+    HANDLE handles[2] = {npc->shm_event, npc->peer_process};
+    unsigned int i;
+
+    for (i = 0; i < LRPC_SPIN_COUNT; i++)
+    {
+        if (lrpc_ring_ready(ring, for_data)) return TRUE;
+        YieldProcessor();
+    }
+
+    for (;;)
+    {
+        InterlockedExchange(waiting, TRUE);
+        if (lrpc_ring_ready(ring, for_data))
+        {
+            InterlockedExchange(waiting, FALSE);
+            return TRUE;
+        }
+        if (ReadAcquire(&npc->shm->closed) || npc->read_closed || InterlockedExchange(&npc->shm_cancelled, FALSE))
+            return FALSE;
+        /* the peer process dying won't close the ring for us */
+        if (WaitForMultipleObjects(ARRAY_SIZE(handles), handles, FALSE, INFINITE) != WAIT_OBJECT_0)
+            return FALSE;
+    }
+}
+
+static int lrpc_shm_read(RpcConnection_np *npc, void *buffer, unsigned int count)
+{
+    struct lrpc_ring *ring = lrpc_recv_ring(npc);
+    ULONG head = ring->head, len, offset;
+    unsigned int done = 0;
+
+    npc->shm_sending = FALSE;
+    while (done < count)
+    {
+        if (!lrpc_ring_ready(ring, TRUE) && !lrpc_wait(npc, ring, TRUE))
+            return -1;
+
+        len = min(count - done, (ULONG)(ReadAcquire(&ring->tail) - head));
+        offset = head % LRPC_RING_SIZE;
+        len = min(len, LRPC_RING_SIZE - offset);
+        memcpy((char *)buffer + done, ring->data + offset, len);
+        head += len;
+        done += len;
+
+        InterlockedExchange(&ring->head, head);
+        if (InterlockedExchange(&ring->writer_waiting, FALSE))
+            SetEvent(npc->peer_event);
+    }
+    return done;
+}
+
+static int lrpc_shm_write(RpcConnection_np *npc, const void *buffer, unsigned int count)
+{
+    struct lrpc_ring *ring = lrpc_send_ring(npc);
+    ULONG tail = ring->tail, len, offset;
+    unsigned int done = 0;
+
+    /* Forget cancellations of the previous call, but keep one that arrives
+     * while this call's fragments are being written. */
+    if (!npc->shm_sending)
+    {
+        InterlockedExchange(&npc->shm_cancelled, FALSE);
+        npc->shm_sending = TRUE;
+    }
+
+    while (done < count)
+    {
+        if (ReadAcquire(&npc->shm->closed))
+            return -1;
+        if (!lrpc_ring_ready(ring, FALSE) && !lrpc_wait(npc, ring, FALSE))
+            return -1;
+
+        len = min(count - done, LRPC_RING_SIZE - (ULONG)(tail - ReadAcquire(&ring->head)));
+        offset = tail % LRPC_RING_SIZE;
+        len = min(len, LRPC_RING_SIZE - offset);
+        memcpy(ring->data + offset, (const char *)buffer + done, len);
+        tail += len;
+        done += len;
+
+        InterlockedExchange(&ring->tail, tail);
+        if (InterlockedExchange(&ring->reader_waiting, FALSE))
+            SetEvent(npc->peer_event);
+    }
+    return done;
+}
+
+static int rpcrt4_ncalrpc_read(RpcConnection *conn, void *buffer, unsigned int count)
+{
+    RpcConnection_np *npc = (RpcConnection_np *)conn;
+    const struct lrpc_shm_offer *offer = buffer;
+    int ret;
+
+    if (npc->shm)
+        return lrpc_shm_read(npc, buffer, count);
+    if (!conn->server || npc->shm_probed || count < sizeof(*offer))
+        return rpcrt4_conn_np_read(conn, buffer, count);
+
+    /* the first message from the client may be a shared memory offer */
+    npc->shm_probed = TRUE;
+    ret = rpcrt4_conn_np_read(conn, buffer, sizeof(*offer));
+    if (ret != sizeof(*offer) || offer->magic != LRPC_SHM_MAGIC)
+    {
+        if (ret == sizeof(*offer) && count > sizeof(*offer))
+        {
+            int rest = rpcrt4_ncalrpc_read(conn, (char *)buffer + sizeof(*offer), count - sizeof(*offer));
+            return rest < 0 ? rest : ret + rest;
+        }
+        return ret;
+    }
+
+    lrpc_shm_accept(npc, offer);
+    return rpcrt4_ncalrpc_read(conn, buffer, count);
+}
+
+static int rpcrt4_ncalrpc_write(RpcConnection *conn, const void *buffer, unsigned int count)
+{
+    RpcConnection_np *npc = (RpcConnection_np *)conn;
+
+    if (npc->shm)
+        return lrpc_shm_write(npc, buffer, count);
+    return rpcrt4_conn_np_write(conn, buffer, count);
+}
+
+static int rpcrt4_ncalrpc_close(RpcConnection *conn)
+{
+    lrpc_shm_close((RpcConnection_np *)conn);
+    return rpcrt4_conn_np_close(conn);
+}
+
+static void rpcrt4_ncalrpc_close_read(RpcConnection *conn)
+{
+    RpcConnection_np *npc = (RpcConnection_np *)conn;
+
+    rpcrt4_conn_np_close_read(conn);
+    if (npc->shm)
+        SetEvent(npc->shm_event);
+}
+
+static void rpcrt4_ncalrpc_cancel_call(RpcConnection *conn)
+{
+    RpcConnection_np *npc = (RpcConnection_np *)conn;
+
+    if (npc->shm)
+    {
+        InterlockedExchange(&npc->shm_cancelled, TRUE);
+        SetEvent(npc->shm_event);
+    }
+    else
+        rpcrt4_conn_np_cancel_call(conn);
+}
+
+static int rpcrt4_ncalrpc_wait_for_incoming_data(RpcConnection *conn)
+{
+    RpcConnection_np *npc = (RpcConnection_np *)conn;
+
+    if (npc->shm)
+        return lrpc_wait(npc, lrpc_recv_ring(npc), TRUE) ? 0 : -1;
+    return rpcrt4_conn_np_wait_for_incoming_data(conn);
+}
+
 static size_t rpcrt4_ncacn_np_get_top_of_tower(unsigned char *tower_data,
                                                const char *networkaddr,
                                                const char *endpoint)
@@ -3145,13 +3526,13 @@ static const struct connection_ops conn_protseq_list[] = {
     rpcrt4_conn_np_alloc,
     rpcrt4_ncalrpc_open,
     rpcrt4_ncalrpc_handoff,
-    rpcrt4_conn_np_read,
-    rpcrt4_conn_np_write,
-    rpcrt4_conn_np_close,
-    rpcrt4_conn_np_close_read,
-    rpcrt4_conn_np_cancel_call,
+    rpcrt4_ncalrpc_read,
+    rpcrt4_ncalrpc_write,
+    rpcrt4_ncalrpc_close,
+    rpcrt4_ncalrpc_close_read,
+    rpcrt4_ncalrpc_cancel_call,
     rpcrt4_ncalrpc_np_is_server_listening,
-    rpcrt4_conn_np_wait_for_incoming_data,
+    rpcrt4_ncalrpc_wait_for_incoming_data,
     rpcrt4_ncalrpc_get_top_of_tower,
     rpcrt4_ncalrpc_parse_top_of_tower,
     NULL,
@@ -1993,6 +1993,37 @@ static void test_handle_return(void)
     test_handle(handle2);
 }
 
+static void
+call_latency_tests(const char *protseq)
+{
+  static const int call_count = 1000, large_count = 20, array_len = 0x10000;
+  LARGE_INTEGER frequency, start, end;
+  int i, *array;
+
+  QueryPerformanceFrequency(&frequency);
+
+  QueryPerformanceCounter(&start);
+  for (i = 0; i < call_count; i++)
+    if (square(i) != i * i) break;
+  QueryPerformanceCounter(&end);
+  ok(i == call_count, "RPC square failed on call %d\n", i);
+  trace("%s: %.1f us per small call\n", protseq,
+        (end.QuadPart - start.QuadPart) * 1000000.0 / frequency.QuadPart / call_count);
+
+  /* large enough to span several fragments */
+  array = malloc(array_len * sizeof(*array));
+  for (i = 0; i < array_len; i++) array[i] = 1;
+  QueryPerformanceCounter(&start);
+  for (i = 0; i < large_count; i++)
+    if (sum_conf_array(array, array_len) != array_len) break;
+  QueryPerformanceCounter(&end);
+  ok(i == large_count, "RPC sum_conf_array failed on call %d\n", i);
+  trace("%s: %.1f us per %u byte call\n", protseq,
+        (end.QuadPart - start.QuadPart) * 1000000.0 / frequency.QuadPart / large_count,
+        (unsigned int)(array_len * sizeof(*array)));
+  free(array);
+}
+
 static void
 run_tests(void)
 {
@@ -2087,6 +2118,7 @@ client(const char *test)
     ok(RPC_S_OK == RpcBindingFromStringBindingA(binding, &IMixedServer_IfHandle), "RpcBindingFromStringBinding\n");
 
     run_tests(); /* can cause RPC_X_BAD_STUB_DATA exception */
+    call_latency_tests("ncalrpc");
     authinfo_test(RPC_PROTSEQ_LRPC, 0);
     test_I_RpcBindingInqLocalClientPID(RPC_PROTSEQ_LRPC, IMixedServer_IfHandle);
     test_is_server_listening(IMixedServer_IfHandle, RPC_S_OK);
@@ -2131,6 +2163,7 @@ client(const char *test)
 
     test_is_server_listening(IMixedServer_IfHandle, RPC_S_OK);
     run_tests();
+    call_latency_tests("ncacn_np");
     authinfo_test(RPC_PROTSEQ_NMP, 0);
     test_I_RpcBindingInqLocalClientPID(RPC_PROTSEQ_NMP, IMixedServer_IfHandle);
     test_is_server_listening(IMixedServer_IfHandle, RPC_S_OK);
@@ -2236,6 +2269,11 @@ server(void)
   {
     run_client("ncalrpc_basic");
 
+    /* the server declines the shared memory transport and calls go through the pipe */
+    SetEnvironmentVariableA("WINE_NCALRPC_SHM", "0");
+    run_client("ncalrpc_basic");
+    SetEnvironmentVariableA("WINE_NCALRPC_SHM", NULL);
+
     /* we don't need to register RPC_C_AUTHN_WINNT for ncalrpc */
     run_client("ncalrpc_secure");
   }
@@ -29,7 +29,9 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <dlfcn.h>
 #ifdef SONAME_LIBGNUTLS
@@ -47,6 +49,7 @@
 #include "secur32_priv.h"
 
 #include "wine/unixlib.h"
+#include "wine/list.h"
 #include "wine/debug.h"
 
 #if defined(SONAME_LIBGNUTLS)
@@ -112,6 +115,9 @@ MAKE_FUNCPTR(gnutls_record_recv);
 MAKE_FUNCPTR(gnutls_record_send);
 MAKE_FUNCPTR(gnutls_server_name_set);
 MAKE_FUNCPTR(gnutls_session_channel_binding);
+MAKE_FUNCPTR(gnutls_session_get_data);
+MAKE_FUNCPTR(gnutls_session_is_resumed);
+MAKE_FUNCPTR(gnutls_session_set_data);
 MAKE_FUNCPTR(gnutls_set_default_priority);
 MAKE_FUNCPTR(gnutls_transport_get_ptr);
 MAKE_FUNCPTR(gnutls_transport_set_errno);
@@ -146,6 +152,10 @@ MAKE_FUNCPTR(gnutls_x509_privkey_deinit);
 #define GNUTLS_ALPN_SERVER_PRECEDENCE (1<<1)
 #endif
 
+#if GNUTLS_VERSION_MAJOR < 3 || (GNUTLS_VERSION_MAJOR == 3 && GNUTLS_VERSION_MINOR < 6)
+#define GNUTLS_TLS1_3 5
+#endif
+
 static inline gnutls_session_t session_from_handle(UINT64 handle)
 {
    return (gnutls_session_t)(ULONG_PTR)handle;
@@ -169,8 +179,114 @@ struct schan_transport
     gnutls_session_t session;
     struct schan_buffers in;
     struct schan_buffers out;
+    UINT64 credentials;     /* credentials of a client stream session, used for resumption */
+    char *target;
+    BOOL handshake_done;
+};
+
+/* Data of the established client sessions, used to resume them when the same credentials are
+ * used to connect to the same target again. */
+struct session_cache_entry
+{
+    struct list entry;
+    UINT64 credentials;
+    char *target;
+    void *data;
+    size_t size;
 };
 
+#define SESSION_CACHE_SIZE 64
+
+static struct list session_cache = LIST_INIT( session_cache );
+static unsigned int session_cache_count;
+static pthread_mutex_t session_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* caller must hold session_cache_mutex */
+static struct session_cache_entry *find_session_cache_entry( UINT64 credentials, const char *target )
+{
+    struct session_cache_entry *entry;
+
+    LIST_FOR_EACH_ENTRY( entry, &session_cache, struct session_cache_entry, entry )
+        if (entry->credentials == credentials && !strcmp( entry->target, target )) return entry;
+    return NULL;
+}
+
+/* caller must hold session_cache_mutex */
+static void free_session_cache_entry( struct session_cache_entry *entry )
+{
+    list_remove( &entry->entry );
+    session_cache_count--;
+    free( entry->target );
+    free( entry->data );
+    free( entry );
+}
+
+static void save_session_data( struct schan_transport *t )
+{
+    struct session_cache_entry *entry;
+    size_t size = 0;
+    void *data;
+
+    if (!t->credentials || !t->target || !t->handshake_done) return;
+    if (pgnutls_session_get_data( t->session, NULL, &size ) != GNUTLS_E_SUCCESS || !size) return;
+    if (!(data = malloc( size ))) return;
+    if (pgnutls_session_get_data( t->session, data, &size ) != GNUTLS_E_SUCCESS)
+    {
+        free( data );
+        return;
+    }
+
+    pthread_mutex_lock( &session_cache_mutex );
+    if ((entry = find_session_cache_entry( t->credentials, t->target )))
+    {
+        list_remove( &entry->entry );
+        free( entry->data );
+    }
+    else if ((entry = malloc( sizeof(*entry) )) && (entry->target = strdup( t->target )))
+    {
+        entry->credentials = t->credentials;
+        session_cache_count++;
+    }
+    else
+    {
+        free( entry );
+        entry = NULL;
+    }
+    if (entry)
+    {
+        entry->data = data;
+        entry->size = size;
+        list_add_head( &session_cache, &entry->entry );
+        if (session_cache_count > SESSION_CACHE_SIZE)
+            free_session_cache_entry( LIST_ENTRY( list_tail( &session_cache ), struct session_cache_entry, entry ));
+    }
+    else free( data );
+    pthread_mutex_unlock( &session_cache_mutex );
+}
+
+static void load_session_data( struct schan_transport *t )
+{
+    struct session_cache_entry *entry;
+
+    pthread_mutex_lock( &session_cache_mutex );
+    if ((entry = find_session_cache_entry( t->credentials, t->target )))
+    {
+        TRACE( "trying to resume session to %s\n", debugstr_a(t->target) );
+        pgnutls_session_set_data( t->session, entry->data, entry->size );
+    }
+    pthread_mutex_unlock( &session_cache_mutex );
+}
+
+static void purge_session_cache( UINT64 credentials )
+{
+    struct session_cache_entry *entry, *next;
+
+    pthread_mutex_lock( &session_cache_mutex );
+    LIST_FOR_EACH_ENTRY_SAFE( entry, next, &session_cache, struct session_cache_entry, entry )
+        if (entry->credentials == credentials) free_session_cache_entry( entry );
+    pthread_mutex_unlock( &session_cache_mutex );
+}
+
 static int compat_cipher_get_block_size(gnutls_cipher_algorithm_t cipher)
 {
     switch(cipher) {
@@ -521,6 +637,7 @@ static NTSTATUS schan_create_session( void *args )
         return STATUS_INTERNAL_ERROR;
     }
     transport->session = s;
+    if (!(flags & (GNUTLS_SERVER | GNUTLS_DATAGRAM))) transport->credentials = cred->credentials;
 
     if ((status = set_priority(cred, s)))
     {
@@ -552,8 +669,14 @@ static NTSTATUS schan_dispose_session( void *args )
     const struct session_params *params = args;
     gnutls_session_t s = session_from_handle(params->session);
     struct schan_transport *t = (struct schan_transport *)pgnutls_transport_get_ptr(s);
+
+    /* TLS 1.3 tickets are received after the handshake, the data is complete only now */
+    t->in.desc = t->out.desc = NULL;
+    save_session_data(t);
+
     pgnutls_transport_set_ptr(s, NULL);
     pgnutls_deinit(s);
+    free(t->target);
     free(t);
     return STATUS_SUCCESS;
 }
@@ -562,7 +685,10 @@ static NTSTATUS schan_set_session_target( void *args )
 {
     const struct set_session_target_params *params = args;
     gnutls_session_t s = session_from_handle(params->session);
+    struct schan_transport *t = (struct schan_transport *)pgnutls_transport_get_ptr(s);
+
     pgnutls_server_name_set( s, GNUTLS_NAME_DNS, params->target, strlen(params->target) );
+    if (t->credentials && !t->target && (t->target = strdup( params->target ))) load_session_data(t);
     return STATUS_SUCCESS;
 }
 
@@ -657,7 +783,9 @@ static NTSTATUS schan_handshake( void *args )
         err = pgnutls_handshake(s);
         if (err == GNUTLS_E_SUCCESS)
         {
-            TRACE("Handshake completed\n");
+            TRACE("Handshake completed%s\n", pgnutls_session_is_resumed(s) ? ", session resumed" : "");
+            t->handshake_done = TRUE;
+            if (pgnutls_protocol_get_version(s) != GNUTLS_TLS1_3) save_session_data(t);
             status = SEC_E_OK;
         }
         else if (err == GNUTLS_E_AGAIN)
@@ -1447,6 +1575,7 @@ static NTSTATUS schan_allocate_certificate_credentials( void *args )
 static NTSTATUS schan_free_certificate_credentials( void *args )
 {
     const struct free_certificate_credentials_params *params = args;
+    purge_session_cache(params->c->credentials);
     pgnutls_certificate_free_credentials(certificate_creds_from_handle(params->c->credentials));
     return STATUS_SUCCESS;
 }
@@ -1514,6 +1643,9 @@ static NTSTATUS process_attach( void *args )
     LOAD_FUNCPTR(gnutls_record_send);
     LOAD_FUNCPTR(gnutls_server_name_set)
     LOAD_FUNCPTR(gnutls_session_channel_binding)
+    LOAD_FUNCPTR(gnutls_session_get_data)
+    LOAD_FUNCPTR(gnutls_session_is_resumed)
+    LOAD_FUNCPTR(gnutls_session_set_data)
     LOAD_FUNCPTR(gnutls_set_default_priority)
     LOAD_FUNCPTR(gnutls_transport_get_ptr)
     LOAD_FUNCPTR(gnutls_transport_set_errno)
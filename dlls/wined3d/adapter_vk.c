@@ -467,6 +467,7 @@ static HRESULT adapter_vk_create_device(struct wined3d *wined3d, const struct wi
     }
 
     wined3d_lock_init(&device_vk->allocator_cs, "wined3d_device_vk.allocator_cs");
+    wined3d_device_vk_start_submit_thread(device_vk);
 
     *device = &device_vk->d;
 
@@ -484,6 +485,7 @@ static void adapter_vk_destroy_device(struct wined3d_device *device)
     const struct wined3d_vk_info *vk_info = &device_vk->vk_info;
 
     wined3d_device_cleanup(&device_vk->d);
+    wined3d_device_vk_stop_submit_thread(device_vk);
     wined3d_allocator_cleanup(&device_vk->allocator);
 
     wined3d_lock_cleanup(&device_vk->allocator_cs);
@@ -1721,7 +1723,8 @@ static void adapter_vk_draw_primitive(struct wined3d_device *device,
     if (!(vk_command_buffer = wined3d_context_vk_apply_draw_state(context_vk,
             state, indirect_vk, parameters->indexed)))
     {
-        ERR("Failed to apply draw state.\n");
+        if (!context_vk->shader_compile_pending)
+            ERR("Failed to apply draw state.\n");
         context_release(&context_vk->c);
         return;
     }
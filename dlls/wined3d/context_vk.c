@@ -26,6 +26,7 @@
 #include "wined3d_vk.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d);
+WINE_DECLARE_DEBUG_CHANNEL(d3d_perf);
 
 VkCompareOp vk_compare_op_from_wined3d(enum wined3d_cmp_func op)
 {
@@ -1705,6 +1706,7 @@ void wined3d_context_vk_cleanup(struct wined3d_context_vk *context_vk)
         buffer->vk_command_buffer = VK_NULL_HANDLE;
     }
 
+    wined3d_device_vk_flush_submissions(device_vk);
     wined3d_context_vk_wait_command_buffer(context_vk, buffer->id - 1);
     context_vk->completed_command_buffer_id = buffer->id;
     for (i = 0; i < context_vk->completed.buffer_count; ++i)
@@ -1830,6 +1832,189 @@ VkCommandBuffer wined3d_context_vk_get_command_buffer(struct wined3d_context_vk
     return buffer->vk_command_buffer;
 }
 
+static void wined3d_submission_vk_submit(struct wined3d_device_vk *device_vk,
+        const struct wined3d_submission_vk *submission)
+{
+    const struct wined3d_vk_info *vk_info = &device_vk->vk_info;
+    VkSubmitInfo submit_info;
+    VkResult vr;
+
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = NULL;
+    submit_info.waitSemaphoreCount = submission->wait_semaphore_count;
+    submit_info.pWaitSemaphores = submission->wait_semaphores;
+    submit_info.pWaitDstStageMask = submission->wait_stages;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &submission->vk_command_buffer;
+    submit_info.signalSemaphoreCount = submission->signal_semaphore_count;
+    submit_info.pSignalSemaphores = submission->signal_semaphores;
+
+    if ((vr = VK_CALL(vkQueueSubmit(device_vk->vk_queue, 1, &submit_info, submission->vk_fence))) < 0)
+        ERR("Failed to submit command buffer %p, vr %s.\n",
+                submission->vk_command_buffer, wined3d_debug_vkresult(vr));
+}
+
+static void wined3d_submit_queue_vk_report_stats(struct wined3d_submit_queue_vk *queue)
+{
+    LARGE_INTEGER freq;
+    DWORD time;
+
+    time = GetTickCount();
+    if (time - queue->stats_time < 1500)
+        return;
+
+    if (queue->submit_count)
+    {
+        QueryPerformanceFrequency(&freq);
+        TRACE_(d3d_perf)("Submission stage: %u submits, average latency %u μs, average submit time %u μs.\n",
+                queue->submit_count,
+                (unsigned int)(queue->latency_time * 1000000 / freq.QuadPart / queue->submit_count),
+                (unsigned int)(queue->submit_time * 1000000 / freq.QuadPart / queue->submit_count));
+    }
+
+    queue->submit_count = 0;
+    queue->latency_time = 0;
+    queue->submit_time = 0;
+    queue->stats_time = time;
+}
+
+static DWORD WINAPI wined3d_device_vk_submit_thread(void *ctx)
+{
+    struct wined3d_device_vk *device_vk = ctx;
+    struct wined3d_submit_queue_vk *queue = &device_vk->submit_queue;
+    struct wined3d_submission_vk *submissions;
+    LARGE_INTEGER start, end;
+    SIZE_T count, size, i;
+
+    TRACE("Started.\n");
+    SetThreadDescription(GetCurrentThread(), L"wined3d_vk_submit");
+
+    EnterCriticalSection(&queue->cs);
+    for (;;)
+    {
+        while (!queue->pending_count && !queue->stop)
+            SleepConditionVariableCS(&queue->work_cond, &queue->cs, INFINITE);
+        if (!queue->pending_count)
+            break;
+
+        /* Swap the arrays, so that the CS thread can keep queueing while we
+         * submit. */
+        submissions = queue->pending;
+        size = queue->pending_size;
+        count = queue->pending_count;
+        queue->pending = queue->processing;
+        queue->pending_size = queue->processing_size;
+        queue->pending_count = 0;
+        queue->processing = submissions;
+        queue->processing_size = size;
+        queue->busy = true;
+        LeaveCriticalSection(&queue->cs);
+
+        for (i = 0; i < count; ++i)
+        {
+            if (!TRACE_ON(d3d_perf))
+            {
+                wined3d_submission_vk_submit(device_vk, &submissions[i]);
+                continue;
+            }
+
+            QueryPerformanceCounter(&start);
+            wined3d_submission_vk_submit(device_vk, &submissions[i]);
+            QueryPerformanceCounter(&end);
+
+            ++queue->submit_count;
+            queue->latency_time += start.QuadPart - submissions[i].queue_time;
+            queue->submit_time += end.QuadPart - start.QuadPart;
+        }
+        if (TRACE_ON(d3d_perf))
+            wined3d_submit_queue_vk_report_stats(queue);
+
+        EnterCriticalSection(&queue->cs);
+        queue->busy = false;
+        WakeAllConditionVariable(&queue->idle_cond);
+    }
+    LeaveCriticalSection(&queue->cs);
+
+    TRACE("Stopped.\n");
+    return 0;
+}
+
+void wined3d_device_vk_start_submit_thread(struct wined3d_device_vk *device_vk)
+{
+    struct wined3d_submit_queue_vk *queue = &device_vk->submit_queue;
+
+    if (!wined3d_settings.vk_submit_thread)
+        return;
+
+    memset(queue, 0, sizeof(*queue));
+    wined3d_lock_init(&queue->cs, "wined3d_submit_queue_vk.cs");
+    InitializeConditionVariable(&queue->work_cond);
+    InitializeConditionVariable(&queue->idle_cond);
+
+    if (!(queue->thread = CreateThread(NULL, 0, wined3d_device_vk_submit_thread, device_vk, 0, NULL)))
+    {
+        ERR("Failed to create submission thread.\n");
+        wined3d_lock_cleanup(&queue->cs);
+        return;
+    }
+
+    TRACE("Using a separate submission thread.\n");
+}
+
+void wined3d_device_vk_stop_submit_thread(struct wined3d_device_vk *device_vk)
+{
+    struct wined3d_submit_queue_vk *queue = &device_vk->submit_queue;
+
+    if (!queue->thread)
+        return;
+
+    EnterCriticalSection(&queue->cs);
+    queue->stop = true;
+    WakeConditionVariable(&queue->work_cond);
+    LeaveCriticalSection(&queue->cs);
+
+    WaitForSingleObject(queue->thread, INFINITE);
+    CloseHandle(queue->thread);
+    queue->thread = NULL;
+
+    free(queue->pending);
+    free(queue->processing);
+    wined3d_lock_cleanup(&queue->cs);
+}
+
+void wined3d_device_vk_flush_submissions(struct wined3d_device_vk *device_vk)
+{
+    struct wined3d_submit_queue_vk *queue = &device_vk->submit_queue;
+
+    if (!queue->thread)
+        return;
+
+    EnterCriticalSection(&queue->cs);
+    while (queue->pending_count || queue->busy)
+        SleepConditionVariableCS(&queue->idle_cond, &queue->cs, INFINITE);
+    LeaveCriticalSection(&queue->cs);
+}
+
+static void wined3d_device_vk_queue_submission(struct wined3d_device_vk *device_vk,
+        const struct wined3d_submission_vk *submission)
+{
+    struct wined3d_submit_queue_vk *queue = &device_vk->submit_queue;
+
+    EnterCriticalSection(&queue->cs);
+    if (!wined3d_array_reserve((void **)&queue->pending, &queue->pending_size,
+            queue->pending_count + 1, sizeof(*queue->pending)))
+    {
+        ERR("Failed to grow submission array.\n");
+        LeaveCriticalSection(&queue->cs);
+        wined3d_device_vk_flush_submissions(device_vk);
+        wined3d_submission_vk_submit(device_vk, submission);
+        return;
+    }
+    queue->pending[queue->pending_count++] = *submission;
+    WakeConditionVariable(&queue->work_cond);
+    LeaveCriticalSection(&queue->cs);
+}
+
 void wined3d_context_vk_submit_command_buffer(struct wined3d_context_vk *context_vk,
         unsigned int wait_semaphore_count, const VkSemaphore *wait_semaphores, const VkPipelineStageFlags *wait_stages,
         unsigned int signal_semaphore_count, const VkSemaphore *signal_semaphores)
@@ -1837,10 +2022,10 @@ void wined3d_context_vk_submit_command_buffer(struct wined3d_context_vk *context
     struct wined3d_device_vk *device_vk = wined3d_device_vk(context_vk->c.device);
     const struct wined3d_vk_info *vk_info = context_vk->vk_info;
     struct wined3d_query_pool_vk *pool_vk, *pool_vk_next;
+    struct wined3d_submission_vk submission;
     struct wined3d_command_buffer_vk *buffer;
     struct wined3d_query_vk *query_vk;
-    VkSubmitInfo submit_info;
-    VkResult vr;
+    LARGE_INTEGER time;
 
     TRACE("context_vk %p, wait_semaphore_count %u, wait_semaphores %p, wait_stages %p,"
             "signal_semaphore_count %u, signal_semaphores %p.\n",
@@ -1887,19 +2072,30 @@ void wined3d_context_vk_submit_command_buffer(struct wined3d_context_vk *context
 
     VK_CALL(vkResetFences(device_vk->vk_device, 1, &buffer->vk_fence));
 
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.pNext = NULL;
-    submit_info.waitSemaphoreCount = wait_semaphore_count;
-    submit_info.pWaitSemaphores = wait_semaphores;
-    submit_info.pWaitDstStageMask = wait_stages;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &buffer->vk_command_buffer;
-    submit_info.signalSemaphoreCount = signal_semaphore_count;
-    submit_info.pSignalSemaphores = signal_semaphores;
+    assert(wait_semaphore_count <= WINED3D_VK_MAX_SUBMIT_SEMAPHORES);
+    assert(signal_semaphore_count <= WINED3D_VK_MAX_SUBMIT_SEMAPHORES);
+    submission.vk_command_buffer = buffer->vk_command_buffer;
+    submission.vk_fence = buffer->vk_fence;
+    submission.wait_semaphore_count = wait_semaphore_count;
+    memcpy(submission.wait_semaphores, wait_semaphores, wait_semaphore_count * sizeof(*wait_semaphores));
+    memcpy(submission.wait_stages, wait_stages, wait_semaphore_count * sizeof(*wait_stages));
+    submission.signal_semaphore_count = signal_semaphore_count;
+    memcpy(submission.signal_semaphores, signal_semaphores, signal_semaphore_count * sizeof(*signal_semaphores));
 
-    if ((vr = VK_CALL(vkQueueSubmit(device_vk->vk_queue, 1, &submit_info, buffer->vk_fence))) < 0)
-        ERR("Failed to submit command buffer %p, vr %s.\n",
-                buffer->vk_command_buffer, wined3d_debug_vkresult(vr));
+    if (device_vk->submit_queue.thread)
+    {
+        submission.queue_time = 0;
+        if (TRACE_ON(d3d_perf))
+        {
+            QueryPerformanceCounter(&time);
+            submission.queue_time = time.QuadPart;
+        }
+        wined3d_device_vk_queue_submission(device_vk, &submission);
+    }
+    else
+    {
+        wined3d_submission_vk_submit(device_vk, &submission);
+    }
 
     if (!wined3d_array_reserve((void **)&context_vk->submitted.buffers, &context_vk->submitted.buffers_size,
             context_vk->submitted.buffer_count + 1, sizeof(*context_vk->submitted.buffers)))
@@ -3611,12 +3807,14 @@ VkCommandBuffer wined3d_context_vk_apply_draw_state(struct wined3d_context_vk *c
 
     if (!context_vk->sample_count)
         context_vk->sample_count = VK_SAMPLE_COUNT_1_BIT;
+    context_vk->shader_compile_pending = 0;
     if (context_vk->c.shader_update_mask & ~(1u << WINED3D_SHADER_TYPE_COMPUTE))
     {
         device_vk->d.shader_backend->shader_apply_draw_state(device_vk->d.shader_priv, &context_vk->c, state);
         if (!context_vk->graphics.vk_pipeline_layout)
         {
-            ERR("No pipeline layout set.\n");
+            if (!context_vk->shader_compile_pending)
+                ERR("No pipeline layout set.\n");
             return VK_NULL_HANDLE;
         }
         context_vk->c.update_shader_resource_bindings = 1;
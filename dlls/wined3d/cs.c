@@ -164,6 +164,7 @@ struct wined3d_cs_present
     RECT dst_rect;
     unsigned int swap_interval;
     uint32_t flags;
+    unsigned int map_stall_count;
 };
 
 struct wined3d_cs_clear
@@ -736,6 +737,13 @@ static void wined3d_cs_exec_present(struct wined3d_cs *cs, const void *data)
         }
     }
 
+    if (cs->perf)
+    {
+        const struct wined3d_cs_queue *queue = &cs->queue[WINED3D_CS_QUEUE_DEFAULT];
+
+        wined3d_perf_end_frame(cs->perf, *(volatile ULONG *)&queue->head - queue->tail, op->map_stall_count);
+    }
+
     InterlockedDecrement(&cs->pending_presents);
     if (InterlockedCompareExchange(&cs->waiting_for_present, FALSE, TRUE))
         SetEvent(cs->present_event);
@@ -759,6 +767,7 @@ void wined3d_cs_emit_present(struct wined3d_cs *cs, struct wined3d_swapchain *sw
     op->dst_rect = *dst_rect;
     op->swap_interval = swap_interval;
     op->flags = flags;
+    op->map_stall_count = cs->frame_map_stalls;
 
     pending = InterlockedIncrement(&cs->pending_presents);
 
@@ -770,6 +779,13 @@ void wined3d_cs_emit_present(struct wined3d_cs *cs, struct wined3d_swapchain *sw
 
     wined3d_device_context_submit(&cs->c, WINED3D_CS_QUEUE_DEFAULT);
 
+    ++cs->frame_count;
+    if (cs->frame_map_stalls || cs->frame_ring_fallbacks)
+        TRACE_(d3d_perf)("Frame %u: %u maps synchronised with the CS, %u upload ring fallbacks.\n",
+                cs->frame_count, cs->frame_map_stalls, cs->frame_ring_fallbacks);
+    cs->frame_map_stalls = 0;
+    cs->frame_ring_fallbacks = 0;
+
     /* Limit input latency by limiting the number of presents that we can get
      * ahead of the worker thread. */
     while (pending >= swapchain->max_frame_latency)
@@ -944,6 +960,9 @@ static void wined3d_cs_exec_dispatch(struct wined3d_cs *cs, const void *data)
     const struct wined3d_cs_dispatch *op = data;
     struct wined3d_state *state = &cs->state;
 
+    if (cs->perf)
+        ++cs->perf->frame.dispatch_count;
+
     if (!state->shader[WINED3D_SHADER_TYPE_COMPUTE])
         WARN("No compute shader bound, skipping dispatch.\n");
     else
@@ -1007,6 +1026,9 @@ static void wined3d_cs_exec_draw(struct wined3d_cs *cs, const void *data)
     const struct wined3d_cs_draw *op = data;
     unsigned int i;
 
+    if (cs->perf)
+        ++cs->perf->frame.draw_count;
+
     base_vertex_idx = 0;
     if (!op->parameters.indirect)
     {
@@ -2451,6 +2473,14 @@ void wined3d_cs_emit_unload_resource(struct wined3d_cs *cs, struct wined3d_resou
     wined3d_device_context_submit(&cs->c, WINED3D_CS_QUEUE_DEFAULT);
 }
 
+static void wined3d_device_context_count_map_stall(struct wined3d_device_context *context)
+{
+    struct wined3d_cs *cs = context->device->cs;
+
+    if (context == &cs->c)
+        ++cs->frame_map_stalls;
+}
+
 static void wined3d_device_context_upload_bo(struct wined3d_device_context *context,
         struct wined3d_resource *resource, unsigned int sub_resource_idx, const struct wined3d_box *box,
         const struct upload_bo *bo, unsigned int row_pitch, unsigned int slice_pitch)
@@ -2504,6 +2534,7 @@ HRESULT wined3d_device_context_emit_map(struct wined3d_device_context *context,
     }
 
     TRACE_(d3d_perf)("Mapping resource %p (type %u), flags %#x through the CS.\n", resource, resource->type, flags);
+    wined3d_device_context_count_map_stall(context);
 
     wined3d_resource_wait_idle(resource);
 
@@ -2558,6 +2589,7 @@ HRESULT wined3d_device_context_emit_unmap(struct wined3d_device_context *context
     wined3d_not_from_cs(context->device->cs);
 
     TRACE_(d3d_perf)("Unmapping resource %p (type %u) through the CS.\n", resource, resource->type);
+    wined3d_device_context_count_map_stall(context);
 
     if (!(op = wined3d_device_context_require_space(context, sizeof(*op), WINED3D_CS_QUEUE_MAP)))
         return E_OUTOFMEMORY;
@@ -2735,6 +2767,47 @@ void wined3d_device_context_emit_blt_sub_resource(struct wined3d_device_context
         wined3d_device_context_finish(context, WINED3D_CS_QUEUE_DEFAULT);
 }
 
+/* Called from the application thread, with the wined3d mutex held. The
+ * allocation must be submitted to the default queue before the next one is
+ * made, so that the CS thread releases them in order. */
+static void *wined3d_cs_upload_ring_alloc(struct wined3d_cs_upload_ring *ring, size_t size)
+{
+    ULONG offset, end, tail;
+    BYTE *ptr;
+
+    size = WINED3D_CS_UPLOAD_RING_ALIGNMENT + ((size + WINED3D_CS_UPLOAD_RING_ALIGNMENT - 1)
+            & ~(size_t)(WINED3D_CS_UPLOAD_RING_ALIGNMENT - 1));
+    if (size > WINED3D_CS_UPLOAD_RING_SIZE / 4)
+        return NULL;
+
+    if (!ring->data && !(ring->data = malloc(WINED3D_CS_UPLOAD_RING_SIZE)))
+        return NULL;
+
+    /* Allocations don't wrap around; skip to the start of the ring instead.
+     * The skipped space is released together with the allocation. */
+    offset = ring->head;
+    if ((offset & WINED3D_CS_UPLOAD_RING_MASK) + size > WINED3D_CS_UPLOAD_RING_SIZE)
+        offset = (offset | WINED3D_CS_UPLOAD_RING_MASK) + 1;
+    end = offset + size;
+
+    tail = *(volatile ULONG *)&ring->tail;
+    if (end - tail > WINED3D_CS_UPLOAD_RING_SIZE)
+        return NULL;
+
+    ptr = &ring->data[offset & WINED3D_CS_UPLOAD_RING_MASK];
+    *(ULONG *)ptr = end;
+    ring->head = end;
+
+    return ptr + WINED3D_CS_UPLOAD_RING_ALIGNMENT;
+}
+
+static void wined3d_cs_upload_ring_free(struct wined3d_cs_upload_ring *ring, const void *data)
+{
+    ULONG end = *(const ULONG *)((const BYTE *)data - WINED3D_CS_UPLOAD_RING_ALIGNMENT);
+
+    InterlockedExchange((LONG *)&ring->tail, end);
+}
+
 static void wined3d_cs_exec_update_sub_resource(struct wined3d_cs *cs, const void *data)
 {
     const struct wined3d_cs_update_sub_resource *op = data;
@@ -2742,6 +2815,19 @@ static void wined3d_cs_exec_update_sub_resource(struct wined3d_cs *cs, const voi
     const struct wined3d_box *box = &op->box;
     struct wined3d_context *context;
 
+    if (cs->perf)
+    {
+        const struct wined3d_format *format = resource->format;
+
+        if (resource->type == WINED3D_RTYPE_BUFFER)
+            cs->perf->frame.upload_bytes += box->right - box->left;
+        else
+            cs->perf->frame.upload_bytes += (box->back - box->front - 1) * op->slice_pitch
+                    + ((box->bottom - box->top - 1) / format->block_height) * op->row_pitch
+                    + ((box->right - box->left + format->block_width - 1) / format->block_width)
+                    * format->block_byte_count;
+    }
+
     context = context_acquire(cs->c.device, NULL, 0);
 
     if (resource->type == WINED3D_RTYPE_BUFFER)
@@ -2757,6 +2843,8 @@ static void wined3d_cs_exec_update_sub_resource(struct wined3d_cs *cs, const voi
     {
         if (op->bo.addr.buffer_object)
             FIXME("Free BO address %s.\n", debug_const_bo_address(&op->bo.addr));
+        else if (op->bo.flags & UPLOAD_BO_RING)
+            wined3d_cs_upload_ring_free(&cs->upload_ring, op->bo.addr.addr);
         else
             free((void *)op->bo.addr.addr);
     }
@@ -2786,6 +2874,7 @@ void wined3d_device_context_emit_update_sub_resource(struct wined3d_device_conte
         return;
     }
 
+    wined3d_device_context_count_map_stall(context);
     wined3d_resource_wait_idle(resource);
 
     op = wined3d_device_context_require_space(context, sizeof(*op), WINED3D_CS_QUEUE_MAP);
@@ -2990,6 +3079,35 @@ static void (* const wined3d_cs_op_handlers[])(struct wined3d_cs *cs, const void
     /* WINED3D_CS_OP_EXECUTE_COMMAND_LIST        */ wined3d_cs_exec_execute_command_list,
 };
 
+/* Execute a single packet, on any CS implementation, and update the
+ * performance counters. */
+static void wined3d_cs_execute_packet(struct wined3d_cs *cs, enum wined3d_cs_op opcode, const void *data)
+{
+    LARGE_INTEGER start, end;
+
+    if (!TRACE_ON(d3d_perf) && !cs->perf)
+    {
+        wined3d_cs_op_handlers[opcode](cs, data);
+        return;
+    }
+
+    QueryPerformanceCounter(&start);
+    wined3d_cs_op_handlers[opcode](cs, data);
+    /* The packets of a command list are counted as they are executed. */
+    if (opcode == WINED3D_CS_OP_EXECUTE_COMMAND_LIST)
+        return;
+    QueryPerformanceCounter(&end);
+
+    cs->exec_time += end.QuadPart - start.QuadPart;
+    ++cs->exec_count;
+    if (cs->perf)
+    {
+        cs->perf->frame.cs_busy_time += end.QuadPart - start.QuadPart;
+        if (opcode >= WINED3D_CS_OP_SET_PREDICATION && opcode <= WINED3D_CS_OP_PUSH_CONSTANTS)
+            ++cs->perf->frame.state_change_count;
+    }
+}
+
 void wined3d_device_context_emit_execute_command_list(struct wined3d_device_context *context,
         struct wined3d_command_list *list, bool restore_state)
 {
@@ -3052,7 +3170,7 @@ static void wined3d_cs_st_submit(struct wined3d_device_context *context, enum wi
     if (opcode >= WINED3D_CS_OP_STOP)
         ERR("Invalid opcode %#x.\n", opcode);
     else
-        wined3d_cs_op_handlers[opcode](cs, &data[start]);
+        wined3d_cs_execute_packet(cs, opcode, &data[start]);
 
     if (cs->data == data)
         cs->start = cs->end = start;
@@ -3067,6 +3185,7 @@ static void wined3d_cs_st_finish(struct wined3d_device_context *context, enum wi
 static bool wined3d_cs_map_upload_bo(struct wined3d_device_context *context, struct wined3d_resource *resource,
         unsigned int sub_resource_idx, struct wined3d_map_desc *map_desc, const struct wined3d_box *box, uint32_t flags)
 {
+    struct wined3d_cs *cs = wined3d_cs_from_context(context);
     struct wined3d_client_resource *client = &resource->client;
     const struct wined3d_format *format = resource->format;
     size_t size;
@@ -3170,6 +3289,17 @@ static bool wined3d_cs_map_upload_bo(struct wined3d_device_context *context, str
             + ((box->bottom - box->top - 1) / format->block_height) * map_desc->row_pitch
             + ((box->right - box->left + format->block_width - 1) / format->block_width) * format->block_byte_count;
 
+    if ((map_desc->data = wined3d_cs_upload_ring_alloc(&cs->upload_ring, size)))
+    {
+        client->mapped_upload.addr.buffer_object = 0;
+        client->mapped_upload.addr.addr = map_desc->data;
+        client->mapped_upload.flags = UPLOAD_BO_UPLOAD_ON_UNMAP | UPLOAD_BO_FREE_ON_UNMAP | UPLOAD_BO_RING;
+        client->mapped_box = *box;
+        return true;
+    }
+    TRACE_(d3d_perf)("Upload ring is full, allocating %Iu bytes from the heap.\n", size);
+    ++cs->frame_ring_fallbacks;
+
     if (!(map_desc->data = malloc(size)))
     {
         WARN_(d3d_perf)("Failed to allocate a heap memory buffer.\n");
@@ -3377,6 +3507,7 @@ static void wined3d_cs_wait_event(struct wined3d_cs *cs)
 {
     static const LARGE_INTEGER query_timeout = {.QuadPart = WINED3D_CS_COMMAND_WAIT_WITH_QUERIES_TIMEOUT * -10};
     const LARGE_INTEGER *timeout = NULL;
+    LARGE_INTEGER start, end;
 
     if (!list_empty(&cs->query_poll_list))
         timeout = &query_timeout;
@@ -3395,10 +3526,45 @@ static void wined3d_cs_wait_event(struct wined3d_cs *cs)
             && InterlockedCompareExchange(&cs->waiting_for_event, FALSE, TRUE))
         return;
 
+    if (TRACE_ON(d3d_perf) || cs->perf)
+        QueryPerformanceCounter(&start);
+
     if (pNtWaitForAlertByThreadId)
         pNtWaitForAlertByThreadId(NULL, timeout);
     else
         NtWaitForSingleObject(cs->event, FALSE, timeout);
+
+    if (TRACE_ON(d3d_perf) || cs->perf)
+    {
+        QueryPerformanceCounter(&end);
+        cs->wait_time += end.QuadPart - start.QuadPart;
+        if (cs->perf)
+            cs->perf->frame.cs_idle_time += end.QuadPart - start.QuadPart;
+    }
+}
+
+static void wined3d_cs_report_stats(struct wined3d_cs *cs)
+{
+    LARGE_INTEGER freq;
+    DWORD time;
+
+    time = GetTickCount();
+    if (time - cs->stats_time < 1500)
+        return;
+
+    if (cs->exec_count)
+    {
+        QueryPerformanceFrequency(&freq);
+        TRACE_(d3d_perf)("Command stream: %u ops, average %u ns per op, busy %u ms, idle %u ms.\n",
+                cs->exec_count, (unsigned int)(cs->exec_time * 1000000000 / freq.QuadPart / cs->exec_count),
+                (unsigned int)(cs->exec_time * 1000 / freq.QuadPart),
+                (unsigned int)(cs->wait_time * 1000 / freq.QuadPart));
+    }
+
+    cs->exec_count = 0;
+    cs->exec_time = 0;
+    cs->wait_time = 0;
+    cs->stats_time = time;
 }
 
 static void wined3d_cs_command_lock(const struct wined3d_cs *cs)
@@ -3435,7 +3601,7 @@ static inline bool wined3d_cs_execute_next(struct wined3d_cs *cs, struct wined3d
         }
 
         wined3d_cs_command_lock(cs);
-        wined3d_cs_op_handlers[opcode](cs, packet->data);
+        wined3d_cs_execute_packet(cs, opcode, packet->data);
         wined3d_cs_command_unlock(cs);
         TRACE("%s at %p executed.\n", debug_cs_op(opcode), packet);
     }
@@ -3468,7 +3634,7 @@ static void wined3d_cs_exec_execute_command_list(struct wined3d_cs *cs, const vo
         if (opcode >= WINED3D_CS_OP_STOP)
             ERR("Invalid opcode %#x.\n", opcode);
         else
-            wined3d_cs_op_handlers[opcode](cs, packet->data);
+            wined3d_cs_execute_packet(cs, opcode, packet->data);
         TRACE("%s executed.\n", debug_cs_op(opcode));
     }
 }
@@ -3521,6 +3687,8 @@ static DWORD WINAPI wined3d_cs_run(void *ctx)
         spin_count = 0;
 
         run = wined3d_cs_execute_next(cs, queue);
+        if (TRACE_ON(d3d_perf))
+            wined3d_cs_report_stats(cs);
     }
 
     cs->queue[WINED3D_CS_QUEUE_MAP].tail = cs->queue[WINED3D_CS_QUEUE_MAP].head;
@@ -3581,6 +3749,8 @@ struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device,
 
     state_init(&cs->state, d3d_info, WINED3D_STATE_NO_REF | WINED3D_STATE_INIT_DEFAULT, cs->c.state->feature_level);
 
+    cs->perf = wined3d_perf_create();
+
     cs->data_size = WINED3D_INITIAL_CS_SIZE;
     if (!(cs->data = malloc(cs->data_size)))
         goto fail;
@@ -3647,6 +3817,7 @@ struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device,
     return cs;
 
 fail:
+    wined3d_perf_destroy(cs->perf);
     wined3d_state_destroy(cs->c.state);
     state_cleanup(&cs->state);
     free(cs);
@@ -3667,6 +3838,8 @@ void wined3d_cs_destroy(struct wined3d_cs *cs)
 
     wined3d_state_destroy(cs->c.state);
     state_cleanup(&cs->state);
+    wined3d_perf_destroy(cs->perf);
+    free(cs->upload_ring.data);
     free(cs->data);
     free(cs);
 }
@@ -4505,6 +4678,154 @@ void CDECL wined3d_deferred_context_destroy(struct wined3d_device_context *conte
     free(deferred);
 }
 
+struct wined3d_cs_state_key
+{
+    enum wined3d_cs_op opcode;
+    unsigned int type;
+    unsigned int start_idx;
+    unsigned int count;
+};
+
+/* Returns false for packets that do anything other than overwrite a piece of
+ * state. A packet that is followed by another one with the same key, without
+ * anything in between that could consume the state, is redundant. */
+static bool wined3d_cs_packet_get_state_key(const struct wined3d_cs_packet *packet, struct wined3d_cs_state_key *key)
+{
+    enum wined3d_cs_op opcode = *(const enum wined3d_cs_op *)packet->data;
+
+    memset(key, 0, sizeof(*key));
+    key->opcode = opcode;
+
+    switch (opcode)
+    {
+        case WINED3D_CS_OP_SET_VIEWPORTS:
+        case WINED3D_CS_OP_SET_SCISSOR_RECTS:
+        case WINED3D_CS_OP_SET_VERTEX_DECLARATION:
+        case WINED3D_CS_OP_SET_INDEX_BUFFER:
+        case WINED3D_CS_OP_SET_BLEND_STATE:
+        case WINED3D_CS_OP_SET_DEPTH_STENCIL_STATE:
+        case WINED3D_CS_OP_SET_RASTERIZER_STATE:
+            return true;
+
+        case WINED3D_CS_OP_SET_SHADER:
+        {
+            const struct wined3d_cs_set_shader *op = (const void *)packet->data;
+
+            key->type = op->type;
+            return true;
+        }
+
+        case WINED3D_CS_OP_SET_STREAM_SOURCES:
+        {
+            const struct wined3d_cs_set_stream_sources *op = (const void *)packet->data;
+
+            key->start_idx = op->start_idx;
+            key->count = op->count;
+            return true;
+        }
+
+        case WINED3D_CS_OP_SET_CONSTANT_BUFFERS:
+        {
+            const struct wined3d_cs_set_constant_buffers *op = (const void *)packet->data;
+
+            key->type = op->type;
+            key->start_idx = op->start_idx;
+            key->count = op->count;
+            return true;
+        }
+
+        case WINED3D_CS_OP_SET_SHADER_RESOURCE_VIEWS:
+        {
+            const struct wined3d_cs_set_shader_resource_views *op = (const void *)packet->data;
+
+            key->type = op->type;
+            key->start_idx = op->start_idx;
+            key->count = op->count;
+            return true;
+        }
+
+        case WINED3D_CS_OP_SET_SAMPLERS:
+        {
+            const struct wined3d_cs_set_samplers *op = (const void *)packet->data;
+
+            key->type = op->type;
+            key->start_idx = op->start_idx;
+            key->count = op->count;
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+/* Copy the recorded packets into a command list, dropping state packets that
+ * are overwritten before anything can consume them. Doing this on the
+ * recording thread means less work for the CS thread when the list is
+ * executed, possibly many times. */
+static SIZE_T wined3d_command_list_copy_packets(BYTE *dst, const BYTE *src, SIZE_T size)
+{
+    struct wined3d_cs_state_key keys[32], key;
+    const struct wined3d_cs_packet **packets;
+    SIZE_T offset, dst_size = 0, packet_size;
+    unsigned int i, j, count = 0, key_count = 0, dropped = 0;
+    bool *redundant;
+
+    if (!(packets = malloc(size / sizeof(**packets) * (sizeof(*packets) + sizeof(*redundant)))))
+    {
+        memcpy(dst, src, size);
+        return size;
+    }
+    redundant = (bool *)&packets[size / sizeof(**packets)];
+
+    offset = 0;
+    while (offset < size)
+        packets[count++] = wined3d_next_cs_packet(src, &offset, ~(SIZE_T)0);
+
+    /* Walk backwards; a state packet is redundant if a later packet in the
+     * same run of state packets has the same key. */
+    for (i = count; i--;)
+    {
+        redundant[i] = false;
+        if (!wined3d_cs_packet_get_state_key(packets[i], &key))
+        {
+            key_count = 0;
+            continue;
+        }
+
+        for (j = 0; j < key_count; ++j)
+        {
+            if (!memcmp(&keys[j], &key, sizeof(key)))
+                break;
+        }
+        if (j < key_count)
+            redundant[i] = true;
+        else if (key_count < ARRAY_SIZE(keys))
+            keys[key_count++] = key;
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        if (redundant[i])
+        {
+            wined3d_cs_packet_decref_objects(packets[i]);
+            ++dropped;
+            continue;
+        }
+
+        packet_size = offsetof(struct wined3d_cs_packet, data[packets[i]->size]);
+        memcpy(&dst[dst_size], packets[i], packet_size);
+        dst_size += packet_size;
+    }
+
+    free(packets);
+
+    if (dropped)
+        TRACE_(d3d_perf)("Dropped %u redundant state packets, %Iu bytes.\n", dropped, size - dst_size);
+
+    return dst_size;
+}
+
 HRESULT CDECL wined3d_deferred_context_record_command_list(struct wined3d_device_context *context,
         bool restore, struct wined3d_command_list **list)
 {
@@ -4559,8 +4880,7 @@ HRESULT CDECL wined3d_deferred_context_record_command_list(struct wined3d_device
     /* Transfer our references to the queries to the command list. */
 
     object->data = memory;
-    object->data_size = deferred->data_size;
-    memcpy(object->data, deferred->data, deferred->data_size);
+    object->data_size = wined3d_command_list_copy_packets(object->data, deferred->data, deferred->data_size);
 
     deferred->data_size = 0;
     deferred->resource_count = 0;
@@ -37,6 +37,7 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d_shader);
 WINE_DECLARE_DEBUG_CHANNEL(d3d);
+WINE_DECLARE_DEBUG_CHANNEL(d3d_perf);
 WINE_DECLARE_DEBUG_CHANNEL(winediag);
 
 #define WINED3D_GLSL_SAMPLE_PROJECTED   0x01
@@ -138,6 +139,13 @@ struct shader_glsl_priv
     struct wine_rb_tree ffp_vertex_shaders;
     struct wine_rb_tree ffp_fragment_shaders;
     BOOL legacy_lighting;
+
+    /* Fixed-function shader variants, generated on use or preloaded from the
+     * settings recorded in the shader cache by previous runs when the first
+     * context is created. */
+    BOOL ffp_cache_loaded;
+    unsigned int ffp_vertex_shader_count, ffp_fragment_shader_count;
+    unsigned int ffp_vertex_shader_preload_count, ffp_fragment_shader_preload_count;
 };
 
 struct glsl_vs_program
@@ -336,6 +344,8 @@ struct glsl_ffp_vertex_shader
     struct wined3d_ffp_vs_desc desc;
     GLuint id;
     struct list linked_programs;
+    unsigned int cache_age; /* age of the shader cache entry it was preloaded from */
+    BOOL used;
 };
 
 struct glsl_ffp_fragment_shader
@@ -343,6 +353,20 @@ struct glsl_ffp_fragment_shader
     struct ffp_frag_desc entry;
     GLuint id;
     struct list linked_programs;
+    unsigned int cache_age;
+    BOOL used;
+};
+
+struct glsl_ffp_vs_cache_entry
+{
+    struct wined3d_ffp_vs_settings settings;
+    unsigned int age; /* runs of the application that didn't use the shader */
+};
+
+struct glsl_ffp_fs_cache_entry
+{
+    struct ffp_frag_settings settings;
+    unsigned int age;
 };
 
 struct glsl_ffp_destroy_ctx
@@ -634,6 +658,105 @@ void shader_glsl_validate_link(const struct wined3d_gl_info *gl_info, GLuint pro
     print_glsl_info_log(gl_info, program, TRUE);
 }
 
+/* Link "program", using a cached program binary when possible. Besides the
+ * sources of the attached shaders, the caller should add anything else that
+ * affects the result of linking, like attribute and fragment data bindings or
+ * transform feedback varyings, to "key".
+ *
+ * Context activation is done by the caller. */
+static void shader_glsl_link_program(const struct wined3d_gl_info *gl_info, GLuint program,
+        struct wined3d_shader_cache_key *key)
+{
+    GLint i, shader_count, source_size = -1, length, status = GL_FALSE;
+    GLuint *shaders;
+    char *source = NULL;
+    GLenum format;
+    size_t size;
+    void *data;
+
+    if (!gl_info->supported[ARB_GET_PROGRAM_BINARY] || !wined3d_shader_cache_enabled())
+    {
+        GL_EXTCALL(glLinkProgram(program));
+        shader_glsl_validate_link(gl_info, program);
+        return;
+    }
+
+    wined3d_shader_cache_key_add_string(key, (const char *)gl_info->gl_ops.gl.p_glGetString(GL_VENDOR));
+    wined3d_shader_cache_key_add_string(key, (const char *)gl_info->gl_ops.gl.p_glGetString(GL_RENDERER));
+    wined3d_shader_cache_key_add_string(key, (const char *)gl_info->gl_ops.gl.p_glGetString(GL_VERSION));
+
+    GL_EXTCALL(glGetProgramiv(program, GL_ATTACHED_SHADERS, &shader_count));
+    if (!(shaders = calloc(shader_count, sizeof(*shaders))))
+    {
+        ERR("Failed to allocate shader array memory.\n");
+        GL_EXTCALL(glLinkProgram(program));
+        shader_glsl_validate_link(gl_info, program);
+        return;
+    }
+
+    GL_EXTCALL(glGetAttachedShaders(program, shader_count, NULL, shaders));
+    for (i = 0; i < shader_count; ++i)
+    {
+        GLint tmp;
+
+        GL_EXTCALL(glGetShaderiv(shaders[i], GL_SHADER_TYPE, &tmp));
+        wined3d_shader_cache_key_add(key, &tmp, sizeof(tmp));
+        GL_EXTCALL(glGetShaderiv(shaders[i], GL_SHADER_SOURCE_LENGTH, &tmp));
+        if (source_size < tmp)
+        {
+            free(source);
+            if (!(source = malloc(tmp)))
+            {
+                ERR("Failed to allocate %d bytes for shader source.\n", tmp);
+                free(shaders);
+                GL_EXTCALL(glLinkProgram(program));
+                shader_glsl_validate_link(gl_info, program);
+                return;
+            }
+            source_size = tmp;
+        }
+        GL_EXTCALL(glGetShaderSource(shaders[i], source_size, &tmp, source));
+        wined3d_shader_cache_key_add(key, source, tmp);
+    }
+    free(source);
+    free(shaders);
+
+    if (wined3d_shader_cache_get(key, &data, &size))
+    {
+        if (size > sizeof(format))
+        {
+            memcpy(&format, data, sizeof(format));
+            GL_EXTCALL(glProgramBinary(program, format, (BYTE *)data + sizeof(format), size - sizeof(format)));
+            GL_EXTCALL(glGetProgramiv(program, GL_LINK_STATUS, &status));
+        }
+        free(data);
+
+        if (status)
+        {
+            TRACE("Loaded program %u from the shader cache.\n", program);
+            return;
+        }
+        /* The driver may reject binaries after e.g. an update; relink from
+         * the attached shaders, and replace the cache entry below. */
+        WARN("Failed to load cached binary for program %u.\n", program);
+    }
+
+    GL_EXTCALL(glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+    GL_EXTCALL(glLinkProgram(program));
+    shader_glsl_validate_link(gl_info, program);
+
+    GL_EXTCALL(glGetProgramiv(program, GL_LINK_STATUS, &status));
+    GL_EXTCALL(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+    if (!status || length <= 0 || !(data = malloc(sizeof(format) + length)))
+        return;
+
+    GL_EXTCALL(glGetProgramBinary(program, length, &length, &format, (BYTE *)data + sizeof(format)));
+    checkGLcall("glGetProgramBinary");
+    memcpy(data, &format, sizeof(format));
+    wined3d_shader_cache_put(key, data, sizeof(format) + length);
+    free(data);
+}
+
 static BOOL shader_glsl_use_layout_qualifier(const struct wined3d_gl_info *gl_info)
 {
     /* Layout qualifiers were introduced in GLSL 1.40. The Nvidia Legacy GPU
@@ -9946,14 +10069,79 @@ static GLuint shader_glsl_generate_ffp_fragment_shader(struct shader_glsl_priv *
     return shader_id;
 }
 
-static struct glsl_ffp_vertex_shader *shader_glsl_find_ffp_vertex_shader(struct shader_glsl_priv *priv,
+/* The settings of the fixed-function shaders used by a device are stored in
+ * the shader cache when the device is destroyed, separately for each
+ * application. In later runs, the corresponding shaders are created along
+ * with the first context of the device, instead of on the draws that need
+ * them; linking the resulting programs is then mostly served by the program
+ * binary cache. Settings that aren't used for a few runs are dropped, and at most
+ * GLSL_FFP_CACHE_MAX_SHADERS of each kind are kept, most recently used first. */
+#define GLSL_FFP_CACHE_MAX_SHADERS 1024
+#define GLSL_FFP_CACHE_MAX_AGE 8
+
+/* Context activation is done by the caller. */
+static void shader_glsl_ffp_cache_key_init(struct wined3d_shader_cache_key *key, const char *tag,
+        const struct wined3d_gl_info *gl_info, size_t entry_size)
+{
+    char app_name[MAX_PATH];
+
+    if (!wined3d_get_app_name(app_name, ARRAY_SIZE(app_name)))
+        app_name[0] = 0;
+
+    wined3d_shader_cache_key_init(key, tag);
+    wined3d_shader_cache_key_add(key, &entry_size, sizeof(entry_size));
+    wined3d_shader_cache_key_add_string(key, app_name);
+    wined3d_shader_cache_key_add_string(key, (const char *)gl_info->gl_ops.gl.p_glGetString(GL_VENDOR));
+    wined3d_shader_cache_key_add_string(key, (const char *)gl_info->gl_ops.gl.p_glGetString(GL_RENDERER));
+    wined3d_shader_cache_key_add_string(key, (const char *)gl_info->gl_ops.gl.p_glGetString(GL_VERSION));
+}
+
+/* Context activation is done by the caller. */
+static void *shader_glsl_ffp_cache_load(const char *tag, const struct wined3d_gl_info *gl_info,
+        size_t entry_size, size_t *count)
+{
+    struct wined3d_shader_cache_key key;
+    size_t size;
+    void *data;
+
+    *count = 0;
+    if (!wined3d_shader_cache_enabled())
+        return NULL;
+
+    shader_glsl_ffp_cache_key_init(&key, tag, gl_info, entry_size);
+    if (!wined3d_shader_cache_get(&key, &data, &size))
+    {
+        wined3d_shader_cache_key_cleanup(&key);
+        return NULL;
+    }
+    wined3d_shader_cache_key_cleanup(&key);
+
+    if (size % entry_size)
+    {
+        WARN("Invalid %s size %Iu.\n", tag, size);
+        free(data);
+        return NULL;
+    }
+
+    *count = size / entry_size;
+    return data;
+}
+
+/* Context activation is done by the caller. */
+static void shader_glsl_ffp_cache_store(const char *tag, const struct wined3d_gl_info *gl_info,
+        const void *entries, size_t entry_size, size_t count)
+{
+    struct wined3d_shader_cache_key key;
+
+    shader_glsl_ffp_cache_key_init(&key, tag, gl_info, entry_size);
+    wined3d_shader_cache_put(&key, entries, count * entry_size);
+    wined3d_shader_cache_key_cleanup(&key);
+}
+
+static struct glsl_ffp_vertex_shader *shader_glsl_create_ffp_vertex_shader(struct shader_glsl_priv *priv,
         const struct wined3d_gl_info *gl_info, const struct wined3d_ffp_vs_settings *settings)
 {
     struct glsl_ffp_vertex_shader *shader;
-    const struct wine_rb_entry *entry;
-
-    if ((entry = wine_rb_get(&priv->ffp_vertex_shaders, settings)))
-        return WINE_RB_ENTRY_VALUE(entry, struct glsl_ffp_vertex_shader, desc.entry);
 
     if (!(shader = malloc(sizeof(*shader))))
         return NULL;
@@ -9961,20 +10149,111 @@ static struct glsl_ffp_vertex_shader *shader_glsl_find_ffp_vertex_shader(struct
     shader->desc.settings = *settings;
     shader->id = shader_glsl_generate_ffp_vertex_shader(priv, settings, gl_info);
     list_init(&shader->linked_programs);
+    shader->cache_age = 0;
+    shader->used = FALSE;
     if (wine_rb_put(&priv->ffp_vertex_shaders, &shader->desc.settings, &shader->desc.entry) == -1)
         ERR("Failed to insert ffp vertex shader.\n");
 
     return shader;
 }
 
-static struct glsl_ffp_fragment_shader *shader_glsl_find_ffp_fragment_shader(struct shader_glsl_priv *priv,
+/* Context activation is done by the caller. */
+static void shader_glsl_preload_ffp_vertex_shaders(struct shader_glsl_priv *priv,
+        const struct wined3d_gl_info *gl_info)
+{
+    struct glsl_ffp_vs_cache_entry *entries;
+    struct glsl_ffp_vertex_shader *shader;
+    size_t count, i;
+
+    if (!(entries = shader_glsl_ffp_cache_load("glsl ffp vertex settings", gl_info, sizeof(*entries), &count)))
+        return;
+
+    for (i = 0; i < count; ++i)
+    {
+        if (wine_rb_get(&priv->ffp_vertex_shaders, &entries[i].settings))
+            continue;
+        if (!(shader = shader_glsl_create_ffp_vertex_shader(priv, gl_info, &entries[i].settings)))
+            continue;
+        shader->cache_age = entries[i].age;
+        ++priv->ffp_vertex_shader_preload_count;
+    }
+    TRACE_(d3d_perf)("Preloaded %u ffp vertex shaders.\n", priv->ffp_vertex_shader_preload_count);
+
+    free(entries);
+}
+
+/* Context activation is done by the caller. */
+static void shader_glsl_store_ffp_vertex_settings(struct shader_glsl_priv *priv,
+        const struct wined3d_gl_info *gl_info)
+{
+    struct glsl_ffp_vs_cache_entry *entries = NULL;
+    struct glsl_ffp_vertex_shader *shader;
+    BOOL changed = FALSE;
+    size_t count = 0;
+
+    if (!wined3d_shader_cache_enabled()
+            || !(entries = calloc(GLSL_FFP_CACHE_MAX_SHADERS, sizeof(*entries))))
+        goto done;
+
+    /* Shaders used by this run first... */
+    RB_FOR_EACH_ENTRY(shader, &priv->ffp_vertex_shaders, struct glsl_ffp_vertex_shader, desc.entry)
+    {
+        if (!shader->used || count == GLSL_FFP_CACHE_MAX_SHADERS)
+            continue;
+        if (shader->cache_age)
+            changed = TRUE;
+        entries[count++].settings = shader->desc.settings;
+    }
+    if (priv->ffp_vertex_shader_count)
+        changed = TRUE;
+
+    /* ...then the preloaded ones it didn't use, which age out. */
+    RB_FOR_EACH_ENTRY(shader, &priv->ffp_vertex_shaders, struct glsl_ffp_vertex_shader, desc.entry)
+    {
+        if (shader->used)
+            continue;
+        changed = TRUE;
+        if (shader->cache_age >= GLSL_FFP_CACHE_MAX_AGE || count == GLSL_FFP_CACHE_MAX_SHADERS)
+            continue;
+        entries[count].settings = shader->desc.settings;
+        entries[count++].age = shader->cache_age + 1;
+    }
+
+    if (changed)
+        shader_glsl_ffp_cache_store("glsl ffp vertex settings", gl_info, entries, sizeof(*entries), count);
+
+done:
+    free(entries);
+}
+
+static struct glsl_ffp_vertex_shader *shader_glsl_find_ffp_vertex_shader(struct shader_glsl_priv *priv,
+        const struct wined3d_gl_info *gl_info, const struct wined3d_ffp_vs_settings *settings)
+{
+    struct glsl_ffp_vertex_shader *shader;
+    const struct wine_rb_entry *entry;
+
+    if ((entry = wine_rb_get(&priv->ffp_vertex_shaders, settings)))
+    {
+        shader = WINE_RB_ENTRY_VALUE(entry, struct glsl_ffp_vertex_shader, desc.entry);
+        shader->used = TRUE;
+        return shader;
+    }
+
+    if ((shader = shader_glsl_create_ffp_vertex_shader(priv, gl_info, settings)))
+    {
+        shader->used = TRUE;
+        ++priv->ffp_vertex_shader_count;
+        TRACE_(d3d_perf)("Created ffp vertex shader variant %u, %u preloaded.\n",
+                priv->ffp_vertex_shader_count, priv->ffp_vertex_shader_preload_count);
+    }
+
+    return shader;
+}
+
+static struct glsl_ffp_fragment_shader *shader_glsl_create_ffp_fragment_shader(struct shader_glsl_priv *priv,
         const struct ffp_frag_settings *args, const struct wined3d_context_gl *context_gl)
 {
     struct glsl_ffp_fragment_shader *glsl_desc;
-    const struct ffp_frag_desc *desc;
-
-    if ((desc = find_ffp_frag_shader(&priv->ffp_fragment_shaders, args)))
-        return CONTAINING_RECORD(desc, struct glsl_ffp_fragment_shader, entry);
 
     if (!(glsl_desc = malloc(sizeof(*glsl_desc))))
         return NULL;
@@ -9982,11 +10261,104 @@ static struct glsl_ffp_fragment_shader *shader_glsl_find_ffp_fragment_shader(str
     glsl_desc->entry.settings = *args;
     glsl_desc->id = shader_glsl_generate_ffp_fragment_shader(priv, args, context_gl);
     list_init(&glsl_desc->linked_programs);
+    glsl_desc->cache_age = 0;
+    glsl_desc->used = FALSE;
     add_ffp_frag_shader(&priv->ffp_fragment_shaders, &glsl_desc->entry);
 
     return glsl_desc;
 }
 
+/* Context activation is done by the caller. */
+static void shader_glsl_preload_ffp_fragment_shaders(struct shader_glsl_priv *priv,
+        const struct wined3d_context_gl *context_gl)
+{
+    struct glsl_ffp_fs_cache_entry *entries;
+    struct glsl_ffp_fragment_shader *shader;
+    size_t count, i;
+
+    if (!(entries = shader_glsl_ffp_cache_load("glsl ffp fragment settings",
+            context_gl->gl_info, sizeof(*entries), &count)))
+        return;
+
+    for (i = 0; i < count; ++i)
+    {
+        if (find_ffp_frag_shader(&priv->ffp_fragment_shaders, &entries[i].settings))
+            continue;
+        if (!(shader = shader_glsl_create_ffp_fragment_shader(priv, &entries[i].settings, context_gl)))
+            continue;
+        shader->cache_age = entries[i].age;
+        ++priv->ffp_fragment_shader_preload_count;
+    }
+    TRACE_(d3d_perf)("Preloaded %u ffp fragment shaders.\n", priv->ffp_fragment_shader_preload_count);
+
+    free(entries);
+}
+
+/* Context activation is done by the caller. */
+static void shader_glsl_store_ffp_fragment_settings(struct shader_glsl_priv *priv,
+        const struct wined3d_gl_info *gl_info)
+{
+    struct glsl_ffp_fs_cache_entry *entries = NULL;
+    struct glsl_ffp_fragment_shader *shader;
+    BOOL changed = FALSE;
+    size_t count = 0;
+
+    if (!wined3d_shader_cache_enabled()
+            || !(entries = calloc(GLSL_FFP_CACHE_MAX_SHADERS, sizeof(*entries))))
+        goto done;
+
+    RB_FOR_EACH_ENTRY(shader, &priv->ffp_fragment_shaders, struct glsl_ffp_fragment_shader, entry.entry)
+    {
+        if (!shader->used || count == GLSL_FFP_CACHE_MAX_SHADERS)
+            continue;
+        if (shader->cache_age)
+            changed = TRUE;
+        entries[count++].settings = shader->entry.settings;
+    }
+    if (priv->ffp_fragment_shader_count)
+        changed = TRUE;
+
+    RB_FOR_EACH_ENTRY(shader, &priv->ffp_fragment_shaders, struct glsl_ffp_fragment_shader, entry.entry)
+    {
+        if (shader->used)
+            continue;
+        changed = TRUE;
+        if (shader->cache_age >= GLSL_FFP_CACHE_MAX_AGE || count == GLSL_FFP_CACHE_MAX_SHADERS)
+            continue;
+        entries[count].settings = shader->entry.settings;
+        entries[count++].age = shader->cache_age + 1;
+    }
+
+    if (changed)
+        shader_glsl_ffp_cache_store("glsl ffp fragment settings", gl_info, entries, sizeof(*entries), count);
+
+done:
+    free(entries);
+}
+
+static struct glsl_ffp_fragment_shader *shader_glsl_find_ffp_fragment_shader(struct shader_glsl_priv *priv,
+        const struct ffp_frag_settings *args, const struct wined3d_context_gl *context_gl)
+{
+    struct glsl_ffp_fragment_shader *glsl_desc;
+    const struct ffp_frag_desc *desc;
+
+    if ((desc = find_ffp_frag_shader(&priv->ffp_fragment_shaders, args)))
+    {
+        glsl_desc = CONTAINING_RECORD(desc, struct glsl_ffp_fragment_shader, entry);
+        glsl_desc->used = TRUE;
+        return glsl_desc;
+    }
+
+    if ((glsl_desc = shader_glsl_create_ffp_fragment_shader(priv, args, context_gl)))
+    {
+        glsl_desc->used = TRUE;
+        ++priv->ffp_fragment_shader_count;
+        TRACE_(d3d_perf)("Created ffp fragment shader variant %u, %u preloaded.\n",
+                priv->ffp_fragment_shader_count, priv->ffp_fragment_shader_preload_count);
+    }
+
+    return glsl_desc;
+}
 
 static void shader_glsl_init_vs_uniform_locations(const struct wined3d_gl_info *gl_info,
         struct shader_glsl_priv *priv, GLuint program_id, struct glsl_vs_program *vs, unsigned int vs_c_count)
@@ -10146,6 +10518,7 @@ static HRESULT shader_glsl_compile_compute_shader(struct shader_glsl_priv *priv,
     struct wined3d_string_buffer *buffer = &priv->shader_buffer;
     struct glsl_cs_compiled_shader *gl_shaders;
     struct glsl_shader_private *shader_data;
+    struct wined3d_shader_cache_key cache_key;
     struct glsl_shader_prog_link *entry;
     GLuint shader_id, program_id;
 
@@ -10175,6 +10548,7 @@ static HRESULT shader_glsl_compile_compute_shader(struct shader_glsl_priv *priv,
     gl_shaders = shader_data->gl_shaders.cs;
 
     TRACE("Compiling compute shader %p.\n", shader);
+    wined3d_cs_count_shader_compile(context_gl->c.device->cs);
 
     string_buffer_clear(buffer);
     shader_id = shader_glsl_generate_compute_shader(context_gl, buffer, &priv->string_buffers, shader);
@@ -10202,8 +10576,9 @@ static HRESULT shader_glsl_compile_compute_shader(struct shader_glsl_priv *priv,
     list_add_head(&shader->linked_programs, &entry->cs.shader_entry);
 
     TRACE("Linking GLSL shader program %u.\n", program_id);
-    GL_EXTCALL(glLinkProgram(program_id));
-    shader_glsl_validate_link(gl_info, program_id);
+    wined3d_shader_cache_key_init(&cache_key, "glsl compute program");
+    shader_glsl_link_program(gl_info, program_id, &cache_key);
+    wined3d_shader_cache_key_cleanup(&cache_key);
 
     GL_EXTCALL(glUseProgram(program_id));
     checkGLcall("glUseProgram");
@@ -10272,9 +10647,11 @@ static void set_glsl_shader_program(const struct wined3d_context_gl *context_gl,
     const struct ps_np2fixup_info *np2fixup_info = NULL;
     struct wined3d_shader *hshader, *dshader, *gshader;
     struct glsl_shader_prog_link *entry = NULL;
+    struct wined3d_shader_cache_key cache_key;
     struct wined3d_shader *vshader = NULL;
     struct wined3d_shader *pshader = NULL;
     GLuint reorder_shader_id = 0;
+    BOOL dual_source;
     struct glsl_program_key key;
     uint32_t attribs_map;
     GLuint program_id;
@@ -10397,6 +10774,7 @@ static void set_glsl_shader_program(const struct wined3d_context_gl *context_gl,
     }
 
     /* If we get to this point, then no matching program exists, so we create one */
+    wined3d_cs_count_shader_compile(context_gl->c.device->cs);
     program_id = GL_EXTCALL(glCreateProgram());
     TRACE("Created new GLSL shader program %u.\n", program_id);
 
@@ -10450,6 +10828,9 @@ static void set_glsl_shader_program(const struct wined3d_context_gl *context_gl,
         attribs_map = (1u << WINED3D_FFP_ATTRIBS_COUNT) - 1;
     }
 
+    wined3d_shader_cache_key_init(&cache_key, "glsl program");
+    wined3d_shader_cache_key_add(&cache_key, &attribs_map, sizeof(attribs_map));
+
     if (!shader_glsl_use_explicit_attrib_location(gl_info))
     {
         /* Bind vertex attributes to a corresponding index number to match
@@ -10533,8 +10914,11 @@ static void set_glsl_shader_program(const struct wined3d_context_gl *context_gl,
 
     /* Link the program */
     TRACE("Linking GLSL shader program %u.\n", program_id);
-    GL_EXTCALL(glLinkProgram(program_id));
-    shader_glsl_validate_link(gl_info, program_id);
+    dual_source = state->blend_state && state->blend_state->dual_source;
+    wined3d_shader_cache_key_add(&cache_key, &dual_source, sizeof(dual_source));
+    wined3d_shader_cache_key_add_stream_output(&cache_key, gshader ? gshader->u.gs.so_desc : NULL);
+    shader_glsl_link_program(gl_info, program_id, &cache_key);
+    wined3d_shader_cache_key_cleanup(&cache_key);
 
     shader_glsl_init_vs_uniform_locations(gl_info, priv, program_id, &entry->vs,
             vshader ? vshader->limits->constant_float : 0);
@@ -11259,9 +11643,19 @@ static void shader_glsl_init_context_state(struct wined3d_context *context)
 {
     struct wined3d_context_gl *context_gl = wined3d_context_gl(context);
     const struct wined3d_gl_info *gl_info = context_gl->gl_info;
+    struct shader_glsl_priv *priv = context->device->shader_priv;
 
     gl_info->gl_ops.gl.p_glEnable(GL_PROGRAM_POINT_SIZE);
     checkGLcall("GL_PROGRAM_POINT_SIZE");
+
+    if (!priv->ffp_cache_loaded)
+    {
+        priv->ffp_cache_loaded = TRUE;
+        if (priv->vertex_pipe == &glsl_vertex_pipe)
+            shader_glsl_preload_ffp_vertex_shaders(priv, gl_info);
+        if (priv->fragment_pipe == &glsl_fragment_pipe)
+            shader_glsl_preload_ffp_fragment_shaders(priv, context_gl);
+    }
 }
 
 static unsigned int shader_glsl_get_shader_model(const struct wined3d_gl_info *gl_info)
@@ -11712,6 +12106,8 @@ static void glsl_vertex_pipe_vp_free(struct wined3d_device *device, struct wined
     struct shader_glsl_priv *priv = device->vertex_priv;
     struct glsl_ffp_destroy_ctx ctx;
 
+    shader_glsl_store_ffp_vertex_settings(priv, context_gl->gl_info);
+
     ctx.priv = priv;
     ctx.context_gl = context_gl;
     wine_rb_destroy(&priv->ffp_vertex_shaders, shader_glsl_free_ffp_vertex_shader, &ctx);
@@ -12231,6 +12627,8 @@ static void glsl_fragment_pipe_free(struct wined3d_device *device, struct wined3
     struct shader_glsl_priv *priv = device->fragment_priv;
     struct glsl_ffp_destroy_ctx ctx;
 
+    shader_glsl_store_ffp_fragment_settings(priv, context_gl->gl_info);
+
     ctx.priv = priv;
     ctx.context_gl = context_gl;
     wine_rb_destroy(&priv->ffp_fragment_shaders, shader_glsl_free_ffp_fragment_shader, &ctx);
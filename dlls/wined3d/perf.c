@@ -0,0 +1,152 @@
+/*
+ * Performance counters
+ *
+ * Copyright (C) the Wine project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include <stdio.h>
+
+#include "wined3d_private.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(d3d_perf);
+
+/* The counters file starts with a struct wined3d_perf_header, followed by
+ * "frame_capacity" struct wined3d_perf_frame records, and is updated in
+ * place through a shared mapping. The record for frame "n" is stored at
+ * index "n % frame_capacity"; "frame_count" is updated after the record has
+ * been written, so readers should read "frame_count" first, and discard the
+ * oldest record in case the writer has caught up with them. */
+#define WINED3D_PERF_MAGIC          0x50443357u /* "W3DP" */
+#define WINED3D_PERF_VERSION        1
+#define WINED3D_PERF_FRAME_CAPACITY 1024
+
+struct wined3d_perf_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t frame_size;
+    uint32_t frame_capacity;
+    uint64_t timestamp_frequency;
+    uint64_t frame_count;
+    uint32_t process_id;
+    uint32_t padding;
+    struct wined3d_perf_frame frames[1];
+};
+
+static LONG wined3d_perf_device_count;
+
+struct wined3d_perf *wined3d_perf_create(void)
+{
+    struct wined3d_perf_header *header;
+    HANDLE file, mapping;
+    struct wined3d_perf *perf;
+    LARGE_INTEGER frequency;
+    WCHAR path[MAX_PATH];
+    size_t size;
+    int len;
+
+    if (!wined3d_settings.perf_counters_path)
+        return NULL;
+
+    if (!(len = MultiByteToWideChar(CP_ACP, 0, wined3d_settings.perf_counters_path, -1, path, ARRAY_SIZE(path))))
+    {
+        ERR("Invalid performance counters path %s.\n", debugstr_a(wined3d_settings.perf_counters_path));
+        return NULL;
+    }
+    while (len > 1 && (path[len - 2] == '\\' || path[len - 2] == '/'))
+        path[--len - 1] = 0;
+    swprintf(&path[len - 1], ARRAY_SIZE(path) - (len - 1), L"\\wined3d-%lu-%ld.perf",
+            GetCurrentProcessId(), InterlockedIncrement(&wined3d_perf_device_count));
+
+    size = offsetof(struct wined3d_perf_header, frames[WINED3D_PERF_FRAME_CAPACITY]);
+    if ((file = CreateFileW(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL)) == INVALID_HANDLE_VALUE)
+    {
+        ERR("Failed to create performance counters file %s, error %lu.\n", debugstr_w(path), GetLastError());
+        return NULL;
+    }
+
+    if (!(mapping = CreateFileMappingW(file, NULL, PAGE_READWRITE, 0, size, NULL)))
+    {
+        ERR("Failed to create file mapping, error %lu.\n", GetLastError());
+        CloseHandle(file);
+        return NULL;
+    }
+
+    if (!(header = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size)))
+    {
+        ERR("Failed to map performance counters file, error %lu.\n", GetLastError());
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return NULL;
+    }
+
+    if (!(perf = calloc(1, sizeof(*perf))))
+    {
+        UnmapViewOfFile(header);
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return NULL;
+    }
+
+    QueryPerformanceFrequency(&frequency);
+    header->version = WINED3D_PERF_VERSION;
+    header->frame_size = sizeof(struct wined3d_perf_frame);
+    header->frame_capacity = WINED3D_PERF_FRAME_CAPACITY;
+    header->timestamp_frequency = frequency.QuadPart;
+    header->frame_count = 0;
+    header->process_id = GetCurrentProcessId();
+    InterlockedExchange((LONG *)&header->magic, WINED3D_PERF_MAGIC);
+
+    perf->file = file;
+    perf->mapping = mapping;
+    perf->header = header;
+
+    TRACE("Writing performance counters to %s.\n", debugstr_w(path));
+
+    return perf;
+}
+
+void wined3d_perf_destroy(struct wined3d_perf *perf)
+{
+    if (!perf)
+        return;
+
+    UnmapViewOfFile(perf->header);
+    CloseHandle(perf->mapping);
+    CloseHandle(perf->file);
+    free(perf);
+}
+
+/* Called from the CS thread when a frame is presented. */
+void wined3d_perf_end_frame(struct wined3d_perf *perf, unsigned int cs_queue_bytes, unsigned int map_stall_count)
+{
+    struct wined3d_perf_header *header = perf->header;
+    struct wined3d_perf_frame *frame = &perf->frame;
+    LARGE_INTEGER time;
+
+    QueryPerformanceCounter(&time);
+    frame->index = perf->frame_count;
+    frame->timestamp = time.QuadPart;
+    frame->cs_queue_bytes = cs_queue_bytes;
+    frame->map_stall_count = map_stall_count;
+
+    header->frames[perf->frame_count % WINED3D_PERF_FRAME_CAPACITY] = *frame;
+    InterlockedExchange64((LONG64 *)&header->frame_count, ++perf->frame_count);
+
+    memset(frame, 0, sizeof(*frame));
+}
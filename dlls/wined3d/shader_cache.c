@@ -0,0 +1,454 @@
+/*
+ * Persistent shader cache
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "wined3d_private.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(d3d_shader);
+
+/* Entries are stored one per file, named after a hash of the key. The full
+ * key follows the header, and is compared on lookup, so that collisions on
+ * the file name are detected. Bump the version whenever the format of the
+ * entries, or the way any of the backends build their keys, changes. */
+#define WINED3D_SHADER_CACHE_MAGIC   0x43533357u /* "W3SC" */
+#define WINED3D_SHADER_CACHE_VERSION 2
+
+/* Temporary files older than this were left behind by a process that didn't
+ * finish writing them; in 100ns units. */
+#define WINED3D_SHADER_CACHE_STALE_TMP_AGE (60 * 60 * (uint64_t)10000000)
+
+struct wined3d_shader_cache_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key_size;
+    uint64_t data_size;
+};
+
+struct wined3d_shader_cache_file
+{
+    FILETIME time;
+    uint64_t size;
+    WCHAR name[MAX_PATH];
+};
+
+static struct
+{
+    BOOL initialised;
+    WCHAR *path;
+    uint64_t size, max_size;
+    unsigned int tmp_idx;
+
+    unsigned int hits, misses, stores, evictions;
+} shader_cache;
+
+static CRITICAL_SECTION shader_cache_cs;
+static CRITICAL_SECTION_DEBUG shader_cache_cs_debug =
+{
+    0, 0, &shader_cache_cs,
+    {&shader_cache_cs_debug.ProcessLocksList,
+    &shader_cache_cs_debug.ProcessLocksList},
+    0, 0, {(DWORD_PTR)(__FILE__ ": shader_cache_cs")}
+};
+static CRITICAL_SECTION shader_cache_cs = {&shader_cache_cs_debug, -1, 0, 0, 0, 0};
+
+void wined3d_shader_cache_key_init(struct wined3d_shader_cache_key *key, const char *tag)
+{
+    key->hash = 0xcbf29ce484222325ull;
+    key->data = NULL;
+    key->size = key->capacity = 0;
+    key->failed = false;
+    wined3d_shader_cache_key_add_string(key, tag);
+}
+
+void wined3d_shader_cache_key_cleanup(struct wined3d_shader_cache_key *key)
+{
+    free(key->data);
+    key->data = NULL;
+    key->size = key->capacity = 0;
+}
+
+void wined3d_shader_cache_key_add(struct wined3d_shader_cache_key *key, const void *data, size_t size)
+{
+    const uint8_t *ptr = data;
+    uint64_t h = key->hash;
+    size_t i;
+
+    if (key->failed || !size)
+        return;
+
+    if (!wined3d_array_reserve((void **)&key->data, &key->capacity, key->size + size, 1))
+    {
+        ERR("Failed to allocate shader cache key memory.\n");
+        key->failed = true;
+        return;
+    }
+    memcpy(key->data + key->size, data, size);
+    key->size += size;
+
+    /* FNV-1a */
+    for (i = 0; i < size; ++i)
+        h = (h ^ ptr[i]) * 0x100000001b3ull;
+    key->hash = h;
+}
+
+void wined3d_shader_cache_key_add_string(struct wined3d_shader_cache_key *key, const char *str)
+{
+    if (!str)
+        str = "";
+    wined3d_shader_cache_key_add(key, str, strlen(str) + 1);
+}
+
+void wined3d_shader_cache_key_add_stream_output(struct wined3d_shader_cache_key *key,
+        const struct wined3d_stream_output_desc *desc)
+{
+    unsigned int i;
+
+    if (!desc)
+    {
+        wined3d_shader_cache_key_add(key, &desc, sizeof(desc));
+        return;
+    }
+
+    wined3d_shader_cache_key_add(key, &desc->element_count, sizeof(desc->element_count));
+    for (i = 0; i < desc->element_count; ++i)
+    {
+        const struct wined3d_stream_output_element *e = &desc->elements[i];
+
+        wined3d_shader_cache_key_add(key, &e->stream_idx, sizeof(e->stream_idx));
+        wined3d_shader_cache_key_add_string(key, e->semantic_name);
+        wined3d_shader_cache_key_add(key, &e->semantic_idx, sizeof(e->semantic_idx));
+        wined3d_shader_cache_key_add(key, &e->component_idx, sizeof(e->component_idx));
+        wined3d_shader_cache_key_add(key, &e->component_count, sizeof(e->component_count));
+        wined3d_shader_cache_key_add(key, &e->output_slot, sizeof(e->output_slot));
+    }
+    wined3d_shader_cache_key_add(key, desc->buffer_strides,
+            desc->buffer_stride_count * sizeof(*desc->buffer_strides));
+    wined3d_shader_cache_key_add(key, &desc->rasterizer_stream_idx, sizeof(desc->rasterizer_stream_idx));
+}
+
+static BOOL shader_cache_create_directory(WCHAR *path)
+{
+    WCHAR *p, c;
+
+    if (CreateDirectoryW(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS)
+        return TRUE;
+
+    for (p = path; *p; ++p)
+    {
+        if (p == path || (*p != '\\' && *p != '/') || p[-1] == ':')
+            continue;
+        c = *p;
+        *p = 0;
+        CreateDirectoryW(path, NULL);
+        *p = c;
+    }
+
+    return CreateDirectoryW(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+static void shader_cache_get_file_name(WCHAR *name, size_t size, const struct wined3d_shader_cache_key *key)
+{
+    swprintf(name, size, L"%s\\%08x%08x.bin", shader_cache.path,
+            (unsigned int)(key->hash >> 32), (unsigned int)key->hash);
+}
+
+static int __cdecl shader_cache_file_compare(const void *a, const void *b)
+{
+    const struct wined3d_shader_cache_file *f1 = a, *f2 = b;
+
+    return CompareFileTime(&f1->time, &f2->time);
+}
+
+/* Scan the cache directory, and evict the least recently used entries until
+ * the size of the cache is below "target_size". */
+static void shader_cache_scan(uint64_t target_size)
+{
+    struct wined3d_shader_cache_file *files = NULL;
+    SIZE_T files_size = 0, file_count = 0, i;
+    WIN32_FIND_DATAW find_data;
+    WCHAR pattern[MAX_PATH];
+    uint64_t size = 0;
+    HANDLE find;
+
+    swprintf(pattern, ARRAY_SIZE(pattern), L"%s\\*.bin", shader_cache.path);
+    if ((find = FindFirstFileW(pattern, &find_data)) != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            struct wined3d_shader_cache_file *file;
+
+            if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                continue;
+            if (!wined3d_array_reserve((void **)&files, &files_size, file_count + 1, sizeof(*files)))
+                break;
+
+            file = &files[file_count++];
+            file->time = find_data.ftLastWriteTime;
+            file->size = ((uint64_t)find_data.nFileSizeHigh << 32) | find_data.nFileSizeLow;
+            swprintf(file->name, ARRAY_SIZE(file->name), L"%s\\%s", shader_cache.path, find_data.cFileName);
+            size += file->size;
+        } while (FindNextFileW(find, &find_data));
+        FindClose(find);
+    }
+
+    if (size > target_size)
+    {
+        qsort(files, file_count, sizeof(*files), shader_cache_file_compare);
+        for (i = 0; i < file_count && size > target_size; ++i)
+        {
+            if (!DeleteFileW(files[i].name))
+                continue;
+            size -= files[i].size;
+            ++shader_cache.evictions;
+        }
+    }
+
+    TRACE("Shader cache size %s bytes, %Iu entries.\n", wine_dbgstr_longlong(size), file_count);
+
+    shader_cache.size = size;
+    free(files);
+}
+
+/* Remove temporary files left behind by processes that exited while storing
+ * an entry. Recent ones may still be in use by another process. */
+static void shader_cache_remove_stale_files(void)
+{
+    WIN32_FIND_DATAW find_data;
+    WCHAR name[MAX_PATH];
+    ULARGE_INTEGER now, time;
+    FILETIME ft;
+    HANDLE find;
+
+    GetSystemTimeAsFileTime(&ft);
+    now.LowPart = ft.dwLowDateTime;
+    now.HighPart = ft.dwHighDateTime;
+
+    swprintf(name, ARRAY_SIZE(name), L"%s\\*.tmp", shader_cache.path);
+    if ((find = FindFirstFileW(name, &find_data)) == INVALID_HANDLE_VALUE)
+        return;
+    do
+    {
+        time.LowPart = find_data.ftLastWriteTime.dwLowDateTime;
+        time.HighPart = find_data.ftLastWriteTime.dwHighDateTime;
+        if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                || time.QuadPart + WINED3D_SHADER_CACHE_STALE_TMP_AGE > now.QuadPart)
+            continue;
+        swprintf(name, ARRAY_SIZE(name), L"%s\\%s", shader_cache.path, find_data.cFileName);
+        TRACE("Removing stale temporary file %s.\n", debugstr_w(name));
+        DeleteFileW(name);
+    } while (FindNextFileW(find, &find_data));
+    FindClose(find);
+}
+
+/* The cache lock must be held by the caller. */
+static BOOL shader_cache_init(void)
+{
+    int len;
+
+    if (shader_cache.initialised)
+        return !!shader_cache.path;
+    shader_cache.initialised = TRUE;
+
+    if (!wined3d_settings.shader_cache_path || !wined3d_settings.shader_cache_size)
+        return FALSE;
+
+    if (!(len = MultiByteToWideChar(CP_ACP, 0, wined3d_settings.shader_cache_path, -1, NULL, 0))
+            || !(shader_cache.path = malloc(len * sizeof(WCHAR))))
+        return FALSE;
+    MultiByteToWideChar(CP_ACP, 0, wined3d_settings.shader_cache_path, -1, shader_cache.path, len);
+    while (len > 1 && (shader_cache.path[len - 2] == '\\' || shader_cache.path[len - 2] == '/'))
+        shader_cache.path[--len - 1] = 0;
+
+    if (!shader_cache_create_directory(shader_cache.path))
+    {
+        ERR("Failed to create shader cache directory %s, error %lu.\n",
+                debugstr_w(shader_cache.path), GetLastError());
+        free(shader_cache.path);
+        shader_cache.path = NULL;
+        return FALSE;
+    }
+
+    shader_cache.max_size = (uint64_t)wined3d_settings.shader_cache_size * 1024 * 1024;
+    shader_cache_remove_stale_files();
+    shader_cache_scan(shader_cache.max_size);
+    TRACE("Using shader cache %s, maximum size %s bytes.\n",
+            debugstr_w(shader_cache.path), wine_dbgstr_longlong(shader_cache.max_size));
+
+    return TRUE;
+}
+
+BOOL wined3d_shader_cache_enabled(void)
+{
+    BOOL ret;
+
+    EnterCriticalSection(&shader_cache_cs);
+    ret = shader_cache_init();
+    LeaveCriticalSection(&shader_cache_cs);
+
+    return ret;
+}
+
+/* On success, the returned data should be freed with free(). */
+BOOL wined3d_shader_cache_get(const struct wined3d_shader_cache_key *key, void **data, size_t *size)
+{
+    struct wined3d_shader_cache_header header;
+    uint8_t *stored_key = NULL;
+    WCHAR name[MAX_PATH];
+    LARGE_INTEGER file_size;
+    FILETIME now;
+    HANDLE file;
+    DWORD count;
+    BOOL valid;
+
+    if (key->failed)
+        return FALSE;
+
+    EnterCriticalSection(&shader_cache_cs);
+
+    if (!shader_cache_init())
+    {
+        LeaveCriticalSection(&shader_cache_cs);
+        return FALSE;
+    }
+
+    shader_cache_get_file_name(name, ARRAY_SIZE(name), key);
+    if ((file = CreateFileW(name, GENERIC_READ | FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_DELETE,
+            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL)) == INVALID_HANDLE_VALUE)
+    {
+        ++shader_cache.misses;
+        LeaveCriticalSection(&shader_cache_cs);
+        return FALSE;
+    }
+
+    valid = GetFileSizeEx(file, &file_size)
+            && ReadFile(file, &header, sizeof(header), &count, NULL) && count == sizeof(header)
+            && header.magic == WINED3D_SHADER_CACHE_MAGIC
+            && header.version == WINED3D_SHADER_CACHE_VERSION
+            && header.key_size == key->size
+            && header.data_size <= ~(DWORD)0
+            && (uint64_t)file_size.QuadPart == sizeof(header) + header.key_size + header.data_size
+            && (stored_key = malloc(key->size))
+            && ReadFile(file, stored_key, key->size, &count, NULL) && count == key->size
+            && !memcmp(stored_key, key->data, key->size);
+    free(stored_key);
+
+    *data = NULL;
+    if (valid && (*data = malloc(header.data_size)))
+    {
+        valid = ReadFile(file, *data, header.data_size, &count, NULL) && count == header.data_size;
+        *size = header.data_size;
+    }
+
+    if (valid && *data)
+    {
+        /* Keep recently used entries from being evicted. */
+        GetSystemTimeAsFileTime(&now);
+        SetFileTime(file, NULL, NULL, &now);
+    }
+    CloseHandle(file);
+
+    if (!valid)
+    {
+        WARN("Discarding invalid or stale shader cache entry %s.\n", debugstr_w(name));
+        DeleteFileW(name);
+        free(*data);
+        *data = NULL;
+    }
+
+    if (*data)
+        ++shader_cache.hits;
+    else
+        ++shader_cache.misses;
+
+    LeaveCriticalSection(&shader_cache_cs);
+
+    return !!*data;
+}
+
+void wined3d_shader_cache_put(const struct wined3d_shader_cache_key *key, const void *data, size_t size)
+{
+    struct wined3d_shader_cache_header header;
+    WCHAR name[MAX_PATH], tmp_name[MAX_PATH];
+    uint64_t entry_size;
+    HANDLE file;
+    DWORD count;
+    BOOL ret;
+
+    if (key->failed)
+        return;
+
+    EnterCriticalSection(&shader_cache_cs);
+
+    entry_size = sizeof(header) + key->size + size;
+    if (!shader_cache_init() || size > ~(DWORD)0 || entry_size > shader_cache.max_size)
+    {
+        LeaveCriticalSection(&shader_cache_cs);
+        return;
+    }
+
+    header.magic = WINED3D_SHADER_CACHE_MAGIC;
+    header.version = WINED3D_SHADER_CACHE_VERSION;
+    header.key_size = key->size;
+    header.data_size = size;
+
+    /* Other processes may be using the same cache; write the entry to a
+     * temporary file first, and then move it into place. */
+    shader_cache_get_file_name(name, ARRAY_SIZE(name), key);
+    swprintf(tmp_name, ARRAY_SIZE(tmp_name), L"%s\\%08lx-%08lx-%08x.tmp", shader_cache.path,
+            GetCurrentProcessId(), GetCurrentThreadId(), shader_cache.tmp_idx++);
+    if ((file = CreateFileW(tmp_name, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL, NULL)) == INVALID_HANDLE_VALUE)
+    {
+        WARN("Failed to create shader cache entry %s, error %lu.\n", debugstr_w(tmp_name), GetLastError());
+        LeaveCriticalSection(&shader_cache_cs);
+        return;
+    }
+
+    ret = WriteFile(file, &header, sizeof(header), &count, NULL) && count == sizeof(header)
+            && WriteFile(file, key->data, key->size, &count, NULL) && count == key->size
+            && WriteFile(file, data, size, &count, NULL) && count == size;
+    CloseHandle(file);
+
+    if (!ret || !MoveFileExW(tmp_name, name, MOVEFILE_REPLACE_EXISTING))
+    {
+        WARN("Failed to write shader cache entry %s, error %lu.\n", debugstr_w(name), GetLastError());
+        DeleteFileW(tmp_name);
+        LeaveCriticalSection(&shader_cache_cs);
+        return;
+    }
+
+    ++shader_cache.stores;
+    if ((shader_cache.size += entry_size) > shader_cache.max_size)
+        shader_cache_scan(shader_cache.max_size / 4 * 3);
+
+    LeaveCriticalSection(&shader_cache_cs);
+}
+
+void wined3d_shader_cache_cleanup(void)
+{
+    if (shader_cache.path)
+        TRACE("Shader cache statistics: %u hits, %u misses, %u stores, %u evictions.\n",
+                shader_cache.hits, shader_cache.misses, shader_cache.stores, shader_cache.evictions);
+
+    free(shader_cache.path);
+    memset(&shader_cache, 0, sizeof(shader_cache));
+    DeleteCriticalSection(&shader_cache_cs);
+}
@@ -21,6 +21,7 @@
 #include "wined3d_vk.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d_shader);
+WINE_DECLARE_DEBUG_CHANNEL(d3d_perf);
 
 static const struct wined3d_shader_backend_ops spirv_shader_backend_vk;
 
@@ -51,6 +52,9 @@ struct shader_spirv_priv
     const struct wined3d_fragment_pipe_ops *fragment_pipe;
 
     struct shader_spirv_resource_bindings bindings;
+
+    unsigned int async_compile_count;
+    unsigned int skipped_draw_count;
 };
 
 #define MAX_SM1_INTER_STAGE_VARYINGS 12
@@ -80,6 +84,7 @@ struct shader_spirv_graphics_program_variant_vk
     size_t binding_base;
 
     VkShaderModule vk_module;
+    struct shader_spirv_compile_job *job;
 };
 
 struct shader_spirv_graphics_program_vk
@@ -116,6 +121,22 @@ struct wined3d_shader_spirv_shader_interface
     struct vkd3d_shader_transform_feedback_info xfb_info;
 };
 
+/* A graphics program variant being compiled on a thread pool thread. The job
+ * only references the shader byte code; everything else is copied, and the
+ * shader waits for outstanding jobs before it is destroyed. */
+struct shader_spirv_compile_job
+{
+    struct wined3d_device_vk *device_vk;
+    struct wined3d_shader_desc shader_desc;
+    enum vkd3d_shader_source_type source_type;
+    enum wined3d_shader_type shader_type;
+    struct shader_spirv_compile_arguments args;
+    struct shader_spirv_resource_bindings bindings;
+
+    HANDLE event;
+    VkShaderModule vk_module;
+};
+
 static enum vkd3d_shader_visibility vkd3d_shader_visibility_from_wined3d(enum wined3d_shader_type shader_type)
 {
     switch (shader_type)
@@ -274,18 +295,40 @@ static void shader_spirv_init_shader_interface_vk(struct wined3d_shader_spirv_sh
     iface->vkd3d_interface.uav_counter_count = b->uav_counter_count;
 }
 
-static VkShaderModule shader_spirv_compile_shader(struct wined3d_context_vk *context_vk,
+static void shader_spirv_init_cache_key(struct wined3d_shader_cache_key *key,
+        const struct wined3d_shader_desc *shader_desc, enum vkd3d_shader_source_type source_type,
+        enum wined3d_shader_type shader_type, const struct shader_spirv_compile_arguments *args,
+        const struct shader_spirv_resource_bindings *bindings, const struct wined3d_stream_output_desc *so_desc,
+        const struct wined3d_shader_spirv_compile_args *compile_args)
+{
+    wined3d_shader_cache_key_init(key, "spirv");
+    wined3d_shader_cache_key_add_string(key, vkd3d_shader_get_version(NULL, NULL));
+    wined3d_shader_cache_key_add(key, spirv_compile_options, sizeof(spirv_compile_options));
+    wined3d_shader_cache_key_add(key, &source_type, sizeof(source_type));
+    wined3d_shader_cache_key_add(key, &shader_type, sizeof(shader_type));
+    wined3d_shader_cache_key_add(key, shader_desc->byte_code, shader_desc->byte_code_size);
+    wined3d_shader_cache_key_add(key, args, sizeof(*args));
+    wined3d_shader_cache_key_add(key, compile_args->extensions,
+            compile_args->spirv_target.extension_count * sizeof(*compile_args->extensions));
+    wined3d_shader_cache_key_add(key, bindings->bindings, bindings->binding_count * sizeof(*bindings->bindings));
+    wined3d_shader_cache_key_add(key, bindings->uav_counters,
+            bindings->uav_counter_count * sizeof(*bindings->uav_counters));
+    wined3d_shader_cache_key_add_stream_output(key, so_desc);
+}
+
+static VkShaderModule shader_spirv_compile_shader(struct wined3d_device_vk *device_vk,
         const struct wined3d_shader_desc *shader_desc, enum vkd3d_shader_source_type source_type,
         enum wined3d_shader_type shader_type, const struct shader_spirv_compile_arguments *args,
         const struct shader_spirv_resource_bindings *bindings, const struct wined3d_stream_output_desc *so_desc)
 {
-    struct wined3d_device_vk *device_vk = wined3d_device_vk(context_vk->c.device);
     const struct wined3d_vk_info *vk_info = &device_vk->vk_info;
     struct wined3d_shader_spirv_compile_args compile_args;
     struct wined3d_shader_spirv_shader_interface iface;
+    struct wined3d_shader_cache_key cache_key;
     VkShaderModuleCreateInfo shader_create_info;
     struct vkd3d_shader_compile_info info;
     struct vkd3d_shader_code spirv;
+    bool use_cache, cached = false;
     VkShaderModule module;
     char *messages;
     VkResult vr;
@@ -295,6 +338,24 @@ static VkShaderModule shader_spirv_compile_shader(struct wined3d_context_vk *con
     shader_spirv_init_compile_args(vk_info, &compile_args, &iface.vkd3d_interface,
             VKD3D_SHADER_SPIRV_ENVIRONMENT_VULKAN_1_0, shader_type, source_type, args);
 
+    if ((use_cache = wined3d_shader_cache_enabled()))
+    {
+        void *data;
+        size_t size;
+
+        shader_spirv_init_cache_key(&cache_key, shader_desc, source_type, shader_type,
+                args, bindings, so_desc, &compile_args);
+        if (wined3d_shader_cache_get(&cache_key, &data, &size))
+        {
+            TRACE("Using cached SPIR-V for %s shader.\n", debug_shader_type(shader_type));
+            wined3d_shader_cache_key_cleanup(&cache_key);
+            spirv.code = data;
+            spirv.size = size;
+            cached = true;
+            goto create_module;
+        }
+    }
+
     info.type = VKD3D_SHADER_STRUCTURE_TYPE_COMPILE_INFO;
     info.next = &compile_args.spirv_target;
     info.source.code = shader_desc->byte_code;
@@ -325,26 +386,117 @@ static VkShaderModule shader_spirv_compile_shader(struct wined3d_context_vk *con
     if (ret < 0)
     {
         ERR("Failed to compile shader, ret %d.\n", ret);
+        if (use_cache)
+            wined3d_shader_cache_key_cleanup(&cache_key);
         return VK_NULL_HANDLE;
     }
 
+    if (use_cache)
+    {
+        wined3d_shader_cache_put(&cache_key, spirv.code, spirv.size);
+        wined3d_shader_cache_key_cleanup(&cache_key);
+    }
+
+create_module:
     shader_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     shader_create_info.pNext = NULL;
     shader_create_info.flags = 0;
     shader_create_info.codeSize = spirv.size;
     shader_create_info.pCode = spirv.code;
-    if ((vr = VK_CALL(vkCreateShaderModule(device_vk->vk_device, &shader_create_info, NULL, &module))) < 0)
-    {
+    vr = VK_CALL(vkCreateShaderModule(device_vk->vk_device, &shader_create_info, NULL, &module));
+    if (cached)
+        free((void *)spirv.code);
+    else
         vkd3d_shader_free_shader_code(&spirv);
+    if (vr < 0)
+    {
         WARN("Failed to create Vulkan shader module, vr %s.\n", wined3d_debug_vkresult(vr));
         return VK_NULL_HANDLE;
     }
 
-    vkd3d_shader_free_shader_code(&spirv);
-
     return module;
 }
 
+static void CALLBACK shader_spirv_compile_job_proc(TP_CALLBACK_INSTANCE *instance, void *ctx)
+{
+    struct shader_spirv_compile_job *job = ctx;
+
+    job->vk_module = shader_spirv_compile_shader(job->device_vk, &job->shader_desc,
+            job->source_type, job->shader_type, &job->args, &job->bindings, NULL);
+    SetEventWhenCallbackReturns(instance, job->event);
+}
+
+static void shader_spirv_compile_job_destroy(struct shader_spirv_compile_job *job)
+{
+    CloseHandle(job->event);
+    free(job->bindings.bindings);
+    free(job);
+}
+
+static struct shader_spirv_compile_job *shader_spirv_compile_job_create(struct wined3d_device_vk *device_vk,
+        const struct wined3d_shader_desc *shader_desc, enum vkd3d_shader_source_type source_type,
+        enum wined3d_shader_type shader_type, const struct shader_spirv_compile_arguments *args,
+        const struct shader_spirv_resource_bindings *bindings)
+{
+    struct shader_spirv_compile_job *job;
+
+    if (!(job = calloc(1, sizeof(*job))))
+        return NULL;
+
+    job->device_vk = device_vk;
+    job->shader_desc = *shader_desc;
+    job->source_type = source_type;
+    job->shader_type = shader_type;
+    job->args = *args;
+
+    if (!(job->bindings.bindings = malloc(bindings->binding_count * sizeof(*bindings->bindings) + 1)))
+    {
+        free(job);
+        return NULL;
+    }
+    memcpy(job->bindings.bindings, bindings->bindings, bindings->binding_count * sizeof(*bindings->bindings));
+    job->bindings.binding_count = bindings->binding_count;
+    memcpy(job->bindings.uav_counters, bindings->uav_counters,
+            bindings->uav_counter_count * sizeof(*bindings->uav_counters));
+    job->bindings.uav_counter_count = bindings->uav_counter_count;
+
+    if (!(job->event = CreateEventW(NULL, TRUE, FALSE, NULL)))
+    {
+        free(job->bindings.bindings);
+        free(job);
+        return NULL;
+    }
+
+    if (!TrySubmitThreadpoolCallback(shader_spirv_compile_job_proc, job, NULL))
+    {
+        ERR("Failed to submit compile job, error %lu.\n", GetLastError());
+        shader_spirv_compile_job_destroy(job);
+        return NULL;
+    }
+
+    return job;
+}
+
+/* Returns false if the variant is still being compiled after waiting for at
+ * most "timeout" milliseconds. */
+static bool shader_spirv_graphics_program_variant_wait(struct shader_spirv_graphics_program_variant_vk *variant_vk,
+        DWORD timeout)
+{
+    struct shader_spirv_compile_job *job;
+
+    if (!(job = variant_vk->job))
+        return true;
+
+    if (WaitForSingleObject(job->event, timeout) == WAIT_TIMEOUT)
+        return false;
+
+    variant_vk->vk_module = job->vk_module;
+    variant_vk->job = NULL;
+    shader_spirv_compile_job_destroy(job);
+
+    return true;
+}
+
 static struct shader_spirv_graphics_program_variant_vk *shader_spirv_find_graphics_program_variant_vk(
         struct shader_spirv_priv *priv, struct wined3d_context_vk *context_vk, struct wined3d_shader *shader,
         const struct wined3d_state *state, const struct shader_spirv_resource_bindings *bindings)
@@ -380,7 +532,12 @@ static struct shader_spirv_graphics_program_variant_vk *shader_spirv_find_graphi
 
     variant_vk = &program_vk->variants[variant_count];
     variant_vk->compile_args = args;
+    variant_vk->so_desc = so_desc;
     variant_vk->binding_base = binding_base;
+    variant_vk->vk_module = VK_NULL_HANDLE;
+    variant_vk->job = NULL;
+
+    wined3d_cs_count_shader_compile(context_vk->c.device->cs);
 
     if (shader->source_type == VKD3D_SHADER_SOURCE_D3D_BYTECODE)
     {
@@ -393,8 +550,20 @@ static struct shader_spirv_graphics_program_variant_vk *shader_spirv_find_graphi
         shader_desc.byte_code_size = shader->byte_code_size;
     }
 
-    if (!(variant_vk->vk_module = shader_spirv_compile_shader(context_vk, &shader_desc,
-            shader->source_type, shader_type, &args, bindings, so_desc)))
+    /* Stream output variants reference the geometry shader's stream output
+     * description, which isn't copied; compile those synchronously. */
+    if (wined3d_settings.async_shader_compile && !so_desc
+            && (variant_vk->job = shader_spirv_compile_job_create(wined3d_device_vk(context_vk->c.device),
+            &shader_desc, shader->source_type, shader_type, &args, bindings)))
+    {
+        TRACE("Compiling %s shader %p variant asynchronously.\n", debug_shader_type(shader_type), shader);
+        ++priv->async_compile_count;
+        ++program_vk->variant_count;
+        return variant_vk;
+    }
+
+    if (!(variant_vk->vk_module = shader_spirv_compile_shader(wined3d_device_vk(context_vk->c.device),
+            &shader_desc, shader->source_type, shader_type, &args, bindings, so_desc)))
         return NULL;
     ++program_vk->variant_count;
 
@@ -422,7 +591,8 @@ static struct shader_spirv_compute_program_vk *shader_spirv_find_compute_program
     shader_desc.byte_code = shader->byte_code;
     shader_desc.byte_code_size = shader->byte_code_size;
 
-    if (!(program->vk_module = shader_spirv_compile_shader(context_vk, &shader_desc,
+    wined3d_cs_count_shader_compile(device_vk->d.cs);
+    if (!(program->vk_module = shader_spirv_compile_shader(device_vk, &shader_desc,
             shader->source_type, WINED3D_SHADER_TYPE_COMPUTE, NULL, bindings, NULL)))
         return NULL;
 
@@ -865,6 +1035,18 @@ static void shader_spirv_apply_draw_state(void *shader_priv, struct wined3d_cont
 
         if (!(variant_vk = shader_spirv_find_graphics_program_variant_vk(priv, context_vk, shader, state, bindings)))
             goto fail;
+        if (!shader_spirv_graphics_program_variant_wait(variant_vk, wined3d_settings.async_shader_wait))
+        {
+            /* Skip the draw instead of stalling; the shader update mask is
+             * left untouched, so the next draw will try again. */
+            context_vk->shader_compile_pending = 1;
+            ++priv->skipped_draw_count;
+            TRACE_(d3d_perf)("Skipping draw, %s shader %p is still being compiled (%u draws skipped).\n",
+                    debug_shader_type(shader_type), shader, priv->skipped_draw_count);
+            goto fail;
+        }
+        if (!variant_vk->vk_module)
+            goto fail;
         context_vk->graphics.vk_modules[shader_type] = variant_vk->vk_module;
     }
 
@@ -1016,6 +1198,7 @@ static void shader_spirv_destroy(struct wined3d_shader *shader)
     for (i = 0; i < program_vk->variant_count; ++i)
     {
         variant_vk = &program_vk->variants[i];
+        shader_spirv_graphics_program_variant_wait(variant_vk, INFINITE);
         shader_spirv_invalidate_contexts_graphics_program_variant(&device_vk->d, variant_vk);
         VK_CALL(vkDestroyShaderModule(device_vk->vk_device, variant_vk->vk_module, NULL));
     }
@@ -1054,6 +1237,8 @@ static HRESULT shader_spirv_alloc(struct wined3d_device *device,
     priv->vertex_pipe = vertex_pipe;
     priv->fragment_pipe = fragment_pipe;
     memset(&priv->bindings, 0, sizeof(priv->bindings));
+    priv->async_compile_count = 0;
+    priv->skipped_draw_count = 0;
 
     device->vertex_priv = vertex_priv;
     device->fragment_priv = fragment_priv;
@@ -1066,6 +1251,10 @@ static void shader_spirv_free(struct wined3d_device *device, struct wined3d_cont
 {
     struct shader_spirv_priv *priv = device->shader_priv;
 
+    if (priv->async_compile_count)
+        TRACE_(d3d_perf)("Compiled %u shader variants asynchronously, skipped %u draws.\n",
+                priv->async_compile_count, priv->skipped_draw_count);
+
     shader_spirv_resource_bindings_cleanup(&priv->bindings);
     priv->fragment_pipe->free_private(device, context);
     priv->vertex_pipe->vp_free(device, context);
@@ -1112,7 +1301,7 @@ static uint64_t shader_spirv_compile(struct wined3d_context *context, const stru
         enum wined3d_shader_type shader_type)
 {
     struct shader_spirv_resource_bindings bindings = {0};
-    return (uint64_t)shader_spirv_compile_shader(wined3d_context_vk(context), shader_desc,
+    return (uint64_t)shader_spirv_compile_shader(wined3d_device_vk(context->device), shader_desc,
             VKD3D_SHADER_SOURCE_DXBC_TPF, shader_type, NULL, &bindings, NULL);
 }
 
@@ -104,6 +104,7 @@ static void wined3d_swapchain_vk_destroy_vulkan_swapchain(struct wined3d_swapcha
 
     vk_info = &wined3d_adapter_vk(device_vk->d.adapter)->vk_info;
 
+    wined3d_device_vk_flush_submissions(device_vk);
     if ((vr = VK_CALL(vkQueueWaitIdle(device_vk->vk_queue))) < 0)
         ERR("Failed to wait on queue, vr %s.\n", wined3d_debug_vkresult(vr));
     free(swapchain_vk->vk_images);
@@ -1160,6 +1161,7 @@ static VkResult wined3d_swapchain_vk_blit(struct wined3d_swapchain_vk *swapchain
     present_desc.pSwapchains = &swapchain_vk->vk_swapchain;
     present_desc.pImageIndices = &image_idx;
     present_desc.pResults = NULL;
+    wined3d_device_vk_flush_submissions(device_vk);
     if ((vr = VK_CALL(vkQueuePresentKHR(device_vk->vk_queue, &present_desc))))
         WARN("Present returned vr %s.\n", wined3d_debug_vkresult(vr));
     return vr;
@@ -130,6 +130,7 @@ struct wined3d_settings wined3d_settings =
     .max_sm_cs = UINT_MAX,
     .renderer = WINED3D_RENDERER_AUTO,
     .shader_backend = WINED3D_SHADER_BACKEND_AUTO,
+    .shader_cache_size = 256,
 };
 
 enum wined3d_renderer CDECL wined3d_get_renderer(void)
@@ -478,6 +479,32 @@ static BOOL wined3d_dll_init(HINSTANCE hInstDLL)
             TRACE("Forcing all constant buffers to be write-mappable.\n");
             wined3d_settings.cb_access_map_w = TRUE;
         }
+        if (!get_config_key(hkey, appkey, env, "ShaderCachePath", buffer, size) && *buffer)
+        {
+            size_t len = strlen(buffer) + 1;
+
+            if (!(wined3d_settings.shader_cache_path = malloc(len)))
+                ERR("Failed to allocate shader cache path memory.\n");
+            else
+                memcpy(wined3d_settings.shader_cache_path, buffer, len);
+        }
+        if (!get_config_key_dword(hkey, appkey, env, "ShaderCacheSize", &wined3d_settings.shader_cache_size))
+            TRACE("Limiting the shader cache size to %u MiB.\n", wined3d_settings.shader_cache_size);
+        if (!get_config_key_dword(hkey, appkey, env, "SubmitThread", &wined3d_settings.vk_submit_thread))
+            ERR_(winediag)("Setting Vulkan submission thread to %#x.\n", wined3d_settings.vk_submit_thread);
+        if (!get_config_key_dword(hkey, appkey, env, "AsyncShaderCompile", &wined3d_settings.async_shader_compile))
+            ERR_(winediag)("Setting asynchronous shader compilation to %#x.\n", wined3d_settings.async_shader_compile);
+        if (!get_config_key_dword(hkey, appkey, env, "AsyncShaderWait", &wined3d_settings.async_shader_wait))
+            TRACE("Waiting at most %u ms for asynchronously compiled shaders.\n", wined3d_settings.async_shader_wait);
+        if (!get_config_key(hkey, appkey, env, "PerfCountersPath", buffer, size) && *buffer)
+        {
+            size_t len = strlen(buffer) + 1;
+
+            if (!(wined3d_settings.perf_counters_path = malloc(len)))
+                ERR("Failed to allocate performance counters path memory.\n");
+            else
+                memcpy(wined3d_settings.perf_counters_path, buffer, len);
+        }
     }
 
     if (appkey) RegCloseKey( appkey );
@@ -537,6 +564,9 @@ static BOOL wined3d_dll_destroy(HINSTANCE hInstDLL)
     free(swapchain_state_table.hooks);
 
     free(wined3d_settings.logo);
+    wined3d_shader_cache_cleanup();
+    free(wined3d_settings.shader_cache_path);
+    free(wined3d_settings.perf_counters_path);
     UnregisterClassA(WINED3D_OPENGL_WINDOW_CLASS_NAME, hInstDLL);
 
     DeleteCriticalSection(&wined3d_command_cs);
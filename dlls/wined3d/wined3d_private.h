@@ -498,6 +498,12 @@ struct wined3d_settings
     enum wined3d_renderer renderer;
     enum wined3d_shader_backend shader_backend;
     BOOL cb_access_map_w;
+    char *shader_cache_path;
+    unsigned int shader_cache_size;
+    unsigned int vk_submit_thread;
+    unsigned int async_shader_compile;
+    unsigned int async_shader_wait;
+    char *perf_counters_path;
 };
 
 extern struct wined3d_settings wined3d_settings;
@@ -2530,6 +2536,7 @@ bool wined3d_driver_info_init(struct wined3d_driver_info *driver_info,
 #define UPLOAD_BO_UPLOAD_ON_UNMAP   0x1
 #define UPLOAD_BO_RENAME_ON_UNMAP   0x2
 #define UPLOAD_BO_FREE_ON_UNMAP     0x4
+#define UPLOAD_BO_RING              0x8
 
 struct upload_bo
 {
@@ -3588,12 +3595,57 @@ enum wined3d_cs_queue_id
 
 C_ASSERT(!(WINED3D_CS_QUEUE_SIZE & (WINED3D_CS_QUEUE_SIZE - 1)));
 
+#define WINED3D_CS_UPLOAD_RING_SIZE     0x800000u
+#define WINED3D_CS_UPLOAD_RING_MASK     (WINED3D_CS_UPLOAD_RING_SIZE - 1)
+#define WINED3D_CS_UPLOAD_RING_ALIGNMENT 16u
+
+C_ASSERT(!(WINED3D_CS_UPLOAD_RING_SIZE & (WINED3D_CS_UPLOAD_RING_SIZE - 1)));
+
 struct wined3d_cs_queue
 {
     ULONG head, tail;
     BYTE data[WINED3D_CS_QUEUE_SIZE];
 };
 
+/* A per-frame record in the performance counters file. Times are in
+ * QueryPerformanceCounter() ticks. */
+struct wined3d_perf_frame
+{
+    uint64_t index;
+    uint64_t timestamp;
+    uint64_t cs_busy_time;
+    uint64_t cs_idle_time;
+    uint64_t upload_bytes;
+    uint32_t draw_count;
+    uint32_t dispatch_count;
+    uint32_t state_change_count;
+    uint32_t shader_compile_count;
+    uint32_t cs_queue_bytes;
+    uint32_t map_stall_count;
+};
+
+struct wined3d_perf
+{
+    struct wined3d_perf_frame frame;
+    uint64_t frame_count;
+
+    HANDLE file, mapping;
+    struct wined3d_perf_header *header;
+};
+
+struct wined3d_perf *wined3d_perf_create(void);
+void wined3d_perf_destroy(struct wined3d_perf *perf);
+void wined3d_perf_end_frame(struct wined3d_perf *perf, unsigned int cs_queue_bytes, unsigned int map_stall_count);
+
+/* Staging memory for UPDATE_SUB_RESOURCE uploads. Allocations are made by
+ * the application thread at "head", and released in submission order by the
+ * CS thread, which advances "tail". */
+struct wined3d_cs_upload_ring
+{
+    ULONG head, tail;
+    BYTE *data;
+};
+
 struct wined3d_device_context_ops
 {
     void *(*require_space)(struct wined3d_device_context *context, size_t size, enum wined3d_cs_queue_id queue_id);
@@ -3637,8 +3689,28 @@ struct wined3d_cs
     LONG waiting_for_event;
     LONG waiting_for_present;
     LONG pending_presents;
+
+    struct wined3d_cs_upload_ring upload_ring;
+
+    /* Performance counters, NULL unless enabled. */
+    struct wined3d_perf *perf;
+
+    /* Statistics, reported on the d3d_perf channel. */
+    unsigned int exec_count;
+    LONGLONG exec_time;
+    LONGLONG wait_time;
+    DWORD stats_time;
+    unsigned int frame_count;
+    unsigned int frame_map_stalls;
+    unsigned int frame_ring_fallbacks;
 };
 
+static inline void wined3d_cs_count_shader_compile(struct wined3d_cs *cs)
+{
+    if (cs->perf)
+        ++cs->perf->frame.shader_compile_count;
+}
+
 static inline void wined3d_device_context_lock(struct wined3d_device_context *context)
 {
     if (context == &context->device->cs->c)
@@ -4615,6 +4687,26 @@ void wined3d_stateblock_invalidate_texture_lod(struct wined3d_stateblock *stateb
 
 BOOL wined3d_array_reserve(void **elements, SIZE_T *capacity, SIZE_T count, SIZE_T size);
 
+struct wined3d_shader_cache_key
+{
+    uint64_t hash;
+    uint8_t *data;
+    SIZE_T size, capacity;
+    bool failed;
+};
+
+void wined3d_shader_cache_key_init(struct wined3d_shader_cache_key *key, const char *tag);
+void wined3d_shader_cache_key_cleanup(struct wined3d_shader_cache_key *key);
+void wined3d_shader_cache_key_add(struct wined3d_shader_cache_key *key, const void *data, size_t size);
+void wined3d_shader_cache_key_add_stream_output(struct wined3d_shader_cache_key *key,
+        const struct wined3d_stream_output_desc *desc);
+void wined3d_shader_cache_key_add_string(struct wined3d_shader_cache_key *key, const char *str);
+
+void wined3d_shader_cache_cleanup(void);
+BOOL wined3d_shader_cache_enabled(void);
+BOOL wined3d_shader_cache_get(const struct wined3d_shader_cache_key *key, void **data, size_t *size);
+void wined3d_shader_cache_put(const struct wined3d_shader_cache_key *key, const void *data, size_t size);
+
 static inline BOOL wined3d_format_is_typeless(const struct wined3d_format *format)
 {
     return format->id == format->typeless_id && format->id != WINED3DFMT_UNKNOWN;
@@ -569,7 +569,8 @@ struct wined3d_context_vk
 
     uint32_t update_compute_pipeline : 1;
     uint32_t update_stream_output : 1;
-    uint32_t padding : 30;
+    uint32_t shader_compile_pending : 1;
+    uint32_t padding : 29;
 
     struct
     {
@@ -789,6 +790,44 @@ struct wined3d_uav_clear_state_vk
     struct wined3d_pipeline_layout_vk *buffer_layout;
 };
 
+#define WINED3D_VK_MAX_SUBMIT_SEMAPHORES 2
+
+struct wined3d_submission_vk
+{
+    VkCommandBuffer vk_command_buffer;
+    VkFence vk_fence;
+    uint32_t wait_semaphore_count;
+    VkSemaphore wait_semaphores[WINED3D_VK_MAX_SUBMIT_SEMAPHORES];
+    VkPipelineStageFlags wait_stages[WINED3D_VK_MAX_SUBMIT_SEMAPHORES];
+    uint32_t signal_semaphore_count;
+    VkSemaphore signal_semaphores[WINED3D_VK_MAX_SUBMIT_SEMAPHORES];
+    LONGLONG queue_time;
+};
+
+/* Command buffers recorded on the CS thread are handed to a separate thread
+ * for vkQueueSubmit(). Anything else that accesses the VkQueue needs to call
+ * wined3d_device_vk_flush_submissions() first. */
+struct wined3d_submit_queue_vk
+{
+    CRITICAL_SECTION cs;
+    CONDITION_VARIABLE work_cond;
+    CONDITION_VARIABLE idle_cond;
+    HANDLE thread;
+    bool stop;
+    bool busy;
+
+    struct wined3d_submission_vk *pending;
+    SIZE_T pending_size;
+    SIZE_T pending_count;
+    struct wined3d_submission_vk *processing;
+    SIZE_T processing_size;
+
+    unsigned int submit_count;
+    LONGLONG latency_time;
+    LONGLONG submit_time;
+    DWORD stats_time;
+};
+
 struct wined3d_device_vk
 {
     struct wined3d_device d;
@@ -809,6 +848,8 @@ struct wined3d_device_vk
     struct wined3d_allocator allocator;
 
     struct wined3d_uav_clear_state_vk uav_clear_state;
+
+    struct wined3d_submit_queue_vk submit_queue;
 };
 
 static inline struct wined3d_device_vk *wined3d_device_vk(struct wined3d_device *device)
@@ -831,6 +872,9 @@ static inline void wined3d_device_vk_allocator_unlock(struct wined3d_device_vk *
     LeaveCriticalSection(&device_vk->allocator_cs);
 }
 
+void wined3d_device_vk_flush_submissions(struct wined3d_device_vk *device_vk);
+void wined3d_device_vk_start_submit_thread(struct wined3d_device_vk *device_vk);
+void wined3d_device_vk_stop_submit_thread(struct wined3d_device_vk *device_vk);
 bool wined3d_device_vk_create_null_resources(struct wined3d_device_vk *device_vk,
         struct wined3d_context_vk *context_vk);
 bool wined3d_device_vk_create_null_views(struct wined3d_device_vk *device_vk,
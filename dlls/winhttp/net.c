@@ -300,6 +300,7 @@ void netconn_release( struct netconn *conn )
     }
     if (conn->socket != -1)
         closesocket( conn->socket );
+    release_host_connection( conn->host );
     release_host( conn->host );
     if (conn->port)
         CloseHandle( conn->port );
@@ -42,6 +42,7 @@
 WINE_DEFAULT_DEBUG_CHANNEL(winhttp);
 
 #define DEFAULT_KEEP_ALIVE_TIMEOUT 30000
+#define DEFAULT_RESOLVE_CACHE_TIMEOUT 30000
 
 static const WCHAR *attribute_table[] =
 {
@@ -1435,10 +1436,19 @@ void release_host( struct hostdata *host )
     if (ref) return;
 
     assert( list_empty( &host->connections ) );
+    if (host->cred_handle_initialized) FreeCredentialsHandle( &host->cred_handle );
     free( host->hostname );
     free( host );
 }
 
+void release_host_connection( struct hostdata *host )
+{
+    EnterCriticalSection( &connection_pool_cs );
+    host->open_connections--;
+    LeaveCriticalSection( &connection_pool_cs );
+    WakeConditionVariable( &host->connection_available );
+}
+
 static BOOL connection_collector_running;
 
 static void CALLBACK connection_collector( TP_CALLBACK_INSTANCE *instance, void *ctx )
@@ -1487,6 +1497,7 @@ static void cache_connection( struct netconn *netconn )
 
     netconn->keep_until = GetTickCount64() + DEFAULT_KEEP_ALIVE_TIMEOUT;
     list_add_head( &netconn->host->connections, &netconn->entry );
+    WakeConditionVariable( &netconn->host->connection_available );
 
     if (!connection_collector_running)
     {
@@ -1512,46 +1523,140 @@ static DWORD map_secure_protocols( DWORD mask )
     return ret;
 }
 
-static DWORD ensure_cred_handle( struct request *request )
+static SECURITY_STATUS acquire_cred_handle( DWORD protocols, const CERT_CONTEXT *client_cert, CredHandle *handle )
 {
-    SECURITY_STATUS status = SEC_E_OK;
+    SECURITY_STATUS status;
+    SCHANNEL_CRED cred;
 
-    if (request->cred_handle_initialized) return ERROR_SUCCESS;
+    memset( &cred, 0, sizeof(cred) );
+    cred.dwVersion             = SCHANNEL_CRED_VERSION;
+    cred.grbitEnabledProtocols = protocols;
+    if (client_cert)
+    {
+        cred.paCred = &client_cert;
+        cred.cCreds = 1;
+    }
+    status = AcquireCredentialsHandleW( NULL, (WCHAR *)UNISP_NAME_W, SECPKG_CRED_OUTBOUND, NULL,
+                                        &cred, NULL, NULL, handle, NULL );
+    if (status != SEC_E_OK) WARN( "AcquireCredentialsHandleW failed: %#lx\n", status );
+    return status;
+}
 
-    if (!request->cred_handle_initialized)
+/* Connections to the same host share their credentials handle when they don't use a client
+ * certificate, which lets schannel resume the TLS sessions established with it. */
+static DWORD ensure_cred_handle( struct request *request, struct hostdata *host, CredHandle **ret )
+{
+    DWORD protocols = map_secure_protocols( request->connect->session->secure_protocols );
+    SECURITY_STATUS status;
+
+    if (!request->client_cert && !request->cred_handle_initialized)
     {
-        SCHANNEL_CRED cred;
-        memset( &cred, 0, sizeof(cred) );
-        cred.dwVersion             = SCHANNEL_CRED_VERSION;
-        cred.grbitEnabledProtocols = map_secure_protocols( request->connect->session->secure_protocols );
-        if (request->client_cert)
+        EnterCriticalSection( &connection_pool_cs );
+        if (!host->cred_handle_initialized &&
+            acquire_cred_handle( protocols, NULL, &host->cred_handle ) == SEC_E_OK)
         {
-            cred.paCred = &request->client_cert;
-            cred.cCreds = 1;
+            host->cred_handle_initialized = TRUE;
+            host->cred_protocols = protocols;
         }
-        status = AcquireCredentialsHandleW( NULL, (WCHAR *)UNISP_NAME_W, SECPKG_CRED_OUTBOUND, NULL,
-                                            &cred, NULL, NULL, &request->cred_handle, NULL );
-        if (status == SEC_E_OK)
-            request->cred_handle_initialized = TRUE;
+        if (host->cred_handle_initialized && host->cred_protocols == protocols)
+        {
+            LeaveCriticalSection( &connection_pool_cs );
+            *ret = &host->cred_handle;
+            return ERROR_SUCCESS;
+        }
+        LeaveCriticalSection( &connection_pool_cs );
     }
 
-    if (status != SEC_E_OK)
+    if (!request->cred_handle_initialized)
     {
-        WARN( "AcquireCredentialsHandleW failed: %#lx\n", status );
-        return status;
+        if ((status = acquire_cred_handle( protocols, request->client_cert, &request->cred_handle )))
+            return status;
+        request->cred_handle_initialized = TRUE;
     }
+    *ret = &request->cred_handle;
     return ERROR_SUCCESS;
 }
 
+void cancel_connection_wait( struct request *request )
+{
+    EnterCriticalSection( &connection_pool_cs );
+    request->closing = TRUE;
+    if (request->waiting_host) WakeAllConditionVariable( &request->waiting_host->connection_available );
+    LeaveCriticalSection( &connection_pool_cs );
+}
+
+/* Wait until a connection to the host is returned to the pool or may be opened, according to the
+ * per-server limit. The wait is bounded by the connect timeout of the request and ends when the
+ * request handle is closed. On success, *ret is NULL if the caller should open a new connection. */
+static DWORD wait_for_connection( struct request *request, struct hostdata *host, DWORD max_conns,
+                                  struct netconn **ret )
+{
+    DWORD timeout = request->connect_timeout > 0 ? request->connect_timeout : INFINITE;
+    ULONGLONG deadline = GetTickCount64() + timeout;
+    struct netconn *netconn;
+    DWORD err = ERROR_SUCCESS;
+
+    for (;;)
+    {
+        netconn = NULL;
+
+        EnterCriticalSection( &connection_pool_cs );
+        request->waiting_host = host;
+        while (list_empty( &host->connections ) && host->open_connections >= max_conns)
+        {
+            ULONGLONG now = GetTickCount64();
+
+            if (request->closing)
+            {
+                err = ERROR_WINHTTP_OPERATION_CANCELLED;
+                break;
+            }
+            if (timeout != INFINITE && now >= deadline)
+            {
+                err = ERROR_WINHTTP_TIMEOUT;
+                break;
+            }
+            TRACE( "waiting for a connection to %s\n", debugstr_w(host->hostname) );
+            SleepConditionVariableCS( &host->connection_available, &connection_pool_cs,
+                                      timeout == INFINITE ? INFINITE : deadline - now );
+        }
+        request->waiting_host = NULL;
+        if (err)
+        {
+            /* pass on a wakeup this request may have consumed */
+            WakeConditionVariable( &host->connection_available );
+            LeaveCriticalSection( &connection_pool_cs );
+            TRACE( "no connection to %s, error %lu\n", debugstr_w(host->hostname), err );
+            return err;
+        }
+        if (!list_empty( &host->connections ))
+        {
+            netconn = LIST_ENTRY( list_head( &host->connections ), struct netconn, entry );
+            list_remove( &netconn->entry );
+        }
+        else host->open_connections++;
+        LeaveCriticalSection( &connection_pool_cs );
+
+        if (!netconn || netconn_is_alive( netconn ))
+        {
+            *ret = netconn;
+            return ERROR_SUCCESS;
+        }
+        TRACE("connection %p no longer alive, closing\n", netconn);
+        netconn_release( netconn );
+    }
+}
+
 static DWORD open_connection( struct request *request )
 {
     BOOL is_secure = request->hdr.flags & WINHTTP_FLAG_SECURE;
     struct hostdata *host = NULL, *iter;
     struct netconn *netconn = NULL;
     struct connect *connect;
+    CredHandle *cred_handle;
     WCHAR *addressW = NULL;
     INTERNET_PORT port;
-    DWORD ret, len;
+    DWORD ret, len, max_conns;
 
     if (request->netconn) goto done;
 
@@ -1562,7 +1667,8 @@ static DWORD open_connection( struct request *request )
 
     LIST_FOR_EACH_ENTRY( iter, &connection_pool, struct hostdata, entry )
     {
-        if (iter->port == port && !wcscmp( connect->servername, iter->hostname ) && !is_secure == !iter->secure)
+        if (iter->port == port && !wcscmp( connect->servername, iter->hostname ) && !is_secure == !iter->secure &&
+            iter->session_id == connect->session->id)
         {
             host = iter;
             host->ref++;
@@ -1577,7 +1683,12 @@ static DWORD open_connection( struct request *request )
             host->ref = 1;
             host->secure = is_secure;
             host->port = port;
+            host->session_id = connect->session->id;
             list_init( &host->connections );
+            host->open_connections = 0;
+            InitializeConditionVariable( &host->connection_available );
+            host->resolved_until = 0;
+            host->cred_handle_initialized = FALSE;
             if ((host->hostname = wcsdup( connect->servername )))
             {
                 list_add_head( &connection_pool, &host->entry );
@@ -1617,6 +1728,17 @@ static DWORD open_connection( struct request *request )
         connect->resolved = TRUE;
     }
 
+    if (!connect->resolved)
+    {
+        EnterCriticalSection( &connection_pool_cs );
+        if (host->resolved_until > GetTickCount64())
+        {
+            connect->sockaddr = host->sockaddr;
+            connect->resolved = TRUE;
+        }
+        LeaveCriticalSection( &connection_pool_cs );
+    }
+
     if (!connect->resolved)
     {
         len = lstrlenW( host->hostname ) + 1;
@@ -1629,6 +1751,11 @@ static DWORD open_connection( struct request *request )
         }
         connect->resolved = TRUE;
 
+        EnterCriticalSection( &connection_pool_cs );
+        host->sockaddr = connect->sockaddr;
+        host->resolved_until = GetTickCount64() + DEFAULT_RESOLVE_CACHE_TIMEOUT;
+        LeaveCriticalSection( &connection_pool_cs );
+
         if (!(addressW = addr_to_str( &connect->sockaddr )))
         {
             release_host( host );
@@ -1638,10 +1765,25 @@ static DWORD open_connection( struct request *request )
         send_callback( &request->hdr, WINHTTP_CALLBACK_STATUS_NAME_RESOLVED, addressW, len );
     }
 
+    if (!netconn)
+    {
+        if (request->version && !wcsicmp( request->version, L"HTTP/1.0" ))
+            max_conns = connect->session->max_conns_per_1_0_server;
+        else
+            max_conns = connect->session->max_conns_per_server;
+        if ((ret = wait_for_connection( request, host, max_conns ? max_conns : ~0u, &netconn )))
+        {
+            free( addressW );
+            release_host( host );
+            return ret;
+        }
+    }
+
     if (!netconn)
     {
         if (!addressW && !(addressW = addr_to_str( &connect->sockaddr )))
         {
+            release_host_connection( host );
             release_host( host );
             return ERROR_OUTOFMEMORY;
         }
@@ -1654,6 +1796,7 @@ static DWORD open_connection( struct request *request )
         if ((ret = netconn_create( host, &connect->sockaddr, request->connect_timeout, &netconn )))
         {
             free( addressW );
+            release_host_connection( host );
             release_host( host );
             return ret;
         }
@@ -1678,9 +1821,9 @@ static DWORD open_connection( struct request *request )
             CertFreeCertificateContext( request->server_cert );
             request->server_cert = NULL;
 
-            if ((ret = ensure_cred_handle( request )) ||
+            if ((ret = ensure_cred_handle( request, host, &cred_handle )) ||
                 (ret = netconn_secure_connect( netconn, connect->hostname, request->security_flags,
-                                               &request->cred_handle, request->check_revocation )))
+                                               cred_handle, request->check_revocation )))
             {
                 request->netconn = NULL;
                 free( addressW );
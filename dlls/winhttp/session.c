@@ -123,6 +123,20 @@ static BOOL session_query_option( struct object_header *hdr, DWORD option, void
         *buflen = sizeof(DWORD);
         return TRUE;
 
+    case WINHTTP_OPTION_MAX_CONNS_PER_SERVER:
+        if (!validate_buffer( buffer, buflen, sizeof(DWORD) )) return FALSE;
+
+        *(DWORD *)buffer = session->max_conns_per_server;
+        *buflen = sizeof(DWORD);
+        return TRUE;
+
+    case WINHTTP_OPTION_MAX_CONNS_PER_1_0_SERVER:
+        if (!validate_buffer( buffer, buflen, sizeof(DWORD) )) return FALSE;
+
+        *(DWORD *)buffer = session->max_conns_per_1_0_server;
+        *buflen = sizeof(DWORD);
+        return TRUE;
+
     case WINHTTP_OPTION_SEND_TIMEOUT:
         if (!validate_buffer( buffer, buflen, sizeof(DWORD) )) return FALSE;
 
@@ -240,11 +254,23 @@ static BOOL session_set_option( struct object_header *hdr, DWORD option, void *b
         return TRUE;
 
     case WINHTTP_OPTION_MAX_CONNS_PER_SERVER:
-        FIXME( "WINHTTP_OPTION_MAX_CONNS_PER_SERVER: %lu\n", *(DWORD *)buffer );
+        if (buflen != sizeof(DWORD))
+        {
+            SetLastError( ERROR_INSUFFICIENT_BUFFER );
+            return FALSE;
+        }
+        TRACE( "WINHTTP_OPTION_MAX_CONNS_PER_SERVER: %lu\n", *(DWORD *)buffer );
+        session->max_conns_per_server = *(DWORD *)buffer;
         return TRUE;
 
     case WINHTTP_OPTION_MAX_CONNS_PER_1_0_SERVER:
-        FIXME( "WINHTTP_OPTION_MAX_CONNS_PER_1_0_SERVER: %lu\n", *(DWORD *)buffer );
+        if (buflen != sizeof(DWORD))
+        {
+            SetLastError( ERROR_INSUFFICIENT_BUFFER );
+            return FALSE;
+        }
+        TRACE( "WINHTTP_OPTION_MAX_CONNS_PER_1_0_SERVER: %lu\n", *(DWORD *)buffer );
+        session->max_conns_per_1_0_server = *(DWORD *)buffer;
         return TRUE;
 
     case WINHTTP_OPTION_WEB_SOCKET_RECEIVE_BUFFER_SIZE:
@@ -299,6 +325,7 @@ static const struct object_vtbl session_vtbl =
  */
 HINTERNET WINAPI WinHttpOpen( LPCWSTR agent, DWORD access, LPCWSTR proxy, LPCWSTR bypass, DWORD flags )
 {
+    static LONG session_id;
     struct session *session;
     HINTERNET handle = NULL;
 
@@ -318,6 +345,9 @@ HINTERNET WINAPI WinHttpOpen( LPCWSTR agent, DWORD access, LPCWSTR proxy, LPCWST
     session->receive_response_timeout = DEFAULT_RECEIVE_RESPONSE_TIMEOUT;
     session->websocket_receive_buffer_size = 32768;
     session->websocket_send_buffer_size = 32768;
+    session->max_conns_per_server = ~0u;
+    session->max_conns_per_1_0_server = ~0u;
+    session->id = InterlockedIncrement( &session_id );
     list_init( &session->cookie_cache );
     InitializeCriticalSectionEx( &session->cs, 0, RTL_CRITICAL_SECTION_FLAG_FORCE_DEBUG_INFO );
     session->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": session.cs");
@@ -1187,9 +1217,14 @@ static BOOL request_set_option( struct object_header *hdr, DWORD option, void *b
     }
 }
 
+static void request_handle_closing( struct object_header *hdr )
+{
+    cancel_connection_wait( (struct request *)hdr );
+}
+
 static const struct object_vtbl request_vtbl =
 {
-    NULL,
+    request_handle_closing,
     request_destroy,
     request_query_option,
     request_set_option
@@ -2197,6 +2197,13 @@ static const char okmsg[] =
 "Server: winetest\r\n"
 "\r\n";
 
+static const char keepalivemsg[] =
+"HTTP/1.1 200 OK\r\n"
+"Server: winetest\r\n"
+"Content-Length: 5\r\n"
+"\r\n"
+"hello";
+
 static const char notokmsg[] =
 "HTTP/1.1 400 Bad Request\r\n"
 "\r\n";
@@ -2408,6 +2415,11 @@ static DWORD CALLBACK server_thread(LPVOID param)
         {
             send(c, page1, sizeof page1 - 1, 0);
         }
+        if (strstr(buffer, "GET /keepalive"))
+        {
+            send(c, keepalivemsg, sizeof keepalivemsg - 1, 0);
+            continue;
+        }
         if (strstr(buffer, "GET /no_content"))
         {
             send(c, nocontentmsg, sizeof nocontentmsg - 1, 0);
@@ -3936,6 +3948,110 @@ static void test_multiple_reads(int port)
     WinHttpCloseHandle(ses);
 }
 
+static DWORD CALLBACK send_request_thread( void *req )
+{
+    if (WinHttpSendRequest( req, NULL, 0, NULL, 0, 0, 0 ) && WinHttpReceiveResponse( req, NULL )) return ERROR_SUCCESS;
+    return GetLastError();
+}
+
+static void test_keep_alive( int port )
+{
+    LARGE_INTEGER freq, start, end;
+    HINTERNET ses, con, req, req2;
+    DWORD size, value, count, i, err;
+    HANDLE thread;
+    char buffer[16];
+    BOOL ret;
+
+    ses = WinHttpOpen( L"winetest", WINHTTP_ACCESS_TYPE_NO_PROXY, NULL, NULL, 0 );
+    ok( ses != NULL, "failed to open session %lu\n", GetLastError() );
+
+    value = 0xdeadbeef;
+    size = sizeof(value);
+    ret = WinHttpQueryOption( ses, WINHTTP_OPTION_MAX_CONNS_PER_SERVER, &value, &size );
+    ok( ret, "failed to query option %lu\n", GetLastError() );
+    ok( value == ~0u, "got %lu\n", value );
+
+    value = 1;
+    ret = WinHttpSetOption( ses, WINHTTP_OPTION_MAX_CONNS_PER_SERVER, &value, sizeof(value) );
+    ok( ret, "failed to set option %lu\n", GetLastError() );
+
+    value = 0xdeadbeef;
+    size = sizeof(value);
+    ret = WinHttpQueryOption( ses, WINHTTP_OPTION_MAX_CONNS_PER_SERVER, &value, &size );
+    ok( ret, "failed to query option %lu\n", GetLastError() );
+    ok( value == 1, "got %lu\n", value );
+
+    con = WinHttpConnect( ses, L"localhost", port, 0 );
+    ok( con != NULL, "failed to open a connection %lu\n", GetLastError() );
+
+    QueryPerformanceFrequency( &freq );
+    QueryPerformanceCounter( &start );
+    for (i = 0; i < 200; i++)
+    {
+        req = WinHttpOpenRequest( con, NULL, L"/keepalive", NULL, NULL, NULL, 0 );
+        ok( req != NULL, "failed to open a request %lu\n", GetLastError() );
+
+        ret = WinHttpSendRequest( req, NULL, 0, NULL, 0, 0, 0 );
+        ok( ret, "failed to send request %lu\n", GetLastError() );
+        ret = WinHttpReceiveResponse( req, NULL );
+        ok( ret, "failed to receive response %lu\n", GetLastError() );
+
+        count = 0;
+        memset( buffer, 0, sizeof(buffer) );
+        ret = WinHttpReadData( req, buffer, sizeof(buffer), &count );
+        ok( ret, "failed to read data %lu\n", GetLastError() );
+        ok( count == 5 && !memcmp( buffer, "hello", 5 ), "got %lu %s\n", count, debugstr_an(buffer, count) );
+
+        WinHttpCloseHandle( req );
+        if (!ret) break;
+    }
+    QueryPerformanceCounter( &end );
+    trace( "%lu requests, %.1f us per request\n", i,
+           (end.QuadPart - start.QuadPart) * 1000000.0 / freq.QuadPart / max( i, 1 ) );
+
+    /* the only allowed connection is in use until the response is read */
+    req = WinHttpOpenRequest( con, NULL, L"/keepalive", NULL, NULL, NULL, 0 );
+    ok( req != NULL, "failed to open a request %lu\n", GetLastError() );
+    ret = WinHttpSendRequest( req, NULL, 0, NULL, 0, 0, 0 );
+    ok( ret, "failed to send request %lu\n", GetLastError() );
+    ret = WinHttpReceiveResponse( req, NULL );
+    ok( ret, "failed to receive response %lu\n", GetLastError() );
+
+    /* waiting for it is bounded by the timeouts */
+    req2 = WinHttpOpenRequest( con, NULL, L"/keepalive", NULL, NULL, NULL, 0 );
+    ok( req2 != NULL, "failed to open a request %lu\n", GetLastError() );
+    ret = WinHttpSetTimeouts( req2, 0, 500, 500, 500 );
+    ok( ret, "failed to set timeouts %lu\n", GetLastError() );
+    SetLastError( 0xdeadbeef );
+    ret = WinHttpSendRequest( req2, NULL, 0, NULL, 0, 0, 0 ) && WinHttpReceiveResponse( req2, NULL );
+    ok( !ret, "request succeeded\n" );
+    ok( GetLastError() == ERROR_WINHTTP_TIMEOUT, "got %lu\n", GetLastError() );
+    WinHttpCloseHandle( req2 );
+
+    /* and ends when the handle is closed */
+    req2 = WinHttpOpenRequest( con, NULL, L"/keepalive", NULL, NULL, NULL, 0 );
+    ok( req2 != NULL, "failed to open a request %lu\n", GetLastError() );
+    ret = WinHttpSetTimeouts( req2, 0, 5000, 5000, 5000 );
+    ok( ret, "failed to set timeouts %lu\n", GetLastError() );
+    thread = CreateThread( NULL, 0, send_request_thread, req2, 0, NULL );
+    ok( WaitForSingleObject( thread, 100 ) == WAIT_TIMEOUT, "request didn't wait\n" );
+    WinHttpCloseHandle( req2 );
+    ok( !WaitForSingleObject( thread, 2000 ), "request wasn't cancelled\n" );
+    GetExitCodeThread( thread, &err );
+    ok( err == ERROR_WINHTTP_OPERATION_CANCELLED || broken(err == ERROR_INVALID_HANDLE), "got %lu\n", err );
+    CloseHandle( thread );
+
+    count = 0;
+    ret = WinHttpReadData( req, buffer, sizeof(buffer), &count );
+    ok( ret, "failed to read data %lu\n", GetLastError() );
+    ok( count == 5, "got %lu\n", count );
+    WinHttpCloseHandle( req );
+
+    WinHttpCloseHandle( con );
+    WinHttpCloseHandle( ses );
+}
+
 static void test_cookies( int port )
 {
     HINTERNET ses, con, req;
@@ -5945,6 +6061,7 @@ START_TEST (winhttp)
     test_large_data_authentication(si.port);
     test_bad_header(si.port);
     test_multiple_reads(si.port);
+    test_keep_alive(si.port);
     test_cookies(si.port);
     test_request_path_escapes(si.port);
     test_passport_auth(si.port);
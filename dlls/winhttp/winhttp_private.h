@@ -63,7 +63,15 @@ struct hostdata
     WCHAR *hostname;
     INTERNET_PORT port;
     BOOL secure;
-    struct list connections;
+    LONG session_id;                    /* connections are pooled and counted per session */
+    struct list connections;            /* idle connections */
+    unsigned int open_connections;      /* idle and in use connections */
+    CONDITION_VARIABLE connection_available;
+    struct sockaddr_storage sockaddr;   /* cached address of the host */
+    ULONGLONG resolved_until;
+    CredHandle cred_handle;             /* shared by the connections not using a client certificate */
+    BOOL cred_handle_initialized;
+    DWORD cred_protocols;
 };
 
 struct session
@@ -87,6 +95,9 @@ struct session
     DWORD passport_flags;
     unsigned int websocket_receive_buffer_size;
     unsigned int websocket_send_buffer_size;
+    DWORD max_conns_per_server;
+    DWORD max_conns_per_1_0_server;
+    LONG id;
 };
 
 struct connect
@@ -210,6 +221,8 @@ struct request
     int send_timeout;
     int receive_timeout;
     int receive_response_timeout;
+    BOOL closing;                       /* handle was closed, protected by the connection pool lock */
+    struct hostdata *waiting_host;      /* host whose connection limit the request waits on */
     DWORD max_redirects;
     DWORD redirect_count; /* total number of redirects during this request */
     WCHAR *status_text;
@@ -426,6 +439,8 @@ BOOL set_server_for_hostname( struct connect *, const WCHAR *, INTERNET_PORT );
 void destroy_authinfo( struct authinfo * );
 
 void release_host( struct hostdata * );
+void release_host_connection( struct hostdata * );
+void cancel_connection_wait( struct request * );
 DWORD process_header( struct request *, const WCHAR *, const WCHAR *, DWORD, BOOL );
 
 extern HRESULT WinHttpRequest_create( void ** );
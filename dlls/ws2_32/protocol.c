@@ -45,6 +45,149 @@ static char *get_fqdn(void)
     return ret;
 }
 
+/* The Unix resolver doesn't report the TTL of the records it used, so its
+ * results are only cached if WINE_ADDRINFO_CACHE_TTL gives a lifetime in
+ * seconds. */
+#define ADDRINFO_CACHE_ENTRIES  64
+
+struct addrinfo_cache_entry
+{
+    struct list entry;
+    ULONGLONG expire;
+    char *node;
+    char *service;
+    BOOL has_hints;
+    int flags, family, socktype, protocol;
+    struct addrinfo *info;
+    unsigned int size;
+};
+
+static struct list addrinfo_cache = LIST_INIT( addrinfo_cache );
+static unsigned int addrinfo_cache_count;
+static SRWLOCK addrinfo_cache_lock = SRWLOCK_INIT;
+
+/* results of the Unix getaddrinfo are stored in a single block */
+static struct addrinfo *copy_addrinfo_block( const struct addrinfo *info, unsigned int size )
+{
+    struct addrinfo *ret, *ai;
+    INT_PTR delta;
+
+    if (!(ret = malloc( size ))) return NULL;
+    memcpy( ret, info, size );
+    delta = (char *)ret - (const char *)info;
+    for (ai = ret; ai; ai = ai->ai_next)
+    {
+        if (ai->ai_canonname) ai->ai_canonname += delta;
+        if (ai->ai_addr) ai->ai_addr = (struct sockaddr *)((char *)ai->ai_addr + delta);
+        if (ai->ai_next) ai->ai_next = (struct addrinfo *)((char *)ai->ai_next + delta);
+    }
+    return ret;
+}
+
+static ULONGLONG get_addrinfo_cache_ttl(void)
+{
+    static LONG ttl = -1;
+    WCHAR value[16];
+    DWORD len;
+
+    if (ttl == -1)
+    {
+        len = GetEnvironmentVariableW( L"WINE_ADDRINFO_CACHE_TTL", value, ARRAY_SIZE(value) );
+        InterlockedExchange( &ttl, len && len < ARRAY_SIZE(value) ? min( wcstoul( value, NULL, 10 ), 86400 ) : 0 );
+        if (ttl) TRACE( "caching lookups for %lu seconds\n", ttl );
+    }
+    return (ULONGLONG)ttl * 1000;
+}
+
+static BOOL addrinfo_cache_match( const struct addrinfo_cache_entry *entry, const char *node,
+                                  const char *service, const struct addrinfo *hints )
+{
+    if (!entry->node != !node || (node && _stricmp( entry->node, node ))) return FALSE;
+    if (!entry->service != !service || (service && strcmp( entry->service, service ))) return FALSE;
+    if (!hints) return !entry->has_hints;
+    return entry->has_hints && entry->flags == hints->ai_flags && entry->family == hints->ai_family &&
+           entry->socktype == hints->ai_socktype && entry->protocol == hints->ai_protocol;
+}
+
+static void free_addrinfo_cache_entry( struct addrinfo_cache_entry *entry )
+{
+    list_remove( &entry->entry );
+    addrinfo_cache_count--;
+    free( entry->info );
+    free( entry->node );
+    free( entry->service );
+    free( entry );
+}
+
+static BOOL addrinfo_cache_lookup( const char *node, const char *service,
+                                   const struct addrinfo *hints, struct addrinfo **info )
+{
+    ULONGLONG now = GetTickCount64();
+    struct addrinfo_cache_entry *entry;
+    BOOL found = FALSE;
+
+    if (!get_addrinfo_cache_ttl()) return FALSE;
+
+    AcquireSRWLockExclusive( &addrinfo_cache_lock );
+    LIST_FOR_EACH_ENTRY( entry, &addrinfo_cache, struct addrinfo_cache_entry, entry )
+    {
+        if (!addrinfo_cache_match( entry, node, service, hints )) continue;
+
+        if (entry->expire <= now)
+            free_addrinfo_cache_entry( entry );
+        else if ((*info = copy_addrinfo_block( entry->info, entry->size )))
+        {
+            list_remove( &entry->entry );
+            list_add_head( &addrinfo_cache, &entry->entry );
+            found = TRUE;
+        }
+        break;
+    }
+    ReleaseSRWLockExclusive( &addrinfo_cache_lock );
+
+    if (found) TRACE( "using cached result for %s, %s\n", debugstr_a(node), debugstr_a(service) );
+    return found;
+}
+
+static void addrinfo_cache_insert( const char *node, const char *service,
+                                   const struct addrinfo *hints, const struct addrinfo *info, unsigned int size )
+{
+    struct addrinfo_cache_entry *entry, *old, *next;
+    ULONGLONG ttl;
+
+    if (!(ttl = get_addrinfo_cache_ttl())) return;
+    if (!(entry = calloc( 1, sizeof(*entry) ))) return;
+    entry->expire = GetTickCount64() + ttl;
+    entry->size = size;
+    if ((node && !(entry->node = strdup( node ))) ||
+        (service && !(entry->service = strdup( service ))) ||
+        !(entry->info = copy_addrinfo_block( info, size )))
+    {
+        free( entry->node );
+        free( entry->service );
+        free( entry );
+        return;
+    }
+    if ((entry->has_hints = !!hints))
+    {
+        entry->flags    = hints->ai_flags;
+        entry->family   = hints->ai_family;
+        entry->socktype = hints->ai_socktype;
+        entry->protocol = hints->ai_protocol;
+    }
+
+    AcquireSRWLockExclusive( &addrinfo_cache_lock );
+    LIST_FOR_EACH_ENTRY_SAFE( old, next, &addrinfo_cache, struct addrinfo_cache_entry, entry )
+    {
+        if (addrinfo_cache_match( old, node, service, hints )) free_addrinfo_cache_entry( old );
+    }
+    if (addrinfo_cache_count == ADDRINFO_CACHE_ENTRIES)
+        free_addrinfo_cache_entry( LIST_ENTRY( list_tail( &addrinfo_cache ), struct addrinfo_cache_entry, entry ) );
+    list_add_head( &addrinfo_cache, &entry->entry );
+    addrinfo_cache_count++;
+    ReleaseSRWLockExclusive( &addrinfo_cache_lock );
+}
+
 /* call Unix getaddrinfo, allocating a large enough buffer */
 static int do_getaddrinfo( const char *node, const char *service,
                            const struct addrinfo *hints, struct addrinfo **info )
@@ -53,12 +196,15 @@ static int do_getaddrinfo( const char *node, const char *service,
     struct getaddrinfo_params params = { node, service, hints, NULL, &size };
     int ret;
 
+    if (addrinfo_cache_lookup( node, service, hints, info )) return 0;
+
     for (;;)
     {
         if (!(params.info = malloc( size )))
             return WSA_NOT_ENOUGH_MEMORY;
         if (!(ret = WS_CALL( getaddrinfo, &params )))
         {
+            addrinfo_cache_insert( node, service, hints, params.info, size );
             *info = params.info;
             return ret;
         }
@@ -335,6 +481,9 @@ static struct addrinfo *addrinfo_WtoA( const struct addrinfoW *ai )
 
 struct getaddrinfo_args
 {
+    struct list entry;
+    HANDLE handle;
+    BOOL cancelled;
     OVERLAPPED *overlapped;
     LPLOOKUPSERVICE_COMPLETION_ROUTINE completion_routine;
     ADDRINFOEXW **result;
@@ -343,20 +492,35 @@ struct getaddrinfo_args
     struct addrinfo *hints;
 };
 
+/* asynchronous lookups which can still be cancelled */
+static struct list pending_lookups = LIST_INIT( pending_lookups );
+static SRWLOCK pending_lookups_lock = SRWLOCK_INIT;
+static LONG next_lookup_handle;
+
 static void WINAPI getaddrinfo_callback(TP_CALLBACK_INSTANCE *instance, void *context)
 {
     struct getaddrinfo_args *args = context;
     OVERLAPPED *overlapped = args->overlapped;
-    HANDLE event = overlapped->hEvent;
     LPLOOKUPSERVICE_COMPLETION_ROUTINE completion_routine = args->completion_routine;
     struct addrinfo *res;
+    BOOL cancelled;
+    HANDLE event;
     int ret;
 
     ret = getaddrinfo( args->nodename, args->servname, args->hints, &res );
+
+    AcquireSRWLockExclusive( &pending_lookups_lock );
+    if (!(cancelled = args->cancelled)) list_remove( &args->entry );
+    ReleaseSRWLockExclusive( &pending_lookups_lock );
+
+    /* the overlapped structure belongs to the caller again once cancelled */
     if (res)
     {
-        *args->result = addrinfo_list_AtoW(res);
-        overlapped->Pointer = args->result;
+        if (!cancelled)
+        {
+            *args->result = addrinfo_list_AtoW(res);
+            overlapped->Pointer = args->result;
+        }
         freeaddrinfo(res);
     }
 
@@ -364,6 +528,9 @@ static void WINAPI getaddrinfo_callback(TP_CALLBACK_INSTANCE *instance, void *co
     free( args->servname );
     free( args );
 
+    if (cancelled) return;
+
+    event = overlapped->hEvent;
     overlapped->Internal = ret;
     if (completion_routine) completion_routine( ret, 0, overlapped );
     if (event) SetEvent( event );
@@ -371,7 +538,7 @@ static void WINAPI getaddrinfo_callback(TP_CALLBACK_INSTANCE *instance, void *co
 
 static int getaddrinfoW( const WCHAR *nodename, const WCHAR *servname,
                             const struct addrinfo *hints, ADDRINFOEXW **res, OVERLAPPED *overlapped,
-                            LPLOOKUPSERVICE_COMPLETION_ROUTINE completion_routine )
+                            LPLOOKUPSERVICE_COMPLETION_ROUTINE completion_routine, HANDLE *handle )
 {
     int ret = EAI_MEMORY, len, i;
     char *nodenameA = NULL, *servnameA = NULL;
@@ -448,10 +615,19 @@ static int getaddrinfoW( const WCHAR *nodename, const WCHAR *servname,
             args->hints->ai_protocol = hints->ai_protocol;
         }
         else args->hints = NULL;
+        args->handle = ULongToHandle( InterlockedIncrement( &next_lookup_handle ) );
+        args->cancelled = FALSE;
+        if (handle) *handle = args->handle;
 
         overlapped->Internal = WSAEINPROGRESS;
+        AcquireSRWLockExclusive( &pending_lookups_lock );
+        list_add_tail( &pending_lookups, &args->entry );
+        ReleaseSRWLockExclusive( &pending_lookups_lock );
         if (!TrySubmitThreadpoolCallback( getaddrinfo_callback, args, NULL ))
         {
+            AcquireSRWLockExclusive( &pending_lookups_lock );
+            list_remove( &args->entry );
+            ReleaseSRWLockExclusive( &pending_lookups_lock );
             free( args );
             ret = GetLastError();
             goto end;
@@ -487,8 +663,6 @@ int WINAPI GetAddrInfoExW( const WCHAR *name, const WCHAR *servname, DWORD names
                            struct timeval *timeout, OVERLAPPED *overlapped,
                            LPLOOKUPSERVICE_COMPLETION_ROUTINE completion_routine, HANDLE *handle )
 {
-    int ret;
-
     TRACE( "name %s, servname %s, namespace %lu, namespace_id %s)\n",
            debugstr_w(name), debugstr_w(servname), namespace, debugstr_guid(namespace_id) );
 
@@ -498,13 +672,9 @@ int WINAPI GetAddrInfoExW( const WCHAR *name, const WCHAR *servname, DWORD names
         FIXME( "Unsupported namespace_id %s\n", debugstr_guid(namespace_id) );
     if (timeout)
         FIXME( "Unsupported timeout\n" );
-    if (handle)
-        FIXME( "Unsupported cancel handle\n" );
 
-    ret = getaddrinfoW( name, servname, (struct addrinfo *)hints, result, overlapped, completion_routine );
-    if (ret) return ret;
-    if (handle) *handle = (HANDLE)0xdeadbeef;
-    return 0;
+    if (handle) *handle = NULL;
+    return getaddrinfoW( name, servname, (struct addrinfo *)hints, result, overlapped, completion_routine, handle );
 }
 
 
@@ -527,8 +697,35 @@ int WINAPI GetAddrInfoExOverlappedResult( OVERLAPPED *overlapped )
  */
 int WINAPI GetAddrInfoExCancel( HANDLE *handle )
 {
-    FIXME( "(%p)\n", handle );
-    return WSA_INVALID_HANDLE;
+    LPLOOKUPSERVICE_COMPLETION_ROUTINE completion_routine = NULL;
+    struct getaddrinfo_args *args;
+    OVERLAPPED *overlapped = NULL;
+    HANDLE event;
+
+    TRACE( "(%p)\n", handle );
+
+    if (!handle) return WSA_INVALID_HANDLE;
+
+    AcquireSRWLockExclusive( &pending_lookups_lock );
+    LIST_FOR_EACH_ENTRY( args, &pending_lookups, struct getaddrinfo_args, entry )
+    {
+        if (args->handle != *handle) continue;
+        list_remove( &args->entry );
+        args->cancelled = TRUE;
+        overlapped = args->overlapped;
+        completion_routine = args->completion_routine;
+        break;
+    }
+    ReleaseSRWLockExclusive( &pending_lookups_lock );
+
+    if (!overlapped) return WSA_INVALID_HANDLE;
+
+    /* the lookup itself can't be interrupted, its result will be discarded */
+    event = overlapped->hEvent;
+    overlapped->Internal = WSA_E_CANCELLED;
+    if (completion_routine) completion_routine( WSA_E_CANCELLED, 0, overlapped );
+    if (event) SetEvent( event );
+    return 0;
 }
 
 
@@ -546,7 +743,7 @@ int WINAPI GetAddrInfoW(const WCHAR *nodename, const WCHAR *servname, const ADDR
 
     *res = NULL;
     if (hints) hintsA = addrinfo_WtoA( hints );
-    ret = getaddrinfoW( nodename, servname, hintsA, &resex, NULL, NULL );
+    ret = getaddrinfoW( nodename, servname, hintsA, &resex, NULL, NULL, NULL );
     freeaddrinfo( hintsA );
     if (ret) return ret;
 
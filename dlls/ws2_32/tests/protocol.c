@@ -38,6 +38,7 @@ static int (WINAPI *pGetAddrInfoExW)(const WCHAR *name, const WCHAR *servname, D
         struct timeval *timeout, OVERLAPPED *overlapped,
         LPLOOKUPSERVICE_COMPLETION_ROUTINE completion_routine, HANDLE *handle);
 static int   (WINAPI *pGetAddrInfoExOverlappedResult)(OVERLAPPED *overlapped);
+static int   (WINAPI *pGetAddrInfoExCancel)(HANDLE *handle);
 static int (WINAPI *pGetHostNameW)(WCHAR *name, int len);
 static const char *(WINAPI *p_inet_ntop)(int family, void *addr, char *string, ULONG size);
 static const WCHAR *(WINAPI *pInetNtopW)(int family, void *addr, WCHAR *string, ULONG size);
@@ -1955,7 +1956,7 @@ static void test_GetAddrInfoExW(void)
     static const WCHAR nxdomain[] = {'n','x','d','o','m','a','i','n','.','w','i','n','e','h','q','.','o','r','g',0};
     ADDRINFOEXW *result, hints;
     OVERLAPPED overlapped;
-    HANDLE event;
+    HANDLE event, handle;
     int ret;
 
     if (!pGetAddrInfoExW || !pGetAddrInfoExOverlappedResult)
@@ -2110,6 +2111,44 @@ static void test_GetAddrInfoExW(void)
     ok(completion_routine_test.called == 1, "got %lu\n", completion_routine_test.called);
     ok(result == NULL, "got %p\n", result);
 
+    if (!pGetAddrInfoExCancel)
+    {
+        win_skip("GetAddrInfoExCancel not present\n");
+        WSACloseEvent(event);
+        return;
+    }
+
+    handle = NULL;
+    ret = pGetAddrInfoExCancel(&handle);
+    ok(ret == WSA_INVALID_HANDLE, "GetAddrInfoExCancel returned %d\n", ret);
+
+    /* cancel, the lookup may have completed already */
+    result = (void *)0xdeadbeef;
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.hEvent = event;
+    ResetEvent(event);
+    handle = NULL;
+    ret = pGetAddrInfoExW(winehq, NULL, NS_DNS, NULL, NULL, &result, NULL, &overlapped, NULL, &handle);
+    ok(ret == ERROR_IO_PENDING, "GetAddrInfoExW failed with %d\n", WSAGetLastError());
+    ok(handle != NULL, "got NULL handle\n");
+    ret = pGetAddrInfoExCancel(&handle);
+    ok(!ret || ret == WSA_INVALID_HANDLE, "GetAddrInfoExCancel returned %d\n", ret);
+    ok(WaitForSingleObject(event, 1000) == WAIT_OBJECT_0, "wait failed\n");
+    if (!ret)
+    {
+        ret = pGetAddrInfoExOverlappedResult(&overlapped);
+        ok(ret == WSA_E_CANCELLED, "overlapped result is %d\n", ret);
+        ok(!result, "got %p\n", result);
+    }
+    else
+    {
+        ret = pGetAddrInfoExOverlappedResult(&overlapped);
+        ok(!ret, "overlapped result is %d\n", ret);
+        pFreeAddrInfoExW(result);
+    }
+    ret = pGetAddrInfoExCancel(&handle);
+    ok(ret == WSA_INVALID_HANDLE, "GetAddrInfoExCancel returned %d\n", ret);
+
     WSACloseEvent(event);
 }
 
@@ -2161,6 +2200,79 @@ static void compare_addrinfo(ADDRINFO *a, ADDRINFO *b)
     ok(!a && !b, "Expected both addresses null (%p != %p)\n", a, b);
 }
 
+static void test_addrinfo_cache_child(void)
+{
+    ADDRINFOA *result, *result2, *result3, hint;
+    struct sockaddr_in *addr;
+    int ret;
+
+    memset(&hint, 0, sizeof(hint));
+    hint.ai_family = AF_INET;
+    hint.ai_socktype = SOCK_STREAM;
+    hint.ai_flags = AI_CANONNAME;
+
+    result = NULL;
+    ret = getaddrinfo("localhost", "80", &hint, &result);
+    ok(!ret, "getaddrinfo failed with %d\n", WSAGetLastError());
+    ok(!!result, "got NULL result\n");
+    addr = (struct sockaddr_in *)result->ai_addr;
+    ok(addr->sin_addr.s_addr == htonl(INADDR_LOOPBACK), "got address %#lx\n", addr->sin_addr.s_addr);
+    ok(addr->sin_port == htons(80), "got port %u\n", ntohs(addr->sin_port));
+
+    result2 = NULL;
+    ret = getaddrinfo("localhost", "80", &hint, &result2);
+    ok(!ret, "getaddrinfo failed with %d\n", WSAGetLastError());
+    ok(result2 != result, "got the same result\n");
+    compare_addrinfo(result, result2);
+
+    /* each lookup returns its own copy */
+    addr->sin_port = htons(81);
+    freeaddrinfo(result);
+    result = NULL;
+    ret = getaddrinfo("localhost", "80", &hint, &result);
+    ok(!ret, "getaddrinfo failed with %d\n", WSAGetLastError());
+    compare_addrinfo(result, result2);
+    freeaddrinfo(result);
+
+    /* different services and hints aren't mixed up */
+    result3 = NULL;
+    ret = getaddrinfo("localhost", "81", &hint, &result3);
+    ok(!ret, "getaddrinfo failed with %d\n", WSAGetLastError());
+    addr = (struct sockaddr_in *)result3->ai_addr;
+    ok(addr->sin_port == htons(81), "got port %u\n", ntohs(addr->sin_port));
+    freeaddrinfo(result3);
+
+    hint.ai_socktype = SOCK_DGRAM;
+    result3 = NULL;
+    ret = getaddrinfo("localhost", "80", &hint, &result3);
+    ok(!ret, "getaddrinfo failed with %d\n", WSAGetLastError());
+    ok(result3->ai_socktype == SOCK_DGRAM, "got socktype %d\n", result3->ai_socktype);
+    freeaddrinfo(result3);
+
+    freeaddrinfo(result2);
+}
+
+static void test_addrinfo_cache(void)
+{
+    STARTUPINFOA si = {sizeof(si)};
+    char cmdline[MAX_PATH + 32];
+    PROCESS_INFORMATION pi;
+    char **argv;
+    BOOL ret;
+
+    /* Wine only caches lookups when asked to; repeated lookups in a child
+     * process with caching enabled need to give the same results. */
+    winetest_get_mainargs(&argv);
+    sprintf(cmdline, "\"%s\" protocol addrinfo_cache", argv[0]);
+    SetEnvironmentVariableA("WINE_ADDRINFO_CACHE_TTL", "60");
+    ret = CreateProcessA(NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi);
+    SetEnvironmentVariableA("WINE_ADDRINFO_CACHE_TTL", NULL);
+    ok(ret, "CreateProcess failed, error %lu\n", GetLastError());
+    wait_child_process(pi.hProcess);
+    CloseHandle(pi.hThread);
+    CloseHandle(pi.hProcess);
+}
+
 static BOOL ipv6_found(ADDRINFOA *addr)
 {
     ADDRINFOA *p;
@@ -3044,11 +3156,13 @@ static void test_startup(void)
 START_TEST( protocol )
 {
     WSADATA data;
+    char **argv;
     int ret;
 
     pFreeAddrInfoExW = (void *)GetProcAddress(GetModuleHandleA("ws2_32"), "FreeAddrInfoExW");
     pGetAddrInfoExOverlappedResult = (void *)GetProcAddress(GetModuleHandleA("ws2_32"), "GetAddrInfoExOverlappedResult");
     pGetAddrInfoExW = (void *)GetProcAddress(GetModuleHandleA("ws2_32"), "GetAddrInfoExW");
+    pGetAddrInfoExCancel = (void *)GetProcAddress(GetModuleHandleA("ws2_32"), "GetAddrInfoExCancel");
     pGetHostNameW = (void *)GetProcAddress(GetModuleHandleA("ws2_32"), "GetHostNameW");
     p_inet_ntop = (void *)GetProcAddress(GetModuleHandleA("ws2_32"), "inet_ntop");
     pInetNtopW = (void *)GetProcAddress(GetModuleHandleA("ws2_32"), "InetNtopW");
@@ -3059,6 +3173,13 @@ START_TEST( protocol )
     ret = WSAStartup(0x202, &data);
     ok(!ret, "got %d\n", ret);
 
+    if (winetest_get_mainargs(&argv) >= 3 && !strcmp(argv[2], "addrinfo_cache"))
+    {
+        test_addrinfo_cache_child();
+        WSACleanup();
+        return;
+    }
+
     test_WSAEnumProtocolsA();
     test_WSAEnumProtocolsW();
     test_getprotobyname();
@@ -3077,6 +3198,7 @@ START_TEST( protocol )
     test_GetAddrInfoW();
     test_GetAddrInfoExW();
     test_getaddrinfo();
+    test_addrinfo_cache();
 
     test_dns();
     test_gethostbyname();
@@ -13236,6 +13236,88 @@ static void test_simultaneous_async_recv(void)
     for (i = 0; i < num_io; i++) CloseHandle(events[i]);
 }
 
+static void test_simultaneous_async_udp_recv(void)
+{
+    const struct sockaddr_in bind_addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    struct sockaddr_in addr, client_addr, from_addrs[8];
+    int from_lens[8], ret, len;
+    LARGE_INTEGER frequency, start, end;
+    unsigned int round, rounds = 500;
+    OVERLAPPED overlappeds[8] = {{0}};
+    char buffers[8][16], data[16];
+    HANDLE events[8];
+    WSABUF wsabufs[8];
+    DWORD flags[8], size, i;
+    SOCKET client, server;
+
+    client = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    server = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    ret = bind(server, (const struct sockaddr *)&bind_addr, sizeof(bind_addr));
+    ok(!ret, "got error %u\n", WSAGetLastError());
+    len = sizeof(addr);
+    ret = getsockname(server, (struct sockaddr *)&addr, &len);
+    ok(!ret, "got error %u\n", WSAGetLastError());
+    ret = bind(client, (const struct sockaddr *)&bind_addr, sizeof(bind_addr));
+    ok(!ret, "got error %u\n", WSAGetLastError());
+    len = sizeof(client_addr);
+    ret = getsockname(client, (struct sockaddr *)&client_addr, &len);
+    ok(!ret, "got error %u\n", WSAGetLastError());
+
+    for (i = 0; i < ARRAY_SIZE(events); i++) events[i] = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+
+    /* each pending receive gets one datagram, in the order they were queued */
+    for (round = 0; round < rounds; round++)
+    {
+        for (i = 0; i < ARRAY_SIZE(overlappeds); i++)
+        {
+            wsabufs[i].buf = buffers[i];
+            wsabufs[i].len = sizeof(buffers[i]);
+            memset(&overlappeds[i], 0, sizeof(overlappeds[i]));
+            overlappeds[i].hEvent = events[i];
+            flags[i] = 0;
+            from_lens[i] = sizeof(from_addrs[i]);
+            ret = WSARecvFrom(server, &wsabufs[i], 1, NULL, &flags[i], (struct sockaddr *)&from_addrs[i],
+                              &from_lens[i], &overlappeds[i], NULL);
+            ok(ret == -1, "got %d\n", ret);
+            ok(WSAGetLastError() == ERROR_IO_PENDING, "got error %u\n", WSAGetLastError());
+        }
+
+        for (i = 0; i < ARRAY_SIZE(overlappeds); i++)
+        {
+            len = sprintf(data, "%u-%lu", round, i) + 1;
+            ret = sendto(client, data, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+            ok(ret == len, "got %d\n", ret);
+        }
+
+        for (i = 0; i < ARRAY_SIZE(overlappeds); i++)
+        {
+            ret = WaitForSingleObject(events[i], 1000);
+            ok(!ret, "wait timed out\n");
+            size = 0;
+            ret = GetOverlappedResult((HANDLE)server, &overlappeds[i], &size, FALSE);
+            ok(ret, "got error %lu\n", GetLastError());
+            len = sprintf(data, "%u-%lu", round, i) + 1;
+            ok(size == len, "got size %lu\n", size);
+            ok(!strcmp(buffers[i], data), "expected %s, got %s\n", debugstr_a(data), debugstr_a(buffers[i]));
+            ok(from_lens[i] == sizeof(client_addr), "got address length %d\n", from_lens[i]);
+            ok(!memcmp(&from_addrs[i], &client_addr, sizeof(client_addr)), "addresses didn't match\n");
+        }
+    }
+
+    QueryPerformanceCounter(&end);
+    if (end.QuadPart > start.QuadPart)
+        trace("received %.0f datagrams/s\n", (double)rounds * ARRAY_SIZE(overlappeds)
+              * frequency.QuadPart / (end.QuadPart - start.QuadPart));
+
+    closesocket(client);
+    closesocket(server);
+
+    for (i = 0; i < ARRAY_SIZE(events); i++) CloseHandle(events[i]);
+}
+
 static void test_empty_recv(void)
 {
     OVERLAPPED overlapped = {0};
@@ -14243,6 +14325,7 @@ START_TEST( sock )
     test_WSAGetOverlappedResult();
     test_nonblocking_async_recv();
     test_simultaneous_async_recv();
+    test_simultaneous_async_udp_recv();
     test_empty_recv();
     test_timeout();
     test_tcp_reset();
@@ -858,6 +858,27 @@ typedef struct
     lparam_t info;
 } cursor_pos_t;
 
+struct completion_msg
+{
+    apc_param_t   ckey;
+    apc_param_t   cvalue;
+    apc_param_t   information;
+    unsigned int  status;
+    int           __pad;
+};
+
+/* completion messages shared between the server and the processes using a completion port;
+ * the server is the only producer, and consumers claim entries by advancing head */
+#define COMPLETION_RING_SIZE 256
+
+struct completion_ring
+{
+    unsigned int          head;
+    unsigned int          tail;
+    unsigned int          __pad[2];
+    struct completion_msg msgs[COMPLETION_RING_SIZE];
+};
+
 
 
 
@@ -1879,6 +1900,19 @@ struct socket_get_icmp_id_reply
 
 
 
+struct socket_wake_recv_request
+{
+    struct request_header __header;
+    obj_handle_t   handle;
+    /* VARARG(asyncs,uints64); */
+};
+struct socket_wake_recv_reply
+{
+    struct reply_header __header;
+};
+
+
+
 struct get_next_console_request_request
 {
     struct request_header __header;
@@ -5243,6 +5277,20 @@ struct remove_completion_reply
 
 
 
+struct get_completion_ring_request
+{
+    struct request_header __header;
+    obj_handle_t  handle;
+};
+struct get_completion_ring_reply
+{
+    struct reply_header __header;
+    data_size_t   size;
+    char __pad_12[4];
+};
+
+
+
 struct query_completion_request
 {
     struct request_header __header;
@@ -5697,6 +5745,7 @@ enum request
     REQ_socket_get_events,
     REQ_socket_send_icmp_id,
     REQ_socket_get_icmp_id,
+    REQ_socket_wake_recv,
     REQ_get_next_console_request,
     REQ_read_directory_changes,
     REQ_read_change,
@@ -5897,6 +5946,7 @@ enum request
     REQ_open_completion,
     REQ_add_completion,
     REQ_remove_completion,
+    REQ_get_completion_ring,
     REQ_query_completion,
     REQ_set_completion_info,
     REQ_add_fd_completion,
@@ -5989,6 +6039,7 @@ union generic_request
     struct socket_get_events_request socket_get_events_request;
     struct socket_send_icmp_id_request socket_send_icmp_id_request;
     struct socket_get_icmp_id_request socket_get_icmp_id_request;
+    struct socket_wake_recv_request socket_wake_recv_request;
     struct get_next_console_request_request get_next_console_request_request;
     struct read_directory_changes_request read_directory_changes_request;
     struct read_change_request read_change_request;
@@ -6189,6 +6240,7 @@ union generic_request
     struct open_completion_request open_completion_request;
     struct add_completion_request add_completion_request;
     struct remove_completion_request remove_completion_request;
+    struct get_completion_ring_request get_completion_ring_request;
     struct query_completion_request query_completion_request;
     struct set_completion_info_request set_completion_info_request;
     struct add_fd_completion_request add_fd_completion_request;
@@ -6279,6 +6331,7 @@ union generic_reply
     struct socket_get_events_reply socket_get_events_reply;
     struct socket_send_icmp_id_reply socket_send_icmp_id_reply;
     struct socket_get_icmp_id_reply socket_get_icmp_id_reply;
+    struct socket_wake_recv_reply socket_wake_recv_reply;
     struct get_next_console_request_reply get_next_console_request_reply;
     struct read_directory_changes_reply read_directory_changes_reply;
     struct read_change_reply read_change_reply;
@@ -6479,6 +6532,7 @@ union generic_reply
     struct open_completion_reply open_completion_reply;
     struct add_completion_reply add_completion_reply;
     struct remove_completion_reply remove_completion_reply;
+    struct get_completion_ring_reply get_completion_ring_reply;
     struct query_completion_reply query_completion_reply;
     struct set_completion_info_reply set_completion_info_reply;
     struct add_fd_completion_reply add_fd_completion_reply;
@@ -6509,7 +6563,7 @@ union generic_reply
 
 /* ### protocol_version begin ### */
 
-#define SERVER_PROTOCOL_VERSION 798
+#define SERVER_PROTOCOL_VERSION 802
 
 /* ### protocol_version end ### */
 
@@ -3534,6 +3534,7 @@ static bool hlsl_ctx_init(struct hlsl_ctx *ctx, const struct vkd3d_shader_compil
     memset(ctx, 0, sizeof(*ctx));
 
     ctx->profile = profile;
+    ctx->config_flags = vkd3d_shader_init_config_flags();
 
     ctx->message_context = message_context;
 
@@ -3633,6 +3634,7 @@ static void hlsl_ctx_cleanup(struct hlsl_ctx *ctx)
     }
 
     vkd3d_free(ctx->constant_defs.regs);
+    vkd3d_free(ctx->pass_stats.stats);
 }
 
 int hlsl_compile_shader(const struct vkd3d_shader_code *hlsl, const struct vkd3d_shader_compile_info *compile_info,
@@ -3642,6 +3644,7 @@ int hlsl_compile_shader(const struct vkd3d_shader_code *hlsl, const struct vkd3d
     struct hlsl_ir_function_decl *decl, *entry_func = NULL;
     const struct hlsl_profile_info *profile;
     struct hlsl_ir_function *func;
+    uint64_t start_time = 0;
     const char *entry_point;
     struct hlsl_ctx ctx;
     int ret;
@@ -3687,7 +3690,16 @@ int hlsl_compile_shader(const struct vkd3d_shader_code *hlsl, const struct vkd3d
     if (!hlsl_ctx_init(&ctx, compile_info, profile, message_context))
         return VKD3D_ERROR_OUT_OF_MEMORY;
 
-    if ((ret = hlsl_lexer_compile(&ctx, hlsl)) == 2)
+    if (ctx.config_flags & VKD3D_SHADER_CONFIG_FLAG_PASS_STATS)
+        start_time = vkd3d_get_time_ns();
+
+    ret = hlsl_lexer_compile(&ctx, hlsl);
+
+    if (ctx.config_flags & VKD3D_SHADER_CONFIG_FLAG_PASS_STATS)
+        vkd3d_dbg_printf(VKD3D_DBG_LEVEL_NONE, __FUNCTION__, "Parsing: %"PRIu64" ns.\n",
+                vkd3d_get_time_ns() - start_time);
+
+    if (ret == 2)
     {
         hlsl_ctx_cleanup(&ctx);
         return VKD3D_ERROR_OUT_OF_MEMORY;
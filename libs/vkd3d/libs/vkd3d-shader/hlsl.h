@@ -815,9 +815,20 @@ struct hlsl_buffer
     bool automatically_packed_elements;
 };
 
+/* Time spent in a compilation pass, accumulated over all the times it is run. */
+struct hlsl_pass_stats
+{
+    const char *name;
+    unsigned int run_count;
+    unsigned int progress_count;
+    uint64_t time;
+};
+
 struct hlsl_ctx
 {
     const struct hlsl_profile_info *profile;
+    /* Flags from enum vkd3d_shader_config_flags. */
+    uint64_t config_flags;
 
     const char **source_files;
     unsigned int source_files_count;
@@ -920,6 +931,14 @@ struct hlsl_ctx
     uint32_t found_numthreads : 1;
 
     bool semantic_compat_mapping;
+
+    /* Per-pass statistics, collected if VKD3D_SHADER_CONFIG_FLAG_PASS_STATS is set. */
+    struct
+    {
+        struct hlsl_pass_stats *stats;
+        size_t count, capacity;
+        uint64_t start_time;
+    } pass_stats;
 };
 
 struct hlsl_resource_load_params
@@ -2282,6 +2282,179 @@ static bool remove_trivial_swizzles(struct hlsl_ctx *ctx, struct hlsl_ir_node *i
     return true;
 }
 
+static bool derefs_are_equal(const struct hlsl_deref *a, const struct hlsl_deref *b)
+{
+    unsigned int i;
+
+    if (a->var != b->var || a->path_len != b->path_len)
+        return false;
+    if (hlsl_deref_is_lowered(a) || hlsl_deref_is_lowered(b))
+        return false;
+
+    for (i = 0; i < a->path_len; ++i)
+    {
+        struct hlsl_ir_node *node_a = a->path[i].node, *node_b = b->path[i].node;
+
+        if (node_a == node_b)
+            continue;
+        if (node_a->type != HLSL_IR_CONSTANT || node_b->type != HLSL_IR_CONSTANT)
+            return false;
+        if (hlsl_ir_constant(node_a)->value.u[0].u != hlsl_ir_constant(node_b)->value.u[0].u)
+            return false;
+    }
+
+    return true;
+}
+
+static struct hlsl_ir_node *get_swizzle_source(struct hlsl_ir_node *node, uint32_t *swizzle)
+{
+    if (node->type == HLSL_IR_SWIZZLE)
+    {
+        *swizzle = hlsl_ir_swizzle(node)->swizzle;
+        return hlsl_ir_swizzle(node)->val.node;
+    }
+
+    *swizzle = HLSL_SWIZZLE(X, Y, Z, W);
+    return node;
+}
+
+/* Returns the next store to the same variable as "store" in the same block,
+ * or NULL if the variable may be read or modified in between. */
+static struct hlsl_ir_store *find_next_store_to_var(struct hlsl_block *block, struct hlsl_ir_store *store)
+{
+    const struct hlsl_ir_var *var = store->lhs.var;
+    struct hlsl_ir_node *instr = &store->node;
+
+    while (instr->entry.next != &block->instrs)
+    {
+        instr = LIST_ENTRY(instr->entry.next, struct hlsl_ir_node, entry);
+
+        switch (instr->type)
+        {
+            case HLSL_IR_CONSTANT:
+            case HLSL_IR_EXPR:
+            case HLSL_IR_SWIZZLE:
+                break;
+
+            case HLSL_IR_LOAD:
+                if (hlsl_ir_load(instr)->src.var == var)
+                    return NULL;
+                break;
+
+            case HLSL_IR_RESOURCE_LOAD:
+                if (hlsl_ir_resource_load(instr)->resource.var == var
+                        || hlsl_ir_resource_load(instr)->sampler.var == var)
+                    return NULL;
+                break;
+
+            case HLSL_IR_STORE:
+                if (hlsl_ir_store(instr)->lhs.var == var)
+                    return hlsl_ir_store(instr);
+                break;
+
+            default:
+                return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+/* Merge stores to disjoint components of the same deref, whose values are
+ * swizzles of the same node, into a single vector store. Splitting copies
+ * and lowering broadcasts produce sequences like
+ *
+ *   2: @1.x
+ *   3: var.x = @2
+ *   4: @1.y
+ *   5: var.y = @4
+ *
+ * which become
+ *
+ *   6: @1.xy
+ *   5: var.xy = @6
+ *
+ * The store is moved later, so this is only done if the variable isn't read
+ * or written in between. */
+static bool vectorize_stores(struct hlsl_ctx *ctx, struct hlsl_block *block)
+{
+    struct hlsl_ir_node *instr, *next, *src1, *src2, *swizzle_node;
+    unsigned int writemask, i, j1, j2, count;
+    struct hlsl_ir_store *store1, *store2;
+    uint32_t swizzle1, swizzle2, swizzle;
+    bool progress = false;
+
+    LIST_FOR_EACH_ENTRY_SAFE(instr, next, &block->instrs, struct hlsl_ir_node, entry)
+    {
+        switch (instr->type)
+        {
+            case HLSL_IR_IF:
+                progress |= vectorize_stores(ctx, &hlsl_ir_if(instr)->then_block);
+                progress |= vectorize_stores(ctx, &hlsl_ir_if(instr)->else_block);
+                continue;
+
+            case HLSL_IR_LOOP:
+                progress |= vectorize_stores(ctx, &hlsl_ir_loop(instr)->body);
+                continue;
+
+            case HLSL_IR_SWITCH:
+            {
+                struct hlsl_ir_switch_case *c;
+
+                LIST_FOR_EACH_ENTRY(c, &hlsl_ir_switch(instr)->cases, struct hlsl_ir_switch_case, entry)
+                    progress |= vectorize_stores(ctx, &c->body);
+                continue;
+            }
+
+            case HLSL_IR_STORE:
+                break;
+
+            default:
+                continue;
+        }
+
+        store1 = hlsl_ir_store(instr);
+        if (store1->rhs.node->data_type->class > HLSL_CLASS_VECTOR)
+            continue;
+        if (!(store2 = find_next_store_to_var(block, store1)))
+            continue;
+        if (!derefs_are_equal(&store1->lhs, &store2->lhs) || (store1->writemask & store2->writemask))
+            continue;
+
+        src1 = get_swizzle_source(store1->rhs.node, &swizzle1);
+        src2 = get_swizzle_source(store2->rhs.node, &swizzle2);
+        if (src1 != src2 || src1->data_type->class > HLSL_CLASS_VECTOR)
+            continue;
+
+        writemask = store1->writemask | store2->writemask;
+        swizzle = 0;
+        for (i = 0, j1 = 0, j2 = 0, count = 0; i < 4; ++i)
+        {
+            if (store1->writemask & (1u << i))
+                swizzle |= hlsl_swizzle_get_component(swizzle1, j1++) << HLSL_SWIZZLE_SHIFT(count++);
+            else if (store2->writemask & (1u << i))
+                swizzle |= hlsl_swizzle_get_component(swizzle2, j2++) << HLSL_SWIZZLE_SHIFT(count++);
+        }
+
+        if (!(swizzle_node = hlsl_new_swizzle(ctx, swizzle, count, src1, &store2->node.loc)))
+            return progress;
+        list_add_before(&store2->node.entry, &swizzle_node->entry);
+
+        TRACE("Merging store %p%s into store %p%s.\n", store1, debug_hlsl_writemask(store1->writemask),
+                store2, debug_hlsl_writemask(store2->writemask));
+
+        hlsl_src_remove(&store2->rhs);
+        hlsl_src_from_node(&store2->rhs, swizzle_node);
+        store2->writemask = writemask;
+
+        list_remove(&store1->node.entry);
+        hlsl_free_instr(&store1->node);
+        progress = true;
+    }
+
+    return progress;
+}
+
 static bool remove_trivial_conditional_branches(struct hlsl_ctx *ctx, struct hlsl_ir_node *instr, void *context)
 {
     struct hlsl_ir_constant *condition;
@@ -3407,6 +3580,69 @@ static bool dce(struct hlsl_ctx *ctx, struct hlsl_ir_node *instr, void *context)
     return false;
 }
 
+/* Remove unused values, walking backwards so that values which only become
+ * unused when their users are removed are caught in the same pass. Unlike
+ * dce(), this doesn't need liveness information, and is much cheaper than
+ * iterating dce() until there is no progress. */
+static bool remove_unused_values(struct hlsl_ctx *ctx, struct hlsl_block *block)
+{
+    struct hlsl_ir_node *instr, *prev;
+    bool progress = false;
+
+    LIST_FOR_EACH_ENTRY_SAFE_REV(instr, prev, &block->instrs, struct hlsl_ir_node, entry)
+    {
+        switch (instr->type)
+        {
+            case HLSL_IR_CONSTANT:
+            case HLSL_IR_EXPR:
+            case HLSL_IR_INDEX:
+            case HLSL_IR_LOAD:
+            case HLSL_IR_RESOURCE_LOAD:
+            case HLSL_IR_SWIZZLE:
+                if (list_empty(&instr->uses))
+                {
+                    list_remove(&instr->entry);
+                    hlsl_free_instr(instr);
+                    progress = true;
+                }
+                break;
+
+            case HLSL_IR_IF:
+            {
+                struct hlsl_ir_if *iff = hlsl_ir_if(instr);
+
+                progress |= remove_unused_values(ctx, &iff->else_block);
+                progress |= remove_unused_values(ctx, &iff->then_block);
+                break;
+            }
+
+            case HLSL_IR_LOOP:
+                progress |= remove_unused_values(ctx, &hlsl_ir_loop(instr)->body);
+                break;
+
+            case HLSL_IR_SWITCH:
+            {
+                struct hlsl_ir_switch *s = hlsl_ir_switch(instr);
+                struct hlsl_ir_switch_case *c;
+
+                LIST_FOR_EACH_ENTRY(c, &s->cases, struct hlsl_ir_switch_case, entry)
+                {
+                    progress |= remove_unused_values(ctx, &c->body);
+                }
+                break;
+            }
+
+            case HLSL_IR_CALL:
+            case HLSL_IR_JUMP:
+            case HLSL_IR_RESOURCE_STORE:
+            case HLSL_IR_STORE:
+                break;
+        }
+    }
+
+    return progress;
+}
+
 static void dump_function(struct rb_entry *entry, void *context)
 {
     struct hlsl_ir_function *func = RB_ENTRY_VALUE(entry, struct hlsl_ir_function, entry);
@@ -4971,33 +5207,111 @@ void hlsl_prepend_global_uniform_copy(struct hlsl_ctx *ctx, struct hlsl_block *b
     }
 }
 
+static void pass_stats_begin(struct hlsl_ctx *ctx)
+{
+    if (ctx->config_flags & VKD3D_SHADER_CONFIG_FLAG_PASS_STATS)
+        ctx->pass_stats.start_time = vkd3d_get_time_ns();
+}
+
+static bool pass_stats_end(struct hlsl_ctx *ctx, const char *name, bool progress)
+{
+    struct hlsl_pass_stats *stats = NULL;
+    uint64_t time;
+    size_t i;
+
+    if (!(ctx->config_flags & VKD3D_SHADER_CONFIG_FLAG_PASS_STATS))
+        return progress;
+    time = vkd3d_get_time_ns() - ctx->pass_stats.start_time;
+
+    /* Names are string literals, so comparing pointers is enough. */
+    for (i = 0; i < ctx->pass_stats.count; ++i)
+    {
+        if (ctx->pass_stats.stats[i].name == name)
+        {
+            stats = &ctx->pass_stats.stats[i];
+            break;
+        }
+    }
+
+    if (!stats)
+    {
+        if (!hlsl_array_reserve(ctx, (void **)&ctx->pass_stats.stats, &ctx->pass_stats.capacity,
+                ctx->pass_stats.count + 1, sizeof(*ctx->pass_stats.stats)))
+            return progress;
+        stats = &ctx->pass_stats.stats[ctx->pass_stats.count++];
+        memset(stats, 0, sizeof(*stats));
+        stats->name = name;
+    }
+
+    ++stats->run_count;
+    if (progress)
+        ++stats->progress_count;
+    stats->time += time;
+
+    return progress;
+}
+
+static void pass_stats_dump(struct hlsl_ctx *ctx, uint64_t start_time)
+{
+    const struct hlsl_pass_stats *stats;
+    size_t i;
+
+    if (!(ctx->config_flags & VKD3D_SHADER_CONFIG_FLAG_PASS_STATS))
+        return;
+
+    for (i = 0; i < ctx->pass_stats.count; ++i)
+    {
+        stats = &ctx->pass_stats.stats[i];
+        vkd3d_dbg_printf(VKD3D_DBG_LEVEL_NONE, __FUNCTION__,
+                "%s: %u runs, %u with progress, %"PRIu64" ns.\n",
+                stats->name, stats->run_count, stats->progress_count, stats->time);
+    }
+    vkd3d_dbg_printf(VKD3D_DBG_LEVEL_NONE, __FUNCTION__,
+            "Total: %"PRIu64" ns.\n", vkd3d_get_time_ns() - start_time);
+}
+
+/* Run a pass, recording statistics for it if requested. Passes are not
+ * nested, so a single start time in the context is enough. */
+#define RUN_PASS(ctx, name, pass) (pass_stats_begin(ctx), pass_stats_end(ctx, name, (pass)))
+#define RUN_TRANSFORM_IR(ctx, func, block, context) RUN_PASS(ctx, #func, hlsl_transform_ir(ctx, func, block, context))
+#define RUN_LOWER_IR(ctx, func, block) RUN_PASS(ctx, #func, lower_ir(ctx, func, block))
+#define RUN_TRANSFORM_DEREFS(ctx, func, block) RUN_PASS(ctx, #func, transform_derefs(ctx, func, block))
+
 int hlsl_emit_bytecode(struct hlsl_ctx *ctx, struct hlsl_ir_function_decl *entry_func,
         enum vkd3d_shader_target_type target_type, struct vkd3d_shader_code *out)
 {
     const struct hlsl_profile_info *profile = ctx->profile;
     struct hlsl_block *const body = &entry_func->body;
     struct recursive_call_ctx recursive_call_ctx;
+    uint64_t start_time = 0;
     struct hlsl_ir_var *var;
     unsigned int i;
     bool progress;
+    int ret;
+
+    if (ctx->config_flags & VKD3D_SHADER_CONFIG_FLAG_PASS_STATS)
+        start_time = vkd3d_get_time_ns();
 
     list_move_head(&body->instrs, &ctx->static_initializers.instrs);
 
     memset(&recursive_call_ctx, 0, sizeof(recursive_call_ctx));
-    hlsl_transform_ir(ctx, find_recursive_calls, body, &recursive_call_ctx);
+    RUN_TRANSFORM_IR(ctx, find_recursive_calls, body, &recursive_call_ctx);
     vkd3d_free(recursive_call_ctx.backtrace);
 
     /* Avoid going into an infinite loop when processing call instructions.
      * lower_return() recurses into inferior calls. */
     if (ctx->result)
-        return ctx->result;
+    {
+        ret = ctx->result;
+        goto done;
+    }
 
     lower_return(ctx, entry_func, body, false);
 
-    while (hlsl_transform_ir(ctx, lower_calls, body, NULL));
+    while (RUN_TRANSFORM_IR(ctx, lower_calls, body, NULL));
 
-    lower_ir(ctx, lower_matrix_swizzles, body);
-    lower_ir(ctx, lower_index_loads, body);
+    RUN_LOWER_IR(ctx, lower_matrix_swizzles, body);
+    RUN_LOWER_IR(ctx, lower_index_loads, body);
 
     hlsl_prepend_global_uniform_copy(ctx, body);
 
@@ -5054,84 +5368,94 @@ int hlsl_emit_bytecode(struct hlsl_ctx *ctx, struct hlsl_ir_function_decl *entry
 
     if (profile->major_version >= 4)
     {
-        hlsl_transform_ir(ctx, lower_discard_neg, body, NULL);
+        RUN_TRANSFORM_IR(ctx, lower_discard_neg, body, NULL);
     }
-    lower_ir(ctx, lower_broadcasts, body);
-    while (hlsl_transform_ir(ctx, fold_redundant_casts, body, NULL));
+    RUN_LOWER_IR(ctx, lower_broadcasts, body);
+    while (RUN_TRANSFORM_IR(ctx, fold_redundant_casts, body, NULL));
     do
     {
-        progress = hlsl_transform_ir(ctx, split_array_copies, body, NULL);
-        progress |= hlsl_transform_ir(ctx, split_struct_copies, body, NULL);
+        progress = RUN_TRANSFORM_IR(ctx, split_array_copies, body, NULL);
+        progress |= RUN_TRANSFORM_IR(ctx, split_struct_copies, body, NULL);
     }
     while (progress);
-    hlsl_transform_ir(ctx, split_matrix_copies, body, NULL);
-
-    lower_ir(ctx, lower_narrowing_casts, body);
-    lower_ir(ctx, lower_casts_to_bool, body);
-    lower_ir(ctx, lower_int_dot, body);
-    lower_ir(ctx, lower_int_division, body);
-    lower_ir(ctx, lower_int_modulus, body);
-    lower_ir(ctx, lower_int_abs, body);
-    lower_ir(ctx, lower_float_modulus, body);
-    hlsl_transform_ir(ctx, fold_redundant_casts, body, NULL);
+    RUN_TRANSFORM_IR(ctx, split_matrix_copies, body, NULL);
+
+    RUN_LOWER_IR(ctx, lower_narrowing_casts, body);
+    RUN_LOWER_IR(ctx, lower_casts_to_bool, body);
+    RUN_LOWER_IR(ctx, lower_int_dot, body);
+    RUN_LOWER_IR(ctx, lower_int_division, body);
+    RUN_LOWER_IR(ctx, lower_int_modulus, body);
+    RUN_LOWER_IR(ctx, lower_int_abs, body);
+    RUN_LOWER_IR(ctx, lower_float_modulus, body);
+    RUN_TRANSFORM_IR(ctx, fold_redundant_casts, body, NULL);
     do
     {
-        progress = hlsl_transform_ir(ctx, hlsl_fold_constant_exprs, body, NULL);
-        progress |= hlsl_transform_ir(ctx, hlsl_fold_constant_swizzles, body, NULL);
-        progress |= hlsl_copy_propagation_execute(ctx, body);
-        progress |= hlsl_transform_ir(ctx, fold_swizzle_chains, body, NULL);
-        progress |= hlsl_transform_ir(ctx, remove_trivial_swizzles, body, NULL);
-        progress |= hlsl_transform_ir(ctx, remove_trivial_conditional_branches, body, NULL);
+        progress = RUN_TRANSFORM_IR(ctx, hlsl_fold_constant_exprs, body, NULL);
+        progress |= RUN_TRANSFORM_IR(ctx, hlsl_fold_constant_swizzles, body, NULL);
+        progress |= RUN_PASS(ctx, "copy_propagation", hlsl_copy_propagation_execute(ctx, body));
+        progress |= RUN_TRANSFORM_IR(ctx, fold_swizzle_chains, body, NULL);
+        progress |= RUN_TRANSFORM_IR(ctx, remove_trivial_swizzles, body, NULL);
+        progress |= RUN_TRANSFORM_IR(ctx, remove_trivial_conditional_branches, body, NULL);
+        progress |= RUN_PASS(ctx, "vectorize_stores", vectorize_stores(ctx, body));
     }
     while (progress);
+    pass_stats_begin(ctx);
     remove_unreachable_code(ctx, body);
-    hlsl_transform_ir(ctx, normalize_switch_cases, body, NULL);
+    pass_stats_end(ctx, "remove_unreachable_code", false);
+    RUN_TRANSFORM_IR(ctx, normalize_switch_cases, body, NULL);
 
-    lower_ir(ctx, lower_nonconstant_vector_derefs, body);
-    lower_ir(ctx, lower_casts_to_bool, body);
-    lower_ir(ctx, lower_int_dot, body);
+    RUN_LOWER_IR(ctx, lower_nonconstant_vector_derefs, body);
+    RUN_LOWER_IR(ctx, lower_casts_to_bool, body);
+    RUN_LOWER_IR(ctx, lower_int_dot, body);
 
-    hlsl_transform_ir(ctx, validate_static_object_references, body, NULL);
-    hlsl_transform_ir(ctx, track_object_components_sampler_dim, body, NULL);
+    RUN_TRANSFORM_IR(ctx, validate_static_object_references, body, NULL);
+    RUN_TRANSFORM_IR(ctx, track_object_components_sampler_dim, body, NULL);
     if (profile->major_version >= 4)
-        hlsl_transform_ir(ctx, lower_combined_samples, body, NULL);
-    hlsl_transform_ir(ctx, track_object_components_usage, body, NULL);
+        RUN_TRANSFORM_IR(ctx, lower_combined_samples, body, NULL);
+    RUN_TRANSFORM_IR(ctx, track_object_components_usage, body, NULL);
     sort_synthetic_separated_samplers_first(ctx);
 
-    lower_ir(ctx, lower_ternary, body);
+    RUN_LOWER_IR(ctx, lower_ternary, body);
     if (profile->major_version < 4)
     {
-        lower_ir(ctx, lower_casts_to_int, body);
-        lower_ir(ctx, lower_division, body);
-        lower_ir(ctx, lower_sqrt, body);
-        lower_ir(ctx, lower_dot, body);
-        lower_ir(ctx, lower_round, body);
-        lower_ir(ctx, lower_ceil, body);
-        lower_ir(ctx, lower_floor, body);
+        RUN_LOWER_IR(ctx, lower_casts_to_int, body);
+        RUN_LOWER_IR(ctx, lower_division, body);
+        RUN_LOWER_IR(ctx, lower_sqrt, body);
+        RUN_LOWER_IR(ctx, lower_dot, body);
+        RUN_LOWER_IR(ctx, lower_round, body);
+        RUN_LOWER_IR(ctx, lower_ceil, body);
+        RUN_LOWER_IR(ctx, lower_floor, body);
     }
 
     if (profile->major_version < 2)
     {
-        lower_ir(ctx, lower_abs, body);
+        RUN_LOWER_IR(ctx, lower_abs, body);
     }
 
-    lower_ir(ctx, validate_nonconstant_vector_store_derefs, body);
+    RUN_LOWER_IR(ctx, validate_nonconstant_vector_store_derefs, body);
 
     /* TODO: move forward, remove when no longer needed */
-    transform_derefs(ctx, replace_deref_path_with_offset, body);
-    while (hlsl_transform_ir(ctx, hlsl_fold_constant_exprs, body, NULL));
-    transform_derefs(ctx, clean_constant_deref_offset_srcs, body);
+    RUN_TRANSFORM_DEREFS(ctx, replace_deref_path_with_offset, body);
+    while (RUN_TRANSFORM_IR(ctx, hlsl_fold_constant_exprs, body, NULL));
+    RUN_TRANSFORM_DEREFS(ctx, clean_constant_deref_offset_srcs, body);
 
+    RUN_PASS(ctx, "remove_unused_values", remove_unused_values(ctx, body));
     do
+    {
+        pass_stats_begin(ctx);
         compute_liveness(ctx, entry_func);
-    while (hlsl_transform_ir(ctx, dce, body, NULL));
+        pass_stats_end(ctx, "compute_liveness", false);
+    }
+    while (RUN_TRANSFORM_IR(ctx, dce, body, NULL));
 
     compute_liveness(ctx, entry_func);
 
     if (TRACE_ON())
         rb_for_each_entry(&ctx->functions, dump_function, ctx);
 
-    transform_derefs(ctx, mark_indexable_vars, body);
+    RUN_TRANSFORM_DEREFS(ctx, mark_indexable_vars, body);
+
+    pass_stats_begin(ctx);
 
     calculate_resource_register_counts(ctx);
 
@@ -5151,19 +5475,33 @@ int hlsl_emit_bytecode(struct hlsl_ctx *ctx, struct hlsl_ir_function_decl *entry
     allocate_semantic_registers(ctx);
     allocate_objects(ctx, HLSL_REGSET_SAMPLERS);
 
+    pass_stats_end(ctx, "allocate_registers", false);
+
     if (ctx->result)
-        return ctx->result;
+    {
+        ret = ctx->result;
+        goto done;
+    }
 
+    pass_stats_begin(ctx);
     switch (target_type)
     {
         case VKD3D_SHADER_TARGET_D3D_BYTECODE:
-            return hlsl_sm1_write(ctx, entry_func, out);
+            ret = hlsl_sm1_write(ctx, entry_func, out);
+            break;
 
         case VKD3D_SHADER_TARGET_DXBC_TPF:
-            return hlsl_sm4_write(ctx, entry_func, out);
+            ret = hlsl_sm4_write(ctx, entry_func, out);
+            break;
 
         default:
             ERR("Unsupported shader target type %#x.\n", target_type);
-            return VKD3D_ERROR_INVALID_ARGUMENT;
+            ret = VKD3D_ERROR_INVALID_ARGUMENT;
+            break;
     }
+    pass_stats_end(ctx, "write_bytecode", false);
+
+done:
+    pass_stats_dump(ctx, start_time);
+    return ret;
 }
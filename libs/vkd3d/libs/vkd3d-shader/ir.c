@@ -91,87 +91,120 @@ static bool vsir_instruction_init_with_params(struct vsir_program *program,
     return true;
 }
 
-static enum vkd3d_result instruction_array_lower_texkills(struct vkd3d_shader_parser *parser)
+static bool vsir_program_lower_texkill(struct vsir_program *program,
+        const struct vkd3d_shader_instruction *texkill_ins, struct vkd3d_shader_instruction *ins,
+        unsigned int components_read, unsigned int tmp_idx)
 {
-    struct vsir_program *program = &parser->program;
-    struct vkd3d_shader_instruction_array *instructions = &program->instructions;
-    struct vkd3d_shader_instruction *texkill_ins, *ins;
-    unsigned int components_read = 3 + (program->shader_version.major >= 2);
-    unsigned int tmp_idx = ~0u;
-    unsigned int i, k;
+    unsigned int k;
 
-    for (i = 0; i < instructions->count; ++i)
-    {
-        texkill_ins = &instructions->elements[i];
+    /* tmp = ins->dst[0] < 0  */
 
-        if (texkill_ins->handler_idx != VKD3DSIH_TEXKILL)
-            continue;
+    if (!vsir_instruction_init_with_params(program, ins, &texkill_ins->location, VKD3DSIH_LTO, 1, 2))
+        return false;
 
-        if (!shader_instruction_array_insert_at(instructions, i + 1, components_read + 1))
-            return VKD3D_ERROR_OUT_OF_MEMORY;
+    vsir_register_init(&ins->dst[0].reg, VKD3DSPR_TEMP, VKD3D_DATA_UINT, 1);
+    ins->dst[0].reg.dimension = VSIR_DIMENSION_VEC4;
+    ins->dst[0].reg.idx[0].offset = tmp_idx;
+    ins->dst[0].write_mask = VKD3DSP_WRITEMASK_ALL;
 
-        if (tmp_idx == ~0u)
-            tmp_idx = program->temp_count++;
+    ins->src[0].reg = texkill_ins->dst[0].reg;
+    vsir_register_init(&ins->src[1].reg, VKD3DSPR_IMMCONST, VKD3D_DATA_FLOAT, 0);
+    ins->src[1].reg.dimension = VSIR_DIMENSION_VEC4;
+    ins->src[1].reg.u.immconst_f32[0] = 0.0f;
+    ins->src[1].reg.u.immconst_f32[1] = 0.0f;
+    ins->src[1].reg.u.immconst_f32[2] = 0.0f;
+    ins->src[1].reg.u.immconst_f32[3] = 0.0f;
 
-        /* tmp = ins->dst[0] < 0  */
+    /* tmp.x = tmp.x || tmp.y */
+    /* tmp.x = tmp.x || tmp.z */
+    /* tmp.x = tmp.x || tmp.w, if sm >= 2.0 */
 
-        ins = &instructions->elements[i + 1];
-        if (!vsir_instruction_init_with_params(program, ins, &texkill_ins->location, VKD3DSIH_LTO, 1, 2))
-            return VKD3D_ERROR_OUT_OF_MEMORY;
+    for (k = 1; k < components_read; ++k)
+    {
+        ++ins;
+        if (!(vsir_instruction_init_with_params(program, ins, &texkill_ins->location, VKD3DSIH_OR, 1, 2)))
+            return false;
 
         vsir_register_init(&ins->dst[0].reg, VKD3DSPR_TEMP, VKD3D_DATA_UINT, 1);
         ins->dst[0].reg.dimension = VSIR_DIMENSION_VEC4;
         ins->dst[0].reg.idx[0].offset = tmp_idx;
-        ins->dst[0].write_mask = VKD3DSP_WRITEMASK_ALL;
+        ins->dst[0].write_mask = VKD3DSP_WRITEMASK_0;
 
-        ins->src[0].reg = texkill_ins->dst[0].reg;
-        vsir_register_init(&ins->src[1].reg, VKD3DSPR_IMMCONST, VKD3D_DATA_FLOAT, 0);
+        vsir_register_init(&ins->src[0].reg, VKD3DSPR_TEMP, VKD3D_DATA_UINT, 1);
+        ins->src[0].reg.dimension = VSIR_DIMENSION_VEC4;
+        ins->src[0].reg.idx[0].offset = tmp_idx;
+        ins->src[0].swizzle = VKD3D_SHADER_SWIZZLE(X, X, X, X);
+        vsir_register_init(&ins->src[1].reg, VKD3DSPR_TEMP, VKD3D_DATA_UINT, 1);
         ins->src[1].reg.dimension = VSIR_DIMENSION_VEC4;
-        ins->src[1].reg.u.immconst_f32[0] = 0.0f;
-        ins->src[1].reg.u.immconst_f32[1] = 0.0f;
-        ins->src[1].reg.u.immconst_f32[2] = 0.0f;
-        ins->src[1].reg.u.immconst_f32[3] = 0.0f;
+        ins->src[1].reg.idx[0].offset = tmp_idx;
+        ins->src[1].swizzle = vkd3d_shader_create_swizzle(k, k, k, k);
+    }
 
-        /* tmp.x = tmp.x || tmp.y */
-        /* tmp.x = tmp.x || tmp.z */
-        /* tmp.x = tmp.x || tmp.w, if sm >= 2.0 */
+    /* discard_nz tmp.x */
 
-        for (k = 1; k < components_read; ++k)
-        {
-            ins = &instructions->elements[i + 1 + k];
-            if (!(vsir_instruction_init_with_params(program, ins, &texkill_ins->location, VKD3DSIH_OR, 1, 2)))
-                return VKD3D_ERROR_OUT_OF_MEMORY;
+    ++ins;
+    if (!(vsir_instruction_init_with_params(program, ins, &texkill_ins->location, VKD3DSIH_DISCARD, 0, 1)))
+        return false;
+    ins->flags = VKD3D_SHADER_CONDITIONAL_OP_NZ;
 
-            vsir_register_init(&ins->dst[0].reg, VKD3DSPR_TEMP, VKD3D_DATA_UINT, 1);
-            ins->dst[0].reg.dimension = VSIR_DIMENSION_VEC4;
-            ins->dst[0].reg.idx[0].offset = tmp_idx;
-            ins->dst[0].write_mask = VKD3DSP_WRITEMASK_0;
-
-            vsir_register_init(&ins->src[0].reg, VKD3DSPR_TEMP, VKD3D_DATA_UINT, 1);
-            ins->src[0].reg.dimension = VSIR_DIMENSION_VEC4;
-            ins->src[0].reg.idx[0].offset = tmp_idx;
-            ins->src[0].swizzle = VKD3D_SHADER_SWIZZLE(X, X, X, X);
-            vsir_register_init(&ins->src[1].reg, VKD3DSPR_TEMP, VKD3D_DATA_UINT, 1);
-            ins->src[1].reg.dimension = VSIR_DIMENSION_VEC4;
-            ins->src[1].reg.idx[0].offset = tmp_idx;
-            ins->src[1].swizzle = vkd3d_shader_create_swizzle(k, k, k, k);
-        }
+    vsir_register_init(&ins->src[0].reg, VKD3DSPR_TEMP, VKD3D_DATA_UINT, 1);
+    ins->src[0].reg.dimension = VSIR_DIMENSION_VEC4;
+    ins->src[0].reg.idx[0].offset = tmp_idx;
+    ins->src[0].swizzle = VKD3D_SHADER_SWIZZLE(X, X, X, X);
 
-        /* discard_nz tmp.x */
+    return true;
+}
 
-        ins = &instructions->elements[i + 1 + components_read];
-        if (!(vsir_instruction_init_with_params(program, ins, &texkill_ins->location, VKD3DSIH_DISCARD, 0, 1)))
-            return VKD3D_ERROR_OUT_OF_MEMORY;
-        ins->flags = VKD3D_SHADER_CONDITIONAL_OP_NZ;
+static enum vkd3d_result instruction_array_lower_texkills(struct vkd3d_shader_parser *parser)
+{
+    struct vsir_program *program = &parser->program;
+    struct vkd3d_shader_instruction_array *instructions = &program->instructions;
+    unsigned int components_read = 3 + (program->shader_version.major >= 2);
+    size_t i, texkill_count = 0, dst_idx;
+    struct vkd3d_shader_instruction *ins;
+    unsigned int tmp_idx;
 
-        vsir_register_init(&ins->src[0].reg, VKD3DSPR_TEMP, VKD3D_DATA_UINT, 1);
-        ins->src[0].reg.dimension = VSIR_DIMENSION_VEC4;
-        ins->src[0].reg.idx[0].offset = tmp_idx;
-        ins->src[0].swizzle = VKD3D_SHADER_SWIZZLE(X, X, X, X);
+    for (i = 0; i < instructions->count; ++i)
+    {
+        if (instructions->elements[i].handler_idx == VKD3DSIH_TEXKILL)
+            ++texkill_count;
+    }
+
+    if (!texkill_count)
+        return VKD3D_OK;
+
+    /* Each texkill is followed by "components_read + 1" new instructions.
+     * Grow the array once, and then move instructions into place working
+     * backwards from the end, instead of inserting at each texkill; the
+     * latter is quadratic in the number of instructions. */
+    dst_idx = instructions->count + texkill_count * (components_read + 1);
+    if (!shader_instruction_array_reserve(instructions, dst_idx))
+        return VKD3D_ERROR_OUT_OF_MEMORY;
+
+    tmp_idx = program->temp_count++;
+
+    for (i = instructions->count; i--;)
+    {
+        ins = &instructions->elements[i];
+
+        if (ins->handler_idx == VKD3DSIH_TEXKILL)
+        {
+            /* The destination slots are always after "i", so "ins" is still intact. */
+            dst_idx -= components_read + 1;
+            if (!vsir_program_lower_texkill(program, ins, &instructions->elements[dst_idx],
+                    components_read, tmp_idx))
+                return VKD3D_ERROR_OUT_OF_MEMORY;
 
-        /* Make the original instruction no-op */
-        vkd3d_shader_instruction_make_nop(texkill_ins);
+            /* Make the original instruction no-op */
+            vkd3d_shader_instruction_make_nop(ins);
+        }
+
+        if (--dst_idx != i)
+            instructions->elements[dst_idx] = *ins;
     }
+    assert(dst_idx == 0);
+
+    instructions->count += texkill_count * (components_read + 1);
 
     return VKD3D_OK;
 }
@@ -3322,33 +3355,95 @@ static void vsir_cfg_compute_dominators(struct vsir_cfg *cfg)
         vkd3d_string_buffer_cleanup(&buf);
 }
 
+/* Per-pass statistics, enabled with VKD3D_SHADER_CONFIG=pass_stats. Running
+ * a corpus of shaders through the compiler with this set gives a profile of
+ * where compilation time and memory go. The instruction array capacity, and
+ * whether the array moved, show which passes reallocate it. */
+struct vsir_pass_stats
+{
+    const struct vkd3d_shader_parser *parser;
+    const char *name;
+    uint64_t start_time;
+    size_t instruction_count;
+    size_t capacity;
+    const struct vkd3d_shader_instruction *elements;
+};
+
+static size_t vsir_program_get_memory_size(const struct vsir_program *program)
+{
+    const struct vkd3d_shader_instruction_array *instructions = &program->instructions;
+
+    return instructions->capacity * sizeof(*instructions->elements)
+            + instructions->src_params.size + instructions->dst_params.size;
+}
+
+static void vsir_pass_stats_begin(struct vsir_pass_stats *stats,
+        const struct vkd3d_shader_parser *parser, const char *name)
+{
+    stats->parser = parser;
+    stats->name = name;
+    if (!(parser->config_flags & VKD3D_SHADER_CONFIG_FLAG_PASS_STATS))
+        return;
+    stats->instruction_count = parser->program.instructions.count;
+    stats->capacity = parser->program.instructions.capacity;
+    stats->elements = parser->program.instructions.elements;
+    stats->start_time = vkd3d_get_time_ns();
+}
+
+static void vsir_pass_stats_end(const struct vsir_pass_stats *stats)
+{
+    const struct vkd3d_shader_parser *parser = stats->parser;
+    const struct vkd3d_shader_instruction_array *instructions;
+    uint64_t time;
+
+    if (!(parser->config_flags & VKD3D_SHADER_CONFIG_FLAG_PASS_STATS))
+        return;
+    time = vkd3d_get_time_ns() - stats->start_time;
+    instructions = &parser->program.instructions;
+
+    vkd3d_dbg_printf(VKD3D_DBG_LEVEL_NONE, __FUNCTION__,
+            "%s: %"PRIu64" ns, %zu -> %zu instructions, capacity %zu -> %zu%s, %zu bytes.\n",
+            stats->name, time, stats->instruction_count, instructions->count,
+            stats->capacity, instructions->capacity,
+            instructions->elements != stats->elements ? " (moved)" : "",
+            vsir_program_get_memory_size(&parser->program));
+}
+
+#define VSIR_RUN_PASS(stats, parser, pass) \
+        (vsir_pass_stats_begin(stats, parser, #pass), result = (pass), vsir_pass_stats_end(stats), result)
+
 enum vkd3d_result vkd3d_shader_normalise(struct vkd3d_shader_parser *parser,
         const struct vkd3d_shader_compile_info *compile_info)
 {
     struct vkd3d_shader_instruction_array *instructions = &parser->program.instructions;
     enum vkd3d_result result = VKD3D_OK;
+    struct vsir_pass_stats stats;
 
+    vsir_pass_stats_begin(&stats, parser, "remove_dcl_temps");
     remove_dcl_temps(&parser->program);
+    vsir_pass_stats_end(&stats);
 
-    if ((result = instruction_array_lower_texkills(parser)) < 0)
+    if (VSIR_RUN_PASS(&stats, parser, instruction_array_lower_texkills(parser)) < 0)
         return result;
 
     if (parser->shader_desc.is_dxil)
     {
         struct vsir_cfg cfg;
 
-        if ((result = lower_switch_to_if_ladder(&parser->program)) < 0)
+        if (VSIR_RUN_PASS(&stats, parser, lower_switch_to_if_ladder(&parser->program)) < 0)
             return result;
 
-        if ((result = materialize_ssas_to_temps(parser)) < 0)
+        if (VSIR_RUN_PASS(&stats, parser, materialize_ssas_to_temps(parser)) < 0)
             return result;
 
         if ((result = vsir_cfg_init(&cfg, &parser->program)) < 0)
             return result;
 
+        vsir_pass_stats_begin(&stats, parser, "vsir_cfg_compute_dominators");
         vsir_cfg_compute_dominators(&cfg);
+        vsir_pass_stats_end(&stats);
 
-        if ((result = simple_structurizer_run(parser)) < 0)
+        if (VSIR_RUN_PASS(&stats, parser, simple_structurizer_run(parser)) < 0)
         {
             vsir_cfg_cleanup(&cfg);
             return result;
@@ -3360,33 +3455,35 @@ enum vkd3d_result vkd3d_shader_normalise(struct vkd3d_shader_parser *parser,
     {
         if (parser->program.shader_version.type != VKD3D_SHADER_TYPE_PIXEL)
         {
-            if ((result = remap_output_signature(parser, compile_info)) < 0)
+            if (VSIR_RUN_PASS(&stats, parser, remap_output_signature(parser, compile_info)) < 0)
                 return result;
         }
 
         if (parser->program.shader_version.type == VKD3D_SHADER_TYPE_HULL)
         {
-            if ((result = instruction_array_flatten_hull_shader_phases(instructions)) < 0)
+            if (VSIR_RUN_PASS(&stats, parser, instruction_array_flatten_hull_shader_phases(instructions)) < 0)
                 return result;
 
-            if ((result = instruction_array_normalise_hull_shader_control_point_io(instructions,
-                    &parser->shader_desc.input_signature)) < 0)
+            if (VSIR_RUN_PASS(&stats, parser, instruction_array_normalise_hull_shader_control_point_io(
+                    instructions, &parser->shader_desc.input_signature)) < 0)
                 return result;
         }
 
-        if ((result = shader_normalise_io_registers(parser)) < 0)
+        if (VSIR_RUN_PASS(&stats, parser, shader_normalise_io_registers(parser)) < 0)
             return result;
 
-        if ((result = instruction_array_normalise_flat_constants(&parser->program)) < 0)
+        if (VSIR_RUN_PASS(&stats, parser, instruction_array_normalise_flat_constants(&parser->program)) < 0)
             return result;
 
+        vsir_pass_stats_begin(&stats, parser, "remove_dead_code");
         remove_dead_code(&parser->program);
+        vsir_pass_stats_end(&stats);
 
-        if ((result = normalise_combined_samplers(parser)) < 0)
+        if (VSIR_RUN_PASS(&stats, parser, normalise_combined_samplers(parser)) < 0)
             return result;
     }
 
-    if ((result = flatten_control_flow_constructs(parser)) < 0)
+    if (VSIR_RUN_PASS(&stats, parser, flatten_control_flow_constructs(parser)) < 0)
         return result;
 
     if (TRACE_ON())
@@ -10034,8 +10034,12 @@ int spirv_compile(struct vkd3d_shader_parser *parser,
         struct vkd3d_shader_code *out, struct vkd3d_shader_message_context *message_context)
 {
     struct spirv_compiler *spirv_compiler;
+    uint64_t start_time = 0;
     int ret;
 
+    if (parser->config_flags & VKD3D_SHADER_CONFIG_FLAG_PASS_STATS)
+        start_time = vkd3d_get_time_ns();
+
     if (!(spirv_compiler = spirv_compiler_create(&parser->program.shader_version, &parser->shader_desc,
             compile_info, scan_descriptor_info, message_context, &parser->location, parser->config_flags)))
     {
@@ -10045,6 +10049,11 @@ int spirv_compile(struct vkd3d_shader_parser *parser,
 
     ret = spirv_compiler_generate_spirv(spirv_compiler, compile_info, parser, out);
 
+    if (parser->config_flags & VKD3D_SHADER_CONFIG_FLAG_PASS_STATS)
+        vkd3d_dbg_printf(VKD3D_DBG_LEVEL_NONE, __FUNCTION__,
+                "%"PRIu64" ns, %zu bytes of code.\n",
+                vkd3d_get_time_ns() - start_time, ret < 0 ? 0 : out->size);
+
     spirv_compiler_destroy(spirv_compiler);
     return ret;
 }
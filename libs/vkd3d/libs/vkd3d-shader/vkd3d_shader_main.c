@@ -518,9 +518,10 @@ static void init_scan_signature_info(const struct vkd3d_shader_compile_info *inf
 static const struct vkd3d_debug_option vkd3d_shader_config_options[] =
 {
     {"force_validation", VKD3D_SHADER_CONFIG_FLAG_FORCE_VALIDATION}, /* force validation of internal shader representations */
+    {"pass_stats", VKD3D_SHADER_CONFIG_FLAG_PASS_STATS}, /* report time and memory used by each compilation pass */
 };
 
-static uint64_t vkd3d_shader_init_config_flags(void)
+uint64_t vkd3d_shader_init_config_flags(void)
 {
     uint64_t config_flags;
     const char *config;
@@ -2021,6 +2022,7 @@ static struct vkd3d_shader_param_node *shader_param_allocator_node_create(
     if (!(node = vkd3d_malloc(offsetof(struct vkd3d_shader_param_node, param[allocator->count * allocator->stride]))))
         return NULL;
     node->next = NULL;
+    allocator->size += allocator->count * allocator->stride;
     return node;
 }
 
@@ -2032,6 +2034,7 @@ static void shader_param_allocator_init(struct vkd3d_shader_param_allocator *all
     allocator->head = NULL;
     allocator->current = NULL;
     allocator->index = allocator->count;
+    allocator->size = 0;
 }
 
 static void shader_param_allocator_destroy(struct vkd3d_shader_param_allocator *allocator)
@@ -1239,6 +1239,7 @@ struct vkd3d_shader_param_allocator
     unsigned int count;
     unsigned int stride;
     unsigned int index;
+    size_t size;
 };
 
 void *shader_param_allocator_get(struct vkd3d_shader_param_allocator *allocator, unsigned int count);
@@ -1283,6 +1284,7 @@ void shader_instruction_array_destroy(struct vkd3d_shader_instruction_array *ins
 enum vkd3d_shader_config_flags
 {
     VKD3D_SHADER_CONFIG_FLAG_FORCE_VALIDATION = 0x00000001,
+    VKD3D_SHADER_CONFIG_FLAG_PASS_STATS = 0x00000002,
 };
 
 struct vsir_program
@@ -1335,6 +1337,7 @@ struct vkd3d_shader_parser_ops
 
 void vkd3d_shader_parser_error(struct vkd3d_shader_parser *parser,
         enum vkd3d_shader_error error, const char *format, ...) VKD3D_PRINTF_FUNC(3, 4);
+uint64_t vkd3d_shader_init_config_flags(void);
 bool vkd3d_shader_parser_init(struct vkd3d_shader_parser *parser,
         struct vkd3d_shader_message_context *message_context, const char *source_name,
         const struct vkd3d_shader_version *version, const struct vkd3d_shader_parser_ops *ops,
@@ -0,0 +1,1411 @@
+/*
+ * Pipeline and shader caches
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "vkd3d_private.h"
+
+#include <stdio.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+/* The same format is used for the on-disk device cache and for serialised
+ * pipeline libraries: a header, followed by the pipeline names, the SPIR-V
+ * records, and finally the Vulkan pipeline cache data. */
+#define VKD3D_CACHE_MAGIC       VKD3D_MAKE_TAG('V', 'K', 'C', 'H')
+#define VKD3D_CACHE_VERSION     2
+
+#define VKD3D_SHADER_CACHE_MAX_SIZE (256u * 1024 * 1024)
+
+struct vkd3d_cache_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t driver_version;
+    uint32_t name_count;
+    uint32_t shader_count;
+    uint32_t reserved;
+    uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+    uint64_t compiler_hash;
+    uint64_t name_data_size;
+    uint64_t shader_data_size;
+    uint64_t pipeline_data_size;
+};
+
+struct vkd3d_cache_shader_record
+{
+    struct vkd3d_shader_cache_key key;
+    uint64_t size;
+};
+
+struct vkd3d_cache_blob
+{
+    const uint8_t *names;
+    size_t name_data_size;
+    unsigned int name_count;
+    const uint8_t *shaders;
+    size_t shader_data_size;
+    unsigned int shader_count;
+    const void *pipeline_data;
+    size_t pipeline_data_size;
+};
+
+struct vkd3d_cache_writer
+{
+    uint8_t *data;
+    size_t size;
+    size_t offset;
+};
+
+struct vkd3d_shader_struct
+{
+    enum vkd3d_shader_structure_type type;
+    const void *next;
+};
+
+struct vkd3d_shader_cache_entry
+{
+    struct rb_entry entry;
+    struct list lru_entry;
+    struct vkd3d_shader_cache_key key;
+    size_t size;
+    uint8_t data[];
+};
+
+static void vkd3d_shader_cache_key_init(struct vkd3d_shader_cache_key *key)
+{
+    key->hash[0] = 0xcbf29ce484222325ull;
+    key->hash[1] = 5381;
+    key->size = 0;
+}
+
+static void vkd3d_shader_cache_key_add(struct vkd3d_shader_cache_key *key, const void *data, size_t size)
+{
+    const uint8_t *ptr = data;
+    uint64_t h0 = key->hash[0], h1 = key->hash[1];
+    size_t i;
+
+    /* FNV-1a and djb2, so that the two hashes are reasonably independent. */
+    for (i = 0; i < size; ++i)
+    {
+        h0 = (h0 ^ ptr[i]) * 0x100000001b3ull;
+        h1 = (h1 << 5) + h1 + ptr[i];
+    }
+
+    key->hash[0] = h0;
+    key->hash[1] = h1;
+    key->size += size;
+}
+
+static void vkd3d_shader_cache_key_add_string(struct vkd3d_shader_cache_key *key, const char *str)
+{
+    if (!str)
+        str = "";
+    vkd3d_shader_cache_key_add(key, str, strlen(str) + 1);
+}
+
+#define vkd3d_shader_cache_key_add_array(key, array, count) \
+        vkd3d_shader_cache_key_add(key, array, (count) * sizeof(*(array)))
+
+/* Hashes everything in the compile info that influences the generated code.
+ * Returns false if the structure chain contains something we don't know how
+ * to hash; such shaders are never cached. */
+bool vkd3d_shader_cache_key_init_compile_info(struct vkd3d_shader_cache_key *key,
+        const struct vkd3d_shader_compile_info *compile_info)
+{
+    const struct vkd3d_shader_transform_feedback_info *xfb_info;
+    const struct vkd3d_shader_descriptor_offset_info *offset_info;
+    const struct vkd3d_shader_spirv_target_info *target_info;
+    const struct vkd3d_shader_interface_info *interface_info;
+    unsigned int binding_count = 0, uav_counter_count = 0;
+    const struct vkd3d_shader_struct *s;
+    unsigned int i;
+
+    vkd3d_shader_cache_key_init(key);
+
+    vkd3d_shader_cache_key_add(key, &compile_info->source_type, sizeof(compile_info->source_type));
+    vkd3d_shader_cache_key_add(key, &compile_info->target_type, sizeof(compile_info->target_type));
+    vkd3d_shader_cache_key_add(key, &compile_info->option_count, sizeof(compile_info->option_count));
+    vkd3d_shader_cache_key_add_array(key, compile_info->options, compile_info->option_count);
+    vkd3d_shader_cache_key_add(key, &compile_info->source.size, sizeof(compile_info->source.size));
+    vkd3d_shader_cache_key_add(key, compile_info->source.code, compile_info->source.size);
+
+    for (s = compile_info->next; s; s = s->next)
+    {
+        vkd3d_shader_cache_key_add(key, &s->type, sizeof(s->type));
+
+        switch (s->type)
+        {
+            case VKD3D_SHADER_STRUCTURE_TYPE_INTERFACE_INFO:
+                interface_info = (const struct vkd3d_shader_interface_info *)s;
+                binding_count = interface_info->binding_count;
+                uav_counter_count = interface_info->uav_counter_count;
+                vkd3d_shader_cache_key_add(key, &binding_count, sizeof(binding_count));
+                vkd3d_shader_cache_key_add_array(key, interface_info->bindings, binding_count);
+                vkd3d_shader_cache_key_add(key, &interface_info->push_constant_buffer_count,
+                        sizeof(interface_info->push_constant_buffer_count));
+                vkd3d_shader_cache_key_add_array(key, interface_info->push_constant_buffers,
+                        interface_info->push_constant_buffer_count);
+                vkd3d_shader_cache_key_add(key, &interface_info->combined_sampler_count,
+                        sizeof(interface_info->combined_sampler_count));
+                vkd3d_shader_cache_key_add_array(key, interface_info->combined_samplers,
+                        interface_info->combined_sampler_count);
+                vkd3d_shader_cache_key_add(key, &uav_counter_count, sizeof(uav_counter_count));
+                vkd3d_shader_cache_key_add_array(key, interface_info->uav_counters, uav_counter_count);
+                break;
+
+            case VKD3D_SHADER_STRUCTURE_TYPE_SPIRV_TARGET_INFO:
+                target_info = (const struct vkd3d_shader_spirv_target_info *)s;
+                vkd3d_shader_cache_key_add_string(key, target_info->entry_point);
+                vkd3d_shader_cache_key_add(key, &target_info->environment, sizeof(target_info->environment));
+                vkd3d_shader_cache_key_add(key, &target_info->extension_count, sizeof(target_info->extension_count));
+                vkd3d_shader_cache_key_add_array(key, target_info->extensions, target_info->extension_count);
+                vkd3d_shader_cache_key_add(key, &target_info->parameter_count, sizeof(target_info->parameter_count));
+                vkd3d_shader_cache_key_add_array(key, target_info->parameters, target_info->parameter_count);
+                vkd3d_shader_cache_key_add(key, &target_info->dual_source_blending,
+                        sizeof(target_info->dual_source_blending));
+                vkd3d_shader_cache_key_add(key, &target_info->output_swizzle_count,
+                        sizeof(target_info->output_swizzle_count));
+                vkd3d_shader_cache_key_add_array(key, target_info->output_swizzles, target_info->output_swizzle_count);
+                break;
+
+            case VKD3D_SHADER_STRUCTURE_TYPE_TRANSFORM_FEEDBACK_INFO:
+                xfb_info = (const struct vkd3d_shader_transform_feedback_info *)s;
+                vkd3d_shader_cache_key_add(key, &xfb_info->element_count, sizeof(xfb_info->element_count));
+                for (i = 0; i < xfb_info->element_count; ++i)
+                {
+                    const struct vkd3d_shader_transform_feedback_element *e = &xfb_info->elements[i];
+
+                    vkd3d_shader_cache_key_add(key, &e->stream_index, sizeof(e->stream_index));
+                    vkd3d_shader_cache_key_add_string(key, e->semantic_name);
+                    vkd3d_shader_cache_key_add(key, &e->semantic_index, sizeof(e->semantic_index));
+                    vkd3d_shader_cache_key_add(key, &e->component_index, sizeof(e->component_index));
+                    vkd3d_shader_cache_key_add(key, &e->component_count, sizeof(e->component_count));
+                    vkd3d_shader_cache_key_add(key, &e->output_slot, sizeof(e->output_slot));
+                }
+                vkd3d_shader_cache_key_add(key, &xfb_info->buffer_stride_count,
+                        sizeof(xfb_info->buffer_stride_count));
+                vkd3d_shader_cache_key_add_array(key, xfb_info->buffer_strides, xfb_info->buffer_stride_count);
+                break;
+
+            case VKD3D_SHADER_STRUCTURE_TYPE_DESCRIPTOR_OFFSET_INFO:
+                /* The offset arrays are sized by the interface info, which
+                 * always precedes this structure in the chain. */
+                offset_info = (const struct vkd3d_shader_descriptor_offset_info *)s;
+                vkd3d_shader_cache_key_add(key, &offset_info->descriptor_table_offset,
+                        sizeof(offset_info->descriptor_table_offset));
+                vkd3d_shader_cache_key_add(key, &offset_info->descriptor_table_count,
+                        sizeof(offset_info->descriptor_table_count));
+                if (offset_info->binding_offsets)
+                    vkd3d_shader_cache_key_add_array(key, offset_info->binding_offsets, binding_count);
+                if (offset_info->uav_counter_offsets)
+                    vkd3d_shader_cache_key_add_array(key, offset_info->uav_counter_offsets, uav_counter_count);
+                break;
+
+            default:
+                TRACE("Not caching shader with structure type %#x.\n", s->type);
+                return false;
+        }
+    }
+
+    return true;
+}
+
+#define vkd3d_shader_cache_key_add_value(key, value) vkd3d_shader_cache_key_add(key, &(value), sizeof(value))
+
+static void vkd3d_shader_cache_key_add_bytecode(struct vkd3d_shader_cache_key *key, const D3D12_SHADER_BYTECODE *code)
+{
+    uint64_t size = code->pShaderBytecode ? code->BytecodeLength : 0;
+
+    vkd3d_shader_cache_key_add_value(key, size);
+    vkd3d_shader_cache_key_add(key, code->pShaderBytecode, size);
+}
+
+/* Hashes the parts of a pipeline description that can be compared between
+ * processes. The root signature is not included; structures with padding
+ * are hashed member by member. */
+void vkd3d_pipeline_state_desc_get_key(struct vkd3d_shader_cache_key *key,
+        const struct d3d12_pipeline_state_desc *desc)
+{
+    const D3D12_DEPTH_STENCIL_DESC1 *ds = &desc->depth_stencil_state;
+    unsigned int i;
+
+    vkd3d_shader_cache_key_init(key);
+
+    vkd3d_shader_cache_key_add_bytecode(key, &desc->vs);
+    vkd3d_shader_cache_key_add_bytecode(key, &desc->ps);
+    vkd3d_shader_cache_key_add_bytecode(key, &desc->ds);
+    vkd3d_shader_cache_key_add_bytecode(key, &desc->hs);
+    vkd3d_shader_cache_key_add_bytecode(key, &desc->gs);
+    vkd3d_shader_cache_key_add_bytecode(key, &desc->cs);
+
+    vkd3d_shader_cache_key_add_value(key, desc->stream_output.NumEntries);
+    for (i = 0; i < desc->stream_output.NumEntries; ++i)
+    {
+        const D3D12_SO_DECLARATION_ENTRY *e = &desc->stream_output.pSODeclaration[i];
+
+        vkd3d_shader_cache_key_add_value(key, e->Stream);
+        vkd3d_shader_cache_key_add_string(key, e->SemanticName);
+        vkd3d_shader_cache_key_add_value(key, e->SemanticIndex);
+        vkd3d_shader_cache_key_add_value(key, e->StartComponent);
+        vkd3d_shader_cache_key_add_value(key, e->ComponentCount);
+        vkd3d_shader_cache_key_add_value(key, e->OutputSlot);
+    }
+    vkd3d_shader_cache_key_add_value(key, desc->stream_output.NumStrides);
+    vkd3d_shader_cache_key_add_array(key, desc->stream_output.pBufferStrides, desc->stream_output.NumStrides);
+    vkd3d_shader_cache_key_add_value(key, desc->stream_output.RasterizedStream);
+
+    vkd3d_shader_cache_key_add_value(key, desc->blend_state.AlphaToCoverageEnable);
+    vkd3d_shader_cache_key_add_value(key, desc->blend_state.IndependentBlendEnable);
+    for (i = 0; i < ARRAY_SIZE(desc->blend_state.RenderTarget); ++i)
+    {
+        const D3D12_RENDER_TARGET_BLEND_DESC *rt = &desc->blend_state.RenderTarget[i];
+
+        vkd3d_shader_cache_key_add_value(key, rt->BlendEnable);
+        vkd3d_shader_cache_key_add_value(key, rt->LogicOpEnable);
+        vkd3d_shader_cache_key_add_value(key, rt->SrcBlend);
+        vkd3d_shader_cache_key_add_value(key, rt->DestBlend);
+        vkd3d_shader_cache_key_add_value(key, rt->BlendOp);
+        vkd3d_shader_cache_key_add_value(key, rt->SrcBlendAlpha);
+        vkd3d_shader_cache_key_add_value(key, rt->DestBlendAlpha);
+        vkd3d_shader_cache_key_add_value(key, rt->BlendOpAlpha);
+        vkd3d_shader_cache_key_add_value(key, rt->LogicOp);
+        vkd3d_shader_cache_key_add_value(key, rt->RenderTargetWriteMask);
+    }
+    vkd3d_shader_cache_key_add_value(key, desc->sample_mask);
+    vkd3d_shader_cache_key_add_value(key, desc->rasterizer_state);
+
+    vkd3d_shader_cache_key_add_value(key, ds->DepthEnable);
+    vkd3d_shader_cache_key_add_value(key, ds->DepthWriteMask);
+    vkd3d_shader_cache_key_add_value(key, ds->DepthFunc);
+    vkd3d_shader_cache_key_add_value(key, ds->StencilEnable);
+    vkd3d_shader_cache_key_add_value(key, ds->StencilReadMask);
+    vkd3d_shader_cache_key_add_value(key, ds->StencilWriteMask);
+    vkd3d_shader_cache_key_add_value(key, ds->FrontFace);
+    vkd3d_shader_cache_key_add_value(key, ds->BackFace);
+    vkd3d_shader_cache_key_add_value(key, ds->DepthBoundsTestEnable);
+
+    vkd3d_shader_cache_key_add_value(key, desc->input_layout.NumElements);
+    for (i = 0; i < desc->input_layout.NumElements; ++i)
+    {
+        const D3D12_INPUT_ELEMENT_DESC *e = &desc->input_layout.pInputElementDescs[i];
+
+        vkd3d_shader_cache_key_add_string(key, e->SemanticName);
+        vkd3d_shader_cache_key_add_value(key, e->SemanticIndex);
+        vkd3d_shader_cache_key_add_value(key, e->Format);
+        vkd3d_shader_cache_key_add_value(key, e->InputSlot);
+        vkd3d_shader_cache_key_add_value(key, e->AlignedByteOffset);
+        vkd3d_shader_cache_key_add_value(key, e->InputSlotClass);
+        vkd3d_shader_cache_key_add_value(key, e->InstanceDataStepRate);
+    }
+
+    vkd3d_shader_cache_key_add_value(key, desc->strip_cut_value);
+    vkd3d_shader_cache_key_add_value(key, desc->primitive_topology_type);
+    vkd3d_shader_cache_key_add_value(key, desc->rtv_formats.NumRenderTargets);
+    vkd3d_shader_cache_key_add_array(key, desc->rtv_formats.RTFormats, desc->rtv_formats.NumRenderTargets);
+    vkd3d_shader_cache_key_add_value(key, desc->dsv_format);
+    vkd3d_shader_cache_key_add_value(key, desc->sample_desc);
+    vkd3d_shader_cache_key_add_value(key, desc->view_instancing_desc.ViewInstanceCount);
+    vkd3d_shader_cache_key_add_array(key, desc->view_instancing_desc.pViewInstanceLocations,
+            desc->view_instancing_desc.ViewInstanceCount);
+    vkd3d_shader_cache_key_add_value(key, desc->view_instancing_desc.Flags);
+}
+
+static int vkd3d_shader_cache_compare(const void *key, const struct rb_entry *entry)
+{
+    const struct vkd3d_shader_cache_entry *e = RB_ENTRY_VALUE(entry, const struct vkd3d_shader_cache_entry, entry);
+
+    return memcmp(key, &e->key, sizeof(e->key));
+}
+
+void vkd3d_shader_cache_init(struct vkd3d_shader_cache *cache)
+{
+    vkd3d_mutex_init(&cache->mutex);
+    rb_init(&cache->entries, vkd3d_shader_cache_compare);
+    list_init(&cache->lru);
+    cache->size = 0;
+    cache->count = 0;
+    cache->modified = false;
+    cache->hits = 0;
+    cache->misses = 0;
+}
+
+static void vkd3d_shader_cache_free_entry(struct rb_entry *entry, void *context)
+{
+    vkd3d_free(RB_ENTRY_VALUE(entry, struct vkd3d_shader_cache_entry, entry));
+}
+
+void vkd3d_shader_cache_cleanup(struct vkd3d_shader_cache *cache)
+{
+    TRACE("SPIR-V cache: %u entries, %zu bytes, %u hits, %u misses.\n",
+            cache->count, cache->size, cache->hits, cache->misses);
+
+    rb_destroy(&cache->entries, vkd3d_shader_cache_free_entry, NULL);
+    vkd3d_mutex_destroy(&cache->mutex);
+}
+
+bool vkd3d_shader_cache_get(struct vkd3d_shader_cache *cache,
+        const struct vkd3d_shader_cache_key *key, struct vkd3d_shader_code *code)
+{
+    struct vkd3d_shader_cache_entry *e;
+    struct rb_entry *entry;
+    void *data = NULL;
+
+    vkd3d_mutex_lock(&cache->mutex);
+
+    if ((entry = rb_get(&cache->entries, key)))
+    {
+        e = RB_ENTRY_VALUE(entry, struct vkd3d_shader_cache_entry, entry);
+        if ((data = vkd3d_malloc(e->size)))
+        {
+            memcpy(data, e->data, e->size);
+            code->code = data;
+            code->size = e->size;
+        }
+        list_remove(&e->lru_entry);
+        list_add_head(&cache->lru, &e->lru_entry);
+    }
+
+    if (data)
+        ++cache->hits;
+    else
+        ++cache->misses;
+
+    vkd3d_mutex_unlock(&cache->mutex);
+
+    return !!data;
+}
+
+static void vkd3d_shader_cache_insert(struct vkd3d_shader_cache *cache,
+        const struct vkd3d_shader_cache_key *key, const void *data, size_t size)
+{
+    struct vkd3d_shader_cache_entry *e;
+    struct list *tail;
+
+    if (rb_get(&cache->entries, key))
+        return;
+
+    if (size > VKD3D_SHADER_CACHE_MAX_SIZE)
+        return;
+
+    /* Evict the least recently used entries. */
+    while (cache->size + size > VKD3D_SHADER_CACHE_MAX_SIZE && (tail = list_tail(&cache->lru)))
+    {
+        e = LIST_ENTRY(tail, struct vkd3d_shader_cache_entry, lru_entry);
+        list_remove(&e->lru_entry);
+        rb_remove(&cache->entries, &e->entry);
+        cache->size -= e->size;
+        --cache->count;
+        vkd3d_free(e);
+    }
+
+    if (!(e = vkd3d_malloc(offsetof(struct vkd3d_shader_cache_entry, data[size]))))
+        return;
+
+    e->key = *key;
+    e->size = size;
+    memcpy(e->data, data, size);
+    rb_put(&cache->entries, &e->key, &e->entry);
+    list_add_head(&cache->lru, &e->lru_entry);
+
+    cache->size += size;
+    ++cache->count;
+    cache->modified = true;
+}
+
+void vkd3d_shader_cache_put(struct vkd3d_shader_cache *cache,
+        const struct vkd3d_shader_cache_key *key, const struct vkd3d_shader_code *code)
+{
+    vkd3d_mutex_lock(&cache->mutex);
+    vkd3d_shader_cache_insert(cache, key, code->code, code->size);
+    vkd3d_mutex_unlock(&cache->mutex);
+}
+
+static void vkd3d_cache_writer_write(struct vkd3d_cache_writer *writer, const void *data, size_t size)
+{
+    if (writer->data && writer->offset + size <= writer->size)
+        memcpy(&writer->data[writer->offset], data, size);
+    writer->offset += size;
+}
+
+static bool vkd3d_cache_writer_fits(const struct vkd3d_cache_writer *writer, size_t size)
+{
+    return !writer->data || writer->offset + size <= writer->size;
+}
+
+/* Writes as many records as fit, and returns how many were written. */
+static unsigned int vkd3d_shader_cache_write_records(struct vkd3d_shader_cache *cache,
+        struct vkd3d_cache_writer *writer)
+{
+    struct vkd3d_cache_shader_record record;
+    struct vkd3d_shader_cache_entry *e;
+    unsigned int count = 0;
+
+    vkd3d_mutex_lock(&cache->mutex);
+
+    RB_FOR_EACH_ENTRY(e, &cache->entries, struct vkd3d_shader_cache_entry, entry)
+    {
+        if (!vkd3d_cache_writer_fits(writer, sizeof(record) + e->size))
+            continue;
+
+        record.key = e->key;
+        record.size = e->size;
+        vkd3d_cache_writer_write(writer, &record, sizeof(record));
+        vkd3d_cache_writer_write(writer, e->data, e->size);
+        ++count;
+    }
+
+    vkd3d_mutex_unlock(&cache->mutex);
+
+    return count;
+}
+
+static HRESULT vkd3d_shader_cache_read_records(struct vkd3d_shader_cache *cache,
+        const uint8_t *data, size_t size, unsigned int count)
+{
+    struct vkd3d_cache_shader_record record;
+    size_t offset = 0;
+    unsigned int i;
+
+    vkd3d_mutex_lock(&cache->mutex);
+
+    for (i = 0; i < count; ++i)
+    {
+        if (size - offset < sizeof(record))
+            break;
+        memcpy(&record, &data[offset], sizeof(record));
+        offset += sizeof(record);
+        if (size - offset < record.size)
+            break;
+        vkd3d_shader_cache_insert(cache, &record.key, &data[offset], record.size);
+        offset += record.size;
+    }
+
+    vkd3d_mutex_unlock(&cache->mutex);
+
+    if (i < count)
+    {
+        WARN("Truncated SPIR-V record %u.\n", i);
+        return E_INVALIDARG;
+    }
+
+    return S_OK;
+}
+
+static void vkd3d_cache_header_init(struct vkd3d_cache_header *header, const struct d3d12_device *device)
+{
+    const struct vkd3d_vk_instance_procs *vk_procs = &device->vkd3d_instance->vk_procs;
+    VkPhysicalDeviceProperties properties;
+    struct vkd3d_shader_cache_key key;
+    unsigned int major, minor;
+    const char *version;
+
+    VK_CALL(vkGetPhysicalDeviceProperties(device->vk_physical_device, &properties));
+
+    memset(header, 0, sizeof(*header));
+    header->magic = VKD3D_CACHE_MAGIC;
+    header->version = VKD3D_CACHE_VERSION;
+    header->vendor_id = properties.vendorID;
+    header->device_id = properties.deviceID;
+    header->driver_version = properties.driverVersion;
+    memcpy(header->pipeline_cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    /* SPIR-V produced by a different vkd3d-shader build is not reused. */
+    version = vkd3d_shader_get_version(&major, &minor);
+    vkd3d_shader_cache_key_init(&key);
+    vkd3d_shader_cache_key_add_string(&key, version);
+    header->compiler_hash = key.hash[0];
+}
+
+static HRESULT vkd3d_cache_blob_parse(struct vkd3d_cache_blob *blob,
+        const struct d3d12_device *device, const void *data, size_t size)
+{
+    struct vkd3d_cache_header header, expected;
+    const uint8_t *ptr = data;
+
+    memset(blob, 0, sizeof(*blob));
+
+    if (size < sizeof(header))
+    {
+        WARN("Invalid cache size %zu.\n", size);
+        return E_INVALIDARG;
+    }
+    memcpy(&header, data, sizeof(header));
+    vkd3d_cache_header_init(&expected, device);
+
+    if (header.magic != expected.magic || header.version != expected.version)
+    {
+        WARN("Invalid cache magic %#x, version %u.\n", header.magic, header.version);
+        return E_INVALIDARG;
+    }
+    if (header.vendor_id != expected.vendor_id || header.device_id != expected.device_id)
+    {
+        WARN("Cache was created for device %04x:%04x.\n", header.vendor_id, header.device_id);
+        return D3D12_ERROR_ADAPTER_NOT_FOUND;
+    }
+    if (header.driver_version != expected.driver_version
+            || memcmp(header.pipeline_cache_uuid, expected.pipeline_cache_uuid, VK_UUID_SIZE)
+            || header.compiler_hash != expected.compiler_hash)
+    {
+        WARN("Cache was created with a different driver or compiler version.\n");
+        return D3D12_ERROR_DRIVER_VERSION_MISMATCH;
+    }
+
+    size -= sizeof(header);
+    ptr += sizeof(header);
+    if (header.name_data_size > size || header.shader_data_size > size - header.name_data_size
+            || header.pipeline_data_size > size - header.name_data_size - header.shader_data_size)
+    {
+        WARN("Truncated cache.\n");
+        return E_INVALIDARG;
+    }
+
+    blob->names = ptr;
+    blob->name_data_size = header.name_data_size;
+    blob->name_count = header.name_count;
+    ptr += header.name_data_size;
+    blob->shaders = ptr;
+    blob->shader_data_size = header.shader_data_size;
+    blob->shader_count = header.shader_count;
+    ptr += header.shader_data_size;
+    blob->pipeline_data = header.pipeline_data_size ? ptr : NULL;
+    blob->pipeline_data_size = header.pipeline_data_size;
+
+    return S_OK;
+}
+
+struct vkd3d_cache_name_list
+{
+    const char **names;
+    const struct vkd3d_shader_cache_key **keys;
+    size_t count;
+};
+
+/* Serialises the device caches, preceded by "names". If the output buffer is
+ * too small, SPIR-V records and pipeline cache data are dropped as needed. */
+static size_t vkd3d_cache_serialize(struct d3d12_device *device,
+        const struct vkd3d_cache_name_list *names, void *data, size_t size)
+{
+    const struct vkd3d_vk_device_procs *vk_procs = &device->vk_procs;
+    struct vkd3d_cache_writer writer = {data, size, 0};
+    struct vkd3d_cache_header header;
+    size_t pipeline_data_size = 0;
+    VkPipelineCache vk_cache;
+    size_t offset, i;
+    uint32_t length;
+    VkResult vr;
+
+    vkd3d_cache_header_init(&header, device);
+    vkd3d_cache_writer_write(&writer, &header, sizeof(header));
+
+    offset = writer.offset;
+    for (i = 0; i < names->count; ++i)
+    {
+        length = strlen(names->names[i]);
+        vkd3d_cache_writer_write(&writer, &length, sizeof(length));
+        vkd3d_cache_writer_write(&writer, names->names[i], length);
+        vkd3d_cache_writer_write(&writer, names->keys[i], sizeof(*names->keys[i]));
+    }
+    header.name_count = names->count;
+    header.name_data_size = writer.offset - offset;
+    if (data && writer.offset > size)
+        return writer.offset;
+
+    offset = writer.offset;
+    header.shader_count = vkd3d_shader_cache_write_records(&device->shader_cache, &writer);
+    header.shader_data_size = writer.offset - offset;
+
+    vk_cache = d3d12_device_acquire_vk_pipeline_cache(device);
+    if (vk_cache)
+    {
+        if (!data)
+        {
+            if ((vr = VK_CALL(vkGetPipelineCacheData(device->vk_device, vk_cache, &pipeline_data_size, NULL))) < 0)
+                pipeline_data_size = 0;
+        }
+        else
+        {
+            /* VK_INCOMPLETE still gives us a valid, if partial, cache. */
+            pipeline_data_size = size - writer.offset;
+            if ((vr = VK_CALL(vkGetPipelineCacheData(device->vk_device, vk_cache,
+                    &pipeline_data_size, &writer.data[writer.offset]))) < 0)
+                pipeline_data_size = 0;
+        }
+    }
+    d3d12_device_release_vk_pipeline_cache(device);
+    writer.offset += pipeline_data_size;
+    header.pipeline_data_size = pipeline_data_size;
+
+    if (data)
+        memcpy(data, &header, sizeof(header));
+
+    return writer.offset;
+}
+
+static char *vkd3d_device_cache_get_file_name(const struct d3d12_device *device)
+{
+    const struct vkd3d_vk_instance_procs *vk_procs = &device->vkd3d_instance->vk_procs;
+    VkPhysicalDeviceProperties properties;
+    const char *path;
+    size_t size;
+    char *name;
+
+    if (!(path = getenv("VKD3D_SHADER_CACHE_PATH")) || !*path)
+        return NULL;
+
+    VK_CALL(vkGetPhysicalDeviceProperties(device->vk_physical_device, &properties));
+
+    size = strlen(path) + 32;
+    if (!(name = vkd3d_malloc(size)))
+        return NULL;
+    snprintf(name, size, "%s/vkd3d-%04x-%04x.cache", path, properties.vendorID, properties.deviceID);
+
+    return name;
+}
+
+/* Reads the on-disk cache, populating the SPIR-V cache. The returned buffer
+ * holds the Vulkan pipeline cache data and must be freed by the caller. */
+void *vkd3d_device_cache_read(struct d3d12_device *device, const void **pipeline_data, size_t *pipeline_data_size)
+{
+    struct vkd3d_cache_blob blob;
+    void *data = NULL;
+    char *file_name;
+    FILE *file;
+    HRESULT hr = E_FAIL;
+    long size = 0;
+
+    *pipeline_data = NULL;
+    *pipeline_data_size = 0;
+
+    if (!(file_name = vkd3d_device_cache_get_file_name(device)))
+        return NULL;
+
+    if (!(file = fopen(file_name, "rb")))
+    {
+        TRACE("No cache file %s.\n", debugstr_a(file_name));
+        vkd3d_free(file_name);
+        return NULL;
+    }
+
+    if (!fseek(file, 0, SEEK_END) && (size = ftell(file)) > 0 && !fseek(file, 0, SEEK_SET)
+            && (data = vkd3d_malloc(size)))
+    {
+        if (fread(data, 1, size, file) != (size_t)size)
+        {
+            WARN("Failed to read cache file %s.\n", debugstr_a(file_name));
+            vkd3d_free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+
+    if (data && SUCCEEDED(hr = vkd3d_cache_blob_parse(&blob, device, data, size))
+            && SUCCEEDED(hr = vkd3d_shader_cache_read_records(&device->shader_cache,
+            blob.shaders, blob.shader_data_size, blob.shader_count)))
+    {
+        *pipeline_data = blob.pipeline_data;
+        *pipeline_data_size = blob.pipeline_data_size;
+        device->cache_file_size = size;
+        TRACE("Loaded %u SPIR-V records and %zu bytes of pipeline cache data from %s.\n",
+                blob.shader_count, blob.pipeline_data_size, debugstr_a(file_name));
+    }
+    else if (data)
+    {
+        WARN("Ignoring cache file %s, hr %s.\n", debugstr_a(file_name), debugstr_hresult(hr));
+    }
+
+    /* Entries that came from disk don't need writing back. */
+    device->shader_cache.modified = false;
+
+    vkd3d_free(file_name);
+    return data;
+}
+
+void vkd3d_device_cache_write(struct d3d12_device *device)
+{
+    static const struct vkd3d_cache_name_list no_names;
+    static uint32_t tmp_counter;
+    char *file_name, *tmp_name;
+    unsigned long pid;
+    void *data = NULL;
+    size_t size;
+    FILE *file;
+
+    if (!(file_name = vkd3d_device_cache_get_file_name(device)))
+        return;
+
+    size = vkd3d_cache_serialize(device, &no_names, NULL, 0);
+    if (!device->shader_cache.modified && size == device->cache_file_size)
+    {
+        TRACE("Cache is unchanged, not writing %s.\n", debugstr_a(file_name));
+        vkd3d_free(file_name);
+        return;
+    }
+
+    /* Other processes may be writing the same cache, use a unique temporary file. */
+#ifdef _WIN32
+    pid = GetCurrentProcessId();
+#else
+    pid = getpid();
+#endif
+    if (!(tmp_name = vkd3d_malloc(strlen(file_name) + 64)) || !(data = vkd3d_malloc(size)))
+        goto done;
+    sprintf(tmp_name, "%s.%lx-%x-%"PRIx64".tmp", file_name, pid,
+            vkd3d_atomic_increment_u32(&tmp_counter), vkd3d_get_time_ns());
+
+    size = vkd3d_cache_serialize(device, &no_names, data, size);
+
+    if (!(file = fopen(tmp_name, "wb")))
+    {
+        WARN("Failed to create %s.\n", debugstr_a(tmp_name));
+        goto done;
+    }
+    if (fwrite(data, 1, size, file) != size)
+    {
+        WARN("Failed to write %s.\n", debugstr_a(tmp_name));
+        fclose(file);
+        remove(tmp_name);
+        goto done;
+    }
+    fclose(file);
+
+    /* Replace the cache atomically; rename() doesn't replace existing files on Windows. */
+#ifdef _WIN32
+    if (!MoveFileExA(tmp_name, file_name, MOVEFILE_REPLACE_EXISTING))
+#else
+    if (rename(tmp_name, file_name))
+#endif
+    {
+        WARN("Failed to rename %s to %s.\n", debugstr_a(tmp_name), debugstr_a(file_name));
+        remove(tmp_name);
+        goto done;
+    }
+
+    TRACE("Wrote %zu bytes to %s.\n", size, debugstr_a(file_name));
+
+done:
+    vkd3d_free(data);
+    vkd3d_free(tmp_name);
+    vkd3d_free(file_name);
+}
+
+VkPipelineCache d3d12_device_acquire_vk_pipeline_cache(struct d3d12_device *device)
+{
+    VkPipelineCache vk_pipeline_cache;
+
+    vkd3d_mutex_lock(&device->pipeline_cache_mutex);
+    vk_pipeline_cache = device->vk_pipeline_cache;
+    ++device->pipeline_cache_users;
+    vkd3d_mutex_unlock(&device->pipeline_cache_mutex);
+
+    return vk_pipeline_cache;
+}
+
+void d3d12_device_release_vk_pipeline_cache(struct d3d12_device *device)
+{
+    const struct vkd3d_vk_device_procs *vk_procs = &device->vk_procs;
+    size_t i;
+
+    vkd3d_mutex_lock(&device->pipeline_cache_mutex);
+    if (!--device->pipeline_cache_users)
+    {
+        /* Nobody can be using a replaced cache anymore. */
+        for (i = 0; i < device->retired_pipeline_cache_count; ++i)
+            VK_CALL(vkDestroyPipelineCache(device->vk_device, device->retired_pipeline_caches[i], NULL));
+        device->retired_pipeline_cache_count = 0;
+    }
+    vkd3d_mutex_unlock(&device->pipeline_cache_mutex);
+}
+
+/* Merges Vulkan pipeline cache data into the device cache. vkMergePipelineCaches()
+ * requires exclusive access to the destination. If the device cache is not in
+ * use, we merge into it directly; otherwise we merge into a new cache and swap
+ * it in, and the previous cache is destroyed once its last user releases it. */
+static HRESULT d3d12_device_merge_pipeline_cache_data(struct d3d12_device *device, const void *data, size_t size)
+{
+    const struct vkd3d_vk_device_procs *vk_procs = &device->vk_procs;
+    VkPipelineCache src_caches[2], vk_cache;
+    VkPipelineCacheCreateInfo cache_info;
+    VkResult vr;
+
+    if (!size || !device->vk_pipeline_cache)
+        return S_OK;
+
+    cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cache_info.pNext = NULL;
+    cache_info.flags = 0;
+    cache_info.initialDataSize = size;
+    cache_info.pInitialData = data;
+    if ((vr = VK_CALL(vkCreatePipelineCache(device->vk_device, &cache_info, NULL, &src_caches[0]))) < 0)
+    {
+        WARN("Failed to create Vulkan pipeline cache, vr %d.\n", vr);
+        return hresult_from_vk_result(vr);
+    }
+
+    vkd3d_mutex_lock(&device->pipeline_cache_mutex);
+
+    if (!device->pipeline_cache_users)
+    {
+        if ((vr = VK_CALL(vkMergePipelineCaches(device->vk_device, device->vk_pipeline_cache, 1, src_caches))) < 0)
+            WARN("Failed to merge pipeline caches, vr %d.\n", vr);
+        vkd3d_mutex_unlock(&device->pipeline_cache_mutex);
+        VK_CALL(vkDestroyPipelineCache(device->vk_device, src_caches[0], NULL));
+        return hresult_from_vk_result(vr);
+    }
+
+    if (!vkd3d_array_reserve((void **)&device->retired_pipeline_caches, &device->retired_pipeline_cache_capacity,
+            device->retired_pipeline_cache_count + 1, sizeof(*device->retired_pipeline_caches)))
+    {
+        vkd3d_mutex_unlock(&device->pipeline_cache_mutex);
+        VK_CALL(vkDestroyPipelineCache(device->vk_device, src_caches[0], NULL));
+        return E_OUTOFMEMORY;
+    }
+
+    cache_info.initialDataSize = 0;
+    cache_info.pInitialData = NULL;
+    if ((vr = VK_CALL(vkCreatePipelineCache(device->vk_device, &cache_info, NULL, &vk_cache))) < 0)
+    {
+        vkd3d_mutex_unlock(&device->pipeline_cache_mutex);
+        WARN("Failed to create Vulkan pipeline cache, vr %d.\n", vr);
+        VK_CALL(vkDestroyPipelineCache(device->vk_device, src_caches[0], NULL));
+        return hresult_from_vk_result(vr);
+    }
+
+    src_caches[1] = device->vk_pipeline_cache;
+    if ((vr = VK_CALL(vkMergePipelineCaches(device->vk_device, vk_cache, ARRAY_SIZE(src_caches), src_caches))) < 0)
+    {
+        vkd3d_mutex_unlock(&device->pipeline_cache_mutex);
+        WARN("Failed to merge pipeline caches, vr %d.\n", vr);
+        VK_CALL(vkDestroyPipelineCache(device->vk_device, vk_cache, NULL));
+        VK_CALL(vkDestroyPipelineCache(device->vk_device, src_caches[0], NULL));
+        return hresult_from_vk_result(vr);
+    }
+
+    device->retired_pipeline_caches[device->retired_pipeline_cache_count++] = device->vk_pipeline_cache;
+    device->vk_pipeline_cache = vk_cache;
+
+    vkd3d_mutex_unlock(&device->pipeline_cache_mutex);
+
+    VK_CALL(vkDestroyPipelineCache(device->vk_device, src_caches[0], NULL));
+
+    return S_OK;
+}
+
+/* ID3D12PipelineLibrary */
+struct d3d12_pipeline_library_entry
+{
+    struct rb_entry entry;
+    char *name;
+    struct vkd3d_shader_cache_key desc_key;
+    ID3D12PipelineState *pipeline_state;
+};
+
+static int d3d12_pipeline_library_compare_name(const void *key, const struct rb_entry *entry)
+{
+    const struct d3d12_pipeline_library_entry *e = RB_ENTRY_VALUE(entry,
+            const struct d3d12_pipeline_library_entry, entry);
+
+    return strcmp(key, e->name);
+}
+
+static void d3d12_pipeline_library_free_entry(struct rb_entry *entry, void *context)
+{
+    struct d3d12_pipeline_library_entry *e = RB_ENTRY_VALUE(entry, struct d3d12_pipeline_library_entry, entry);
+
+    if (e->pipeline_state)
+        ID3D12PipelineState_Release(e->pipeline_state);
+    vkd3d_free(e->name);
+    vkd3d_free(e);
+}
+
+static HRESULT d3d12_pipeline_library_add_entry(struct d3d12_pipeline_library *library,
+        char *name, const struct vkd3d_shader_cache_key *desc_key, ID3D12PipelineState *pipeline_state)
+{
+    struct d3d12_pipeline_library_entry *e;
+
+    if (rb_get(&library->entries, name))
+        return E_INVALIDARG;
+
+    if (!(e = vkd3d_malloc(sizeof(*e))))
+        return E_OUTOFMEMORY;
+
+    e->name = name;
+    e->desc_key = *desc_key;
+    if ((e->pipeline_state = pipeline_state))
+        ID3D12PipelineState_AddRef(pipeline_state);
+    rb_put(&library->entries, e->name, &e->entry);
+    ++library->entry_count;
+
+    return S_OK;
+}
+
+static inline struct d3d12_pipeline_library *impl_from_ID3D12PipelineLibrary1(ID3D12PipelineLibrary1 *iface)
+{
+    return CONTAINING_RECORD(iface, struct d3d12_pipeline_library, ID3D12PipelineLibrary1_iface);
+}
+
+static HRESULT STDMETHODCALLTYPE d3d12_pipeline_library_QueryInterface(ID3D12PipelineLibrary1 *iface,
+        REFIID iid, void **out)
+{
+    TRACE("iface %p, iid %s, out %p.\n", iface, debugstr_guid(iid), out);
+
+    if (IsEqualGUID(iid, &IID_ID3D12PipelineLibrary1)
+            || IsEqualGUID(iid, &IID_ID3D12PipelineLibrary)
+            || IsEqualGUID(iid, &IID_ID3D12DeviceChild)
+            || IsEqualGUID(iid, &IID_ID3D12Object)
+            || IsEqualGUID(iid, &IID_IUnknown))
+    {
+        ID3D12PipelineLibrary1_AddRef(iface);
+        *out = iface;
+        return S_OK;
+    }
+
+    WARN("%s not implemented, returning E_NOINTERFACE.\n", debugstr_guid(iid));
+
+    *out = NULL;
+    return E_NOINTERFACE;
+}
+
+static ULONG STDMETHODCALLTYPE d3d12_pipeline_library_AddRef(ID3D12PipelineLibrary1 *iface)
+{
+    struct d3d12_pipeline_library *library = impl_from_ID3D12PipelineLibrary1(iface);
+    unsigned int refcount = vkd3d_atomic_increment_u32(&library->refcount);
+
+    TRACE("%p increasing refcount to %u.\n", library, refcount);
+
+    return refcount;
+}
+
+static ULONG STDMETHODCALLTYPE d3d12_pipeline_library_Release(ID3D12PipelineLibrary1 *iface)
+{
+    struct d3d12_pipeline_library *library = impl_from_ID3D12PipelineLibrary1(iface);
+    unsigned int refcount = vkd3d_atomic_decrement_u32(&library->refcount);
+    struct d3d12_device *device = library->device;
+
+    TRACE("%p decreasing refcount to %u.\n", library, refcount);
+
+    if (!refcount)
+    {
+        TRACE("Pipeline library: %zu entries, %u hits, %u misses.\n",
+                library->entry_count, library->hits, library->misses);
+
+        vkd3d_private_store_destroy(&library->private_store);
+        rb_destroy(&library->entries, d3d12_pipeline_library_free_entry, NULL);
+        vkd3d_mutex_destroy(&library->mutex);
+        vkd3d_free(library);
+
+        d3d12_device_release(device);
+    }
+
+    return refcount;
+}
+
+static HRESULT STDMETHODCALLTYPE d3d12_pipeline_library_GetPrivateData(ID3D12PipelineLibrary1 *iface,
+        REFGUID guid, UINT *data_size, void *data)
+{
+    struct d3d12_pipeline_library *library = impl_from_ID3D12PipelineLibrary1(iface);
+
+    TRACE("iface %p, guid %s, data_size %p, data %p.\n", iface, debugstr_guid(guid), data_size, data);
+
+    return vkd3d_get_private_data(&library->private_store, guid, data_size, data);
+}
+
+static HRESULT STDMETHODCALLTYPE d3d12_pipeline_library_SetPrivateData(ID3D12PipelineLibrary1 *iface,
+        REFGUID guid, UINT data_size, const void *data)
+{
+    struct d3d12_pipeline_library *library = impl_from_ID3D12PipelineLibrary1(iface);
+
+    TRACE("iface %p, guid %s, data_size %u, data %p.\n", iface, debugstr_guid(guid), data_size, data);
+
+    return vkd3d_set_private_data(&library->private_store, guid, data_size, data);
+}
+
+static HRESULT STDMETHODCALLTYPE d3d12_pipeline_library_SetPrivateDataInterface(ID3D12PipelineLibrary1 *iface,
+        REFGUID guid, const IUnknown *data)
+{
+    struct d3d12_pipeline_library *library = impl_from_ID3D12PipelineLibrary1(iface);
+
+    TRACE("iface %p, guid %s, data %p.\n", iface, debugstr_guid(guid), data);
+
+    return vkd3d_set_private_data_interface(&library->private_store, guid, data);
+}
+
+static HRESULT STDMETHODCALLTYPE d3d12_pipeline_library_SetName(ID3D12PipelineLibrary1 *iface, const WCHAR *name)
+{
+    struct d3d12_pipeline_library *library = impl_from_ID3D12PipelineLibrary1(iface);
+
+    TRACE("iface %p, name %s.\n", iface, debugstr_w(name, library->device->wchar_size));
+
+    return name ? S_OK : E_INVALIDARG;
+}
+
+static HRESULT STDMETHODCALLTYPE d3d12_pipeline_library_GetDevice(ID3D12PipelineLibrary1 *iface,
+        REFIID iid, void **device)
+{
+    struct d3d12_pipeline_library *library = impl_from_ID3D12PipelineLibrary1(iface);
+
+    TRACE("iface %p, iid %s, device %p.\n", iface, debugstr_guid(iid), device);
+
+    return d3d12_device_query_interface(library->device, iid, device);
+}
+
+static HRESULT STDMETHODCALLTYPE d3d12_pipeline_library_StorePipeline(ID3D12PipelineLibrary1 *iface,
+        const WCHAR *name, ID3D12PipelineState *pipeline)
+{
+    struct d3d12_pipeline_library *library = impl_from_ID3D12PipelineLibrary1(iface);
+    struct d3d12_pipeline_state *state;
+    char *name_utf8;
+    HRESULT hr;
+
+    TRACE("iface %p, name %s, pipeline %p.\n", iface, debugstr_w(name, library->device->wchar_size), pipeline);
+
+    if (!name || !(state = unsafe_impl_from_ID3D12PipelineState(pipeline)))
+        return E_INVALIDARG;
+
+    if (!(name_utf8 = vkd3d_strdup_w_utf8(name, library->device->wchar_size)))
+        return E_OUTOFMEMORY;
+
+    vkd3d_mutex_lock(&library->mutex);
+    hr = d3d12_pipeline_library_add_entry(library, name_utf8, &state->desc_key, pipeline);
+    vkd3d_mutex_unlock(&library->mutex);
+
+    if (FAILED(hr))
+    {
+        WARN("Failed to store pipeline %s, hr %s.\n", debugstr_a(name_utf8), debugstr_hresult(hr));
+        vkd3d_free(name_utf8);
+    }
+
+    return hr;
+}
+
+/* The library keeps the names of stored pipelines along with a hash of their
+ * description; the pipelines themselves are recreated from the description,
+ * which is cheap when the SPIR-V and Vulkan pipeline caches are warm. Like
+ * native, loading with a description that doesn't match the stored pipeline
+ * fails. */
+static HRESULT d3d12_pipeline_library_find(struct d3d12_pipeline_library *library, const WCHAR *name,
+        const struct vkd3d_shader_cache_key *key)
+{
+    struct d3d12_pipeline_library_entry *e;
+    struct rb_entry *entry;
+    char *name_utf8;
+    HRESULT hr;
+
+    if (!name)
+        return E_INVALIDARG;
+
+    if (!(name_utf8 = vkd3d_strdup_w_utf8(name, library->device->wchar_size)))
+        return E_OUTOFMEMORY;
+
+    vkd3d_mutex_lock(&library->mutex);
+    if (!(entry = rb_get(&library->entries, name_utf8)))
+    {
+        TRACE("Pipeline %s not found.\n", debugstr_a(name_utf8));
+        hr = E_INVALIDARG;
+    }
+    else
+    {
+        e = RB_ENTRY_VALUE(entry, struct d3d12_pipeline_library_entry, entry);
+        if (memcmp(&e->desc_key, key, sizeof(*key)))
+        {
+            WARN("Description doesn't match stored pipeline %s.\n", debugstr_a(name_utf8));
+            hr = E_INVALIDARG;
+        }
+        else
+        {
+            hr = S_OK;
+        }
+    }
+    if (SUCCEEDED(hr))
+        ++library->hits;
+    else
+        ++library->misses;
+    vkd3d_mutex_unlock(&library->mutex);
+
+    vkd3d_free(name_utf8);
+
+    return hr;
+}
+
+static HRESULT STDMETHODCALLTYPE d3d12_pipeline_library_LoadGraphicsPipeline(ID3D12PipelineLibrary1 *iface,
+        const WCHAR *name, const D3D12_GRAPHICS_PIPELINE_STATE_DESC *desc, REFIID iid, void **pipeline_state)
+{
+    struct d3d12_pipeline_library *library = impl_from_ID3D12PipelineLibrary1(iface);
+    struct d3d12_pipeline_state *object;
+    HRESULT hr;
+
+    TRACE("iface %p, name %s, desc %p, iid %s, pipeline_state %p.\n", iface,
+            debugstr_w(name, library->device->wchar_size), desc, debugstr_guid(iid), pipeline_state);
+
+    if (FAILED(hr = d3d12_pipeline_state_create_graphics(library->device, desc, &object)))
+        return hr;
+
+    if (FAILED(hr = d3d12_pipeline_library_find(library, name, &object->desc_key)))
+    {
+        ID3D12PipelineState_Release(&object->ID3D12PipelineState_iface);
+        return hr;
+    }
+
+    return return_interface(&object->ID3D12PipelineState_iface, &IID_ID3D12PipelineState, iid, pipeline_state);
+}
+
+static HRESULT STDMETHODCALLTYPE d3d12_pipeline_library_LoadComputePipeline(ID3D12PipelineLibrary1 *iface,
+        const WCHAR *name, const D3D12_COMPUTE_PIPELINE_STATE_DESC *desc, REFIID iid, void **pipeline_state)
+{
+    struct d3d12_pipeline_library *library = impl_from_ID3D12PipelineLibrary1(iface);
+    struct d3d12_pipeline_state *object;
+    HRESULT hr;
+
+    TRACE("iface %p, name %s, desc %p, iid %s, pipeline_state %p.\n", iface,
+            debugstr_w(name, library->device->wchar_size), desc, debugstr_guid(iid), pipeline_state);
+
+    if (FAILED(hr = d3d12_pipeline_state_create_compute(library->device, desc, &object)))
+        return hr;
+
+    if (FAILED(hr = d3d12_pipeline_library_find(library, name, &object->desc_key)))
+    {
+        ID3D12PipelineState_Release(&object->ID3D12PipelineState_iface);
+        return hr;
+    }
+
+    return return_interface(&object->ID3D12PipelineState_iface, &IID_ID3D12PipelineState, iid, pipeline_state);
+}
+
+static HRESULT d3d12_pipeline_library_get_names(struct d3d12_pipeline_library *library,
+        struct vkd3d_cache_name_list *names)
+{
+    struct d3d12_pipeline_library_entry *e;
+
+    names->count = 0;
+    names->keys = NULL;
+    if (!(names->names = vkd3d_calloc(library->entry_count, sizeof(*names->names))) && library->entry_count)
+        return E_OUTOFMEMORY;
+    if (!(names->keys = vkd3d_calloc(library->entry_count, sizeof(*names->keys))) && library->entry_count)
+    {
+        vkd3d_free(names->names);
+        return E_OUTOFMEMORY;
+    }
+
+    RB_FOR_EACH_ENTRY(e, &library->entries, struct d3d12_pipeline_library_entry, entry)
+    {
+        names->names[names->count] = e->name;
+        names->keys[names->count++] = &e->desc_key;
+    }
+
+    return S_OK;
+}
+
+static SIZE_T STDMETHODCALLTYPE d3d12_pipeline_library_GetSerializedSize(ID3D12PipelineLibrary1 *iface)
+{
+    struct d3d12_pipeline_library *library = impl_from_ID3D12PipelineLibrary1(iface);
+    struct vkd3d_cache_name_list names;
+    size_t size = 0;
+
+    TRACE("iface %p.\n", iface);
+
+    vkd3d_mutex_lock(&library->mutex);
+    if (SUCCEEDED(d3d12_pipeline_library_get_names(library, &names)))
+    {
+        size = vkd3d_cache_serialize(library->device, &names, NULL, 0);
+        vkd3d_free(names.names);
+        vkd3d_free(names.keys);
+    }
+    vkd3d_mutex_unlock(&library->mutex);
+
+    return size;
+}
+
+static HRESULT STDMETHODCALLTYPE d3d12_pipeline_library_Serialize(ID3D12PipelineLibrary1 *iface,
+        void *data, SIZE_T data_size)
+{
+    struct d3d12_pipeline_library *library = impl_from_ID3D12PipelineLibrary1(iface);
+    struct vkd3d_cache_name_list names;
+    size_t size;
+    HRESULT hr;
+
+    TRACE("iface %p, data %p, data_size %"PRIuPTR".\n", iface, data, (uintptr_t)data_size);
+
+    if (!data)
+        return E_INVALIDARG;
+
+    vkd3d_mutex_lock(&library->mutex);
+    if (SUCCEEDED(hr = d3d12_pipeline_library_get_names(library, &names)))
+    {
+        if ((size = vkd3d_cache_serialize(library->device, &names, data, data_size)) > data_size)
+        {
+            WARN("Buffer size %"PRIuPTR" is too small, %zu bytes required.\n", (uintptr_t)data_size, size);
+            hr = E_INVALIDARG;
+        }
+        vkd3d_free(names.names);
+        vkd3d_free(names.keys);
+    }
+    vkd3d_mutex_unlock(&library->mutex);
+
+    return hr;
+}
+
+static HRESULT STDMETHODCALLTYPE d3d12_pipeline_library_LoadPipeline(ID3D12PipelineLibrary1 *iface,
+        const WCHAR *name, const D3D12_PIPELINE_STATE_STREAM_DESC *desc, REFIID iid, void **pipeline_state)
+{
+    struct d3d12_pipeline_library *library = impl_from_ID3D12PipelineLibrary1(iface);
+    struct d3d12_pipeline_state *object;
+    HRESULT hr;
+
+    TRACE("iface %p, name %s, desc %p, iid %s, pipeline_state %p.\n", iface,
+            debugstr_w(name, library->device->wchar_size), desc, debugstr_guid(iid), pipeline_state);
+
+    if (FAILED(hr = d3d12_pipeline_state_create(library->device, desc, &object)))
+        return hr;
+
+    if (FAILED(hr = d3d12_pipeline_library_find(library, name, &object->desc_key)))
+    {
+        ID3D12PipelineState_Release(&object->ID3D12PipelineState_iface);
+        return hr;
+    }
+
+    return return_interface(&object->ID3D12PipelineState_iface, &IID_ID3D12PipelineState, iid, pipeline_state);
+}
+
+static const struct ID3D12PipelineLibrary1Vtbl d3d12_pipeline_library_vtbl =
+{
+    /* IUnknown methods */
+    d3d12_pipeline_library_QueryInterface,
+    d3d12_pipeline_library_AddRef,
+    d3d12_pipeline_library_Release,
+    /* ID3D12Object methods */
+    d3d12_pipeline_library_GetPrivateData,
+    d3d12_pipeline_library_SetPrivateData,
+    d3d12_pipeline_library_SetPrivateDataInterface,
+    d3d12_pipeline_library_SetName,
+    /* ID3D12DeviceChild methods */
+    d3d12_pipeline_library_GetDevice,
+    /* ID3D12PipelineLibrary methods */
+    d3d12_pipeline_library_StorePipeline,
+    d3d12_pipeline_library_LoadGraphicsPipeline,
+    d3d12_pipeline_library_LoadComputePipeline,
+    d3d12_pipeline_library_GetSerializedSize,
+    d3d12_pipeline_library_Serialize,
+    /* ID3D12PipelineLibrary1 methods */
+    d3d12_pipeline_library_LoadPipeline,
+};
+
+static HRESULT d3d12_pipeline_library_read_names(struct d3d12_pipeline_library *library,
+        const struct vkd3d_cache_blob *blob)
+{
+    size_t offset = 0, size = blob->name_data_size;
+    struct vkd3d_shader_cache_key key;
+    uint32_t length;
+    unsigned int i;
+    char *name;
+    HRESULT hr;
+
+    for (i = 0; i < blob->name_count; ++i)
+    {
+        if (size - offset < sizeof(length))
+            return E_INVALIDARG;
+        memcpy(&length, &blob->names[offset], sizeof(length));
+        offset += sizeof(length);
+        if (size - offset < length || size - offset - length < sizeof(key))
+            return E_INVALIDARG;
+
+        if (!(name = vkd3d_malloc(length + 1)))
+            return E_OUTOFMEMORY;
+        memcpy(name, &blob->names[offset], length);
+        name[length] = '\0';
+        offset += length;
+        memcpy(&key, &blob->names[offset], sizeof(key));
+        offset += sizeof(key);
+
+        if (FAILED(hr = d3d12_pipeline_library_add_entry(library, name, &key, NULL)))
+        {
+            vkd3d_free(name);
+            return hr;
+        }
+    }
+
+    return S_OK;
+}
+
+static HRESULT d3d12_pipeline_library_init(struct d3d12_pipeline_library *library,
+        struct d3d12_device *device, const void *data, size_t size)
+{
+    struct vkd3d_cache_blob blob;
+    HRESULT hr;
+
+    library->ID3D12PipelineLibrary1_iface.lpVtbl = &d3d12_pipeline_library_vtbl;
+    library->refcount = 1;
+    library->device = device;
+
+    vkd3d_mutex_init(&library->mutex);
+    rb_init(&library->entries, d3d12_pipeline_library_compare_name);
+    library->entry_count = 0;
+    library->hits = 0;
+    library->misses = 0;
+
+    if (size)
+    {
+        if (FAILED(hr = vkd3d_cache_blob_parse(&blob, device, data, size))
+                || FAILED(hr = d3d12_pipeline_library_read_names(library, &blob))
+                || FAILED(hr = vkd3d_shader_cache_read_records(&device->shader_cache,
+                blob.shaders, blob.shader_data_size, blob.shader_count))
+                || FAILED(hr = d3d12_device_merge_pipeline_cache_data(device,
+                blob.pipeline_data, blob.pipeline_data_size)))
+            goto fail;
+
+        TRACE("Loaded %u pipelines, %u SPIR-V records and %zu bytes of pipeline cache data.\n",
+                blob.name_count, blob.shader_count, blob.pipeline_data_size);
+    }
+
+    if (FAILED(hr = vkd3d_private_store_init(&library->private_store)))
+        goto fail;
+
+    d3d12_device_add_ref(device);
+
+    return S_OK;
+
+fail:
+    rb_destroy(&library->entries, d3d12_pipeline_library_free_entry, NULL);
+    vkd3d_mutex_destroy(&library->mutex);
+    return hr;
+}
+
+HRESULT d3d12_pipeline_library_create(struct d3d12_device *device, const void *blob,
+        size_t blob_size, struct d3d12_pipeline_library **library)
+{
+    struct d3d12_pipeline_library *object;
+    HRESULT hr;
+
+    if (blob_size && !blob)
+        return E_INVALIDARG;
+
+    if (!(object = vkd3d_malloc(sizeof(*object))))
+        return E_OUTOFMEMORY;
+
+    if (FAILED(hr = d3d12_pipeline_library_init(object, device, blob, blob_size)))
+    {
+        vkd3d_free(object);
+        return hr;
+    }
+
+    TRACE("Created pipeline library %p.\n", object);
+
+    *library = object;
+
+    return S_OK;
+}
@@ -2098,32 +2098,60 @@ static HRESULT d3d12_device_init_pipeline_cache(struct d3d12_device *device)
 {
     const struct vkd3d_vk_device_procs *vk_procs = &device->vk_procs;
     VkPipelineCacheCreateInfo cache_info;
+    const void *pipeline_data;
+    size_t pipeline_data_size;
+    void *cache_data;
     VkResult vr;
 
     vkd3d_mutex_init(&device->pipeline_cache_mutex);
+    device->pipeline_cache_users = 0;
+    device->retired_pipeline_caches = NULL;
+    device->retired_pipeline_cache_capacity = 0;
+    device->retired_pipeline_cache_count = 0;
+    device->cache_file_size = 0;
+    vkd3d_shader_cache_init(&device->shader_cache);
+
+    cache_data = vkd3d_device_cache_read(device, &pipeline_data, &pipeline_data_size);
 
     cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
     cache_info.pNext = NULL;
     cache_info.flags = 0;
-    cache_info.initialDataSize = 0;
-    cache_info.pInitialData = NULL;
+    cache_info.initialDataSize = pipeline_data_size;
+    cache_info.pInitialData = pipeline_data;
     if ((vr = VK_CALL(vkCreatePipelineCache(device->vk_device, &cache_info, NULL,
-            &device->vk_pipeline_cache))) < 0)
+            &device->vk_pipeline_cache))) < 0 && pipeline_data_size)
+    {
+        WARN("Failed to create Vulkan pipeline cache from %zu bytes of data, vr %d.\n", pipeline_data_size, vr);
+        cache_info.initialDataSize = 0;
+        cache_info.pInitialData = NULL;
+        vr = VK_CALL(vkCreatePipelineCache(device->vk_device, &cache_info, NULL, &device->vk_pipeline_cache));
+    }
+    if (vr < 0)
     {
         ERR("Failed to create Vulkan pipeline cache, vr %d.\n", vr);
         device->vk_pipeline_cache = VK_NULL_HANDLE;
     }
 
+    vkd3d_free(cache_data);
+
     return S_OK;
 }
 
 static void d3d12_device_destroy_pipeline_cache(struct d3d12_device *device)
 {
     const struct vkd3d_vk_device_procs *vk_procs = &device->vk_procs;
+    size_t i;
 
     if (device->vk_pipeline_cache)
+    {
+        vkd3d_device_cache_write(device);
         VK_CALL(vkDestroyPipelineCache(device->vk_device, device->vk_pipeline_cache, NULL));
+    }
+    for (i = 0; i < device->retired_pipeline_cache_count; ++i)
+        VK_CALL(vkDestroyPipelineCache(device->vk_device, device->retired_pipeline_caches[i], NULL));
+    vkd3d_free(device->retired_pipeline_caches);
 
+    vkd3d_shader_cache_cleanup(&device->shader_cache);
     vkd3d_mutex_destroy(&device->pipeline_cache_mutex);
 }
 
@@ -4257,10 +4285,17 @@ static LUID * STDMETHODCALLTYPE d3d12_device_GetAdapterLuid(ID3D12Device7 *iface
 static HRESULT STDMETHODCALLTYPE d3d12_device_CreatePipelineLibrary(ID3D12Device7 *iface,
         const void *blob, SIZE_T blob_size, REFIID iid, void **lib)
 {
-    FIXME("iface %p, blob %p, blob_size %"PRIuPTR", iid %s, lib %p stub!\n",
+    struct d3d12_device *device = impl_from_ID3D12Device7(iface);
+    struct d3d12_pipeline_library *object;
+    HRESULT hr;
+
+    TRACE("iface %p, blob %p, blob_size %"PRIuPTR", iid %s, lib %p.\n",
             iface, blob, (uintptr_t)blob_size, debugstr_guid(iid), lib);
 
-    return DXGI_ERROR_UNSUPPORTED;
+    if (FAILED(hr = d3d12_pipeline_library_create(device, blob, blob_size, &object)))
+        return hr;
+
+    return return_interface(&object->ID3D12PipelineLibrary1_iface, &IID_ID3D12PipelineLibrary1, iid, lib);
 }
 
 static HRESULT STDMETHODCALLTYPE d3d12_device_SetEventOnMultipleFenceCompletion(ID3D12Device7 *iface,
@@ -2168,6 +2168,8 @@ static HRESULT create_shader_stage(struct d3d12_device *device,
     struct vkd3d_shader_compile_info compile_info;
     struct VkShaderModuleCreateInfo shader_desc;
     struct vkd3d_shader_code spirv = {0};
+    struct vkd3d_shader_cache_key key;
+    bool use_cache, cached = false;
     VkResult vr;
     int ret;
 
@@ -2200,17 +2202,33 @@ static HRESULT create_shader_stage(struct d3d12_device *device,
     compile_info.log_level = VKD3D_SHADER_LOG_NONE;
     compile_info.source_name = NULL;
 
-    if ((ret = vkd3d_shader_parse_dxbc_source_type(&compile_info.source, &compile_info.source_type, NULL)) < 0
-            || (ret = vkd3d_shader_compile(&compile_info, &spirv, NULL)) < 0)
+    if ((ret = vkd3d_shader_parse_dxbc_source_type(&compile_info.source, &compile_info.source_type, NULL)) < 0)
     {
         WARN("Failed to compile shader, vkd3d result %d.\n", ret);
         return hresult_from_vkd3d_result(ret);
     }
+
+    if ((use_cache = vkd3d_shader_cache_key_init_compile_info(&key, &compile_info)))
+        cached = vkd3d_shader_cache_get(&device->shader_cache, &key, &spirv);
+
+    if (!cached)
+    {
+        if ((ret = vkd3d_shader_compile(&compile_info, &spirv, NULL)) < 0)
+        {
+            WARN("Failed to compile shader, vkd3d result %d.\n", ret);
+            return hresult_from_vkd3d_result(ret);
+        }
+        if (use_cache)
+            vkd3d_shader_cache_put(&device->shader_cache, &key, &spirv);
+    }
     shader_desc.codeSize = spirv.size;
     shader_desc.pCode = spirv.code;
 
     vr = VK_CALL(vkCreateShaderModule(device->vk_device, &shader_desc, NULL, &stage_desc->module));
-    vkd3d_shader_free_shader_code(&spirv);
+    if (cached)
+        vkd3d_free((void *)spirv.code);
+    else
+        vkd3d_shader_free_shader_code(&spirv);
     if (vr < 0)
     {
         WARN("Failed to create Vulkan shader module, vr %d.\n", vr);
@@ -2268,7 +2286,8 @@ static HRESULT vkd3d_create_compute_pipeline(struct d3d12_device *device,
     pipeline_info.basePipelineIndex = -1;
 
     vr = VK_CALL(vkCreateComputePipelines(device->vk_device,
-            VK_NULL_HANDLE, 1, &pipeline_info, NULL, vk_pipeline));
+            d3d12_device_acquire_vk_pipeline_cache(device), 1, &pipeline_info, NULL, vk_pipeline));
+    d3d12_device_release_vk_pipeline_cache(device);
     VK_CALL(vkDestroyShaderModule(device->vk_device, pipeline_info.stage.module, NULL));
     if (vr < 0)
     {
@@ -2509,6 +2528,7 @@ HRESULT d3d12_pipeline_state_create_compute(struct d3d12_device *device,
         vkd3d_free(object);
         return hr;
     }
+    vkd3d_pipeline_state_desc_get_key(&object->desc_key, &pipeline_desc);
 
     TRACE("Created compute pipeline state %p.\n", object);
 
@@ -3517,6 +3537,7 @@ HRESULT d3d12_pipeline_state_create_graphics(struct d3d12_device *device,
         vkd3d_free(object);
         return hr;
     }
+    vkd3d_pipeline_state_desc_get_key(&object->desc_key, &pipeline_desc);
 
     TRACE("Created graphics pipeline state %p.\n", object);
 
@@ -3558,6 +3579,7 @@ HRESULT d3d12_pipeline_state_create(struct d3d12_device *device,
         vkd3d_free(object);
         return hr;
     }
+    vkd3d_pipeline_state_desc_get_key(&object->desc_key, &pipeline_desc);
 
     TRACE("Created pipeline state %p.\n", object);
 
@@ -3862,8 +3884,10 @@ VkPipeline d3d12_pipeline_state_get_or_create_pipeline(struct d3d12_pipeline_sta
 
     *vk_render_pass = pipeline_desc.renderPass;
 
-    if ((vr = VK_CALL(vkCreateGraphicsPipelines(device->vk_device, device->vk_pipeline_cache,
-            1, &pipeline_desc, NULL, &vk_pipeline))) < 0)
+    vr = VK_CALL(vkCreateGraphicsPipelines(device->vk_device, d3d12_device_acquire_vk_pipeline_cache(device),
+            1, &pipeline_desc, NULL, &vk_pipeline));
+    d3d12_device_release_vk_pipeline_cache(device);
+    if (vr < 0)
     {
         WARN("Failed to create Vulkan graphics pipeline, vr %d.\n", vr);
         return VK_NULL_HANDLE;
@@ -518,6 +518,35 @@ HRESULT vkd3d_render_pass_cache_find(struct vkd3d_render_pass_cache *cache, stru
         const struct vkd3d_render_pass_key *key, VkRenderPass *vk_render_pass);
 void vkd3d_render_pass_cache_init(struct vkd3d_render_pass_cache *cache);
 
+struct vkd3d_shader_cache_key
+{
+    uint64_t hash[2];
+    uint64_t size;
+};
+
+/* SPIR-V produced by vkd3d-shader, keyed by the source and compile parameters. */
+struct vkd3d_shader_cache
+{
+    struct vkd3d_mutex mutex;
+    struct rb_tree entries;
+    struct list lru; /* most recently used first */
+    size_t size;
+    unsigned int count;
+    bool modified;
+
+    unsigned int hits;
+    unsigned int misses;
+};
+
+bool vkd3d_shader_cache_key_init_compile_info(struct vkd3d_shader_cache_key *key,
+        const struct vkd3d_shader_compile_info *compile_info);
+void vkd3d_shader_cache_cleanup(struct vkd3d_shader_cache *cache);
+bool vkd3d_shader_cache_get(struct vkd3d_shader_cache *cache,
+        const struct vkd3d_shader_cache_key *key, struct vkd3d_shader_code *code);
+void vkd3d_shader_cache_init(struct vkd3d_shader_cache *cache);
+void vkd3d_shader_cache_put(struct vkd3d_shader_cache *cache,
+        const struct vkd3d_shader_cache_key *key, const struct vkd3d_shader_code *code);
+
 struct vkd3d_private_store
 {
     struct vkd3d_mutex mutex;
@@ -1281,6 +1310,9 @@ struct d3d12_pipeline_state
 
     struct d3d12_device *device;
 
+    /* Hash of the description, used to validate pipeline library loads. */
+    struct vkd3d_shader_cache_key desc_key;
+
     struct vkd3d_private_store private_store;
 };
 
@@ -1332,6 +1364,9 @@ struct d3d12_pipeline_state_desc
     D3D12_PIPELINE_STATE_FLAGS flags;
 };
 
+void vkd3d_pipeline_state_desc_get_key(struct vkd3d_shader_cache_key *key,
+        const struct d3d12_pipeline_state_desc *desc);
+
 HRESULT d3d12_pipeline_state_create_compute(struct d3d12_device *device,
         const D3D12_COMPUTE_PIPELINE_STATE_DESC *desc, struct d3d12_pipeline_state **state);
 HRESULT d3d12_pipeline_state_create_graphics(struct d3d12_device *device,
@@ -1342,6 +1377,27 @@ VkPipeline d3d12_pipeline_state_get_or_create_pipeline(struct d3d12_pipeline_sta
         D3D12_PRIMITIVE_TOPOLOGY topology, const uint32_t *strides, VkFormat dsv_format, VkRenderPass *vk_render_pass);
 struct d3d12_pipeline_state *unsafe_impl_from_ID3D12PipelineState(ID3D12PipelineState *iface);
 
+/* ID3D12PipelineLibrary */
+struct d3d12_pipeline_library
+{
+    ID3D12PipelineLibrary1 ID3D12PipelineLibrary1_iface;
+    unsigned int refcount;
+
+    struct vkd3d_mutex mutex;
+    struct rb_tree entries;
+    size_t entry_count;
+
+    unsigned int hits;
+    unsigned int misses;
+
+    struct d3d12_device *device;
+
+    struct vkd3d_private_store private_store;
+};
+
+HRESULT d3d12_pipeline_library_create(struct d3d12_device *device, const void *blob,
+        size_t blob_size, struct d3d12_pipeline_library **library);
+
 struct vkd3d_buffer
 {
     VkBuffer vk_buffer;
@@ -1765,6 +1821,12 @@ struct d3d12_device
     struct vkd3d_mutex pipeline_cache_mutex;
     struct vkd3d_render_pass_cache render_pass_cache;
     VkPipelineCache vk_pipeline_cache;
+    unsigned int pipeline_cache_users;
+    VkPipelineCache *retired_pipeline_caches;
+    size_t retired_pipeline_cache_capacity;
+    size_t retired_pipeline_cache_count;
+    struct vkd3d_shader_cache shader_cache;
+    size_t cache_file_size;
 
     VkPhysicalDeviceMemoryProperties memory_properties;
 
@@ -1811,6 +1873,8 @@ bool d3d12_device_is_uma(struct d3d12_device *device, bool *coherent);
 void d3d12_device_mark_as_removed(struct d3d12_device *device, HRESULT reason,
         const char *message, ...) VKD3D_PRINTF_FUNC(3, 4);
 struct d3d12_device *unsafe_impl_from_ID3D12Device7(ID3D12Device7 *iface);
+void *vkd3d_device_cache_read(struct d3d12_device *device, const void **pipeline_data, size_t *pipeline_data_size);
+void vkd3d_device_cache_write(struct d3d12_device *device);
 HRESULT d3d12_device_add_descriptor_heap(struct d3d12_device *device, struct d3d12_descriptor_heap *heap);
 void d3d12_device_remove_descriptor_heap(struct d3d12_device *device, struct d3d12_descriptor_heap *heap);
 
@@ -1819,6 +1883,11 @@ static inline HRESULT d3d12_device_query_interface(struct d3d12_device *device,
     return ID3D12Device7_QueryInterface(&device->ID3D12Device7_iface, iid, object);
 }
 
+/* The device pipeline cache may be replaced when a pipeline library is loaded;
+ * callers using it must release it once the pipeline has been created. */
+VkPipelineCache d3d12_device_acquire_vk_pipeline_cache(struct d3d12_device *device);
+void d3d12_device_release_vk_pipeline_cache(struct d3d12_device *device);
+
 static inline ULONG d3d12_device_add_ref(struct d3d12_device *device)
 {
     return ID3D12Device7_AddRef(&device->ID3D12Device7_iface);
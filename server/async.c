@@ -675,6 +675,21 @@ void async_wake_up( struct async_queue *queue, unsigned int status )
     }
 }
 
+/* wake up a specific async of the given process, identified by its client pointer */
+int async_wake_up_user( struct async_queue *queue, struct process *process, client_ptr_t user,
+                        unsigned int status )
+{
+    struct async *async;
+
+    LIST_FOR_EACH_ENTRY( async, &queue->queue, struct async, queue_entry )
+    {
+        if (async->terminated || async->data.user != user || async->thread->process != process) continue;
+        async_terminate( async, status );
+        return 1;
+    }
+    return 0;
+}
+
 static void iosb_dump( struct object *obj, int verbose );
 static void iosb_destroy( struct object *obj );
 
@@ -30,6 +30,8 @@
 
 #include <stdarg.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -58,9 +60,12 @@ struct type_descr completion_type =
 
 struct completion
 {
-    struct object  obj;
-    struct list    queue;
-    unsigned int   depth;
+    struct object           obj;
+    struct list             queue;      /* messages that didn't fit in the ring */
+    unsigned int            depth;      /* number of messages in queue */
+    struct completion_ring *ring;       /* shared message ring, created on demand */
+    int                     ring_fd;    /* unix fd of the ring mapping */
+    unsigned int            ring_tail;  /* our copy of ring->tail, which clients can write to */
 };
 
 static void completion_dump( struct object*, int );
@@ -109,6 +114,95 @@ static void completion_destroy( struct object *obj)
     {
         free( tmp );
     }
+    if (completion->ring) munmap( completion->ring, sizeof(*completion->ring) );
+    if (completion->ring_fd != -1) close( completion->ring_fd );
+}
+
+/* number of messages in the ring; head is advanced by the clients, don't trust it */
+static unsigned int get_ring_depth( struct completion *completion )
+{
+    unsigned int count;
+
+    if (!completion->ring) return 0;
+    count = completion->ring_tail - __atomic_load_n( &completion->ring->head, __ATOMIC_ACQUIRE );
+    return min( count, COMPLETION_RING_SIZE );
+}
+
+static int ring_push( struct completion *completion, const struct comp_msg *msg )
+{
+    struct completion_ring *ring = completion->ring;
+    struct completion_msg *entry;
+
+    if (get_ring_depth( completion ) >= COMPLETION_RING_SIZE) return 0;
+
+    entry = &ring->msgs[completion->ring_tail % COMPLETION_RING_SIZE];
+    entry->ckey        = msg->ckey;
+    entry->cvalue      = msg->cvalue;
+    entry->information = msg->information;
+    entry->status      = msg->status;
+    entry->__pad       = 0;
+    __atomic_store_n( &ring->tail, ++completion->ring_tail, __ATOMIC_RELEASE );
+    return 1;
+}
+
+static int ring_pop( struct completion *completion, struct completion_msg *msg )
+{
+    struct completion_ring *ring = completion->ring;
+    unsigned int head;
+
+    if (!ring) return 0;
+
+    head = __atomic_load_n( &ring->head, __ATOMIC_ACQUIRE );
+    do
+    {
+        if (completion->ring_tail - head - 1 >= COMPLETION_RING_SIZE) return 0;
+        *msg = ring->msgs[head % COMPLETION_RING_SIZE];
+    } while (!__atomic_compare_exchange_n( &ring->head, &head, head + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE ));
+    return 1;
+}
+
+/* move queued messages into the ring, as long as they fit */
+static void refill_ring( struct completion *completion )
+{
+    struct comp_msg *msg, *next;
+
+    if (!completion->ring) return;
+
+    LIST_FOR_EACH_ENTRY_SAFE( msg, next, &completion->queue, struct comp_msg, queue_entry )
+    {
+        if (!ring_push( completion, msg )) break;
+        list_remove( &msg->queue_entry );
+        completion->depth--;
+        free( msg );
+    }
+}
+
+static struct completion_ring *get_completion_ring( struct completion *completion )
+{
+    const file_pos_t size = sizeof(struct completion_ring);
+    struct completion_ring *ring;
+    int fd;
+
+    if (completion->ring) return completion->ring;
+
+    if ((fd = create_temp_file( size )) == -1)
+    {
+        file_set_error();
+        return NULL;
+    }
+    if ((ring = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) == MAP_FAILED)
+    {
+        file_set_error();
+        close( fd );
+        return NULL;
+    }
+
+    ring->head = ring->tail = 0;
+    completion->ring = ring;
+    completion->ring_fd = fd;
+    completion->ring_tail = 0;
+    refill_ring( completion );
+    return ring;
 }
 
 static void completion_dump( struct object *obj, int verbose )
@@ -116,14 +210,14 @@ static void completion_dump( struct object *obj, int verbose )
     struct completion *completion = (struct completion *) obj;
 
     assert( obj->ops == &completion_ops );
-    fprintf( stderr, "Completion depth=%u\n", completion->depth );
+    fprintf( stderr, "Completion depth=%u\n", completion->depth + get_ring_depth( completion ) );
 }
 
 static int completion_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct completion *completion = (struct completion *)obj;
 
-    return !list_empty( &completion->queue );
+    return !list_empty( &completion->queue ) || get_ring_depth( completion );
 }
 
 static struct completion *create_completion( struct object *root, const struct unicode_str *name,
@@ -138,6 +232,9 @@ static struct completion *create_completion( struct object *root, const struct u
         {
             list_init( &completion->queue );
             completion->depth = 0;
+            completion->ring = NULL;
+            completion->ring_fd = -1;
+            completion->ring_tail = 0;
         }
     }
 
@@ -162,8 +259,15 @@ void add_completion( struct completion *completion, apc_param_t ckey, apc_param_
     msg->status = status;
     msg->information = information;
 
-    list_add_tail( &completion->queue, &msg->queue_entry );
-    completion->depth++;
+    /* keep the messages ordered, the queue holds the ones that arrived after the ring was full */
+    refill_ring( completion );
+    if (list_empty( &completion->queue ) && completion->ring && ring_push( completion, msg ))
+        free( msg );
+    else
+    {
+        list_add_tail( &completion->queue, &msg->queue_entry );
+        completion->depth++;
+    }
     wake_up( &completion->obj, 1 );
 }
 
@@ -209,28 +313,60 @@ DECL_HANDLER(add_completion)
     release_object( completion );
 }
 
+/* remove the oldest message, from the ring first since queued messages are always newer */
+static int remove_msg( struct completion *completion, struct completion_msg *msg )
+{
+    struct comp_msg *entry;
+
+    if (!ring_pop( completion, msg ))
+    {
+        if (list_empty( &completion->queue )) return 0;
+        entry = LIST_ENTRY( list_head( &completion->queue ), struct comp_msg, queue_entry );
+        list_remove( &entry->queue_entry );
+        completion->depth--;
+        msg->ckey        = entry->ckey;
+        msg->cvalue      = entry->cvalue;
+        msg->information = entry->information;
+        msg->status      = entry->status;
+        msg->__pad       = 0;
+        free( entry );
+    }
+    refill_ring( completion );
+    return 1;
+}
+
 /* get completion from completion port */
 DECL_HANDLER(remove_completion)
 {
     struct completion* completion = get_completion_obj( current->process, req->handle, IO_COMPLETION_MODIFY_STATE );
-    struct list *entry;
-    struct comp_msg *msg;
+    struct completion_msg msg;
 
     if (!completion) return;
 
-    entry = list_head( &completion->queue );
-    if (!entry)
+    if (!remove_msg( completion, &msg ))
         set_error( STATUS_PENDING );
     else
     {
-        list_remove( entry );
-        completion->depth--;
-        msg = LIST_ENTRY( entry, struct comp_msg, queue_entry );
-        reply->ckey = msg->ckey;
-        reply->cvalue = msg->cvalue;
-        reply->status = msg->status;
-        reply->information = msg->information;
-        free( msg );
+        reply->ckey = msg.ckey;
+        reply->cvalue = msg.cvalue;
+        reply->status = msg.status;
+        reply->information = msg.information;
+    }
+
+    release_object( completion );
+}
+
+/* get a unix fd for the completion message ring */
+DECL_HANDLER(get_completion_ring)
+{
+    struct completion* completion = get_completion_obj( current->process, req->handle, IO_COMPLETION_MODIFY_STATE );
+
+    if (!completion) return;
+
+    if (get_completion_ring( completion ))
+    {
+        reply->size = sizeof(struct completion_ring);
+        send_client_fd( current->process, completion->ring_fd, req->handle );
     }
 
     release_object( completion );
@@ -243,7 +379,7 @@ DECL_HANDLER(query_completion)
 
     if (!completion) return;
 
-    reply->depth = completion->depth;
+    reply->depth = completion->depth + get_ring_depth( completion );
 
     release_object( completion );
 }
@@ -176,6 +176,7 @@ struct memory_view;
 
 extern void init_memory(void);
 extern int grow_file( int unix_fd, file_pos_t new_size );
+extern int create_temp_file( file_pos_t size );
 extern void free_map_addr( client_ptr_t base, mem_size_t size );
 extern struct memory_view *find_mapped_view( struct process *process, client_ptr_t base );
 extern struct memory_view *get_exe_view( struct process *process );
@@ -244,6 +245,8 @@ extern void async_request_complete( struct async *async, unsigned int status, da
 extern void async_request_complete_alloc( struct async *async, unsigned int status, data_size_t result,
                                           data_size_t out_size, const void *out_data );
 extern void async_wake_up( struct async_queue *queue, unsigned int status );
+extern int async_wake_up_user( struct async_queue *queue, struct process *process, client_ptr_t user,
+                               unsigned int status );
 extern struct completion *fd_get_completion( struct fd *fd, apc_param_t *p_key );
 extern void fd_copy_completion( struct fd *src, struct fd *dst );
 extern struct iosb *async_get_iosb( struct async *async );
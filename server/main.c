@@ -38,6 +38,7 @@
 /* command-line options */
 int debug_level = 0;
 int foreground = 0;
+int direct_pipes = 0;
 timeout_t master_socket_timeout = 3 * -TICKS_PER_SEC;  /* master socket timeout, default is 3 seconds */
 const char *server_argv0;
 
@@ -48,6 +49,7 @@ static void usage( FILE *fh )
     fprintf(fh, "Usage: %s [options]\n\n", server_argv0);
     fprintf(fh, "Options:\n");
     fprintf(fh, "   -d[n], --debug[=n]       set debug level to n or +1 if n not specified\n");
+    fprintf(fh, "          --direct-pipes    let connected byte mode pipes bypass the server\n");
     fprintf(fh, "   -f,    --foreground      remain in the foreground for debugging\n");
     fprintf(fh, "   -h,    --help            display this help message\n");
     fprintf(fh, "   -k[n], --kill[=n]        kill the current wineserver, optionally with signal n\n");
@@ -72,6 +74,9 @@ static void option_callback( int optc, char *optarg )
     case 'f':
         foreground = 1;
         break;
+    case 'D':
+        direct_pipes = 1;
+        break;
     case 'h':
         usage(stdout);
         exit(0);
@@ -108,6 +113,7 @@ static struct long_option
 } long_options[] =
 {
     {"debug",       2, 'd'},
+    {"direct-pipes", 0, 'D'},
     {"foreground",  0, 'f'},
     {"help",        0, 'h'},
     {"kill",        2, 'k'},
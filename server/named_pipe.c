@@ -27,7 +27,19 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#ifdef HAVE_SYS_FILIO_H
+# include <sys/filio.h>
+#endif
+#include <unistd.h>
+
+#if defined(__linux__) && !defined(SIOCOUTQ)
+# define SIOCOUTQ TIOCOUTQ
+#endif
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -66,6 +78,8 @@ struct pipe_end
     struct list          message_queue;
     struct async_queue   read_q;     /* read queue */
     struct async_queue   write_q;    /* write queue */
+    struct fd           *direct_fd;  /* socket used for the direct data path */
+    struct timeout_user *flush_timeout; /* timer polling the socket during a flush */
 };
 
 struct pipe_server
@@ -243,6 +257,41 @@ static const struct fd_ops pipe_client_fd_ops =
     pipe_end_reselect_async       /* reselect_async */
 };
 
+/* fd operations used once a pipe end is connected through a socket; data is
+ * read and written directly by the clients, the server only handles control
+ * requests and polls the socket for asynchronous I/O */
+static const struct fd_ops pipe_server_direct_fd_ops =
+{
+    default_fd_get_poll_events,   /* get_poll_events */
+    default_poll_event,           /* poll_event */
+    pipe_end_get_fd_type,         /* get_fd_type */
+    no_fd_read,                   /* read */
+    no_fd_write,                  /* write */
+    pipe_end_flush,               /* flush */
+    pipe_end_get_file_info,       /* get_file_info */
+    pipe_end_get_volume_info,     /* get_volume_info */
+    pipe_server_ioctl,            /* ioctl */
+    default_fd_cancel_async,      /* cancel_async */
+    default_fd_queue_async,       /* queue_async */
+    default_fd_reselect_async     /* reselect_async */
+};
+
+static const struct fd_ops pipe_client_direct_fd_ops =
+{
+    default_fd_get_poll_events,   /* get_poll_events */
+    default_poll_event,           /* poll_event */
+    pipe_end_get_fd_type,         /* get_fd_type */
+    no_fd_read,                   /* read */
+    no_fd_write,                  /* write */
+    pipe_end_flush,               /* flush */
+    pipe_end_get_file_info,       /* get_file_info */
+    pipe_end_get_volume_info,     /* get_volume_info */
+    pipe_client_ioctl,            /* ioctl */
+    default_fd_cancel_async,      /* cancel_async */
+    default_fd_queue_async,       /* queue_async */
+    default_fd_reselect_async     /* reselect_async */
+};
+
 static void named_pipe_device_dump( struct object *obj, int verbose );
 static struct object *named_pipe_device_lookup_name( struct object *obj,
     struct unicode_str *name, unsigned int attr, struct object *root );
@@ -371,9 +420,81 @@ static void named_pipe_destroy( struct object *obj)
 static struct fd *pipe_end_get_fd( struct object *obj )
 {
     struct pipe_end *pipe_end = (struct pipe_end *) obj;
+    if (pipe_end->direct_fd) return (struct fd *) grab_object( pipe_end->direct_fd );
     return (struct fd *) grab_object( pipe_end->fd );
 }
 
+/* create the socket pair used by both ends of a newly connected pipe */
+static void pipe_end_connect_direct( struct pipe_end *server_end, struct pipe_end *client )
+{
+    int fds[2];
+
+    if (!direct_pipes || server_end->pipe->message_mode) return;
+    if (server_end->flags & (NAMED_PIPE_MESSAGE_STREAM_READ | NAMED_PIPE_NONBLOCKING_MODE)) return;
+
+    if (socketpair( PF_UNIX, SOCK_STREAM, 0, fds )) return;
+    fcntl( fds[0], F_SETFL, O_NONBLOCK );
+    fcntl( fds[1], F_SETFL, O_NONBLOCK );
+
+    if (!(server_end->direct_fd = create_anonymous_fd( &pipe_server_direct_fd_ops, fds[0], &server_end->obj,
+                                                       get_fd_options( server_end->fd ) )))
+    {
+        close( fds[1] );
+        clear_error();
+        return;
+    }
+    if (!(client->direct_fd = create_anonymous_fd( &pipe_client_direct_fd_ops, fds[1], &client->obj,
+                                                   get_fd_options( client->fd ) )))
+    {
+        release_object( server_end->direct_fd );
+        server_end->direct_fd = NULL;
+        clear_error();
+        return;
+    }
+    /* the server end gets a new socket on each connection, so only the client fd can be cached;
+     * once the client is disconnected its socket is shut down and reads see end of file */
+    allow_fd_caching( client->direct_fd );
+}
+
+static void pipe_end_close_direct( struct pipe_end *pipe_end, unsigned int status )
+{
+    if (pipe_end->flush_timeout)
+    {
+        remove_timeout_user( pipe_end->flush_timeout );
+        pipe_end->flush_timeout = NULL;
+    }
+    if (!pipe_end->direct_fd) return;
+
+    /* processes may have cached the unix fd, make sure the peer sees the disconnection */
+    shutdown( get_unix_fd( pipe_end->direct_fd ), SHUT_RDWR );
+    fd_async_wake_up( pipe_end->direct_fd, ASYNC_TYPE_READ, status );
+    fd_async_wake_up( pipe_end->direct_fd, ASYNC_TYPE_WRITE, status );
+    release_object( pipe_end->direct_fd );
+    pipe_end->direct_fd = NULL;
+}
+
+/* amount of data written through the socket and not yet read by the peer */
+static int pipe_end_get_direct_outq( struct pipe_end *pipe_end )
+{
+#ifdef SIOCOUTQ
+    int queued;
+
+    if (!ioctl( get_unix_fd( pipe_end->direct_fd ), SIOCOUTQ, &queued ) && queued > 0) return queued;
+#endif
+    return 0;
+}
+
+static void pipe_end_flush_timeout( void *private )
+{
+    struct pipe_end *pipe_end = private;
+
+    pipe_end->flush_timeout = NULL;
+    if (pipe_end->direct_fd && pipe_end_get_direct_outq( pipe_end ))
+        pipe_end->flush_timeout = add_timeout_user( -TICKS_PER_SEC / 100, pipe_end_flush_timeout, pipe_end );
+    else
+        fd_async_wake_up( pipe_end->fd, ASYNC_TYPE_WAIT, STATUS_SUCCESS );
+}
+
 static struct pipe_message *queue_message( struct pipe_end *pipe_end, struct iosb *iosb )
 {
     struct pipe_message *message;
@@ -414,6 +535,8 @@ static void pipe_end_disconnect( struct pipe_end *pipe_end, unsigned int status
 
     pipe_end->state = status == STATUS_PIPE_DISCONNECTED
         ? FILE_PIPE_DISCONNECTED_STATE : FILE_PIPE_CLOSING_STATE;
+    /* data still buffered in the socket remains readable after the peer has been closed */
+    if (status == STATUS_PIPE_DISCONNECTED) pipe_end_close_direct( pipe_end, status );
     fd_async_wake_up( pipe_end->fd, ASYNC_TYPE_WAIT, status );
     async_wake_up( &pipe_end->read_q, status );
     LIST_FOR_EACH_ENTRY_SAFE( message, next, &pipe_end->message_queue, struct pipe_message, entry )
@@ -447,6 +570,7 @@ static void pipe_end_destroy( struct object *obj )
         free_message( message );
     }
 
+    pipe_end_close_direct( pipe_end, STATUS_PIPE_BROKEN );
     free_async_queue( &pipe_end->read_q );
     free_async_queue( &pipe_end->write_q );
     if (pipe_end->fd) release_object( pipe_end->fd );
@@ -591,6 +715,19 @@ static void pipe_end_flush( struct fd *fd, struct async *async )
         return;
     }
 
+    if (pipe_end->direct_fd)
+    {
+        /* there is no notification when the peer reads from the socket, poll it instead */
+        if (pipe_end_get_direct_outq( pipe_end ))
+        {
+            fd_queue_async( pipe_end->fd, async, ASYNC_TYPE_WAIT );
+            if (!pipe_end->flush_timeout)
+                pipe_end->flush_timeout = add_timeout_user( -TICKS_PER_SEC / 100, pipe_end_flush_timeout, pipe_end );
+            set_error( STATUS_PENDING );
+        }
+        return;
+    }
+
     if (pipe_end->connection && !list_empty( &pipe_end->connection->message_queue ))
     {
         fd_queue_async( pipe_end->fd, async, ASYNC_TYPE_WAIT );
@@ -603,6 +740,14 @@ static data_size_t pipe_end_get_avail( struct pipe_end *pipe_end )
     struct pipe_message *message;
     data_size_t avail = 0;
 
+    if (pipe_end->direct_fd)
+    {
+        int count;
+
+        if (ioctl( get_unix_fd( pipe_end->direct_fd ), FIONREAD, &count ) || count < 0) return 0;
+        return count;
+    }
+
     LIST_FOR_EACH_ENTRY( message, &pipe_end->message_queue, struct pipe_message, entry )
         avail += message->iosb->in_size - message->read_pos;
 
@@ -1019,6 +1164,32 @@ static enum server_fd_type pipe_end_get_fd_type( struct fd *fd )
     return FD_TYPE_PIPE;
 }
 
+static void pipe_end_peek_direct( struct pipe_end *pipe_end, data_size_t reply_size )
+{
+    FILE_PIPE_PEEK_BUFFER *buffer;
+    data_size_t avail = pipe_end_get_avail( pipe_end );
+    char *data = NULL;
+    ssize_t ret = 0;
+
+    reply_size = min( reply_size, avail );
+    if (reply_size)
+    {
+        if (!(data = mem_alloc( reply_size ))) return;
+        ret = recv( get_unix_fd( pipe_end->direct_fd ), data, reply_size, MSG_PEEK | MSG_DONTWAIT );
+        if (ret < 0) ret = 0;
+    }
+
+    if ((buffer = set_reply_data_size( offsetof( FILE_PIPE_PEEK_BUFFER, Data[ret] ) )))
+    {
+        buffer->NamedPipeState    = pipe_end->state;
+        buffer->ReadDataAvailable = avail;
+        buffer->NumberOfMessages  = 0;
+        buffer->MessageLength     = 0;
+        memcpy( buffer->Data, data, ret );
+    }
+    free( data );
+}
+
 static void pipe_end_peek( struct pipe_end *pipe_end )
 {
     unsigned reply_size = get_reply_max_size();
@@ -1040,6 +1211,7 @@ static void pipe_end_peek( struct pipe_end *pipe_end )
         break;
     case FILE_PIPE_CLOSING_STATE:
         if (!list_empty( &pipe_end->message_queue )) break;
+        if (pipe_end->direct_fd && pipe_end_get_avail( pipe_end )) break;
         set_error( STATUS_PIPE_BROKEN );
         return;
     default:
@@ -1047,6 +1219,12 @@ static void pipe_end_peek( struct pipe_end *pipe_end )
         return;
     }
 
+    if (pipe_end->direct_fd)
+    {
+        pipe_end_peek_direct( pipe_end, reply_size );
+        return;
+    }
+
     LIST_FOR_EACH_ENTRY( message, &pipe_end->message_queue, struct pipe_message, entry )
         avail += message->iosb->in_size - message->read_pos;
     reply_size = min( reply_size, avail );
@@ -1263,6 +1441,8 @@ static void init_pipe_end( struct pipe_end *pipe_end, struct named_pipe *pipe,
     pipe_end->flags = pipe_flags;
     pipe_end->connection = NULL;
     pipe_end->buffer_size = buffer_size;
+    pipe_end->direct_fd = NULL;
+    pipe_end->flush_timeout = NULL;
     init_async_queue( &pipe_end->read_q );
     init_async_queue( &pipe_end->write_q );
     list_init( &pipe_end->message_queue );
@@ -1289,7 +1469,8 @@ static struct pipe_server *create_pipe_server( struct named_pipe *pipe, unsigned
         release_object( server );
         return NULL;
     }
-    allow_fd_caching( server->pipe_end.fd );
+    /* with direct pipes, the unix fd changes on connection */
+    if (!direct_pipes) allow_fd_caching( server->pipe_end.fd );
     set_fd_signaled( server->pipe_end.fd, 1 );
     async_wake_up( &pipe->waiters, STATUS_SUCCESS );
     return server;
@@ -1365,6 +1546,7 @@ static struct object *named_pipe_open_file( struct object *obj, unsigned int acc
         server->pipe_end.client_pid = client->client_pid;
         client->server_pid = server->pipe_end.server_pid;
         list_remove( &server->entry );
+        pipe_end_connect_direct( &server->pipe_end, client );
     }
     return &client->obj;
 }
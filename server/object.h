@@ -294,6 +294,7 @@ extern struct object *create_symlink( struct object *root, const struct unicode_
   /* command-line options */
 extern int debug_level;
 extern int foreground;
+extern int direct_pipes;
 extern timeout_t master_socket_timeout;
 extern const char *server_argv0;
 
@@ -4082,6 +4082,22 @@ DECL_HANDLER(socket_send_icmp_id)
     release_object( sock );
 }
 
+DECL_HANDLER(socket_wake_recv)
+{
+    struct sock *sock = (struct sock *)get_handle_obj( current->process, req->handle, 0, &sock_ops );
+    const client_ptr_t *asyncs = get_req_data();
+    data_size_t i, count = get_req_data_size() / sizeof(*asyncs);
+
+    if (!sock) return;
+
+    /* the client has already filled the buffers of these asyncs with
+     * datagrams received in a batch, let it complete them */
+    for (i = 0; i < count; ++i)
+        async_wake_up_user( &sock->read_q, current->process, asyncs[i], STATUS_ALERTED );
+
+    release_object( sock );
+}
+
 DECL_HANDLER(socket_get_icmp_id)
 {
     struct sock *sock = (struct sock *)get_handle_obj( current->process, req->handle, 0, &sock_ops );
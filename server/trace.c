@@ -2097,6 +2097,12 @@ static void dump_socket_get_icmp_id_reply( const struct socket_get_icmp_id_reply
     fprintf( stderr, " icmp_id=%04x", req->icmp_id );
 }
 
+static void dump_socket_wake_recv_request( const struct socket_wake_recv_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    dump_varargs_uints64( ", asyncs=", cur_size );
+}
+
 static void dump_get_next_console_request_request( const struct get_next_console_request_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4360,6 +4366,16 @@ static void dump_remove_completion_reply( const struct remove_completion_reply *
     fprintf( stderr, ", status=%08x", req->status );
 }
 
+static void dump_get_completion_ring_request( const struct get_completion_ring_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_completion_ring_reply( const struct get_completion_ring_reply *req )
+{
+    fprintf( stderr, " size=%u", req->size );
+}
+
 static void dump_query_completion_request( const struct query_completion_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4649,6 +4665,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_socket_get_events_request,
     (dump_func)dump_socket_send_icmp_id_request,
     (dump_func)dump_socket_get_icmp_id_request,
+    (dump_func)dump_socket_wake_recv_request,
     (dump_func)dump_get_next_console_request_request,
     (dump_func)dump_read_directory_changes_request,
     (dump_func)dump_read_change_request,
@@ -4849,6 +4866,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_request,
     (dump_func)dump_add_completion_request,
     (dump_func)dump_remove_completion_request,
+    (dump_func)dump_get_completion_ring_request,
     (dump_func)dump_query_completion_request,
     (dump_func)dump_set_completion_info_request,
     (dump_func)dump_add_fd_completion_request,
@@ -4937,6 +4955,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_socket_get_events_reply,
     NULL,
     (dump_func)dump_socket_get_icmp_id_reply,
+    NULL,
     (dump_func)dump_get_next_console_request_reply,
     NULL,
     (dump_func)dump_read_change_reply,
@@ -5137,6 +5156,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_reply,
     NULL,
     (dump_func)dump_remove_completion_reply,
+    (dump_func)dump_get_completion_ring_reply,
     (dump_func)dump_query_completion_reply,
     NULL,
     NULL,
@@ -5225,6 +5245,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "socket_get_events",
     "socket_send_icmp_id",
     "socket_get_icmp_id",
+    "socket_wake_recv",
     "get_next_console_request",
     "read_directory_changes",
     "read_change",
@@ -5425,6 +5446,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "open_completion",
     "add_completion",
     "remove_completion",
+    "get_completion_ring",
     "query_completion",
     "set_completion_info",
     "add_fd_completion",